@@ -0,0 +1,185 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ArchiveWriter.h"
+#include "Sha256.h"
+
+#include <QDebug>
+#include <QTemporaryFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace {
+enum {
+    MergeBufferSize = 1024 // entries read from a spilled run at a time
+};
+
+// a sorted run in the temporary file, read back a buffer at a time.
+struct SpilledRun {
+    qint64 position; // the first entry not in the buffer yet
+    qint64 end;
+    QVector<ArchiveWriter::IndexEntry> buffer;
+    int next;
+};
+
+bool fillBuffer(QIODevice *file, SpilledRun &run)
+{
+    const int count = static_cast<int>(qMin<qint64>(MergeBufferSize, run.end - run.position));
+    run.buffer.resize(count);
+    const qint64 size = count * static_cast<qint64>(sizeof(ArchiveWriter::IndexEntry));
+    if (!file->seek(run.position * sizeof(ArchiveWriter::IndexEntry))
+            || file->read(reinterpret_cast<char*>(run.buffer.data()), size) != size)
+        return false;
+    run.position += count;
+    run.next = 0;
+    return true;
+}
+
+// the next entry of a sorted run, for merging them.
+struct RunHead {
+    ArchiveWriter::IndexEntry entry;
+    int run;
+    inline bool operator>(const RunHead &other) const {
+        return other.entry < entry;
+    }
+};
+}
+
+ArchiveWriter::ArchiveWriter(QIODevice *device, int runSize)
+    : m_out(device),
+      m_count(0),
+      m_runSize(runSize),
+      m_spill(0),
+      m_spillFailed(false)
+{
+    Q_ASSERT(runSize > 0);
+    m_out.append("TXARCHV1");
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    delete m_spill;
+}
+
+void ArchiveWriter::append(const char *txid, const char *data, int size)
+{
+    Q_ASSERT(txid);
+    Q_ASSERT(size >= 0);
+    IndexEntry entry;
+    entry.key = qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(txid));
+    entry.offset = m_out.bytesWritten();
+    m_current.append(entry);
+    if (m_current.size() == m_runSize)
+        spillRun();
+
+    m_out.append32bitValue(size);
+    m_out.append(txid, Sha256::HashSize);
+    m_out.append(data, size);
+    ++m_count;
+}
+
+bool ArchiveWriter::finish()
+{
+    while (m_out.bytesWritten() % 8)
+        m_out.append('\0');
+    const qint64 indexOffset = m_out.bytesWritten();
+
+    bool ok = true;
+    if (m_runEnds.isEmpty()) { // it all fit in one run
+        std::sort(m_current.begin(), m_current.end());
+        foreach (const IndexEntry &entry, m_current) {
+            m_out.append64bitValue(entry.key);
+            m_out.append64bitValue(entry.offset);
+        }
+        m_current.clear();
+    } else {
+        if (!m_current.isEmpty())
+            spillRun();
+        ok = mergeSpilledRuns();
+    }
+    delete m_spill;
+    m_spill = 0;
+    m_runEnds.clear();
+
+    m_out.append64bitValue(indexOffset);
+    m_out.append64bitValue(m_count);
+    m_out.append("TXINDEX1");
+    return m_out.flush() && m_out.isOk() && ok;
+}
+
+void ArchiveWriter::spillRun()
+{
+    std::sort(m_current.begin(), m_current.end());
+    if (!m_spill) {
+        m_spill = new QTemporaryFile();
+        if (!m_spill->open()) {
+            qWarning() << "Failed to create a temporary file for the archive index";
+            m_spillFailed = true;
+        }
+    }
+    const qint64 size = m_current.size() * static_cast<qint64>(sizeof(IndexEntry));
+    if (!m_spillFailed && m_spill->write(reinterpret_cast<const char*>(m_current.constData()), size) != size) {
+        qWarning() << "Failed to write the archive index to its temporary file";
+        m_spillFailed = true;
+    }
+    m_runEnds.append((m_runEnds.isEmpty() ? 0 : m_runEnds.last()) + m_current.size());
+    m_current.clear();
+}
+
+bool ArchiveWriter::mergeSpilledRuns()
+{
+    if (m_spillFailed)
+        return false;
+    QVector<SpilledRun> runs(m_runEnds.size());
+    std::priority_queue<RunHead, std::vector<RunHead>, std::greater<RunHead> > heads;
+    for (int i = 0; i < runs.size(); ++i) {
+        SpilledRun &run = runs[i];
+        run.position = i == 0 ? 0 : m_runEnds.at(i - 1);
+        run.end = m_runEnds.at(i);
+        if (!fillBuffer(m_spill, run))
+            break;
+        RunHead head;
+        head.entry = run.buffer.at(0);
+        head.run = i;
+        heads.push(head);
+    }
+    if (static_cast<int>(heads.size()) != runs.size()) {
+        qWarning() << "Failed to read the archive index back from its temporary file";
+        return false;
+    }
+    while (!heads.empty()) {
+        RunHead head = heads.top();
+        heads.pop();
+        m_out.append64bitValue(head.entry.key);
+        m_out.append64bitValue(head.entry.offset);
+        SpilledRun &run = runs[head.run];
+        if (++run.next == run.buffer.size()) {
+            if (run.position == run.end)
+                continue;
+            if (!fillBuffer(m_spill, run)) {
+                qWarning() << "Failed to read the archive index back from its temporary file";
+                return false;
+            }
+        }
+        head.entry = run.buffer.at(run.next);
+        heads.push(head);
+    }
+    return true;
+}
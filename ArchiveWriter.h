@@ -0,0 +1,86 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ARCHIVEWRITER_H
+#define ARCHIVEWRITER_H
+
+#include "BufferedWriter.h"
+
+#include <QVector>
+
+class QIODevice;
+class QTemporaryFile;
+
+/**
+ * ArchiveWriter creates a transaction archive, many v4 transactions in one file with an
+ * index to find them by txid. TransactionArchive reads it.
+ *
+ * The file starts with the 8 bytes "TXARCHV1", followed by one record per transaction:
+ * its size (32 bit), the txid (32 bytes, in hash order) and the transaction itself.
+ * After the records, aligned to 8 bytes, comes the index: per transaction the first
+ * 8 bytes of its txid as a big-endian number and the offset of its record (64 bit),
+ * sorted by txid. The file ends with the offset of the index (64 bit), the amount of
+ * transactions (64 bit) and the 8 bytes "TXINDEX1".
+ * All numbers are little-endian unless noted otherwise.
+ *
+ * Records are written as they are appended, the device is only written to sequentially.
+ * At most one run of index entries, 16 bytes each, is kept in memory. Every full run is
+ * sorted and spilled to a temporary file, finish() merges the runs from there.
+ * An archive that was not finished can't be opened.
+ */
+class ArchiveWriter
+{
+public:
+    /// write to @a device, sorting the index in runs of @a runSize entries.
+    explicit ArchiveWriter(QIODevice *device, int runSize = 1 << 20);
+    ~ArchiveWriter();
+
+    /// append the @a size bytes v4 transaction at @a data, with the 32 bytes @a txid.
+    void append(const char *txid, const char *data, int size);
+
+    /// write the index, returns false if any write to the device or the temporary file failed.
+    bool finish();
+
+    /// the amount of transactions appended.
+    inline qint64 count() const {
+        return m_count;
+    }
+
+    struct IndexEntry {
+        quint64 key;
+        quint64 offset;
+        inline bool operator<(const IndexEntry &other) const {
+            return key < other.key || (key == other.key && offset < other.offset);
+        }
+    };
+
+private:
+    /// sort m_current and append it to the temporary file.
+    void spillRun();
+    /// write the index merged from the runs in the temporary file.
+    bool mergeSpilledRuns();
+
+    BufferedWriter m_out;
+    qint64 m_count;
+    const int m_runSize;
+    QVector<IndexEntry> m_current;
+    QTemporaryFile *m_spill;
+    QVector<qint64> m_runEnds; // in entries, run i starts where run i - 1 ends
+    bool m_spillFailed;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+# include <sys/mman.h>
+#endif
+
+namespace {
+const qint64 HugePageSize = 2 * 1024 * 1024;
+}
+
+Arena::Arena(int blockSize, PageType pages)
+    : m_current(-1),
+      m_pos(0),
+      m_end(0),
+      m_usedInPreviousBlocks(0),
+      m_blockSize(blockSize),
+      m_pageType(pages),
+      m_hugePages(false)
+{
+    Q_ASSERT(blockSize > 0);
+}
+
+Arena::~Arena()
+{
+    foreach (const Block &block, m_blocks) {
+#ifdef Q_OS_UNIX
+        if (block.mapped) {
+            munmap(block.data, block.size);
+            continue;
+        }
+#endif
+        free(block.data);
+    }
+}
+
+char *Arena::copy(const char *data, int size)
+{
+    char *answer = static_cast<char*>(allocate(size, 1));
+    memcpy(answer, data, size);
+    return answer;
+}
+
+void Arena::reset()
+{
+    m_usedInPreviousBlocks = 0;
+    if (m_blocks.isEmpty())
+        return;
+    m_current = 0;
+    m_pos = m_blocks.at(0).data;
+    m_end = m_pos + m_blocks.at(0).size;
+}
+
+qint64 Arena::bytesAllocated() const
+{
+    if (m_current < 0)
+        return 0;
+    return m_usedInPreviousBlocks + (m_pos - m_blocks.at(m_current).data);
+}
+
+qint64 Arena::capacity() const
+{
+    qint64 answer = 0;
+    foreach (const Block &block, m_blocks) {
+        answer += block.size;
+    }
+    return answer;
+}
+
+void *Arena::allocateInNewBlock(int size, int alignment)
+{
+    if (m_current >= 0)
+        m_usedInPreviousBlocks += m_pos - m_blocks.at(m_current).data;
+    // use the next block kept by reset(), unless it is too small for this allocation.
+    const int next = m_current + 1;
+    const qint64 needed = qint64(size) + alignment;
+    if (next == m_blocks.size() || m_blocks.at(next).size < needed)
+        createBlock(needed, next);
+    m_current = next;
+    m_pos = m_blocks.at(next).data;
+    m_end = m_pos + m_blocks.at(next).size;
+    return allocate(size, alignment);
+}
+
+void Arena::createBlock(qint64 minimumSize, int position)
+{
+    Block block;
+    block.size = qMax<qint64>(m_blockSize, minimumSize);
+    block.data = 0;
+    block.mapped = false;
+#ifdef Q_OS_UNIX
+    if (m_pageType == HugePages) {
+        block.size = (block.size + HugePageSize - 1) & ~(HugePageSize - 1);
+# ifdef MAP_HUGETLB
+        // the reserved huge pages, typically not available unless configured by the admin.
+        void *data = mmap(0, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED) {
+            block.data = static_cast<char*>(data);
+            m_hugePages = true;
+        }
+# endif
+        if (block.data == 0) {
+            // transparent huge pages need 2MB alignment, map a bit more and trim.
+            void *data = mmap(0, block.size + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (data != MAP_FAILED) {
+                char *start = static_cast<char*>(data);
+                char *aligned = reinterpret_cast<char*>((reinterpret_cast<quintptr>(start) + HugePageSize - 1)
+                                                        & ~quintptr(HugePageSize - 1));
+                if (aligned > start)
+                    munmap(start, aligned - start);
+                munmap(aligned + block.size, start + HugePageSize - aligned);
+                block.data = aligned;
+# ifdef MADV_HUGEPAGE
+                if (madvise(aligned, block.size, MADV_HUGEPAGE) == 0)
+                    m_hugePages = true;
+# endif
+            }
+        }
+        block.mapped = block.data != 0;
+    }
+#endif
+    if (block.data == 0)
+        block.data = static_cast<char*>(malloc(block.size));
+    Q_CHECK_PTR(block.data);
+    m_blocks.insert(position, block);
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QVector>
+
+/**
+ * Arena is a bump allocator for data that is all released at the same time.
+ *
+ * Memory is handed out sequentially from large blocks, allocating is little more
+ * than moving a pointer. There is no way to free a single allocation, reset()
+ * releases everything in one go while keeping the blocks for reuse.
+ * Destructors of objects placed in the arena are never called.
+ *
+ * With HugePages the blocks are backed by 2MB pages where the OS allows this, which
+ * avoids TLB misses when working through multi-GB data sets. This first tries the
+ * reserved huge pages (MAP_HUGETLB) and falls back to transparent huge pages.
+ *
+ * An Arena is not thread-safe, use one per thread.
+ */
+class Arena
+{
+public:
+    enum PageType {
+        NormalPages,
+        HugePages
+    };
+
+    explicit Arena(int blockSize = 4 * 1024 * 1024, PageType pages = NormalPages);
+    ~Arena();
+
+    /// return @a size bytes aligned to @a alignment, which has to be a power of two.
+    inline void *allocate(int size, int alignment = 8) {
+        Q_ASSERT(size >= 0);
+        Q_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+        char *start = reinterpret_cast<char*>((reinterpret_cast<quintptr>(m_pos) + alignment - 1)
+                                              & ~quintptr(alignment - 1));
+        if (start + size > m_end)
+            return allocateInNewBlock(size, alignment);
+        m_pos = start + size;
+        return start;
+    }
+
+    /// return uninitialized room for @a count objects of type T.
+    template<typename T>
+    inline T *allocate(int count) {
+        return static_cast<T*>(allocate(count * sizeof(T), Q_ALIGNOF(T)));
+    }
+
+    /// copy @a size bytes at @a data into the arena.
+    char *copy(const char *data, int size);
+
+    /// release all allocations, the memory is kept for reuse.
+    void reset();
+
+    /// return the amount of bytes handed out since the last reset().
+    qint64 bytesAllocated() const;
+    /// return the amount of memory the arena holds.
+    qint64 capacity() const;
+
+    /// return true if at least one block got huge pages.
+    inline bool usesHugePages() const {
+        return m_hugePages;
+    }
+
+private:
+    Arena(const Arena&);
+    Arena &operator=(const Arena&);
+
+    void *allocateInNewBlock(int size, int alignment);
+    void createBlock(qint64 minimumSize, int position);
+
+    struct Block {
+        char *data;
+        qint64 size;
+        bool mapped;
+    };
+
+    QVector<Block> m_blocks;
+    int m_current;
+    char *m_pos;
+    char *m_end;
+    qint64 m_usedInPreviousBlocks;
+    const int m_blockSize;
+    const PageType m_pageType;
+    bool m_hugePages;
+};
+
+#endif
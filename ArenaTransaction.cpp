@@ -0,0 +1,124 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ArenaTransaction.h"
+#include "Arena.h"
+#include "MessageBuilder.h"
+#include "Transaction.h"
+#include "TransactionView.h"
+#include "V4Writer.h"
+
+#include <new>
+
+ArenaTransaction *ArenaTransaction::create(Arena &arena, TransactionView &view, const char *data, int size)
+{
+    if (!view.parse(data, size))
+        return 0;
+    const bool legacy = view.version() <= 2;
+    if (legacy) {
+        // Transaction only accepts push-only input scripts, which are the ones the view splits in items.
+        foreach (const TransactionView::Input &input, view.inputs()) {
+            if (input.itemCount == 0 && input.script.length > 0)
+                return 0;
+        }
+    }
+
+    const char *raw = arena.copy(data, size);
+    ArenaTransaction *tx = new (arena.allocate<ArenaTransaction>(1)) ArenaTransaction();
+    tx->m_version = view.version();
+    tx->m_lockTime = view.lockTime();
+    tx->m_rawData.data = raw;
+    tx->m_rawData.size = size;
+
+    const QVector<TransactionView::Range> &ranges = view.scriptItems();
+    Bytes *items = arena.allocate<Bytes>(ranges.size());
+    for (int i = 0; i < ranges.size(); ++i) {
+        items[i].data = raw + ranges.at(i).offset;
+        items[i].size = ranges.at(i).length;
+    }
+
+    tx->m_inputCount = view.inputs().size();
+    Input *inputs = arena.allocate<Input>(tx->m_inputCount);
+    for (int i = 0; i < tx->m_inputCount; ++i) {
+        const TransactionView::Input &in = view.inputs().at(i);
+        inputs[i].prevHash.data = raw + in.prevHash.offset;
+        inputs[i].prevHash.size = in.prevHash.length;
+        inputs[i].prevIndex = in.prevIndex;
+        inputs[i].sequence = legacy ? in.sequence : 0xFFFFFFFF;
+        inputs[i].items = items + in.firstItem;
+        inputs[i].itemCount = in.itemCount;
+    }
+    tx->m_inputs = inputs;
+
+    tx->m_outputCount = view.outputs().size();
+    Output *outputs = arena.allocate<Output>(tx->m_outputCount);
+    for (int i = 0; i < tx->m_outputCount; ++i) {
+        const TransactionView::Output &out = view.outputs().at(i);
+        outputs[i].value = out.value;
+        outputs[i].script.data = raw + out.script.offset;
+        outputs[i].script.size = out.script.length;
+    }
+    tx->m_outputs = outputs;
+    return tx;
+}
+
+namespace {
+struct V4Source {
+    explicit V4Source(const ArenaTransaction &tx) : tx(tx), legacy(tx.version() <= 2) {}
+
+    inline int inputCount() const {
+        return tx.inputCount();
+    }
+    // Transaction stores legacy hashes reversed, and writes them that way.
+    inline ConstBytes prevHash(int input, char *buffer) const {
+        const ArenaTransaction::Bytes &hash = tx.inputs()[input].prevHash;
+        if (!legacy)
+            return ConstBytes(hash.data, hash.size);
+        for (int j = 0; j < 32; ++j)
+            buffer[j] = hash.data[31 - j];
+        return ConstBytes(buffer, 32);
+    }
+    inline int prevIndex(int input) const {
+        return tx.inputs()[input].prevIndex;
+    }
+    inline int itemCount(int input) const {
+        return tx.inputs()[input].itemCount;
+    }
+    inline ConstBytes item(int input, int index) const {
+        const ArenaTransaction::Bytes &item = tx.inputs()[input].items[index];
+        return ConstBytes(item.data, item.size);
+    }
+    inline int outputCount() const {
+        return tx.outputCount();
+    }
+    inline ConstBytes outputScript(int output) const {
+        const ArenaTransaction::Bytes &script = tx.outputs()[output].script;
+        return ConstBytes(script.data, script.size);
+    }
+    inline quint64 outputValue(int output) const {
+        return tx.outputs()[output].value;
+    }
+
+    const ArenaTransaction &tx;
+    const bool legacy;
+};
+}
+
+void ArenaTransaction::writev4(MessageBuilder &builder, bool includeSignatures) const
+{
+    V4Writer<V4Source>::write(builder, V4Source(*this), includeSignatures);
+}
@@ -0,0 +1,111 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ARENATRANSACTION_H
+#define ARENATRANSACTION_H
+
+#include <QByteArray>
+
+class Arena;
+class MessageBuilder;
+class TransactionView;
+
+/**
+ * ArenaTransaction is a parsed transaction that lives entirely inside an Arena.
+ *
+ * Where Transaction uses a couple of dozen heap allocations for its lists, hashes
+ * and scripts, an ArenaTransaction copies the raw transaction into the arena once
+ * and points into that copy, the source buffer can be dropped after create().
+ * Nothing is ever freed individually, the whole batch is released by resetting
+ * the arena. This makes it the cheaper choice for converting bulk data.
+ *
+ * Parsing follows Transaction with LenientParsing, legacy input scripts need to be
+ * push-only, and writev4() gives the same bytes as Transaction::writev4() as both
+ * use the V4Writer.
+ */
+class ArenaTransaction
+{
+public:
+    struct Bytes {
+        const char *data;
+        int size;
+        /// return a QByteArray referencing, not copying, the bytes.
+        inline QByteArray toByteArray() const {
+            return QByteArray::fromRawData(data, size);
+        }
+    };
+
+    struct Input {
+        /// in the byte-order of the format it was read from, see TransactionView::Input
+        Bytes prevHash;
+        int prevIndex;
+        quint32 sequence; // 0xFFFFFFFF for v4
+        const Bytes *items;
+        int itemCount;
+    };
+
+    struct Output {
+        quint64 value;
+        Bytes script;
+    };
+
+    /**
+     * Parse the transaction of @a size bytes at @a data and place it in @a arena.
+     * The @a view is only used while parsing, reusing one keeps it allocation-free.
+     * Returns 0 if the transaction is malformed.
+     */
+    static ArenaTransaction *create(Arena &arena, TransactionView &view, const char *data, int size);
+
+    inline int version() const {
+        return m_version;
+    }
+    inline quint32 lockTime() const {
+        return m_lockTime;
+    }
+    inline const Input *inputs() const {
+        return m_inputs;
+    }
+    inline int inputCount() const {
+        return m_inputCount;
+    }
+    inline const Output *outputs() const {
+        return m_outputs;
+    }
+    inline int outputCount() const {
+        return m_outputCount;
+    }
+    /// the transaction as passed to create(), copied into the arena.
+    inline Bytes rawData() const {
+        return m_rawData;
+    }
+
+    /// append the v4 transaction to the builder.
+    void writev4(MessageBuilder &builder, bool includeSignatures) const;
+
+private:
+    ArenaTransaction() {}
+
+    int m_version;
+    quint32 m_lockTime;
+    const Input *m_inputs;
+    int m_inputCount;
+    const Output *m_outputs;
+    int m_outputCount;
+    Bytes m_rawData;
+};
+
+#endif
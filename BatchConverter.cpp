@@ -0,0 +1,346 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BatchConverter.h"
+#include "ArchiveWriter.h"
+#include "ArenaTransaction.h"
+#include "BlockFileReader.h"
+#include "BoundedQueue.h"
+#include "CorpusReader.h"
+#include "MessageBuilder.h"
+#include "TransactionView.h"
+
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QDebug>
+
+namespace {
+struct Result {
+    Result() : ok(false), size(0) {}
+    bool ok;
+    int size; // of the transaction with signatures
+    QByteArray withSignatures;
+    QByteArray withoutSignatures;
+    QByteArray archived; // binary, with signatures
+};
+
+// the unit of work passed between the stages, the batch objects are reused.
+struct Batch {
+    Batch() : sequence(0), arenaPeak(0) {}
+    qint64 sequence;
+    QList<QByteArray> transactions;
+    QVector<Result> results;
+    QByteArray txids;
+    qint64 arenaPeak;
+    // for block files, keeps the file the transactions point into mapped.
+    QSharedPointer<BlockFileReader> mapping;
+};
+
+struct Pipeline {
+    explicit Pipeline(int capacity) : freeBatches(capacity), read(capacity), converted(capacity) {}
+    BoundedQueue<Batch*> freeBatches; // writer -> reader
+    BoundedQueue<Batch*> read;        // reader -> converters
+    BoundedQueue<Batch*> converted;   // converters -> writer
+    QAtomicInt activeConverters;
+};
+
+// reads batches of transactions for as long as there are free batches to fill.
+class ReadStage : public QRunnable
+{
+public:
+    ReadStage(Pipeline &pipeline, CorpusReader &reader, int batchSize, qint64 *busy)
+        : m_pipeline(pipeline), m_reader(reader), m_batchSize(batchSize), m_busy(busy)
+    {
+    }
+
+    void run() {
+        QElapsedTimer timer;
+        for (qint64 sequence = 0;; ++sequence) {
+            Batch *batch;
+            m_pipeline.freeBatches.pop(batch);
+            timer.start();
+            batch->transactions.clear();
+            const int count = m_reader.read(batch->transactions, m_batchSize);
+            *m_busy += timer.nsecsElapsed();
+            if (count == 0)
+                break;
+            batch->mapping = m_reader.blockFile();
+            batch->sequence = sequence;
+            m_pipeline.read.push(batch);
+        }
+        m_pipeline.read.close();
+    }
+
+private:
+    Pipeline &m_pipeline;
+    CorpusReader &m_reader;
+    const int m_batchSize;
+    qint64 *m_busy;
+};
+
+// parses and encodes batches, the last one to finish closes the queue to the writer.
+class ConvertStage : public QRunnable
+{
+public:
+    ConvertStage(Pipeline &pipeline, Transaction::Lint lint, bool withSignatures, bool withoutSignatures,
+                 bool archive, bool useArena, Arena::PageType pages, qint64 *busy)
+        : m_pipeline(pipeline),
+          m_lint(lint),
+          m_withSignatures(withSignatures),
+          m_withoutSignatures(withoutSignatures),
+          m_archive(archive),
+          m_useArena(useArena),
+          m_pages(pages),
+          m_busy(busy),
+          m_arena(0),
+          m_builder(&m_buffer)
+    {
+    }
+    ~ConvertStage() {
+        delete m_arena;
+    }
+
+    void run() {
+        QElapsedTimer timer;
+        Batch *batch;
+        while (m_pipeline.read.pop(batch)) {
+            timer.start();
+            batch->results.fill(Result(), batch->transactions.size());
+            batch->arenaPeak = 0;
+            if (m_useArena)
+                convertInArena(batch);
+            else
+                convert(batch);
+            if (m_archive) // the ids of the original transactions, which is what they will be looked up by.
+                batch->txids = Transaction::txids(batch->transactions);
+            *m_busy += timer.nsecsElapsed();
+            m_pipeline.converted.push(batch);
+        }
+        if (m_pipeline.activeConverters.fetchAndAddOrdered(-1) == 1)
+            m_pipeline.converted.close();
+    }
+
+private:
+    void convert(Batch *batch) {
+        for (int i = 0; i < batch->transactions.size(); ++i) {
+            Transaction tx;
+            Result &result = batch->results[i];
+            result.ok = tx.read(batch->transactions.at(i), m_lint);
+            if (!result.ok)
+                continue;
+            m_builder.reset();
+            tx.writev4(m_builder, true);
+            result.size = m_builder.size();
+            if (m_withSignatures)
+                result.withSignatures = m_buffer.toHex();
+            if (m_archive)
+                result.archived = QByteArray(m_buffer.constData(), m_buffer.size());
+            if (m_withoutSignatures) {
+                m_builder.reset();
+                tx.writev4(m_builder, false);
+                result.withoutSignatures = m_buffer.toHex();
+            }
+        }
+    }
+
+    void convertInArena(Batch *batch) {
+        if (m_arena == 0)
+            m_arena = new Arena(4 * 1024 * 1024, m_pages);
+        // the whole batch is placed in the arena and released at once by the reset for the next batch.
+        m_arena->reset();
+        const int count = batch->transactions.size();
+        ArenaTransaction **transactions = m_arena->allocate<ArenaTransaction*>(count);
+        for (int i = 0; i < count; ++i) {
+            const QByteArray &bytes = batch->transactions.at(i);
+            transactions[i] = ArenaTransaction::create(*m_arena, m_view, bytes.constData(), bytes.size());
+            if (m_view.error() != TransactionView::NoError) // like Transaction::read(), tell why
+                qWarning().noquote() << m_view.errorString();
+        }
+        batch->arenaPeak = m_arena->bytesAllocated();
+
+        for (int i = 0; i < count; ++i) {
+            Result &result = batch->results[i];
+            result.ok = transactions[i] != 0;
+            if (!result.ok)
+                continue;
+            m_builder.reset();
+            transactions[i]->writev4(m_builder, true);
+            result.size = m_builder.size();
+            if (m_withSignatures)
+                result.withSignatures = m_buffer.toHex();
+            if (m_archive)
+                result.archived = QByteArray(m_buffer.constData(), m_buffer.size());
+            if (m_withoutSignatures) {
+                m_builder.reset();
+                transactions[i]->writev4(m_builder, false);
+                result.withoutSignatures = m_buffer.toHex();
+            }
+        }
+    }
+
+    Pipeline &m_pipeline;
+    const Transaction::Lint m_lint;
+    const bool m_withSignatures;
+    const bool m_withoutSignatures;
+    const bool m_archive;
+    const bool m_useArena;
+    const Arena::PageType m_pages;
+    qint64 *m_busy;
+    Arena *m_arena; // kept over batches, reset() keeps its blocks for reuse
+    TransactionView m_view;
+    // one buffer for all batches, the builder reuses its memory after a reset()
+    QByteArray m_buffer;
+    MessageBuilder m_builder;
+};
+}
+
+BatchConverter::BatchConverter()
+    : m_threadCount(QThread::idealThreadCount()),
+      m_chunkSize(10000),
+      m_lint(Transaction::LenientParsing),
+      m_useArena(false),
+      m_arenaPages(Arena::NormalPages),
+      m_archive(0)
+{
+    if (m_threadCount < 1)
+        m_threadCount = 1;
+}
+
+void BatchConverter::setThreadCount(int threads)
+{
+    Q_ASSERT(threads > 0);
+    m_threadCount = threads;
+}
+
+void BatchConverter::setChunkSize(int size)
+{
+    Q_ASSERT(size > 0);
+    m_chunkSize = size;
+}
+
+void BatchConverter::setLint(Transaction::Lint lint)
+{
+    m_lint = lint;
+}
+
+void BatchConverter::setUseArena(bool on, Arena::PageType pages)
+{
+    m_useArena = on;
+    m_arenaPages = pages;
+}
+
+void BatchConverter::setArchive(ArchiveWriter *archive)
+{
+    m_archive = archive;
+}
+
+bool BatchConverter::convert(CorpusReader &reader, QIODevice *withSignatures, QIODevice *withoutSignatures)
+{
+    m_stats = Statistics();
+    QElapsedTimer timer;
+    timer.start();
+
+    // a chunk is split in a couple of batches per thread, and at most two chunks are in flight.
+    const int batchSize = qMax(1, m_chunkSize / (m_threadCount * 4));
+    const int batchCount = m_threadCount * 8;
+    QVector<Batch> batches(batchCount);
+    Pipeline pipeline(batchCount);
+    for (int i = 0; i < batchCount; ++i)
+        pipeline.freeBatches.push(&batches[i]);
+    pipeline.activeConverters.store(m_threadCount);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_threadCount + 1);
+    qint64 readerBusy = 0;
+    QVector<qint64> convertersBusy(m_threadCount, 0);
+    pool.start(new ReadStage(pipeline, reader, batchSize, &readerBusy));
+    const bool useArena = m_useArena && m_lint == Transaction::LenientParsing;
+    for (int i = 0; i < m_threadCount; ++i) {
+        pool.start(new ConvertStage(pipeline, m_lint, withSignatures != 0, withoutSignatures != 0, m_archive != 0,
+                                    useArena, m_arenaPages, convertersBusy.data() + i));
+    }
+
+    // the writer stage; batches arrive in any order and are written in the order they were read.
+    QVector<Batch*> pending(batchCount, 0);
+    qint64 next = 0;
+    QElapsedTimer busyTimer;
+    Batch *batch;
+    while (pipeline.converted.pop(batch)) {
+        pending[batch->sequence % batchCount] = batch;
+        while ((batch = pending.at(next % batchCount)) != 0) {
+            busyTimer.start();
+            pending[next % batchCount] = 0;
+            m_stats.arenaPeak = qMax(m_stats.arenaPeak, batch->arenaPeak);
+            for (int i = 0; i < batch->results.size(); ++i) {
+                const Result &result = batch->results.at(i);
+                ++m_stats.transactions;
+                if (!result.ok)
+                    ++m_stats.failed;
+                m_stats.bytesOut += result.size;
+                if (withSignatures) {
+                    withSignatures->write(result.withSignatures);
+                    withSignatures->write("\n", 1);
+                }
+                if (withoutSignatures) {
+                    withoutSignatures->write(result.withoutSignatures);
+                    withoutSignatures->write("\n", 1);
+                }
+                if (m_archive && result.ok)
+                    m_archive->append(batch->txids.constData() + i * Sha256::HashSize, result.archived.constData(), result.archived.size());
+            }
+            m_stats.writerBusy += busyTimer.nsecsElapsed();
+            batch->mapping.clear();
+            pipeline.freeBatches.push(batch);
+            ++next;
+        }
+    }
+    pool.waitForDone();
+
+    m_stats.readerBusy = readerBusy;
+    foreach (qint64 busy, convertersBusy) {
+        m_stats.convertersBusy += busy;
+    }
+    m_stats.readerWaits = pipeline.freeBatches.popWaits();
+    m_stats.converterWaits = pipeline.read.popWaits();
+    m_stats.writerWaits = pipeline.converted.popWaits();
+    m_stats.bytesIn = reader.bytesRead();
+    m_stats.milliseconds = timer.elapsed();
+    return m_stats.failed < m_stats.transactions;
+}
+
+void BatchConverter::printStatistics(QTextStream &out) const
+{
+    const double seconds = qMax<qint64>(1, m_stats.milliseconds) / 1000.;
+    out << "transactions: " << m_stats.transactions << " (" << m_stats.failed << " failed)\n";
+    out << "time: " << m_stats.milliseconds << " ms, threads: " << m_threadCount << "\n";
+    out << "input: " << m_stats.bytesIn << " bytes, v4 output: " << m_stats.bytesOut << " bytes\n";
+    out << "throughput: " << qRound64(m_stats.transactions / seconds) << " tx/s, "
+        << QString::number(m_stats.bytesIn / seconds / 1E6, 'f', 2) << " MB/s\n";
+    if (m_stats.arenaPeak > 0)
+        out << "arena: " << m_stats.arenaPeak << " bytes peak per batch\n";
+    // the share of the wall time each stage spent working, and how often it waited for another.
+    const qint64 nanoseconds = qMax<qint64>(1, m_stats.milliseconds) * 1000000;
+    out << "pipeline: reader " << qRound(m_stats.readerBusy * 100. / nanoseconds) << "% busy, "
+        << m_stats.readerWaits << " waits for the writer; converters "
+        << qRound(m_stats.convertersBusy * 100. / nanoseconds / m_threadCount) << "% busy, "
+        << m_stats.converterWaits << " waits for the reader; writer "
+        << qRound(m_stats.writerBusy * 100. / nanoseconds) << "% busy, "
+        << m_stats.writerWaits << " waits for the converters\n";
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BATCHCONVERTER_H
+#define BATCHCONVERTER_H
+
+#include "Arena.h"
+#include "Transaction.h"
+
+class ArchiveWriter;
+class CorpusReader;
+class QIODevice;
+
+/**
+ * The BatchConverter converts a large amount of transactions to the v4 format.
+ *
+ * The conversion is a pipeline of stages on their own threads: a reader fills batches
+ * of transactions from a CorpusReader, a pool of converters parses and re-encodes them,
+ * and the writer writes the results in input order. The stages hand batches to each
+ * other over lock-free BoundedQueues. A fixed set of batches is recycled, so when the
+ * writer or the converters fall behind the reader runs out of batches and waits, which
+ * keeps the memory use bounded while the disk and the cores are both kept busy.
+ * Each output gets one line of hex per input transaction, a transaction that
+ * failed to parse leaves an empty line to keep the lines aligned with the input.
+ * The transactions with signatures can also be appended to an archive, by their original txid.
+ */
+class BatchConverter
+{
+public:
+    BatchConverter();
+
+    /// the amount of worker threads, defaults to the amount of cores.
+    void setThreadCount(int threads);
+    /**
+     * The amount of transactions in flight per round, defaults to 10000. A round is split in
+     * batches of a quarter per thread, and at most two rounds are in the pipeline.
+     */
+    void setChunkSize(int size);
+    void setLint(Transaction::Lint lint);
+
+    /**
+     * Parse into per-thread arenas (see ArenaTransaction) instead of into Transaction
+     * objects, which avoids nearly all heap allocations. Only used with LenientParsing.
+     */
+    void setUseArena(bool on, Arena::PageType pages = Arena::NormalPages);
+
+    /// also append the transactions with signatures to @a archive, which may be null.
+    void setArchive(ArchiveWriter *archive);
+
+    /**
+     * Convert all transactions from the reader.
+     * Either of the devices may be null, in which case that output is skipped.
+     * @return false if none of the transactions could be parsed.
+     */
+    bool convert(CorpusReader &reader, QIODevice *withSignatures, QIODevice *withoutSignatures);
+
+    struct Statistics {
+        Statistics() : transactions(0), failed(0), bytesIn(0), bytesOut(0), milliseconds(0), arenaPeak(0),
+            readerBusy(0), convertersBusy(0), writerBusy(0), readerWaits(0), converterWaits(0), writerWaits(0) {}
+        qint64 transactions;
+        qint64 failed;
+        qint64 bytesIn;
+        qint64 bytesOut; // binary bytes, before hex-encoding
+        qint64 milliseconds;
+        qint64 arenaPeak; // the most bytes one arena held for a batch
+        // the nanoseconds each stage spent working, the converters summed over the threads.
+        qint64 readerBusy;
+        qint64 convertersBusy;
+        qint64 writerBusy;
+        // the amount of times each stage found nothing to work on.
+        qint64 readerWaits;
+        qint64 converterWaits;
+        qint64 writerWaits;
+    };
+
+    inline const Statistics &statistics() const {
+        return m_stats;
+    }
+
+    /// print the throughput numbers (tx/s, MB/s) of the last convert()
+    void printStatistics(QTextStream &out) const;
+
+private:
+    int m_threadCount;
+    int m_chunkSize;
+    Transaction::Lint m_lint;
+    bool m_useArena;
+    Arena::PageType m_arenaPages;
+    ArchiveWriter *m_archive;
+    Statistics m_stats;
+};
+
+#endif
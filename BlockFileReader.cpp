@@ -0,0 +1,193 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BlockFileReader.h"
+#include "StreamMethods.h"
+
+#include <QFileInfo>
+#include <QDebug>
+
+namespace {
+const int BlockHeaderSize = 80;
+}
+
+BlockFileReader::BlockFileReader(const QString &filename)
+    : m_file(filename),
+      m_data(0),
+      m_size(0),
+      m_blockEnd(0),
+      m_pos(0),
+      m_magic(0),
+      m_txStart(0),
+      m_txSize(0),
+      m_txCount(0),
+      m_txIndex(-1),
+      m_blockIndex(-1),
+      m_error(false)
+{
+}
+
+BlockFileReader::~BlockFileReader()
+{
+    close();
+}
+
+bool BlockFileReader::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open input" << m_file.fileName();
+        return false;
+    }
+    m_size = m_file.size();
+    m_data = reinterpret_cast<const char*>(m_file.map(0, m_size));
+    if (m_data == 0) {
+        qWarning() << "Failed to map block file" << m_file.fileName();
+        m_file.close();
+        return false;
+    }
+    m_blockEnd = m_pos = 0;
+    m_magic = 0;
+    m_txCount = 0;
+    m_txIndex = m_blockIndex = -1;
+    m_error = false;
+    return true;
+}
+
+void BlockFileReader::close()
+{
+    if (m_data) {
+        m_file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_data)));
+        m_data = 0;
+    }
+    m_file.close();
+}
+
+bool BlockFileReader::nextBlock()
+{
+    while (true) {
+        m_pos = m_blockEnd;
+        if (m_pos + 8 > m_size)
+            return false;
+        const quint32 magic = Streaming::fetch32bitValue(m_data, m_pos);
+        if (magic == 0) // the preallocated tail of the file.
+            return false;
+        if (m_magic == 0) {
+            m_magic = magic;
+        } else if (magic != m_magic) {
+            qWarning() << "Block file" << m_file.fileName() << "has an unexpected network magic at offset" << m_pos;
+            m_error = true;
+            return false;
+        }
+        const quint32 blockSize = Streaming::fetch32bitValue(m_data, m_pos + 4);
+        if (m_pos + 8 + blockSize > m_size || blockSize < BlockHeaderSize + 1) {
+            qWarning() << "Block file" << m_file.fileName() << "has a truncated block at offset" << m_pos;
+            m_error = true;
+            return false;
+        }
+        m_blockEnd = m_pos + 8 + blockSize;
+        m_pos += 8 + BlockHeaderSize;
+        ++m_blockIndex;
+        m_txIndex = -1;
+
+        quint64 count;
+        if (!Streaming::fetchBitcoinCompact(m_data, m_blockEnd, m_pos, count) || count > blockSize) {
+            qWarning() << "Block" << m_blockIndex << "has an invalid transaction count, skipping";
+            continue;
+        }
+        m_txCount = count;
+        if (m_txCount > 0)
+            return true;
+    }
+}
+
+bool BlockFileReader::next()
+{
+    if (m_data == 0)
+        return false;
+    while (true) {
+        if (m_txIndex + 1 >= m_txCount && !nextBlock())
+            return false;
+        const int size = legacyTransactionSize(m_data + m_pos, m_blockEnd - m_pos);
+        if (size < 0) {
+            qWarning() << "Block" << m_blockIndex << "has a corrupt transaction at index"
+                       << m_txIndex + 1 << "skipping rest of block";
+            m_txCount = 0;
+            continue;
+        }
+        m_txStart = m_pos;
+        m_txSize = size;
+        m_pos += size;
+        ++m_txIndex;
+        return true;
+    }
+}
+
+bool BlockFileReader::isBlockFile(const QString &filename)
+{
+    const QString name = QFileInfo(filename).fileName();
+    return name.startsWith("blk") && name.endsWith(".dat");
+}
+
+int BlockFileReader::legacyTransactionSize(const char *data, qint64 available)
+{
+    qint64 pos = 4; // version
+    if (available < 10)
+        return -1;
+    // segwit serialization has a zero marker where the input-count would be.
+    const bool witness = data[4] == 0 && data[5] == 1;
+    if (witness)
+        pos += 2;
+
+    quint64 inputs, count, length;
+    if (!Streaming::fetchBitcoinCompact(data, available, pos, inputs))
+        return -1;
+    for (quint64 i = 0; i < inputs; ++i) {
+        pos += 36; // prev-hash and index
+        if (!Streaming::fetchBitcoinCompact(data, available, pos, length) || length > quint64(available))
+            return -1;
+        pos += length + 4; // script and sequence
+        if (pos > available)
+            return -1;
+    }
+    if (!Streaming::fetchBitcoinCompact(data, available, pos, count))
+        return -1;
+    for (quint64 i = 0; i < count; ++i) {
+        pos += 8; // value
+        if (!Streaming::fetchBitcoinCompact(data, available, pos, length) || length > quint64(available))
+            return -1;
+        pos += length;
+        if (pos > available)
+            return -1;
+    }
+    if (witness) {
+        for (quint64 i = 0; i < inputs; ++i) {
+            if (!Streaming::fetchBitcoinCompact(data, available, pos, count))
+                return -1;
+            for (quint64 item = 0; item < count; ++item) {
+                if (!Streaming::fetchBitcoinCompact(data, available, pos, length) || length > quint64(available))
+                    return -1;
+                pos += length;
+                if (pos > available)
+                    return -1;
+            }
+        }
+    }
+    pos += 4; // nLockTime
+    if (pos > available)
+        return -1;
+    return pos;
+}
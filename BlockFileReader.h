@@ -0,0 +1,103 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BLOCKFILEREADER_H
+#define BLOCKFILEREADER_H
+
+#include <QByteArray>
+#include <QFile>
+
+/**
+ * BlockFileReader walks the transactions stored in a blkNNNNN.dat file of a full node.
+ *
+ * The file is memory-mapped and never copied into the heap. Each block in the file
+ * is framed as a 4 byte network-magic, a 4 byte block-size, the 80 byte block header
+ * and a compact-int transaction count followed by the transactions themselves.
+ * Call next() to move to the following transaction, the transaction() method
+ * then returns a QByteArray that points directly into the mapped file.
+ *
+ * Nodes pre-allocate their block files, walking stops at the zero-filled tail.
+ */
+class BlockFileReader
+{
+public:
+    explicit BlockFileReader(const QString &filename);
+    ~BlockFileReader();
+
+    /// open and map the file, returns false on failure.
+    bool open();
+    void close();
+
+    /**
+     * Move to the next transaction.
+     * @return false when the end of the file was reached or the framing was corrupt, see error().
+     */
+    bool next();
+
+    /// return the current transaction, this references the mapped memory and is valid until close().
+    inline QByteArray transaction() const {
+        return QByteArray::fromRawData(m_data + m_txStart, m_txSize);
+    }
+    inline const char *transactionData() const {
+        return m_data + m_txStart;
+    }
+    inline int transactionSize() const {
+        return m_txSize;
+    }
+
+    /// the zero-based index of the block in this file the current transaction is part of.
+    inline int blockIndex() const {
+        return m_blockIndex;
+    }
+    /// the zero-based index of the current transaction in its block, zero is the coinbase.
+    inline int transactionIndex() const {
+        return m_txIndex;
+    }
+
+    /// returns true if next() stopped because of corrupt data rather than the end of the file.
+    inline bool error() const {
+        return m_error;
+    }
+
+    /// return true if the filename looks like one of a node's block files.
+    static bool isBlockFile(const QString &filename);
+
+    /**
+     * Returns the size of the legacy-serialized transaction at the start of @a data,
+     * or -1 if it does not fit in @a available bytes.
+     * This only walks the framing, nothing is parsed or copied.
+     */
+    static int legacyTransactionSize(const char *data, qint64 available);
+
+private:
+    bool nextBlock();
+
+    QFile m_file;
+    const char *m_data;
+    qint64 m_size;
+    qint64 m_blockEnd; // offset of the first byte after the current block
+    qint64 m_pos;
+    quint32 m_magic;
+    qint64 m_txStart;
+    int m_txSize;
+    int m_txCount; // in current block
+    int m_txIndex;
+    int m_blockIndex;
+    bool m_error;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QAtomicInteger>
+#include <QScopedArrayPointer>
+#include <QThread>
+
+/**
+ * BoundedQueue is a lock-free, fixed capacity queue for any amount of producer and consumer threads.
+ *
+ * Each cell carries a sequence number telling whether it is ready to be written or read
+ * in the current lap around the ring, so a push or pop is a single compare-and-swap on
+ * the head or tail and nothing is ever locked. The capacity is rounded up to a power of two.
+ *
+ * push() waits while the queue is full, which is what slows a producer down to the speed
+ * of its consumers. pop() waits while it is empty, until close() was called. Waiting
+ * first yields and then sleeps in short steps; the amount of times either side had to
+ * wait is counted, which tells which end of the queue is the bottleneck.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity)
+        : m_mask(1),
+          m_closed(0),
+          m_pushWaits(0),
+          m_popWaits(0)
+    {
+        Q_ASSERT(capacity > 0);
+        while (m_mask < static_cast<quint32>(capacity))
+            m_mask <<= 1;
+        m_cells.reset(new Cell[m_mask]);
+        for (quint32 i = 0; i < m_mask; ++i)
+            m_cells[i].sequence.store(i);
+        --m_mask;
+    }
+
+    inline int capacity() const {
+        return m_mask + 1;
+    }
+
+    /// add @a item if there is room, returns false if the queue is full.
+    bool tryPush(const T &item) {
+        Cell *cell;
+        quint32 position = m_tail.load();
+        while (true) {
+            cell = &m_cells[position & m_mask];
+            const qint32 diff = static_cast<qint32>(cell->sequence.loadAcquire() - position);
+            if (diff == 0) {
+                if (m_tail.testAndSetOrdered(position, position + 1))
+                    break;
+                position = m_tail.load();
+            } else if (diff < 0) {
+                return false; // the cell still holds an item from the previous lap
+            } else {
+                position = m_tail.load();
+            }
+        }
+        cell->item = item;
+        cell->sequence.storeRelease(position + 1);
+        return true;
+    }
+
+    /// take the oldest item, returns false if the queue is empty.
+    bool tryPop(T &item) {
+        Cell *cell;
+        quint32 position = m_head.load();
+        while (true) {
+            cell = &m_cells[position & m_mask];
+            const qint32 diff = static_cast<qint32>(cell->sequence.loadAcquire() - (position + 1));
+            if (diff == 0) {
+                if (m_head.testAndSetOrdered(position, position + 1))
+                    break;
+                position = m_head.load();
+            } else if (diff < 0) {
+                return false; // nothing was pushed in this cell yet
+            } else {
+                position = m_head.load();
+            }
+        }
+        item = cell->item;
+        cell->sequence.storeRelease(position + m_mask + 1);
+        return true;
+    }
+
+    /// add @a item, waiting for room while the queue is full.
+    void push(const T &item) {
+        if (tryPush(item))
+            return;
+        m_pushWaits.fetchAndAddRelaxed(1);
+        for (int spins = 0; !tryPush(item); ++spins)
+            pause(spins);
+    }
+
+    /**
+     * Take the oldest item, waiting while the queue is empty.
+     * Returns false when the queue is empty and closed.
+     */
+    bool pop(T &item) {
+        if (tryPop(item))
+            return true;
+        m_popWaits.fetchAndAddRelaxed(1);
+        for (int spins = 0; !tryPop(item); ++spins) {
+            if (m_closed.loadAcquire())
+                return tryPop(item); // an item pushed just before the close
+            pause(spins);
+        }
+        return true;
+    }
+
+    /// tell the consumers no more items will be pushed.
+    void close() {
+        m_closed.storeRelease(1);
+    }
+
+    /// the amount of times push() found the queue full.
+    inline qint64 pushWaits() const {
+        return m_pushWaits.load();
+    }
+    /// the amount of times pop() found the queue empty.
+    inline qint64 popWaits() const {
+        return m_popWaits.load();
+    }
+
+private:
+    static void pause(int spins) {
+        if (spins < 64)
+            QThread::yieldCurrentThread();
+        else
+            QThread::usleep(50);
+    }
+
+    struct Cell {
+        QAtomicInteger<quint32> sequence;
+        T item;
+    };
+
+    QScopedArrayPointer<Cell> m_cells;
+    quint32 m_mask;
+    // head and tail are written by different threads, keep them on their own cache line.
+    char m_padding1[64];
+    QAtomicInteger<quint32> m_head;
+    char m_padding2[64];
+    QAtomicInteger<quint32> m_tail;
+    char m_padding3[64];
+    QAtomicInteger<int> m_closed;
+    QAtomicInteger<qint64> m_pushWaits;
+    QAtomicInteger<qint64> m_popWaits;
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BufferedWriter.h"
+#include "StreamMethods.h"
+
+#include <QIODevice>
+
+namespace {
+// two lowercase hex digits for each byte value.
+struct HexTable {
+    HexTable() {
+        static const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) {
+            pairs[i * 2] = digits[i >> 4];
+            pairs[i * 2 + 1] = digits[i & 15];
+        }
+    }
+    char pairs[512];
+};
+const HexTable s_hex;
+}
+
+BufferedWriter::BufferedWriter(QIODevice *device, int bufferSize)
+    : m_device(device),
+      m_storage(qMax(64, bufferSize), Qt::Uninitialized),
+      m_buffer(m_storage.data()),
+      m_size(m_storage.size()),
+      m_position(0),
+      m_written(0),
+      m_ok(true)
+{
+    Q_ASSERT(m_device);
+}
+
+BufferedWriter::~BufferedWriter()
+{
+    flush();
+}
+
+bool BufferedWriter::flush()
+{
+    if (m_position > 0) {
+        if (m_device->write(m_buffer, m_position) != m_position)
+            m_ok = false;
+        m_written += m_position;
+        m_position = 0;
+    }
+    return m_ok;
+}
+
+void BufferedWriter::appendLarge(const char *data, int length)
+{
+    while (length > 0) {
+        if (m_position == m_size)
+            flush();
+        const int chunk = qMin(length, m_size - m_position);
+        memcpy(m_buffer + m_position, data, chunk);
+        m_position += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+void BufferedWriter::appendNumber(quint64 value)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[sizeof(digits) - ++count] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    append(digits + sizeof(digits) - count, count);
+}
+
+void BufferedWriter::appendNumber(qint64 value)
+{
+    if (value < 0) {
+        append('-');
+        appendNumber(0 - static_cast<quint64>(value));
+    } else {
+        appendNumber(static_cast<quint64>(value));
+    }
+}
+
+void BufferedWriter::appendHex(const char *data, int length, bool reversed)
+{
+    const quint8 *bytes = reinterpret_cast<const quint8*>(data);
+    while (length > 0) {
+        // convert in pieces that fit the buffer
+        const int chunk = qMin(length, m_size / 2);
+        char *out = reserve(chunk * 2);
+        if (reversed) {
+            for (int i = 0; i < chunk; ++i) {
+                memcpy(out, s_hex.pairs + bytes[length - 1 - i] * 2, 2);
+                out += 2;
+            }
+        } else {
+            for (int i = 0; i < chunk; ++i) {
+                memcpy(out, s_hex.pairs + bytes[i] * 2, 2);
+                out += 2;
+            }
+            bytes += chunk;
+        }
+        commit(chunk * 2);
+        length -= chunk;
+    }
+}
+
+void BufferedWriter::appendJsonString(const char *data, int length)
+{
+    for (int i = 0; i < length; ++i) {
+        const quint8 c = data[i];
+        if (c == '"' || c == '\\') {
+            append('\\');
+            append(static_cast<char>(c));
+        } else if (c < 0x20) {
+            append("\\u00");
+            append(s_hex.pairs + c * 2, 2);
+        } else if (c >= 0x80) { // Latin-1 to utf8
+            append(static_cast<char>(0xC0 | (c >> 6)));
+            append(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            append(static_cast<char>(c));
+        }
+    }
+}
+
+void BufferedWriter::appendCompact(quint64 value)
+{
+    char *out = reserve(9);
+    commit(Streaming::writeBitcoinCompact(out, value));
+}
+
+void BufferedWriter::append32bitValue(quint32 value)
+{
+    char *out = reserve(4);
+    Streaming::write32bitValue(out, value);
+    commit(4);
+}
+
+void BufferedWriter::append64bitValue(quint64 value)
+{
+    char *out = reserve(8);
+    Streaming::write64bitValue(out, value);
+    commit(8);
+}
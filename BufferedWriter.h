@@ -0,0 +1,115 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BUFFEREDWRITER_H
+#define BUFFEREDWRITER_H
+
+#include <QByteArray>
+
+#include <string.h>
+
+class QIODevice;
+
+/**
+ * BufferedWriter collects output in a fixed buffer and writes it to a device in big blocks.
+ *
+ * Unlike QTextStream there is no codec and no per-call allocation; numbers and hex are
+ * formatted straight into the buffer. The buffer is written when full, on flush() and
+ * on destruction.
+ */
+class BufferedWriter
+{
+public:
+    explicit BufferedWriter(QIODevice *device, int bufferSize = 256 * 1024);
+    ~BufferedWriter();
+
+    inline void append(char c) {
+        if (m_position == m_size)
+            flush();
+        m_buffer[m_position++] = c;
+    }
+    inline void append(const char *data, int length) {
+        if (length > m_size - m_position) {
+            appendLarge(data, length);
+            return;
+        }
+        memcpy(m_buffer + m_position, data, length);
+        m_position += length;
+    }
+    /// append a string literal, without the terminating zero.
+    template<int N>
+    inline void append(const char (&text)[N]) {
+        append(text, N - 1);
+    }
+
+    void appendNumber(qint64 value);
+    void appendNumber(quint64 value);
+    inline void appendNumber(int value) {
+        appendNumber(static_cast<qint64>(value));
+    }
+    inline void appendNumber(quint32 value) {
+        appendNumber(static_cast<quint64>(value));
+    }
+
+    /// append @a length bytes as lowercase hex, last byte first if @a reversed.
+    void appendHex(const char *data, int length, bool reversed = false);
+
+    /// append Latin-1 @a data as the contents of a JSON string, escaped and encoded as utf8.
+    void appendJsonString(const char *data, int length);
+
+    /// append @a value as a bitcoin compact-size.
+    void appendCompact(quint64 value);
+    void append32bitValue(quint32 value);
+    void append64bitValue(quint64 value);
+
+    /// write the buffer to the device, returns false on a write error.
+    bool flush();
+
+    /// true if all writes to the device succeeded.
+    inline bool isOk() const {
+        return m_ok;
+    }
+
+    /// the amount of bytes appended since construction.
+    inline qint64 bytesWritten() const {
+        return m_written + m_position;
+    }
+
+    /// return the address of @a count free bytes in the buffer, commit() them after writing.
+    inline char *reserve(int count) {
+        Q_ASSERT(count <= m_size);
+        if (count > m_size - m_position)
+            flush();
+        return m_buffer + m_position;
+    }
+    inline void commit(int count) {
+        m_position += count;
+    }
+
+private:
+    void appendLarge(const char *data, int length);
+
+    QIODevice *m_device;
+    QByteArray m_storage;
+    char *m_buffer;
+    int m_size;
+    int m_position;
+    qint64 m_written;
+    bool m_ok;
+};
+
+#endif
@@ -17,6 +17,14 @@
  */
 #include "CMF.h"
 
+#include <QtAlgorithms>
+#include <QtEndian>
+
+#include <string.h>
+#if defined(__x86_64__) || defined(__SSE2__)
+# include <immintrin.h>
+#endif
+
 int CMF::serialize(char *data, quint64 value)
 {
     int pos = 0;
@@ -53,3 +61,177 @@ bool CMF::unserialize(const char *data, int dataSize, int &position, quint64 &re
     }
     return false;
 }
+
+namespace {
+// The value a varint of n bytes starts at, every continuation byte adds one before the shift.
+const quint64 VarIntOffsets[11] = {
+    0, 0, 0x80ULL, 0x4080ULL, 0x204080ULL, 0x10204080ULL, 0x810204080ULL,
+    0x40810204080ULL, 0x2040810204080ULL, 0x102040810204080ULL, 0x8102040810204080ULL
+};
+
+// pack the low 7 bits of each of the 8 bytes into 56 continuous bits.
+inline quint64 compact7Bits(quint64 x)
+{
+    x = (x & 0x007F007F007F007FULL) | ((x & 0x7F007F007F007F00ULL) >> 1);
+    x = (x & 0x00003FFF00003FFFULL) | ((x & 0x3FFF00003FFF0000ULL) >> 2);
+    return (x & 0x000000000FFFFFFFULL) | ((x & 0x0FFFFFFF00000000ULL) >> 4);
+}
+
+// the reverse of compact7Bits, @a x has to fit in 56 bits.
+inline quint64 spread7Bits(quint64 x)
+{
+    x = (x & 0x000000000FFFFFFFULL) | ((x << 4) & 0x0FFFFFFF00000000ULL);
+    x = (x & 0x00003FFF00003FFFULL) | ((x << 2) & 0x3FFF00003FFF0000ULL);
+    return (x & 0x007F007F007F007FULL) | ((x << 1) & 0x7F007F007F007F00ULL);
+}
+
+// unserialize a varint using a single 8-byte load, at least 8 bytes have to be available.
+inline bool unserializeWord(const char *data, int &position, quint64 &result)
+{
+    const quint64 word = qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(data + position));
+    const quint64 stops = ~word & 0x8080808080808080ULL;
+    if (stops == 0) // longer than 8 bytes isn't supported, like in unserialize()
+        return false;
+    const int length = qCountTrailingZeroBits(stops) / 8 + 1;
+    // turn the bytes around so the first one is the most significant and drop the rest.
+    const quint64 bits = qbswap(word & 0x7F7F7F7F7F7F7F7FULL) >> (64 - 8 * length);
+    result = compact7Bits(bits) + VarIntOffsets[length];
+    position += length;
+    return true;
+}
+
+/*
+ * The single-byte-run kernels copy the leading bytes that have no continuation bit
+ * into @a results, up to @a max. They return the amount copied.
+ */
+int singleBytesScalar(const char *data, int max, quint64 *results)
+{
+    int i = 0;
+    while (i < max && (data[i] & 0x80) == 0) {
+        results[i] = static_cast<quint8>(data[i]);
+        ++i;
+    }
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__SSE2__)
+int singleBytesSse2(const char *data, int max, quint64 *results)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= max; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const int mask = _mm_movemask_epi8(bytes);
+        if (mask)
+            return i + singleBytesScalar(data + i, qCountTrailingZeroBits(quint32(mask)), results + i);
+        const __m128i words[2] = { _mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero) };
+        __m128i *out = reinterpret_cast<__m128i*>(results + i);
+        for (int w = 0; w < 2; ++w) {
+            const __m128i low = _mm_unpacklo_epi16(words[w], zero);
+            const __m128i high = _mm_unpackhi_epi16(words[w], zero);
+            _mm_storeu_si128(out++, _mm_unpacklo_epi32(low, zero));
+            _mm_storeu_si128(out++, _mm_unpackhi_epi32(low, zero));
+            _mm_storeu_si128(out++, _mm_unpacklo_epi32(high, zero));
+            _mm_storeu_si128(out++, _mm_unpackhi_epi32(high, zero));
+        }
+    }
+    return i + singleBytesScalar(data + i, max - i, results + i);
+}
+# define CMF_HAVE_SSE2
+#endif
+
+#if defined(CMF_HAVE_SSE2) && defined(__GNUC__)
+__attribute__((target("avx2")))
+int singleBytesAvx2(const char *data, int max, quint64 *results)
+{
+    int i = 0;
+    for (; i + 32 <= max; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const int mask = _mm256_movemask_epi8(bytes);
+        if (mask)
+            return i + singleBytesScalar(data + i, qCountTrailingZeroBits(quint32(mask)), results + i);
+        __m256i *out = reinterpret_cast<__m256i*>(results + i);
+        for (int b = 0; b < 32; b += 4) {
+            quint32 four;
+            memcpy(&four, data + i + b, 4);
+            _mm256_storeu_si256(out++, _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four)));
+        }
+    }
+    return i + singleBytesSse2(data + i, max - i, results + i);
+}
+# define CMF_HAVE_AVX2
+#endif
+
+typedef int (*SingleBytesKernel)(const char *, int, quint64 *);
+
+SingleBytesKernel selectSingleBytesKernel()
+{
+#ifdef CMF_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return singleBytesAvx2;
+#endif
+#ifdef CMF_HAVE_SSE2
+    return singleBytesSse2;
+#else
+    return singleBytesScalar;
+#endif
+}
+}
+
+int CMF::serializeFast(char *data, quint64 value)
+{
+    if (value < 0x80) { // tags and small numbers are the most common by far.
+        data[0] = static_cast<char>(value);
+        return 1;
+    }
+    // the bit-length gives the byte-count, or one too many due to the offsets.
+    int length = (64 - qCountLeadingZeroBits(value | 1) + 6) / 7;
+    if (value < VarIntOffsets[length])
+        --length;
+    if (length > 8)
+        return serialize(data, value);
+
+    quint64 bits = spread7Bits(value - VarIntOffsets[length]);
+    // all but the last byte get the continuation bit.
+    bits |= 0x8080808080808080ULL & (((1ULL << (8 * (length - 1))) - 1) << 8);
+    // the most significant byte goes first.
+    qToLittleEndian<quint64>(qbswap(bits << (64 - 8 * length)), reinterpret_cast<uchar*>(data));
+    return length;
+}
+
+bool CMF::unserializeFast(const char *data, int dataSize, int &position, quint64 &result)
+{
+    Q_ASSERT(data);
+    Q_ASSERT(position >= 0);
+    if (position < dataSize && (data[position] & 0x80) == 0) { // the most common case
+        result = static_cast<quint8>(data[position++]);
+        return true;
+    }
+    if (dataSize - position < 8) { // near the end, avoid reading past it.
+        result = 0;
+        return unserialize(data, dataSize, position, result);
+    }
+    return unserializeWord(data, position, result);
+}
+
+int CMF::unserializeMany(const char *data, int dataSize, int &position, quint64 *results, int count)
+{
+    Q_ASSERT(data);
+    Q_ASSERT(results);
+    static const SingleBytesKernel singleBytes = selectSingleBytesKernel();
+    int done = 0;
+    while (done < count && position < dataSize) {
+        if ((data[position] & 0x80) == 0) {
+            const int run = singleBytes(data + position, qMin(dataSize - position, count - done), results + done);
+            position += run;
+            done += run;
+        } else if (dataSize - position >= 8 ? unserializeWord(data, position, results[done])
+                   : unserializeFast(data, dataSize, position, results[done])) {
+            ++done;
+        } else {
+            break;
+        }
+    }
+    return done;
+}
@@ -59,4 +59,29 @@ namespace CMF {
      * take input data, which is of size dataSize and unserialize a utf8 encoded unsigned integer into result.
      */
     bool unserialize(const char *data, int dataSize, int &position, quint64 &result);
+
+    /*
+     * The functions below are optimized versions of the above, giving identical results.
+     * The versions above are kept as the reference implementation.
+     */
+
+    /**
+     * Same output as serialize(), but the bytes are built in a register instead of one at a time.
+     * Notice that up to 8 bytes are written even for short values, @a data needs room for
+     * 10 bytes; the maximum length of a varint.
+     */
+    int serializeFast(char *data, quint64 value);
+
+    /**
+     * Same as unserialize(), but reads the varint with a single 8-byte load instead of
+     * a loop. @a result is overwritten, it does not need to be zero.
+     */
+    bool unserializeFast(const char *data, int dataSize, int &position, quint64 &result);
+
+    /**
+     * Unserialize up to @a count varints that directly follow each other into @a results.
+     * Runs of single-byte values are decoded 16 or 32 at a time using SSE2 / AVX2 when available.
+     * @return the amount of values unserialized, less than count on malformed or missing data.
+     */
+    int unserializeMany(const char *data, int dataSize, int &position, quint64 *results, int count);
 }
@@ -0,0 +1,289 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CMFSCHEMA_H
+#define CMFSCHEMA_H
+
+#include "CMF.h"
+#include "MessageBuilder.h"
+#include "MessageParser.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include <string.h>
+
+/**
+ * CMFSchema binds CMF tags to the members of a struct. The mapping is declared once
+ * and both the encoder and the decoder are generated from it, keeping them in sync.
+ *
+ * For example:
+ * @code
+ *   struct Item { QByteArray name; quint64 count; };
+ *   typedef CMFSchema::Schema<Item, CMFSchema::KeyStartsRecord,
+ *       CMFSchema::Field<ItemName, CMF::ByteArray, Item, QByteArray, &Item::name>,
+ *       CMFSchema::Field<ItemCount, CMF::PositiveNumber, Item, quint64, &Item::count, CMFSchema::Optional>
+ *   > ItemSchema;
+ * @endcode
+ *
+ * The encoder writes fields with a tag below 31 using a header byte that is a
+ * compile-time constant. The decoder uses a table indexed by tag which holds the
+ * handler specialized for the member and value type of that field.
+ */
+namespace CMFSchema {
+
+enum FieldOption {
+    Required,   ///< always written.
+    Optional    ///< numbers are only written when above zero, bytearrays and strings when not empty.
+};
+
+/// Decides how ListReader splits the stream of fields into records.
+enum Grouping {
+    KeyStartsRecord,    ///< the first field of the schema starts a new record.
+    RepeatStartsRecord  ///< a field that was already seen in the current record starts a new record.
+};
+
+enum ReadResult {
+    Stored,
+    UnknownTag, ///< the tag is not part of this schema.
+    WrongType,  ///< the tag is known, but the value type is not the declared one.
+    MissingKey  ///< a field was found before the first field of the record (KeyStartsRecord only).
+};
+
+namespace Private {
+template <CMF::ValueType Type> struct ValueTraits;
+
+template <> struct ValueTraits<CMF::PositiveNumber> {
+    static bool matches(CMF::ValueType type) {
+        return type == CMF::PositiveNumber;
+    }
+    template <typename T> static void load(const MessageParser &parser, T &value) {
+        value = static_cast<T>(parser.longData());
+    }
+    template <typename T> static bool isEmpty(const T &value) {
+        return !(value > 0);
+    }
+    template <typename T> static void write(MessageBuilder &builder, quint8 header, const T &value) {
+        builder.addWithHeader(header, static_cast<quint64>(value));
+    }
+    template <typename T> static void write(MessageBuilder &builder, quint32 tag, const T &value) {
+        builder.add(tag, static_cast<quint64>(value));
+    }
+};
+
+template <> struct ValueTraits<CMF::ByteArray> {
+    static bool matches(CMF::ValueType type) {
+        return type == CMF::ByteArray;
+    }
+    static void load(const MessageParser &parser, QByteArray &value) {
+        value = parser.bytesData().toByteArray();
+    }
+    static bool isEmpty(const QByteArray &value) {
+        return value.isEmpty();
+    }
+    static void write(MessageBuilder &builder, quint8 header, const QByteArray &value) {
+        builder.addWithHeader(header, value.constData(), value.size());
+    }
+    static void write(MessageBuilder &builder, quint32 tag, const QByteArray &value) {
+        builder.add(tag, value);
+    }
+};
+
+template <> struct ValueTraits<CMF::String> {
+    static bool matches(CMF::ValueType type) {
+        return type == CMF::String;
+    }
+    static void load(const MessageParser &parser, QString &value) {
+        value = parser.stringData().toString();
+    }
+    static bool isEmpty(const QString &value) {
+        return value.isEmpty();
+    }
+    static void write(MessageBuilder &builder, quint8 header, const QString &value) {
+        const QByteArray utf8 = value.toUtf8();
+        builder.addWithHeader(header, utf8.constData(), utf8.size());
+    }
+    static void write(MessageBuilder &builder, quint32 tag, const QString &value) {
+        builder.add(tag, value);
+    }
+};
+
+/// booleans are declared as BoolTrue, the header of BoolFalse is one higher.
+template <> struct ValueTraits<CMF::BoolTrue> {
+    static bool matches(CMF::ValueType type) {
+        return type == CMF::BoolTrue || type == CMF::BoolFalse;
+    }
+    static void load(const MessageParser &parser, bool &value) {
+        value = parser.boolData();
+    }
+    static bool isEmpty(bool value) {
+        return !value;
+    }
+    static void write(MessageBuilder &builder, quint8 header, bool value) {
+        builder.addWithHeader(value ? header : header + 1);
+    }
+    static void write(MessageBuilder &builder, quint32 tag, bool value) {
+        builder.add(tag, value);
+    }
+};
+}
+
+/**
+ * A single field, mapping @a Tag to @a Member of @a Record which is of type @a T.
+ * @a Type is the CMF::ValueType used on the wire; CMF::BoolTrue for booleans.
+ */
+template <quint32 Tag, CMF::ValueType Type, typename Record, typename T, T Record::*Member,
+          FieldOption Option = Required>
+struct Field
+{
+    typedef Private::ValueTraits<Type> Traits;
+    enum {
+        tag = Tag,
+        // the header byte, only valid for tags below 31.
+        header = ((Tag < 31 ? Tag : 31) << 3) | Type
+    };
+
+    static void write(MessageBuilder &builder, const Record &record) {
+        const T &value = record.*Member;
+        if (Option == Optional && Traits::isEmpty(value))
+            return;
+        if (Tag < 31)
+            Traits::write(builder, static_cast<quint8>(header), value);
+        else
+            Traits::write(builder, static_cast<quint32>(Tag), value);
+    }
+
+    static bool read(const MessageParser &parser, Record &record) {
+        if (!Traits::matches(parser.valueType()))
+            return false;
+        Traits::load(parser, record.*Member);
+        return true;
+    }
+};
+
+/**
+ * The schema of @a Record, a list of Field types.
+ * At most 32 fields are supported.
+ */
+template <typename Record, Grouping Group, typename... Fields>
+class Schema
+{
+public:
+    typedef bool (*Handler)(const MessageParser &, Record &);
+
+    /// write all fields of @a record, in the order of declaration.
+    static void write(MessageBuilder &builder, const Record &record) {
+        const int expand[] = { 0, (Fields::write(builder, record), 0)... };
+        Q_UNUSED(expand);
+    }
+
+    /// returns true if @a tag is one of the fields of this schema.
+    static inline bool contains(quint32 tag) {
+        return indexOf(tag) >= 0;
+    }
+
+    /// store the value the parser is positioned on in @a record.
+    static ReadResult read(const MessageParser &parser, Record &record) {
+        const int index = indexOf(parser.tag());
+        if (index < 0)
+            return UnknownTag;
+        return table().handlers[index](parser, record) ? Stored : WrongType;
+    }
+
+    /**
+     * Reads a sequence of records from a flat stream of fields, appending
+     * them to a list which should start empty. The Grouping of the schema decides
+     * where one record ends and the next starts.
+     */
+    class ListReader
+    {
+    public:
+        explicit ListReader(QList<Record> &list) : m_list(list), m_seen(0) {}
+
+        ReadResult read(const MessageParser &parser) {
+            const int index = indexOf(parser.tag());
+            if (index < 0)
+                return UnknownTag;
+            const quint32 bit = 1U << index;
+            bool startsRecord;
+            if (Group == KeyStartsRecord) {
+                startsRecord = index == 0;
+                if (!startsRecord && m_list.isEmpty())
+                    return MissingKey;
+            } else {
+                startsRecord = m_list.isEmpty() || (m_seen & bit);
+            }
+            if (startsRecord) {
+                m_list.append(Record());
+                m_seen = 0;
+            }
+            m_seen |= bit;
+            return table().handlers[index](parser, m_list.last()) ? Stored : WrongType;
+        }
+
+    private:
+        QList<Record> &m_list;
+        quint32 m_seen; // bit per field seen in the current record
+    };
+
+private:
+    enum {
+        FieldCount = sizeof...(Fields),
+        DirectTags = 32 // tags below this are looked up directly
+    };
+
+    struct Table {
+        Handler handlers[FieldCount];
+        quint32 tags[FieldCount];
+        qint8 byTag[DirectTags]; // index in handlers, or -1
+    };
+
+    static const Table &table() {
+        static const Table table = createTable();
+        return table;
+    }
+
+    static Table createTable() {
+        static_assert(FieldCount <= 32, "A schema can have at most 32 fields");
+        const Handler handlers[] = { &Fields::read... };
+        const quint32 tags[] = { static_cast<quint32>(Fields::tag)... };
+        Table answer;
+        memset(answer.byTag, -1, sizeof(answer.byTag));
+        for (int i = 0; i < FieldCount; ++i) {
+            answer.handlers[i] = handlers[i];
+            answer.tags[i] = tags[i];
+            if (tags[i] < DirectTags)
+                answer.byTag[tags[i]] = i;
+        }
+        return answer;
+    }
+
+    static inline int indexOf(quint32 tag) {
+        const Table &t = table();
+        if (tag < DirectTags)
+            return t.byTag[tag];
+        for (int i = 0; i < FieldCount; ++i) {
+            if (t.tags[i] == tag)
+                return i;
+        }
+        return -1;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ChunkedCorpus.h"
+#include "CorpusReader.h"
+
+#include <QRunnable>
+#include <QThread>
+
+namespace {
+class RangeJob : public QRunnable
+{
+public:
+    RangeJob(ChunkedCorpus::Analysis &analysis, const QList<QByteArray> &chunk, int range, int start, int count)
+        : m_analysis(analysis),
+          m_chunk(chunk),
+          m_range(range),
+          m_start(start),
+          m_count(count)
+    {
+    }
+
+    void run() {
+        m_analysis.processRange(m_chunk, m_range, m_start, m_count);
+    }
+
+private:
+    ChunkedCorpus::Analysis &m_analysis;
+    const QList<QByteArray> &m_chunk;
+    const int m_range;
+    const int m_start;
+    const int m_count;
+};
+}
+
+void ChunkedCorpus::Analysis::beginChunk(const QList<QByteArray> &, qint64, int)
+{
+}
+
+ChunkedCorpus::ChunkedCorpus()
+    : m_threadCount(QThread::idealThreadCount())
+{
+    if (m_threadCount < 1)
+        m_threadCount = 1;
+    m_pool.setMaxThreadCount(m_threadCount);
+}
+
+void ChunkedCorpus::setThreadCount(int threads)
+{
+    Q_ASSERT(threads > 0);
+    m_threadCount = threads;
+    m_pool.setMaxThreadCount(m_threadCount);
+}
+
+qint64 ChunkedCorpus::forEachChunk(CorpusReader &reader, Analysis &analysis)
+{
+    QList<QByteArray> chunk;
+    qint64 transactions = 0;
+    while (true) {
+        chunk.clear();
+        if (reader.read(chunk, ChunkSize) == 0)
+            break;
+
+        const int rangeSize = qMax(1, chunk.size() / (m_threadCount * 4));
+        const int rangeCount = (chunk.size() + rangeSize - 1) / rangeSize;
+        analysis.beginChunk(chunk, transactions, rangeCount);
+        for (int range = 0; range < rangeCount; ++range) {
+            const int start = range * rangeSize;
+            m_pool.start(new RangeJob(analysis, chunk, range, start, qMin(rangeSize, chunk.size() - start)));
+        }
+        m_pool.waitForDone();
+        analysis.reduceChunk(chunk, transactions);
+        transactions += chunk.size();
+    }
+    return transactions;
+}
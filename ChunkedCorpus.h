@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CHUNKEDCORPUS_H
+#define CHUNKEDCORPUS_H
+
+#include <QByteArray>
+#include <QList>
+#include <QThreadPool>
+
+class CorpusReader;
+
+/**
+ * ChunkedCorpus reads a corpus in chunks and spreads the work on each chunk over a pool of threads.
+ *
+ * The work is supplied as an Analysis. Each chunk is split into ranges, a few per thread
+ * so a slow range doesn't leave the other threads idle, and processRange() is called for
+ * every range on a worker thread. When all ranges of a chunk are done reduceChunk() is
+ * called on the calling thread, chunk after chunk in corpus order.
+ */
+class ChunkedCorpus
+{
+public:
+    class Analysis
+    {
+    public:
+        virtual ~Analysis() {}
+
+        /// called before the ranges of @a chunk are processed, @a firstIndex is the corpus index of its first transaction.
+        virtual void beginChunk(const QList<QByteArray> &chunk, qint64 firstIndex, int rangeCount);
+        /// process the @a count transactions of @a chunk starting at @a start. Ranges are processed in parallel.
+        virtual void processRange(const QList<QByteArray> &chunk, int range, int start, int count) = 0;
+        /// merge the results of the ranges of @a chunk.
+        virtual void reduceChunk(const QList<QByteArray> &chunk, qint64 firstIndex) = 0;
+    };
+
+    ChunkedCorpus();
+
+    /// the amount of worker threads, defaults to the amount of cores.
+    void setThreadCount(int threads);
+    inline int threadCount() const {
+        return m_threadCount;
+    }
+
+    /// the pool running the ranges, for other parallel steps of an analysis.
+    inline QThreadPool &pool() {
+        return m_pool;
+    }
+
+    /// run @a analysis on all transactions from the reader, returns the amount of transactions.
+    qint64 forEachChunk(CorpusReader &reader, Analysis &analysis);
+
+    enum {
+        ChunkSize = 10000
+    };
+
+private:
+    int m_threadCount;
+    QThreadPool m_pool;
+};
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ColumnarArchive.h"
+#include "CMF.h"
+#include "StreamMethods.h"
+#include "TransactionBatch.h"
+#include "TransactionView.h"
+
+#include <QRunnable>
+#include <QThreadPool>
+#include <QDebug>
+
+#include <string.h>
+
+namespace {
+const int HeaderSize = 8;
+const int FooterSize = 24;
+const int BlockHeaderSize = 16;
+
+// reads one column of a block from the start.
+class ColumnReader
+{
+public:
+    ColumnReader(const ConstBytes &column) : m_data(column.data), m_size(column.size), m_position(0) {}
+
+    inline bool readVarInt(quint64 &value) {
+        return CMF::unserializeFast(m_data, m_size, m_position, value);
+    }
+    inline const char *readBytes(quint64 count) {
+        if (count > static_cast<quint64>(m_size - m_position))
+            return 0;
+        const char *answer = m_data + m_position;
+        m_position += count;
+        return answer;
+    }
+    inline bool atEnd() const {
+        return m_position == m_size;
+    }
+
+private:
+    const char *m_data;
+    int m_size;
+    int m_position;
+};
+
+inline void appendCompact(QByteArray &out, quint64 value)
+{
+    char buffer[9];
+    out.append(buffer, Streaming::writeBitcoinCompact(buffer, value));
+}
+
+inline void append32bitValue(QByteArray &out, quint32 value)
+{
+    char buffer[4];
+    Streaming::write32bitValue(buffer, value);
+    out.append(buffer, 4);
+}
+
+// sums the output values of a range of blocks.
+class SumJob : public QRunnable
+{
+public:
+    SumJob(const ColumnarArchive *archive, int begin, int end, quint64 *sum, int *damaged)
+        : m_archive(archive), m_begin(begin), m_end(end), m_sum(sum), m_damaged(damaged)
+    {
+    }
+
+    void run() {
+        QVector<quint64> values;
+        for (int i = m_begin; i < m_end; ++i) {
+            if (!ColumnarArchive::decodeValues(m_archive->block(i), values))
+                ++*m_damaged;
+            *m_sum += TransactionBatch::sum(values.constData(), values.size());
+        }
+    }
+
+private:
+    const ColumnarArchive *m_archive;
+    const int m_begin;
+    const int m_end;
+    quint64 *m_sum;
+    int *m_damaged;
+};
+}
+
+ColumnarArchive::ColumnarArchive()
+    : m_data(0),
+      m_size(0),
+      m_transactionCount(0)
+{
+}
+
+ColumnarArchive::~ColumnarArchive()
+{
+    close();
+}
+
+const char *ColumnarArchive::columnName(Column column)
+{
+    static const char *const Names[ColumnCount] = {
+        "versions", "lock-times", "input-counts", "output-counts",
+        "prev-hashes", "prev-indexes", "sequences", "input-script-sizes", "input-scripts",
+        "values", "template-dictionary", "script-templates", "script-payloads", "script-sizes", "scripts",
+        "raw-sizes", "raw-transactions"
+    };
+    Q_ASSERT(column >= 0 && column < ColumnCount);
+    return Names[column];
+}
+
+bool ColumnarArchive::findTemplate(const char *script, int size, ScriptTemplate &scriptTemplate)
+{
+    const quint8 *bytes = reinterpret_cast<const quint8*>(script);
+    int position = 0;
+    int literalStart = 0;
+    int count = 0;
+    while (position < size) {
+        const quint8 opcode = bytes[position];
+        int header = 1;
+        qint64 length = 0;
+        if (opcode >= 1 && opcode <= 75) {
+            length = opcode;
+        } else if (opcode == 76 && position + 1 < size) { // OP_PUSHDATA1
+            length = bytes[position + 1];
+            header = 2;
+        } else if (opcode == 77 && position + 2 < size) { // OP_PUSHDATA2
+            length = Streaming::fetch16bitValue(script, position + 1);
+            header = 3;
+        } else if (opcode == 78 && position + 4 < size) { // OP_PUSHDATA4
+            length = Streaming::fetch32bitValue(script, position + 1);
+            header = 5;
+        } else if (opcode >= 76 && opcode <= 78) {
+            return false;
+        }
+        if (position + header + length > size)
+            return false;
+        if (length >= MinPayloadSize) {
+            if (count == MaxPayloads)
+                return false;
+            scriptTemplate.literals[count] = ConstBytes(script + literalStart, position + header - literalStart);
+            scriptTemplate.payloadSizes[count] = length;
+            ++count;
+            literalStart = position + header + length;
+        }
+        position += header + length;
+    }
+    scriptTemplate.literals[count] = ConstBytes(script + literalStart, size - literalStart);
+    scriptTemplate.payloadCount = count;
+    return count > 0;
+}
+
+void ColumnarArchive::writeTemplate(QByteArray &column, const ScriptTemplate &scriptTemplate)
+{
+    char buffer[10];
+    column.append(buffer, CMF::serializeFast(buffer, scriptTemplate.payloadCount));
+    for (int i = 0; i <= scriptTemplate.payloadCount; ++i) {
+        const ConstBytes &literal = scriptTemplate.literals[i];
+        column.append(buffer, CMF::serializeFast(buffer, literal.size));
+        column.append(literal.data, literal.size);
+        if (i < scriptTemplate.payloadCount)
+            column.append(buffer, CMF::serializeFast(buffer, scriptTemplate.payloadSizes[i]));
+    }
+}
+
+bool ColumnarArchive::readTemplates(const ConstBytes &column, QVector<ScriptTemplate> &templates)
+{
+    templates.resize(0);
+    ColumnReader reader(column);
+    while (!reader.atEnd()) {
+        ScriptTemplate scriptTemplate;
+        quint64 count;
+        if (templates.size() == MaxTemplates || !reader.readVarInt(count) || count == 0 || count > MaxPayloads)
+            return false;
+        scriptTemplate.payloadCount = count;
+        for (int i = 0; i <= scriptTemplate.payloadCount; ++i) {
+            quint64 size;
+            const char *literal;
+            if (!reader.readVarInt(size) || (literal = reader.readBytes(size)) == 0)
+                return false;
+            scriptTemplate.literals[i] = ConstBytes(literal, size);
+            if (i == scriptTemplate.payloadCount)
+                break;
+            if (!reader.readVarInt(size) || size < MinPayloadSize || size > 0x7FFFFFFF)
+                return false;
+            scriptTemplate.payloadSizes[i] = size;
+        }
+        templates.append(scriptTemplate);
+    }
+    return true;
+}
+
+bool ColumnarArchive::open(const QString &filename)
+{
+    close();
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open columnar archive" << filename;
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size >= HeaderSize + FooterSize)
+        m_data = reinterpret_cast<const char*>(m_file.map(0, m_size));
+    if (m_data == 0 || memcmp(m_data, "TXCOLS02", 8) != 0
+            || memcmp(m_data + m_size - 8, "TXCOLIX1", 8) != 0) {
+        qWarning() << "Not a complete columnar archive" << filename;
+        close();
+        return false;
+    }
+    const char *footer = m_data + m_size - FooterSize;
+    const quint64 listOffset = Streaming::fetch64bitValue(footer, 0);
+    const quint64 blockCount = Streaming::fetch64bitValue(footer, 8);
+    bool ok = listOffset >= HeaderSize && blockCount <= static_cast<quint64>(m_size) / 8
+            && listOffset + blockCount * 8 + FooterSize == static_cast<quint64>(m_size);
+    for (quint64 i = 0; ok && i < blockCount; ++i) {
+        const quint64 offset = Streaming::fetch64bitValue(m_data, listOffset + i * 8);
+        // compared without adding to the offset, which could wrap around.
+        ok = offset >= HeaderSize && offset <= listOffset && listOffset - offset >= BlockHeaderSize + ColumnCount * 4;
+        if (!ok)
+            break;
+        const quint64 columnsOffset = offset + BlockHeaderSize + ColumnCount * 4;
+        const char *header = m_data + offset;
+        Block block;
+        block.transactions = Streaming::fetch32bitValue(header, 0);
+        block.inputs = Streaming::fetch32bitValue(header, 4);
+        block.outputs = Streaming::fetch32bitValue(header, 8);
+        ok = Streaming::fetch32bitValue(header, 12) == ColumnCount
+                && block.transactions >= 0 && block.inputs >= 0 && block.outputs >= 0;
+        quint64 position = columnsOffset;
+        for (int column = 0; ok && column < ColumnCount; ++column) {
+            const quint32 size = Streaming::fetch32bitValue(header, BlockHeaderSize + column * 4);
+            ok = size <= listOffset - position;
+            block.columns[column] = ConstBytes(m_data + position, size);
+            position += size;
+        }
+        m_blocks.append(block);
+        m_transactionCount += block.transactions;
+    }
+    if (!ok) {
+        qWarning() << "The block list of the columnar archive is damaged" << filename;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ColumnarArchive::close()
+{
+    m_file.close(); // this unmaps
+    m_data = 0;
+    m_size = 0;
+    m_transactionCount = 0;
+    m_blocks.clear();
+}
+
+bool ColumnarArchive::decode(const Block &block, QList<QByteArray> &transactions)
+{
+    ColumnReader versions(block.columns[Versions]);
+    ColumnReader lockTimes(block.columns[LockTimes]);
+    ColumnReader inputCounts(block.columns[InputCounts]);
+    ColumnReader outputCounts(block.columns[OutputCounts]);
+    ColumnReader prevHashes(block.columns[PrevHashes]);
+    ColumnReader prevIndexes(block.columns[PrevIndexes]);
+    ColumnReader sequences(block.columns[Sequences]);
+    ColumnReader inputScriptSizes(block.columns[InputScriptSizes]);
+    ColumnReader inputScripts(block.columns[InputScripts]);
+    ColumnReader values(block.columns[Values]);
+    ColumnReader templates(block.columns[ScriptTemplates]);
+    QVector<ScriptTemplate> dictionary;
+    const char *valueCoding = values.readBytes(1);
+    if (valueCoding == 0 || *valueCoding > DeltaValues || !readTemplates(block.columns[TemplateDictionary], dictionary))
+        return false;
+    const bool deltaValues = *valueCoding == DeltaValues;
+    quint64 previousValue = 0;
+    ColumnReader payloads(block.columns[ScriptPayloads]);
+    ColumnReader scriptSizes(block.columns[ScriptSizes]);
+    ColumnReader scripts(block.columns[Scripts]);
+    ColumnReader rawSizes(block.columns[RawSizes]);
+    ColumnReader rawTransactions(block.columns[RawTransactions]);
+
+    quint32 lockTime = 0;
+    for (int i = 0; i < block.transactions; ++i) {
+        quint64 version, size;
+        if (!versions.readVarInt(version))
+            return false;
+        if (version == 4) {
+            const char *raw;
+            if (!rawSizes.readVarInt(size) || (raw = rawTransactions.readBytes(size)) == 0)
+                return false;
+            transactions.append(QByteArray(raw, size));
+            continue;
+        }
+
+        quint64 delta, inputCount, outputCount;
+        if (version > 2 || !lockTimes.readVarInt(delta) || !inputCounts.readVarInt(inputCount)
+                || !outputCounts.readVarInt(outputCount))
+            return false;
+        lockTime += static_cast<quint32>((delta >> 1) ^ (0 - (delta & 1)));
+        QByteArray tx;
+        append32bitValue(tx, version);
+        appendCompact(tx, inputCount);
+        for (quint64 input = 0; input < inputCount; ++input) {
+            quint64 prevIndex, sequence;
+            const char *prevHash = prevHashes.readBytes(32);
+            const char *script;
+            if (prevHash == 0 || !prevIndexes.readVarInt(prevIndex) || !sequences.readVarInt(sequence)
+                    || !inputScriptSizes.readVarInt(size) || (script = inputScripts.readBytes(size)) == 0)
+                return false;
+            tx.append(prevHash, 32);
+            append32bitValue(tx, prevIndex - 1);
+            appendCompact(tx, size);
+            tx.append(script, size);
+            append32bitValue(tx, ~sequence);
+        }
+        appendCompact(tx, outputCount);
+        for (quint64 output = 0; output < outputCount; ++output) {
+            quint64 value;
+            const char *code = templates.readBytes(1);
+            if (!values.readVarInt(value) || code == 0)
+                return false;
+            if (deltaValues)
+                value = previousValue + ((value >> 1) ^ (0 - (value & 1)));
+            previousValue = value;
+            char valueBytes[8];
+            Streaming::write64bitValue(valueBytes, value);
+            tx.append(valueBytes, 8);
+            const int templateCode = static_cast<quint8>(*code);
+            if (templateCode > dictionary.size())
+                return false;
+            if (templateCode > 0) {
+                const ScriptTemplate &scriptTemplate = dictionary.at(templateCode - 1);
+                quint64 scriptSize = scriptTemplate.literals[0].size;
+                for (int j = 0; j < scriptTemplate.payloadCount; ++j)
+                    scriptSize += scriptTemplate.payloadSizes[j] + scriptTemplate.literals[j + 1].size;
+                appendCompact(tx, scriptSize);
+                for (int j = 0; j <= scriptTemplate.payloadCount; ++j) {
+                    tx.append(scriptTemplate.literals[j].data, scriptTemplate.literals[j].size);
+                    if (j == scriptTemplate.payloadCount)
+                        break;
+                    const char *payload = payloads.readBytes(scriptTemplate.payloadSizes[j]);
+                    if (payload == 0)
+                        return false;
+                    tx.append(payload, scriptTemplate.payloadSizes[j]);
+                }
+            } else {
+                const char *script;
+                if (!scriptSizes.readVarInt(size) || (script = scripts.readBytes(size)) == 0)
+                    return false;
+                appendCompact(tx, size);
+                tx.append(script, size);
+            }
+        }
+        append32bitValue(tx, lockTime);
+        transactions.append(tx);
+    }
+    // every byte of every column has to be used up.
+    return versions.atEnd() && lockTimes.atEnd() && inputCounts.atEnd() && outputCounts.atEnd()
+            && prevHashes.atEnd() && prevIndexes.atEnd() && sequences.atEnd() && inputScriptSizes.atEnd()
+            && inputScripts.atEnd() && values.atEnd() && templates.atEnd() && payloads.atEnd()
+            && scriptSizes.atEnd() && scripts.atEnd() && rawSizes.atEnd() && rawTransactions.atEnd();
+}
+
+bool ColumnarArchive::decodeValues(const Block &block, QVector<quint64> &values)
+{
+    const ConstBytes &column = block.columns[Values];
+    if (column.size == 0 || column.data[0] > DeltaValues) {
+        values.resize(0);
+        return false;
+    }
+    values.resize(block.outputs);
+    int position = 1;
+    const int count = CMF::unserializeMany(column.data, column.size, position, values.data(), block.outputs);
+    if (count != block.outputs || position != column.size) {
+        values.resize(count);
+        return false;
+    }
+    if (column.data[0] == DeltaValues) {
+        quint64 previous = 0;
+        quint64 *value = values.data();
+        for (int i = 0; i < count; ++i) {
+            previous += (value[i] >> 1) ^ (0 - (value[i] & 1));
+            value[i] = previous;
+        }
+    }
+
+    // the transactions stored as they are have to be parsed for their values.
+    ColumnReader rawSizes(block.columns[RawSizes]);
+    ColumnReader rawTransactions(block.columns[RawTransactions]);
+    TransactionView view;
+    while (!rawSizes.atEnd()) {
+        quint64 size;
+        const char *raw;
+        if (!rawSizes.readVarInt(size) || (raw = rawTransactions.readBytes(size)) == 0)
+            return false;
+        if (!view.parse(raw, size))
+            continue; // it has no outputs to count
+        foreach (const TransactionView::Output &output, view.outputs())
+            values.append(output.value);
+    }
+    return rawTransactions.atEnd();
+}
+
+quint64 ColumnarArchive::totalValue(int threadCount, bool *ok) const
+{
+    Q_ASSERT(threadCount > 0);
+    // a couple of jobs per thread, each sums a distinct range of blocks.
+    const int jobSize = qMax(1, m_blocks.size() / (threadCount * 4));
+    const int jobCount = (m_blocks.size() + jobSize - 1) / jobSize;
+    QVector<quint64> sums(jobCount, 0);
+    QVector<int> damaged(jobCount, 0);
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        for (int job = 0; job < jobCount; ++job) {
+            const int begin = job * jobSize;
+            pool.start(new SumJob(this, begin, qMin(begin + jobSize, m_blocks.size()), sums.data() + job,
+                                  damaged.data() + job));
+        }
+        pool.waitForDone();
+    }
+    quint64 total = 0;
+    int damagedBlocks = 0;
+    for (int job = 0; job < jobCount; ++job) {
+        total += sums.at(job);
+        damagedBlocks += damaged.at(job);
+    }
+    if (ok)
+        *ok = damagedBlocks == 0;
+    return total;
+}
@@ -0,0 +1,157 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef COLUMNARARCHIVE_H
+#define COLUMNARARCHIVE_H
+
+#include "MessageParser.h"
+
+#include <QFile>
+#include <QList>
+#include <QVector>
+
+/**
+ * ColumnarArchive reads a corpus that ColumnarWriter stored by column.
+ *
+ * The file holds blocks of transactions, each block stores every field in its own column:
+ * the output values of all its transactions one after the other, then all prev-hashes,
+ * and so on. Numbers are CMF varints, some of them delta and zig-zag coded. Output
+ * scripts are split into a template and their payloads, the pushed keys and hashes; each
+ * block has a dictionary of the templates its scripts use, so any script shape that is
+ * common in a block is stored as a one byte code. See Column for the encoding of each column.
+ *
+ * A block is decoded on its own, so blocks can be handed to different threads. A scan
+ * of one field, like totalValue(), only decodes (and, as the file is memory-mapped,
+ * only reads) the one column it needs.
+ */
+class ColumnarArchive
+{
+public:
+    ColumnarArchive();
+    ~ColumnarArchive();
+
+    /// the columns of a block, in the order they are stored.
+    enum Column {
+        Versions,           ///< varint per transaction, 4 means the transaction is stored in RawTransactions.
+        LockTimes,          ///< zig-zag varint per transaction, the difference with the previous lock time.
+        InputCounts,        ///< varint per transaction.
+        OutputCounts,       ///< varint per transaction.
+        PrevHashes,         ///< 32 bytes per input.
+        PrevIndexes,        ///< varint per input, the index plus one which makes the coinbase -1 a zero.
+        Sequences,          ///< varint per input, the inverted sequence which makes the common 0xFFFFFFFF a zero.
+        InputScriptSizes,   ///< varint per input.
+        InputScripts,       ///< the input scripts, concatenated.
+        /**
+         * A ValueCoding byte, then a varint per output; the value, or the zig-zag difference with
+         * the value before it. The writer picks the smaller of the two for each block.
+         */
+        Values,
+        TemplateDictionary, ///< the ScriptTemplates used in the block, see writeTemplate().
+        ScriptTemplates,    ///< byte per output, one plus the index of its template in the dictionary, or zero.
+        ScriptPayloads,     ///< the payloads of the output scripts that have a template, concatenated.
+        ScriptSizes,        ///< varint per output script that has no template.
+        Scripts,            ///< the output scripts that don't match a template, concatenated.
+        RawSizes,           ///< varint per transaction that is not a legacy one.
+        RawTransactions,    ///< those transactions, concatenated.
+        ColumnCount
+    };
+
+    enum ValueCoding {
+        PlainValues,
+        DeltaValues
+    };
+
+    enum {
+        MinPayloadSize = 20,    ///< smaller pushes are part of the template.
+        MaxPayloads = 16,       ///< per template, enough for a bare 15 of 15 multisig.
+        MaxTemplates = 255      ///< per block, later shapes are stored as they are.
+    };
+
+    /**
+     * An output script template, the bytes of a script with gaps for its payloads:
+     * literal 0, payload 0, literal 1, ... payload n - 1, literal n.
+     * A payload is the data of a push of at least MinPayloadSize bytes.
+     */
+    struct ScriptTemplate {
+        ScriptTemplate() : payloadCount(0) {}
+        int payloadCount;
+        ConstBytes literals[MaxPayloads + 1];
+        int payloadSizes[MaxPayloads];
+    };
+    /// return a short name of @a column, like "values".
+    static const char *columnName(Column column);
+
+    /**
+     * split @a script into @a scriptTemplate, which points into the script.
+     * Returns false if the script has no payloads, more than MaxPayloads or a truncated push.
+     */
+    static bool findTemplate(const char *script, int size, ScriptTemplate &scriptTemplate);
+    /**
+     * append @a scriptTemplate to a TemplateDictionary column: a varint payload count,
+     * then each literal as a varint size and its bytes, each followed by the varint size of
+     * the payload after it.
+     */
+    static void writeTemplate(QByteArray &column, const ScriptTemplate &scriptTemplate);
+    /// read the dictionary of @a column into @a templates, returns false if it is damaged.
+    static bool readTemplates(const ConstBytes &column, QVector<ScriptTemplate> &templates);
+
+    struct Block {
+        Block() : transactions(0), inputs(0), outputs(0) {}
+        int transactions;
+        int inputs;     ///< of the transactions stored by column.
+        int outputs;
+        ConstBytes columns[ColumnCount];
+    };
+
+    /// open and map the archive, returns false if it is not a complete archive.
+    bool open(const QString &filename);
+    void close();
+
+    inline int blockCount() const {
+        return m_blocks.size();
+    }
+    inline qint64 transactionCount() const {
+        return m_transactionCount;
+    }
+    /// return the block at @a index, pointing into the mapping.
+    inline const Block &block(int index) const {
+        return m_blocks.at(index);
+    }
+
+    /// rebuild the transactions of @a block, appending them to @a transactions. Returns false if the block is damaged.
+    static bool decode(const Block &block, QList<QByteArray> &transactions);
+    /**
+     * Decode only the output values of @a block into @a values, those of the transactions stored
+     * by column followed by those of the ones stored as they are. Returns false if the block is damaged.
+     */
+    static bool decodeValues(const Block &block, QVector<quint64> &values);
+
+    /**
+     * return the sum of all output values, decoding the blocks with @a threadCount threads.
+     * @a ok is set to false if a block is damaged.
+     */
+    quint64 totalValue(int threadCount, bool *ok = 0) const;
+
+private:
+    QFile m_file;
+    const char *m_data;
+    qint64 m_size;
+    qint64 m_transactionCount;
+    QVector<Block> m_blocks;
+};
+
+#endif
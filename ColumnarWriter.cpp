@@ -0,0 +1,188 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ColumnarWriter.h"
+#include "CMF.h"
+#include "StreamMethods.h"
+
+ColumnarWriter::ColumnarWriter(QIODevice *device, int blockSize)
+    : m_out(device),
+      m_blockSize(blockSize),
+      m_transactions(0),
+      m_inputs(0),
+      m_outputs(0),
+      m_lastLockTime(0),
+      m_count(0),
+      m_rawCount(0),
+      m_columnSizes(ColumnarArchive::ColumnCount, 0)
+{
+    Q_ASSERT(blockSize > 0);
+    m_out.append("TXCOLS02");
+}
+
+namespace {
+inline quint64 zigZag(qint64 value)
+{
+    return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+}
+}
+
+void ColumnarWriter::appendVarInt(ColumnarArchive::Column column, quint64 value)
+{
+    char buffer[10];
+    m_columns[column].append(buffer, CMF::serializeFast(buffer, value));
+}
+
+void ColumnarWriter::append(const char *data, int size)
+{
+    Q_ASSERT(data);
+    Q_ASSERT(size >= 0);
+    if (!appendColumns(data, size)) {
+        appendVarInt(ColumnarArchive::Versions, 4);
+        appendVarInt(ColumnarArchive::RawSizes, size);
+        m_columns[ColumnarArchive::RawTransactions].append(data, size);
+        ++m_rawCount;
+    }
+    ++m_count;
+    if (++m_transactions == m_blockSize)
+        writeBlock();
+}
+
+bool ColumnarWriter::appendColumns(const char *data, int size)
+{
+    using namespace Streaming;
+    // only legacy transactions are split up, the others are stored raw.
+    if (!m_view.parse(data, size) || m_view.version() > 2)
+        return false;
+    const QVector<TransactionView::Input> &inputs = m_view.inputs();
+    const QVector<TransactionView::Output> &outputs = m_view.outputs();
+
+    // decoding writes minimal compact sizes, if the original didn't it can't be stored by column.
+    qint64 expectedSize = 8 + bitcoinCompactSize(inputs.size()) + bitcoinCompactSize(outputs.size());
+    foreach (const TransactionView::Input &input, inputs)
+        expectedSize += 40 + bitcoinCompactSize(input.script.length) + input.script.length;
+    foreach (const TransactionView::Output &output, outputs)
+        expectedSize += 8 + bitcoinCompactSize(output.script.length) + output.script.length;
+    if (expectedSize != size)
+        return false;
+
+    appendVarInt(ColumnarArchive::Versions, m_view.version());
+    appendVarInt(ColumnarArchive::LockTimes, zigZag(static_cast<qint64>(m_view.lockTime()) - m_lastLockTime));
+    m_lastLockTime = m_view.lockTime();
+    appendVarInt(ColumnarArchive::InputCounts, inputs.size());
+    appendVarInt(ColumnarArchive::OutputCounts, outputs.size());
+
+    foreach (const TransactionView::Input &input, inputs) {
+        m_columns[ColumnarArchive::PrevHashes].append(m_view.at(input.prevHash), 32);
+        appendVarInt(ColumnarArchive::PrevIndexes, static_cast<quint32>(input.prevIndex) + 1u);
+        appendVarInt(ColumnarArchive::Sequences, ~input.sequence);
+        appendVarInt(ColumnarArchive::InputScriptSizes, input.script.length);
+        m_columns[ColumnarArchive::InputScripts].append(m_view.at(input.script), input.script.length);
+    }
+    foreach (const TransactionView::Output &output, outputs) {
+        m_values.append(output.value);
+        const char *script = m_view.at(output.script);
+        const int code = templateCode(script, output.script.length);
+        m_columns[ColumnarArchive::ScriptTemplates].append(static_cast<char>(code));
+        if (code) {
+            for (int i = 0; i < m_template.payloadCount; ++i) {
+                const ConstBytes &literal = m_template.literals[i];
+                m_columns[ColumnarArchive::ScriptPayloads].append(literal.data + literal.size, m_template.payloadSizes[i]);
+            }
+        } else {
+            appendVarInt(ColumnarArchive::ScriptSizes, output.script.length);
+            m_columns[ColumnarArchive::Scripts].append(script, output.script.length);
+        }
+    }
+    m_inputs += inputs.size();
+    m_outputs += outputs.size();
+    return true;
+}
+
+int ColumnarWriter::templateCode(const char *script, int size)
+{
+    if (!ColumnarArchive::findTemplate(script, size, m_template))
+        return 0;
+    m_templateEntry.resize(0);
+    ColumnarArchive::writeTemplate(m_templateEntry, m_template);
+    const int known = m_templateCodes.value(m_templateEntry);
+    if (known)
+        return known;
+    if (m_templateCodes.size() == ColumnarArchive::MaxTemplates)
+        return 0;
+    const int code = m_templateCodes.size() + 1;
+    m_templateCodes.insert(m_templateEntry, code);
+    m_columns[ColumnarArchive::TemplateDictionary].append(m_templateEntry);
+    return code;
+}
+
+void ColumnarWriter::writeValues()
+{
+    // delta coding only pays off when the values of a block are close to each other, like in a batch of payouts.
+    qint64 plainSize = 0, deltaSize = 0;
+    quint64 previous = 0;
+    char buffer[10];
+    foreach (quint64 value, m_values) {
+        plainSize += CMF::serializeFast(buffer, value);
+        deltaSize += CMF::serializeFast(buffer, zigZag(value - previous));
+        previous = value;
+    }
+    const bool delta = deltaSize < plainSize;
+    m_columns[ColumnarArchive::Values].append(static_cast<char>(delta ? ColumnarArchive::DeltaValues
+                                                                       : ColumnarArchive::PlainValues));
+    previous = 0;
+    foreach (quint64 value, m_values) {
+        appendVarInt(ColumnarArchive::Values, delta ? zigZag(value - previous) : value);
+        previous = value;
+    }
+    m_values.resize(0);
+}
+
+void ColumnarWriter::writeBlock()
+{
+    if (m_transactions == 0)
+        return;
+    writeValues();
+    m_blockOffsets.append(m_out.bytesWritten());
+    m_out.append32bitValue(m_transactions);
+    m_out.append32bitValue(m_inputs);
+    m_out.append32bitValue(m_outputs);
+    m_out.append32bitValue(ColumnarArchive::ColumnCount);
+    for (int i = 0; i < ColumnarArchive::ColumnCount; ++i)
+        m_out.append32bitValue(m_columns[i].size());
+    for (int i = 0; i < ColumnarArchive::ColumnCount; ++i) {
+        m_out.append(m_columns[i].constData(), m_columns[i].size());
+        m_columnSizes[i] += m_columns[i].size();
+        m_columns[i].resize(0);
+    }
+    // every block starts from scratch, so it can be decoded on its own.
+    m_transactions = m_inputs = m_outputs = 0;
+    m_lastLockTime = 0;
+    m_templateCodes.clear();
+}
+
+bool ColumnarWriter::finish()
+{
+    writeBlock();
+    const qint64 listOffset = m_out.bytesWritten();
+    foreach (quint64 offset, m_blockOffsets)
+        m_out.append64bitValue(offset);
+    m_out.append64bitValue(listOffset);
+    m_out.append64bitValue(m_blockOffsets.size());
+    m_out.append("TXCOLIX1");
+    return m_out.flush() && m_out.isOk();
+}
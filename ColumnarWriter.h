@@ -0,0 +1,102 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef COLUMNARWRITER_H
+#define COLUMNARWRITER_H
+
+#include "BufferedWriter.h"
+#include "ColumnarArchive.h"
+#include "TransactionView.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+class QIODevice;
+
+/**
+ * ColumnarWriter stores a corpus of transactions by column, ColumnarArchive reads it.
+ *
+ * The file starts with the 8 bytes "TXCOLS02", followed by the blocks. A block starts with
+ * its transaction, input and output count and the amount of columns, followed by the size
+ * of each column and then the columns themselves (see ColumnarArchive::Column). After the
+ * blocks comes the offset of each block (64 bit), and the file ends with the offset of
+ * that list (64 bit), the amount of blocks (64 bit) and the 8 bytes "TXCOLIX1".
+ * All numbers in the headers are little-endian 32 bit unless noted otherwise.
+ *
+ * Legacy transactions are split into the columns, anything else (v4 transactions, but also
+ * legacy ones that don't parse or use non-minimal compact sizes) is stored as it is. Either
+ * way decoding gives back the exact bytes that were appended.
+ *
+ * The template dictionary of a block is built while its outputs are appended, the first
+ * MaxTemplates script shapes found get a code. The output values are kept until the block
+ * is written, to choose between plain and delta coding.
+ */
+class ColumnarWriter
+{
+public:
+    /// write to @a device, in blocks of @a blockSize transactions.
+    explicit ColumnarWriter(QIODevice *device, int blockSize = 16384);
+
+    /// append the @a size bytes transaction at @a data.
+    void append(const char *data, int size);
+
+    /// write the last block and the block list, returns false if any write to the device failed.
+    bool finish();
+
+    /// the amount of transactions appended.
+    inline qint64 count() const {
+        return m_count;
+    }
+    /// the amount of transactions that were stored as they are.
+    inline qint64 rawCount() const {
+        return m_rawCount;
+    }
+    /// the bytes written for each ColumnarArchive::Column, over all blocks.
+    inline const QVector<qint64> &columnSizes() const {
+        return m_columnSizes;
+    }
+    /// the bytes written to the device so far.
+    inline qint64 bytesWritten() const {
+        return m_out.bytesWritten();
+    }
+
+private:
+    bool appendColumns(const char *data, int size);
+    inline void appendVarInt(ColumnarArchive::Column column, quint64 value);
+    /// return the code of the template of @a script in the block dictionary, adding it if needed. Zero for none.
+    int templateCode(const char *script, int size);
+    void writeValues();
+    void writeBlock();
+
+    BufferedWriter m_out;
+    const int m_blockSize;
+    TransactionView m_view;
+    QByteArray m_columns[ColumnarArchive::ColumnCount];
+    int m_transactions, m_inputs, m_outputs; // in the current block
+    quint32 m_lastLockTime;
+    QVector<quint64> m_values; // of the current block
+    QHash<QByteArray, int> m_templateCodes; // the dictionary entry of a template, to its code
+    ColumnarArchive::ScriptTemplate m_template;
+    QByteArray m_templateEntry;
+    qint64 m_count;
+    qint64 m_rawCount;
+    QVector<qint64> m_columnSizes;
+    QVector<quint64> m_blockOffsets;
+};
+
+#endif
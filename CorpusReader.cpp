@@ -0,0 +1,144 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "CorpusReader.h"
+#include "BlockFileReader.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+CorpusReader::CorpusReader(const QString &path)
+    : m_path(path),
+      m_format(HexLines),
+      m_nextFile(0),
+      m_bytesRead(0),
+      m_blockFileDone(false),
+      m_fileBackend(RawFileLoader::Automatic),
+      m_fileLoader(0)
+{
+}
+
+CorpusReader::~CorpusReader()
+{
+    delete m_fileLoader;
+}
+
+void CorpusReader::setFileBackend(RawFileLoader::Backend backend)
+{
+    m_fileBackend = backend;
+}
+
+bool CorpusReader::open()
+{
+    QFileInfo info(m_path);
+    m_nextFile = 0;
+    if (info.isDir()) {
+        // sorted by name, that defines the input order.
+        QDir dir(m_path);
+        m_files = dir.entryList(QStringList() << "blk*.dat", QDir::Files | QDir::Readable, QDir::Name);
+        if (!m_files.isEmpty()) {
+            m_format = BlockFiles;
+        } else {
+            m_format = RawFileDirectory;
+            m_files = dir.entryList(QDir::Files | QDir::Readable, QDir::Name);
+        }
+        for (int i = 0; i < m_files.size(); ++i) {
+            m_files[i] = dir.filePath(m_files.at(i));
+        }
+        if (m_format == RawFileDirectory) {
+            delete m_fileLoader;
+            m_fileLoader = new RawFileLoader(m_fileBackend);
+            m_fileLoader->start(m_files);
+        }
+        return true;
+    }
+    if (BlockFileReader::isBlockFile(m_path)) {
+        m_format = BlockFiles;
+        m_files = QStringList() << m_path;
+        return true;
+    }
+
+    m_format = HexLines;
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open input" << m_path;
+        return false;
+    }
+    return true;
+}
+
+int CorpusReader::read(QList<QByteArray> &chunk, int max)
+{
+    Q_ASSERT(max > 0);
+    if (m_format == HexLines) {
+        int count = 0;
+        while (count < max && !m_file.atEnd()) {
+            const QByteArray line = m_file.readLine().trimmed();
+            if (line.isEmpty())
+                continue;
+            QByteArray tx = QByteArray::fromHex(line);
+            m_bytesRead += tx.size();
+            chunk.append(tx);
+            ++count;
+        }
+        return count;
+    }
+    if (m_format == BlockFiles)
+        return readBlockFiles(chunk, max);
+
+    // an unreadable file still takes its slot so the output order stays aligned.
+    const int start = chunk.size();
+    const int count = m_fileLoader->next(chunk, max);
+    for (int i = start; i < chunk.size(); ++i)
+        m_bytesRead += chunk.at(i).size();
+    return count;
+}
+
+int CorpusReader::readBlockFiles(QList<QByteArray> &chunk, int max)
+{
+    // the previous chunk may still point into the last file, only let go of it now.
+    if (m_blockFileDone) {
+        m_blockFile.clear();
+        m_blockFileDone = false;
+    }
+
+    int count = 0;
+    while (count < max) {
+        if (m_blockFile.isNull()) {
+            if (m_nextFile >= m_files.size())
+                break;
+            m_blockFile.reset(new BlockFileReader(m_files.at(m_nextFile++)));
+            if (!m_blockFile->open()) {
+                m_blockFile.clear();
+                continue;
+            }
+        }
+        if (!m_blockFile->next()) {
+            if (count > 0) { // stop at the file boundary to keep this chunk valid.
+                m_blockFileDone = true;
+                break;
+            }
+            m_blockFile.clear();
+            continue;
+        }
+        m_bytesRead += m_blockFile->transactionSize();
+        chunk.append(m_blockFile->transaction());
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CORPUSREADER_H
+#define CORPUSREADER_H
+
+#include "RawFileLoader.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QSharedPointer>
+#include <QStringList>
+
+class BlockFileReader;
+
+/**
+ * CorpusReader reads a large set of raw transactions in chunks.
+ *
+ * The source is either a text file with one hex-encoded transaction per line,
+ * a directory where each file holds exactly one raw transaction (which is
+ * what Transaction::read(filename) expects), or the blkNNNNN.dat files of a full
+ * node (a single file, or a directory holding them).
+ * Transactions are returned in input order, empty lines are skipped.
+ *
+ * Transactions read from block files point into the memory-mapped file. The reader lets
+ * go of the mapping in the read() call following the one that reached the end of that file.
+ * Callers keeping transactions longer than the next call to read() hold on to blockFile(),
+ * which keeps the mapping alive, or copy them.
+ *
+ * The files of a directory of raw transactions are read by a RawFileLoader, which keeps
+ * many of them in flight at the same time and reads ahead of the calls to read().
+ */
+class CorpusReader
+{
+public:
+    enum Format {
+        HexLines,
+        RawFileDirectory,
+        BlockFiles
+    };
+
+    explicit CorpusReader(const QString &path);
+    ~CorpusReader();
+
+    /// how to read a directory of raw transaction files, call before open(). Defaults to Automatic.
+    void setFileBackend(RawFileLoader::Backend backend);
+
+    /// detect the format of the source and open it. Returns false if the source is unusable.
+    bool open();
+
+    /**
+     * Append up to @a max transactions to @a chunk.
+     * @return the amount of transactions appended, zero when the source is exhausted.
+     */
+    int read(QList<QByteArray> &chunk, int max);
+
+    inline Format format() const {
+        return m_format;
+    }
+    /// the backend reading a directory of raw transaction files, null for the other formats.
+    inline const RawFileLoader *fileLoader() const {
+        return m_fileLoader;
+    }
+
+    /**
+     * For block files, return the reader of the file the transactions of the last read() point
+     * into, or null. The file stays mapped for as long as a copy of the pointer is held.
+     */
+    inline QSharedPointer<BlockFileReader> blockFile() const {
+        return m_blockFile;
+    }
+
+    /// return the amount of raw transaction bytes returned by read() so far.
+    inline qint64 bytesRead() const {
+        return m_bytesRead;
+    }
+
+private:
+    int readBlockFiles(QList<QByteArray> &chunk, int max);
+
+    QString m_path;
+    Format m_format;
+    QFile m_file;
+    QStringList m_files;
+    int m_nextFile;
+    qint64 m_bytesRead;
+    QSharedPointer<BlockFileReader> m_blockFile;
+    bool m_blockFileDone;
+    RawFileLoader::Backend m_fileBackend;
+    RawFileLoader *m_fileLoader;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "FeeStatistics.h"
+#include "CorpusReader.h"
+#include "ScriptClassifier.h"
+#include "Sha256.h"
+#include "Transaction.h"
+#include "TransactionView.h"
+#include "UtxoIndex.h"
+
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QTextStream>
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+const int FeeRateLimits[FeeStatistics::FeeRateGroupCount - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+
+class FeeAnalysis : public ChunkedCorpus::Analysis
+{
+public:
+    FeeAnalysis(FeeStatistics::Statistics &stats, QTextStream *details)
+        : m_stats(stats),
+          m_details(details),
+          m_index(UtxoIndex::ValuesOnly)
+    {
+    }
+
+    void beginChunk(const QList<QByteArray> &chunk, qint64, int) {
+        m_txids.resize(chunk.size() * Sha256::HashSize);
+    }
+
+    void processRange(const QList<QByteArray> &chunk, int, int start, int count) {
+        const QByteArray txids = Transaction::txids(chunk.mid(start, count));
+        memcpy(m_txids.data() + start * Sha256::HashSize, txids.constData(), txids.size());
+    }
+
+    // the index is updated in corpus order.
+    void reduceChunk(const QList<QByteArray> &chunk, qint64) {
+        for (int i = 0; i < chunk.size(); ++i, ++m_stats.transactions) {
+            if (!m_view.parse(chunk.at(i))) {
+                ++m_stats.failed;
+                continue;
+            }
+            const QVector<TransactionView::Input> &inputs = m_view.inputs();
+            const bool coinbase = m_view.isCoinbase();
+            quint64 inputValue = 0;
+            bool complete = true;
+            if (!coinbase) {
+                foreach (const TransactionView::Input &input, inputs) {
+                    char prevHash[Sha256::HashSize];
+                    memcpy(prevHash, m_view.at(input.prevHash), Sha256::HashSize);
+                    if (m_view.version() == 4) // v4 stores the hash in reverse
+                        std::reverse(prevHash, prevHash + Sha256::HashSize);
+                    if (m_index.spend(prevHash, input.prevIndex, &m_spent)) {
+                        inputValue += m_spent.value;
+                        ++m_stats.resolvedInputs;
+                    } else {
+                        complete = false;
+                    }
+                }
+                m_stats.inputs += inputs.size();
+            }
+            quint64 outputValue = 0;
+            const QVector<TransactionView::Output> &outputs = m_view.outputs();
+            for (int o = 0; o < outputs.size(); ++o) {
+                const TransactionView::Output &out = outputs.at(o);
+                outputValue += out.value;
+                // OP_RETURN outputs can't be spent, remembering them only grows the index.
+                if (ScriptClassifier::classify(m_view.at(out.script), out.script.length) != ScriptClassifier::NullData)
+                    m_index.insert(m_txids.constData() + i * Sha256::HashSize, o, out.value);
+            }
+            m_stats.peakUnspentOutputs = qMax(m_stats.peakUnspentOutputs, m_index.size());
+            m_stats.peakMemory = qMax(m_stats.peakMemory, m_index.memoryUsage());
+
+            if (coinbase) {
+                ++m_stats.coinbases;
+            } else if (!complete) {
+                ++m_stats.missingInputs;
+            } else if (outputValue > inputValue) {
+                ++m_stats.negativeFee;
+            } else {
+                const qint64 fee = inputValue - outputValue;
+                const double feeRate = static_cast<double>(fee) / m_view.size();
+                ++m_stats.withFee;
+                m_stats.fees += fee;
+                m_stats.feeBytes += m_view.size();
+                ++m_stats.feeRates[FeeStatistics::feeRateGroup(feeRate)];
+                if (m_details) {
+                    *m_details << m_stats.transactions << ',' << m_view.size() << ',' << fee << ','
+                               << QString::number(feeRate, 'f', 3) << '\n';
+                }
+                continue;
+            }
+            if (m_details)
+                *m_details << m_stats.transactions << ',' << m_view.size() << ",,\n";
+        }
+    }
+
+    inline const UtxoIndex &index() const {
+        return m_index;
+    }
+
+private:
+    FeeStatistics::Statistics &m_stats;
+    QTextStream *m_details;
+    UtxoIndex m_index;
+    UtxoIndex::Output m_spent;
+    TransactionView m_view;
+    QByteArray m_txids;
+};
+}
+
+FeeStatistics::FeeStatistics()
+    : m_details(0)
+{
+}
+
+void FeeStatistics::setThreadCount(int threads)
+{
+    m_workers.setThreadCount(threads);
+}
+
+void FeeStatistics::setDetailsDevice(QIODevice *device)
+{
+    m_details = device;
+}
+
+int FeeStatistics::feeRateGroup(double satoshisPerByte)
+{
+    int group = 0;
+    while (group < FeeRateGroupCount - 1 && satoshisPerByte >= FeeRateLimits[group])
+        ++group;
+    return group;
+}
+
+void FeeStatistics::collect(CorpusReader &reader)
+{
+    m_stats = Statistics();
+    QElapsedTimer timer;
+    timer.start();
+
+    QTextStream details;
+    if (m_details) {
+        details.setDevice(m_details);
+        details << "index,size,fee,feerate\n";
+    }
+
+    FeeAnalysis analysis(m_stats, m_details ? &details : 0);
+    m_workers.forEachChunk(reader, analysis);
+
+    m_stats.unspentOutputs = analysis.index().size();
+    m_stats.bytesIn = reader.bytesRead();
+    m_stats.milliseconds = timer.elapsed();
+}
+
+void FeeStatistics::printStatistics(QTextStream &out) const
+{
+    const double seconds = qMax<qint64>(1, m_stats.milliseconds) / 1000.;
+    out << "transactions: " << m_stats.transactions << " (" << m_stats.failed << " failed, "
+        << m_stats.coinbases << " coinbase)\n";
+    out << "inputs: " << m_stats.inputs << ", resolved: " << m_stats.resolvedInputs << "\n";
+    out << "with fee: " << m_stats.withFee << ", missing inputs: " << m_stats.missingInputs
+        << ", negative fee: " << m_stats.negativeFee << "\n";
+    out << "total fees: " << m_stats.fees << " sat";
+    if (m_stats.feeBytes > 0)
+        out << ", average " << QString::number(static_cast<double>(m_stats.fees) / m_stats.feeBytes, 'f', 3) << " sat/byte";
+    out << "\n";
+    for (int g = 0; g < FeeRateGroupCount; ++g) {
+        const QString name = g == 0 ? QString("< 1")
+                : g == FeeRateGroupCount - 1 ? QString(">= %1").arg(FeeRateLimits[g - 1])
+                : QString("%1 - %2").arg(FeeRateLimits[g - 1]).arg(FeeRateLimits[g]);
+        out << "  " << (name + " sat/byte").leftJustified(20) << QString::number(m_stats.feeRates[g]).rightJustified(12);
+        if (m_stats.withFee > 0)
+            out << (QString::number(m_stats.feeRates[g] * 100. / m_stats.withFee, 'f', 1) + "%").rightJustified(8);
+        out << "\n";
+    }
+    out << "unspent outputs: " << m_stats.unspentOutputs << ", peak " << m_stats.peakUnspentOutputs
+        << " using " << QString::number(m_stats.peakMemory / 1E6, 'f', 1) << " MB";
+    if (m_stats.peakUnspentOutputs > 0)
+        out << ", " << QString::number(static_cast<double>(m_stats.peakMemory) / m_stats.peakUnspentOutputs, 'f', 1) << " bytes per output";
+    out << "\n";
+    out << "time: " << m_stats.milliseconds << " ms, threads: " << m_workers.threadCount() << "\n";
+    out << "throughput: " << qRound64(m_stats.transactions / seconds) << " tx/s, "
+        << QString::number(m_stats.bytesIn / seconds / 1E6, 'f', 2) << " MB/s\n";
+}
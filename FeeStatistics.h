@@ -0,0 +1,100 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FEESTATISTICS_H
+#define FEESTATISTICS_H
+
+#include "ChunkedCorpus.h"
+
+class CorpusReader;
+class QIODevice;
+class QTextStream;
+
+/**
+ * FeeStatistics calculates the fee and fee rate of each transaction of a corpus.
+ *
+ * The values of the inputs are found in a UtxoIndex, which is filled with the outputs
+ * of the transactions read before. This requires the corpus to be in chain order,
+ * the inputs of a transaction that spends outputs that come later, or from outside
+ * the corpus, can't be resolved and the transaction is counted as missing inputs.
+ * Only values are kept in the index, about 30 bytes per unspent output, and OP_RETURN
+ * outputs are left out as they can never be spent.
+ *
+ * Updating the index is sequential, the txids are hashed in parallel, one batch per
+ * range of a chunk.
+ */
+class FeeStatistics
+{
+public:
+    FeeStatistics();
+
+    /// the amount of worker threads hashing txids, defaults to the amount of cores.
+    void setThreadCount(int threads);
+
+    /// if set, the fee of each transaction is written to @a device as a line of comma separated values.
+    void setDetailsDevice(QIODevice *device);
+
+    /// calculate the fees of all transactions from the reader.
+    void collect(CorpusReader &reader);
+
+    /// fee rates in satoshi per byte, below 1, 1-2, 2-5, 5-10 and so on, up to 1000 and more.
+    enum {
+        FeeRateGroupCount = 11
+    };
+
+    struct Statistics {
+        Statistics() : transactions(0), failed(0), coinbases(0), withFee(0), missingInputs(0), negativeFee(0),
+            inputs(0), resolvedInputs(0), fees(0), feeBytes(0), unspentOutputs(0), peakUnspentOutputs(0),
+            peakMemory(0), bytesIn(0), milliseconds(0) {
+            for (int i = 0; i < FeeRateGroupCount; ++i)
+                feeRates[i] = 0;
+        }
+        qint64 transactions;
+        qint64 failed;          // didn't parse
+        qint64 coinbases;
+        qint64 withFee;         // all inputs were resolved
+        qint64 missingInputs;   // transactions with inputs that were not found
+        qint64 negativeFee;     // the outputs are worth more than the inputs
+        qint64 inputs;
+        qint64 resolvedInputs;
+        qint64 fees;            // the total of the transactions withFee
+        qint64 feeBytes;        // the size of the transactions withFee
+        qint64 feeRates[FeeRateGroupCount];
+        qint64 unspentOutputs;  // left in the index at the end
+        qint64 peakUnspentOutputs;
+        qint64 peakMemory;      // of the index
+        qint64 bytesIn;
+        qint64 milliseconds;
+    };
+
+    inline const Statistics &statistics() const {
+        return m_stats;
+    }
+
+    /// print the results and the throughput of the last collect().
+    void printStatistics(QTextStream &out) const;
+
+    /// return the index in Statistics::feeRates of @a satoshisPerByte.
+    static int feeRateGroup(double satoshisPerByte);
+
+private:
+    ChunkedCorpus m_workers;
+    QIODevice *m_details;
+    Statistics m_stats;
+};
+
+#endif
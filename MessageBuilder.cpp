@@ -18,16 +18,18 @@
 #include "MessageBuilder.h"
 #include "CMF.h"
 
-#include <QBuffer>
+#include <QIODevice>
 #include <QDebug>
 
+#include <string.h>
+
 namespace {
     int write(char *data, quint32 tag, CMF::ValueType type) {
         Q_ASSERT(type < 8);
         if (tag >= 31) { // use more than 1 byte
             quint8 byte = type | 0xF8; // set the 'tag' to all 1s
             data[0] = byte;
-            return CMF::serialize(data +1, tag) + 1;
+            return CMF::serializeFast(data +1, tag) + 1;
         }
         Q_ASSERT(tag < 32);
         quint8 byte = tag;
@@ -39,26 +41,55 @@ namespace {
 }
 
 MessageBuilder::MessageBuilder(QIODevice *device)
-    : m_device(device),
-      m_ownsBuffer(false)
+    : m_backend(DeviceBackend),
+      m_device(device),
+      m_byteArray(0),
+      m_buffer(0),
+      m_bufferSize(0),
+      m_start(0),
+      m_size(0),
+      m_overflowed(false)
 {
     Q_ASSERT(device);
 }
 
 MessageBuilder::MessageBuilder(QByteArray *byteArray)
-    : m_device(new QBuffer(byteArray)),
-      m_ownsBuffer(true)
+    : m_backend(ByteArrayBackend),
+      m_device(0),
+      m_byteArray(byteArray),
+      m_buffer(0),
+      m_bufferSize(0),
+      m_start(byteArray->size()),
+      m_size(0),
+      m_overflowed(false)
 {
     Q_ASSERT(byteArray);
-    m_device->open(QIODevice::WriteOnly);
 }
 
-MessageBuilder::~MessageBuilder()
+MessageBuilder::MessageBuilder(char *buffer, int size)
+    : m_backend(BufferBackend),
+      m_device(0),
+      m_byteArray(0),
+      m_buffer(buffer),
+      m_bufferSize(size),
+      m_start(0),
+      m_size(0),
+      m_overflowed(false)
+{
+    Q_ASSERT(buffer);
+    Q_ASSERT(size >= 0);
+}
+
+MessageBuilder::MessageBuilder(MeasureTag)
+    : m_backend(MeasureBackend),
+      m_device(0),
+      m_byteArray(0),
+      m_buffer(0),
+      m_bufferSize(0),
+      m_start(0),
+      m_size(0),
+      m_overflowed(false)
 {
-    if (m_ownsBuffer) {
-        qobject_cast<QBuffer*>(m_device)->close();
-        delete m_device;
-    }
 }
 
 void MessageBuilder::add(quint32 tag, qint64 value)
@@ -71,42 +102,115 @@ void MessageBuilder::add(quint32 tag, qint64 value)
         value *= -1;
     }
     int tagSize = write(m_data, tag, vt);
-    tagSize += CMF::serialize(m_data + tagSize, value);
-    m_device->write(m_data, tagSize);
+    tagSize += CMF::serializeFast(m_data + tagSize, value);
+    append(tagSize);
 }
 
 void MessageBuilder::add(quint32 tag, quint64 value)
 {
     int tagSize = write(m_data, tag, CMF::PositiveNumber);
-    tagSize += CMF::serialize(m_data + tagSize, value);
-    m_device->write(m_data, tagSize);
+    tagSize += CMF::serializeFast(m_data + tagSize, value);
+    append(tagSize);
 }
 
 void MessageBuilder::add(quint32 tag, const QString &value)
 {
     int tagSize = write(m_data, tag, CMF::String);
     const QByteArray serializedData = value.toUtf8();
-    tagSize += CMF::serialize(m_data + tagSize, serializedData.count());
-    m_device->write(m_data, tagSize);
-    m_device->write(serializedData);
+    tagSize += CMF::serializeFast(m_data + tagSize, serializedData.count());
+    append(tagSize, serializedData.constData(), serializedData.size());
 }
 
 void MessageBuilder::add(quint32 tag, const QByteArray &data)
 {
     int tagSize = write(m_data, tag, CMF::ByteArray);
-    tagSize += CMF::serialize(m_data + tagSize, data.count());
-    m_device->write(m_data, tagSize);
-    m_device->write(data);
+    tagSize += CMF::serializeFast(m_data + tagSize, data.count());
+    append(tagSize, data.constData(), data.size());
 }
 
 void MessageBuilder::add(quint32 tag, bool value)
 {
     int tagSize = write(m_data, tag, value ? CMF::BoolTrue : CMF::BoolFalse);
-    m_device->write(m_data, tagSize);
+    append(tagSize);
+}
+
+void MessageBuilder::addWithHeader(quint8 header, quint64 value)
+{
+    m_data[0] = header;
+    append(1 + CMF::serializeFast(m_data + 1, value));
+}
+
+void MessageBuilder::addWithHeader(quint8 header, const char *data, int size)
+{
+    Q_ASSERT(size >= 0);
+    m_data[0] = header;
+    append(1 + CMF::serializeFast(m_data + 1, size), data, size);
+}
+
+void MessageBuilder::addWithHeader(quint8 header)
+{
+    m_data[0] = header;
+    append(1);
+}
+
+void MessageBuilder::addRaw(const char *data, int length)
+{
+    Q_ASSERT(length >= 0);
+    append(0, data, length);
 }
 
 void MessageBuilder::close()
 {
-    if (m_ownsBuffer)
-        qobject_cast<QBuffer*>(m_device)->close();
+    // Nothing is buffered and the device is owned by the caller, nothing to do.
+}
+
+void MessageBuilder::reset()
+{
+    m_size = 0;
+    m_overflowed = false;
+    if (m_backend == ByteArrayBackend) {
+        // marking the capacity as reserved avoids resize() freeing it.
+        m_byteArray->reserve(m_byteArray->capacity());
+        m_byteArray->resize(m_start);
+    }
+}
+
+void MessageBuilder::append(int headerSize, const char *payload, int payloadSize)
+{
+    // the header (tag and length / value) has been prepared in m_data
+    Q_ASSERT(headerSize >= 0 && headerSize <= (int) sizeof(m_data));
+    Q_ASSERT(payloadSize >= 0);
+    switch (m_backend) {
+    case DeviceBackend:
+        if (headerSize > 0)
+            m_device->write(m_data, headerSize);
+        if (payloadSize > 0)
+            m_device->write(payload, payloadSize);
+        break;
+    case ByteArrayBackend: {
+        const int pos = m_byteArray->size();
+        m_byteArray->resize(pos + headerSize + payloadSize);
+        char *out = m_byteArray->data() + pos;
+        memcpy(out, m_data, headerSize);
+        if (payloadSize > 0)
+            memcpy(out + headerSize, payload, payloadSize);
+        break;
+    }
+    case BufferBackend: {
+        if (m_size + headerSize + payloadSize > m_bufferSize) {
+            if (!m_overflowed)
+                qWarning() << "MessageBuilder: buffer too small, dropping data";
+            m_overflowed = true;
+            return;
+        }
+        char *out = m_buffer + m_size;
+        memcpy(out, m_data, headerSize);
+        if (payloadSize > 0)
+            memcpy(out + headerSize, payload, payloadSize);
+        break;
+    }
+    case MeasureBackend:
+        break;
+    }
+    m_size += headerSize + payloadSize;
 }
@@ -38,14 +38,29 @@ class QString;
  * You can compare this to an XML stream where some items are stored with tags or attributes
  * are unknown to the reader, without causing any effect on being able to parse them or to write
  * them out again unchanged.
+ *
+ * The builder can write to a QIODevice, or directly into memory without any virtual
+ * calls; either appending to a QByteArray or filling a caller-provided buffer.
+ * Last, there is the MeasureOnly mode which writes nothing and only calculates the
+ * size() of the message, which allows the caller to reserve memory once.
  */
 class MessageBuilder
 {
 public:
     explicit MessageBuilder(QIODevice *device);
+    /// append the message to @a byteArray, which grows as needed.
     explicit MessageBuilder(QByteArray *byteArray);
+    /**
+     * write the message into the caller-provided @a buffer of @a size bytes.
+     * Writes that don't fit are dropped with a warning, see overflowed().
+     */
+    MessageBuilder(char *buffer, int size);
 
-    ~MessageBuilder();
+    enum MeasureTag {
+        MeasureOnly
+    };
+    /// calculate the size() of the message without writing it anywhere.
+    explicit MessageBuilder(MeasureTag);
 
     void add(quint32 tag, quint64 value);
     void add(quint32 tag, qint64 value);
@@ -57,11 +72,52 @@ public:
     void add(quint32 tag, const QPointF &data);
     void add(quint32 tag, bool value);
 
+    /**
+     * Add a field where the caller provides the header byte, which for tags below 31
+     * is (tag << 3) | type. Used by the CMFSchema encoders which calculate it at compile time.
+     */
+    void addWithHeader(quint8 header, quint64 value);
+    void addWithHeader(quint8 header, const char *data, int size);
+    void addWithHeader(quint8 header);
+
+    /// append bytes verbatim, for framing that is not part of the CMF message.
+    void addRaw(const char *data, int length);
+
     void close();
 
+    /// return the amount of bytes written (or measured) since construction or the last reset().
+    inline int size() const {
+        return m_size;
+    }
+
+    /**
+     * Start a new message, reusing the memory. A byte array is truncated back to
+     * its size at construction time without freeing its capacity.
+     */
+    void reset();
+
+    /// returns true if a write did not fit in the buffer passed to the constructor.
+    inline bool overflowed() const {
+        return m_overflowed;
+    }
+
 private:
+    void append(int headerSize, const char *payload = 0, int payloadSize = 0);
+
+    enum Backend {
+        DeviceBackend,
+        ByteArrayBackend,
+        BufferBackend,
+        MeasureBackend
+    };
+    const Backend m_backend;
     QIODevice *m_device;
-    bool m_ownsBuffer;
+    QByteArray *m_byteArray;
+    char *m_buffer;
+    int m_bufferSize;
+    int m_start; // size of the byte array at construction time
+    int m_size;
+    bool m_overflowed;
     char m_data[20];
 };
 
@@ -23,18 +23,90 @@
 
 MessageParser::MessageParser(const QByteArray &data)
     : m_data(data),
-    m_privData(m_data.data()),
+    m_privData(m_data.constData()),
+    m_length(m_data.size()),
     m_position(0),
     m_tag(0),
-    m_valueState(ValueParsed),
+    m_valueType(CMF::BoolFalse),
+    m_longValue(0),
     m_dataStart(-1),
-    m_dataLength(-1)
+    m_dataLength(-1),
+    m_pushState(NotPushing),
+    m_finished(true),
+    m_pendingType(CMF::BoolFalse),
+    m_varInt(0),
+    m_varIntBytes(0),
+    m_payloadRemaining(0),
+    m_maxItemSize(0x7FFFFFFF)
 {
 }
 
+MessageParser::MessageParser(const char *data, int length)
+    : m_privData(data),
+    m_length(length),
+    m_position(0),
+    m_tag(0),
+    m_valueType(CMF::BoolFalse),
+    m_longValue(0),
+    m_dataStart(-1),
+    m_dataLength(-1),
+    m_pushState(NotPushing),
+    m_finished(true),
+    m_pendingType(CMF::BoolFalse),
+    m_varInt(0),
+    m_varIntBytes(0),
+    m_payloadRemaining(0),
+    m_maxItemSize(0x7FFFFFFF)
+{
+}
+
+MessageParser::MessageParser()
+    : m_privData(0),
+    m_length(0),
+    m_position(0),
+    m_tag(0),
+    m_valueType(CMF::BoolFalse),
+    m_longValue(0),
+    m_dataStart(-1),
+    m_dataLength(-1),
+    m_pushState(PushHeader),
+    m_finished(false),
+    m_pendingType(CMF::BoolFalse),
+    m_varInt(0),
+    m_varIntBytes(0),
+    m_payloadRemaining(0),
+    m_maxItemSize(0x7FFFFFFF)
+{
+}
+
+void MessageParser::feed(const char *data, int length)
+{
+    Q_ASSERT(m_pushState != NotPushing);
+    Q_ASSERT(!m_finished);
+    Q_ASSERT(m_position >= m_length); // the previous chunk is fully consumed
+    Q_ASSERT(data || length == 0);
+    m_privData = data;
+    m_length = length;
+    m_position = 0;
+}
+
+void MessageParser::finish()
+{
+    Q_ASSERT(m_pushState != NotPushing);
+    m_finished = true;
+}
+
+void MessageParser::setMaxItemSize(int bytes)
+{
+    Q_ASSERT(bytes >= 0);
+    m_maxItemSize = bytes;
+}
+
 MessageParser::Type MessageParser::next()
 {
-    if (m_data.count() <= m_position)
+    if (m_pushState != NotPushing)
+        return nextPushed();
+    if (m_length <= m_position)
         return EndOfDocument;
 
     quint8 byte = m_privData[m_position];
@@ -43,7 +115,7 @@ MessageParser::Type MessageParser::next()
     m_tag = byte >> 3;
     if (m_tag == 31) { // the tag is stored in the next byte(s)
         quint64 newTag = 0;
-        bool ok = CMF::unserialize(m_privData, m_data.size(), ++m_position, newTag);
+        bool ok = CMF::unserializeFast(m_privData, m_length, ++m_position, newTag);
         if (ok && newTag > 0xFFFF) {
             qWarning() << "Malformed tag-type" << newTag << "is a too large enum value";
             ok = false;
@@ -58,63 +130,200 @@ MessageParser::Type MessageParser::next()
     switch (type) {
     case CMF::NegativeNumber:
     case CMF::PositiveNumber: {
-        bool ok = CMF::unserialize(m_privData, m_data.size(), ++m_position, value);
+        bool ok = CMF::unserializeFast(m_privData, m_length, ++m_position, value);
         if (!ok) {
             --m_position;
             return Error;
         }
         if (type == CMF::NegativeNumber)
             value *= -1;
-        m_value = QVariant(value);
+        m_longValue = value;
         break;
     }
     case CMF::ByteArray:
     case CMF::String: {
         int newPos = m_position + 1;
-        bool ok = CMF::unserialize(m_privData, m_data.size(), newPos, value);
+        bool ok = CMF::unserializeFast(m_privData, m_length, newPos, value);
         if (!ok)
             return Error;
-        if (newPos + value > (unsigned int) m_data.count()) // need more bytes
+        if (newPos + value > (unsigned int) m_length) // need more bytes
             return Error;
 
-        m_valueState = type == CMF::ByteArray ? LazyByteArray : LazyString;
         m_dataStart = newPos;
         m_dataLength = value;
         m_position = newPos + value;
         break;
     }
     case CMF::BoolTrue:
-        m_value = QVariant(true);
-        ++m_position;
-        break;
     case CMF::BoolFalse:
-        m_value = QVariant(false);
         ++m_position;
         break;
     default:
         return Error;
     }
+    m_valueType = type;
     return FoundTag;
 }
 
+MessageParser::Type MessageParser::nextPushed()
+{
+    while (m_position < m_length) {
+        switch (m_pushState) {
+        case PushHeader: {
+            const quint8 byte = m_privData[m_position++];
+            m_pendingType = static_cast<CMF::ValueType>(byte & 0x07);
+            if (m_pendingType > CMF::BoolFalse)
+                return Error;
+            m_tag = byte >> 3;
+            if (m_tag == 31) { // the tag is stored in the next byte(s)
+                m_pushState = PushTag;
+                m_varInt = 0;
+                m_varIntBytes = 0;
+                break;
+            }
+            const Type type = startValue();
+            if (type != NeedMoreData)
+                return type;
+            break;
+        }
+        case PushTag: {
+            const int state = readVarInt();
+            if (state < 0)
+                return Error;
+            if (state == 0)
+                break;
+            if (m_varInt > 0xFFFF) {
+                qWarning() << "Malformed tag-type" << m_varInt << "is a too large enum value";
+                return Error;
+            }
+            m_tag = m_varInt;
+            const Type type = startValue();
+            if (type != NeedMoreData)
+                return type;
+            break;
+        }
+        case PushNumber: {
+            const int state = readVarInt();
+            if (state < 0)
+                return Error;
+            if (state == 0)
+                break;
+            m_longValue = m_varInt;
+            if (m_pendingType == CMF::NegativeNumber)
+                m_longValue *= -1;
+            m_valueType = m_pendingType;
+            m_pushState = PushHeader;
+            return FoundTag;
+        }
+        case PushLength: {
+            const int state = readVarInt();
+            if (state < 0)
+                return Error;
+            if (state == 0)
+                break;
+            if (m_varInt > static_cast<quint64>(m_maxItemSize))
+                return Error;
+            m_dataLength = m_varInt;
+            const int available = m_length - m_position;
+            if (m_dataLength <= available) { // the common case, no copying.
+                m_dataStart = m_position;
+                m_position += m_dataLength;
+                m_valueType = m_pendingType;
+                m_pushState = PushHeader;
+                return FoundTag;
+            }
+            // the length is not trusted, the buffer only grows as the payload arrives.
+            // Marking the capacity as reserved avoids resize() freeing it.
+            m_assembled.reserve(m_assembled.capacity());
+            m_assembled.resize(0);
+            m_assembled.append(m_privData + m_position, available);
+            m_position = m_length;
+            m_payloadRemaining = m_dataLength - available;
+            m_pushState = PushPayload;
+            break;
+        }
+        case PushPayload: {
+            const int count = qMin(m_payloadRemaining, m_length - m_position);
+            m_assembled.append(m_privData + m_position, count);
+            m_position += count;
+            m_payloadRemaining -= count;
+            if (m_payloadRemaining == 0) {
+                m_dataStart = -1;
+                m_valueType = m_pendingType;
+                m_pushState = PushHeader;
+                return FoundTag;
+            }
+            break;
+        }
+        case NotPushing:
+            Q_ASSERT(false);
+            return Error;
+        }
+    }
+    if (!m_finished)
+        return NeedMoreData;
+    return m_pushState == PushHeader ? EndOfDocument : Error;
+}
+
+MessageParser::Type MessageParser::startValue()
+{
+    switch (m_pendingType) {
+    case CMF::PositiveNumber:
+    case CMF::NegativeNumber:
+        m_pushState = PushNumber;
+        break;
+    case CMF::ByteArray:
+    case CMF::String:
+        m_pushState = PushLength;
+        break;
+    case CMF::BoolTrue:
+    case CMF::BoolFalse:
+        m_valueType = m_pendingType;
+        m_pushState = PushHeader;
+        return FoundTag;
+    }
+    m_varInt = 0;
+    m_varIntBytes = 0;
+    return NeedMoreData;
+}
+
+// continue reading a varint, returns 1 when done, 0 when the chunk ran out and -1 on errors.
+int MessageParser::readVarInt()
+{
+    // same logic as CMF::unserialize(), but able to stop and resume at any byte.
+    while (m_position < m_length) {
+        const quint8 byte = m_privData[m_position++];
+        m_varInt = (m_varInt << 7) | (byte & 0x7F);
+        if ((byte & 0x80) == 0)
+            return 1;
+        ++m_varInt;
+        if (++m_varIntBytes == 8)
+            return -1;
+    }
+    return 0;
+}
+
 quint32 MessageParser::tag() const
 {
     return m_tag;
 }
 
-QVariant MessageParser::data()
+QVariant MessageParser::data() const
 {
-    if (m_valueState != ValueParsed) {
-        QByteArray data(m_privData + m_dataStart, m_dataLength);
-        Q_ASSERT(data.count() == (int) m_dataLength);
-        if (m_valueState == LazyByteArray)
-            m_value = QVariant(data);
-        else
-            m_value = QVariant(QString::fromUtf8(data));
-        m_valueState = ValueParsed;
+    switch (m_valueType) {
+    case CMF::PositiveNumber:
+    case CMF::NegativeNumber:
+        return QVariant(m_longValue);
+    case CMF::ByteArray:
+        return QVariant(QByteArray(valueData(), m_dataLength));
+    case CMF::String:
+        return QVariant(QString::fromUtf8(valueData(), m_dataLength));
+    case CMF::BoolTrue:
+        return QVariant(true);
+    case CMF::BoolFalse:
+        return QVariant(false);
     }
-
-    return m_value;
+    return QVariant();
 }
 
 void MessageParser::consume(int bytes)
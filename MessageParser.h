@@ -18,12 +18,38 @@
 #ifndef MESSAGEPARSER_H
 #define MESSAGEPARSER_H
 
+#include "CMF.h"
+
 #include <QByteArray>
+#include <QString>
 #include <QVariant>
 #include <QPointF>
 
 class QIODevice;
-class QString;
+
+/**
+ * A non-owning reference to a range of bytes, as returned by the MessageParser.
+ * The bytes are only valid as long as the parsed document is.
+ */
+struct ConstBytes {
+    ConstBytes() : data(0), size(0) {}
+    ConstBytes(const char *d, int s) : data(d), size(s) {}
+
+    /// return a deep copy of the bytes.
+    inline QByteArray toByteArray() const {
+        return QByteArray(data, size);
+    }
+    /// interpret the bytes as utf8 and return a copy.
+    inline QString toString() const {
+        return QString::fromUtf8(data, size);
+    }
+    inline bool isEmpty() const {
+        return size == 0;
+    }
+
+    const char *data;
+    int size;
+};
 
 /**
  * MessageParser takes a CMF stream and parses it into tokens.
@@ -32,27 +58,99 @@ class QString;
  * long as FoundTag is returned you can then find the token-tag
  * as well as the actual data. The MessageParser will actually have typed
  * data based on what was encoded in the CMF stream. You can access
- * this using the different getters like getLong() getString(). Please note
- * that if the requested data is not what was present in the stream you will
- * end up throwing a casting exception in those getters.
+ * this using the typed getters longData(), boolData(), bytesData() and stringData(),
+ * which read straight from the document and never allocate. Please note
+ * that if the requested data is not what was present in the stream those getters
+ * return an empty value; check valueType() if you need to tell the difference.
+ * The data() getter wraps the value in a QVariant, it is convenient but slower.
+ *
+ * Data that arrives in pieces, for instance from a socket, can be parsed in push mode.
+ * Create the parser with the default constructor and feed() it each chunk, then call
+ * next() until it returns NeedMoreData. The parser remembers a partially read tag and
+ * continues where it left off on the next chunk, no byte is parsed twice. Values that
+ * fit in one chunk are returned without copying and are valid until the next feed(),
+ * only values that span chunks are collected in a buffer owned by the parser.
+ * Call finish() after the last chunk to get EndOfDocument, or Error for a truncated stream.
+ * That buffer grows with the bytes that actually arrived, not with the length the stream
+ * claims; use setMaxItemSize() to refuse long values from untrusted peers early.
  */
 class MessageParser
 {
 public:
     MessageParser(const QByteArray &data);
+    /**
+     * Parse the @a length bytes at @a data without copying them.
+     * The caller has to keep the data alive for the lifetime of the parser.
+     */
+    MessageParser(const char *data, int length);
+    /// create a parser in push mode, see feed().
+    MessageParser();
 
     enum Type {
         FoundTag,
         EndOfDocument,
-        Error
+        Error,
+        NeedMoreData ///< push mode only, all fed data has been consumed.
     };
 
     Type next();
 
+    /**
+     * Push mode: parse the @a length bytes at @a data next, without copying them.
+     * The previous chunk has to be completely consumed, which is the case when next()
+     * returned NeedMoreData. The data has to stay alive until the next feed().
+     */
+    void feed(const char *data, int length);
+    inline void feed(const QByteArray &chunk) {
+        feed(chunk.constData(), chunk.size());
+    }
+    /// Push mode: no more data will be fed, the end of the last chunk is the end of the document.
+    void finish();
+    /**
+     * Push mode: a bytearray or string longer than @a bytes makes next() return Error as soon
+     * as its length is read, before any of it is buffered. The default only limits it to 2GB.
+     */
+    void setMaxItemSize(int bytes);
+
     quint32 tag() const;
-    QVariant data();
+    /// return the value of the latest tag wrapped in a (copying) QVariant.
+    QVariant data() const;
+
+    /// return the type of the value of the latest tag.
+    inline CMF::ValueType valueType() const {
+        return m_valueType;
+    }
+
+    /// for PositiveNumber and NegativeNumber tags, return the value.
+    inline qint64 longData() const {
+        if (m_valueType != CMF::PositiveNumber && m_valueType != CMF::NegativeNumber)
+            return 0;
+        return static_cast<qint64>(m_longValue);
+    }
+
+    /// for BoolTrue and BoolFalse tags, return the value.
+    inline bool boolData() const {
+        return m_valueType == CMF::BoolTrue;
+    }
+
+    /// for ByteArray tags, return the bytes without copying them.
+    inline ConstBytes bytesData() const {
+        if (m_valueType != CMF::ByteArray)
+            return ConstBytes();
+        return ConstBytes(valueData(), m_dataLength);
+    }
+
+    /// for String tags, return the utf8 encoded bytes without copying or decoding them.
+    inline ConstBytes stringData() const {
+        if (m_valueType != CMF::String)
+            return ConstBytes();
+        return ConstBytes(valueData(), m_dataLength);
+    }
 
-    /// return the amount of bytes consumed up-including the latest parsed tag.
+    /**
+     * return the amount of bytes consumed up-including the latest parsed tag.
+     * In push mode this is relative to the start of the current chunk.
+     */
     inline int consumed() const {
         return m_position;
     }
@@ -60,21 +158,55 @@ public:
     /// consume a number of bytes without parsing.
     void consume(int bytes);
 
+    /**
+     * for ByteArray and String tags, return the offset in the document the value starts at.
+     * In push mode the offset is in the current chunk, or -1 if the value spanned chunks.
+     */
+    inline int dataStart() const {
+        return m_dataStart;
+    }
+    /// for ByteArray and String tags, return the amount of bytes of the value.
+    inline int dataLength() const {
+        return m_dataLength;
+    }
+
 private:
+    Type nextPushed();
+    int readVarInt();
+    Type startValue();
+
+    inline const char *valueData() const {
+        return m_dataStart >= 0 ? m_privData + m_dataStart : m_assembled.constData();
+    }
+
     const QByteArray m_data;
     const char *m_privData;
+    int m_length;
     int m_position;
-    QVariant m_value;
     quint32 m_tag;
 
-    enum LazyState {
-        ValueParsed,
-        LazyByteArray,
-        LazyString
-    };
-    LazyState m_valueState;
+    CMF::ValueType m_valueType;
+    quint64 m_longValue;
     int m_dataStart;
     int m_dataLength;
+
+    // push mode state
+    enum PushState {
+        NotPushing,
+        PushHeader,     // at the start of a tag
+        PushTag,        // reading the varint of a tag of 31 or higher
+        PushNumber,     // reading the varint of a number
+        PushLength,     // reading the varint length of a bytearray or string
+        PushPayload     // collecting a bytearray or string that spans chunks
+    };
+    PushState m_pushState;
+    bool m_finished;
+    CMF::ValueType m_pendingType;
+    quint64 m_varInt;
+    int m_varIntBytes;
+    int m_payloadRemaining;
+    int m_maxItemSize;
+    QByteArray m_assembled;
 };
 
 #endif
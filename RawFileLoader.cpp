@@ -0,0 +1,589 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "RawFileLoader.h"
+
+#include <QFile>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
+#include <QDebug>
+
+#include <string.h>
+
+#if defined(Q_OS_LINUX) && defined(__GNUC__)
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+# if defined(__NR_io_uring_setup) && defined(STATX_SIZE) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   include <linux/io_uring.h>
+#   define RAWFILELOADER_HAVE_URING
+#  endif
+# endif
+#endif
+
+namespace {
+const qint64 MaxFileSize = 1 << 30;
+
+QByteArray readFile(const QString &filename)
+{
+    QFile in(filename);
+    if (!in.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open input" << filename;
+        return QByteArray();
+    }
+    return in.readAll();
+}
+}
+
+#ifdef RAWFILELOADER_HAVE_URING
+// the rings shared with the kernel (see io_uring_setup(2)), and the files in flight.
+struct RawFileLoader::Ring {
+    explicit Ring(RawFileLoader *loader)
+        : fd(-1),
+          sqRing(MAP_FAILED),
+          cqRing(MAP_FAILED),
+          sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+          sqRingSize(0),
+          cqRingSize(0),
+          sqesSize(0),
+          loader(loader),
+          failed(false)
+    {
+        fileSlots.resize(loader->m_queueDepth);
+        for (int i = loader->m_queueDepth - 1; i >= 0; --i)
+            freeSlots.append(i);
+    }
+
+    ~Ring() {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    /**
+     * Start the files that fit in the window and the free slots, submit and handle the completions.
+     * With @a wait this blocks until at least one operation completed. Returns false if the ring failed.
+     */
+    bool pump(bool wait);
+    inline bool idle() const {
+        return freeSlots.size() == fileSlots.size();
+    }
+    /// keep the buffers of the unfinished files alive, the kernel may still write into them.
+    void abandon();
+
+    // each file in flight has a slot, it goes through an open and a statx at the same time, reads and a close.
+    enum Operation { Open, Stat, Read, Close };
+    struct Slot {
+        int file;
+        QByteArray path;
+        struct statx stat;
+        int fd;
+        int waiting; // for the open and the statx
+        bool finished;
+        int error;
+        qint64 size;
+        qint64 done;
+    };
+
+    /**
+     * Return a cleared submission entry for @a operation on @a slot, submitting the queued ones
+     * if the queue is full. Returns null if the ring failed.
+     */
+    io_uring_sqe *queue(int slot, Operation operation);
+    /// hand the queued entries to the kernel and wait for at least @a waitFor completions, false on failure.
+    bool submit(unsigned waitFor);
+    inline QByteArray &buffer(int file) {
+        return loader->m_window[file % loader->m_window.size()];
+    }
+    void start(int slot, int file);
+    void complete(const io_uring_cqe &cqe);
+    void queueRead(int slot);
+    void finish(int slot);
+
+    int fd;
+    void *sqRing;
+    void *cqRing;
+    io_uring_sqe *sqes;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqEntries;
+    unsigned sqTailLocal;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    io_uring_cqe *cqes;
+
+    RawFileLoader *loader;
+    QVector<Slot> fileSlots;
+    QVector<int> freeSlots;
+    QList<QByteArray> abandoned;
+    bool failed;
+};
+
+io_uring_sqe *RawFileLoader::Ring::queue(int slot, Operation operation)
+{
+    while (sqTailLocal - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        if (!submit(0))
+            return 0;
+    }
+    const unsigned index = sqTailLocal & *sqMask;
+    io_uring_sqe *sqe = sqes + index;
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->user_data = (static_cast<quint64>(slot) << 2) | operation;
+    sqArray[index] = index;
+    ++sqTailLocal;
+    return sqe;
+}
+
+bool RawFileLoader::Ring::submit(unsigned waitFor)
+{
+    __atomic_store_n(sqTail, sqTailLocal, __ATOMIC_RELEASE);
+    const unsigned queued = sqTailLocal - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (queued == 0 && waitFor == 0)
+        return true;
+    while (syscall(__NR_io_uring_enter, fd, queued, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0, 0, 0) < 0) {
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EBUSY) // the completions have to be reaped first
+            return true;
+        qWarning() << "io_uring_enter failed:" << strerror(errno);
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+void RawFileLoader::Ring::start(int index, int file)
+{
+    Slot &slot = fileSlots[index];
+    slot.file = file;
+    slot.path = QFile::encodeName(loader->m_files.at(file));
+    slot.fd = -1;
+    slot.waiting = 2;
+    slot.finished = false;
+    slot.error = 0;
+    slot.size = slot.done = 0;
+    io_uring_sqe *sqe = queue(index, Open);
+    if (sqe == 0)
+        return;
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<quint64>(slot.path.constData());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe = queue(index, Stat);
+    if (sqe == 0)
+        return;
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<quint64>(slot.path.constData());
+    sqe->len = STATX_SIZE;
+    sqe->off = reinterpret_cast<quint64>(&slot.stat);
+}
+
+void RawFileLoader::Ring::queueRead(int index)
+{
+    const Slot &slot = fileSlots.at(index);
+    io_uring_sqe *sqe = queue(index, Read);
+    if (sqe == 0)
+        return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = slot.fd;
+    sqe->addr = reinterpret_cast<quint64>(buffer(slot.file).data() + slot.done);
+    sqe->len = slot.size - slot.done;
+    sqe->off = slot.done;
+}
+
+void RawFileLoader::Ring::finish(int index)
+{
+    Slot &slot = fileSlots[index];
+    if (slot.error) {
+        qWarning() << "Failed to read input" << loader->m_files.at(slot.file) << strerror(slot.error);
+        buffer(slot.file).clear();
+    }
+    slot.finished = true;
+    loader->m_loaded[slot.file % loader->m_loaded.size()] = 1;
+    if (slot.fd >= 0) { // the slot is free once the close completed
+        io_uring_sqe *sqe = queue(index, Close);
+        if (sqe == 0)
+            return;
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slot.fd;
+    } else {
+        freeSlots.append(index);
+    }
+}
+
+void RawFileLoader::Ring::complete(const io_uring_cqe &cqe)
+{
+    const int index = cqe.user_data >> 2;
+    const Operation operation = static_cast<Operation>(cqe.user_data & 3);
+    Slot &slot = fileSlots[index];
+    switch (operation) {
+    case Open:
+    case Stat:
+        if (cqe.res < 0)
+            slot.error = -cqe.res;
+        else if (operation == Open)
+            slot.fd = cqe.res;
+        else
+            slot.size = slot.stat.stx_size;
+        if (--slot.waiting > 0)
+            return;
+        if (slot.size > MaxFileSize)
+            slot.error = EFBIG;
+        if (slot.error || slot.size == 0) {
+            finish(index);
+            return;
+        }
+        buffer(slot.file).resize(slot.size);
+        queueRead(index);
+        return;
+    case Read:
+        if (cqe.res < 0) {
+            slot.error = -cqe.res;
+        } else if (cqe.res == 0) { // the file got shorter since the statx
+            buffer(slot.file).resize(slot.done);
+        } else {
+            slot.done += cqe.res;
+            if (slot.done < slot.size) {
+                queueRead(index);
+                return;
+            }
+        }
+        finish(index);
+        return;
+    case Close:
+        freeSlots.append(index);
+        return;
+    }
+}
+
+bool RawFileLoader::Ring::pump(bool wait)
+{
+    const int windowEnd = qMin(loader->m_files.size(), loader->m_nextFile + loader->m_window.size());
+    while (!failed && loader->m_started < windowEnd && !freeSlots.isEmpty())
+        start(freeSlots.takeLast(), loader->m_started++);
+    if (failed || !submit(wait && !idle() ? 1 : 0))
+        return false;
+
+    unsigned head = *cqHead;
+    const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+        complete(cqes[head & *cqMask]);
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return !failed;
+}
+
+void RawFileLoader::Ring::abandon()
+{
+    for (int i = 0; i < fileSlots.size(); ++i) {
+        Slot &slot = fileSlots[i];
+        if (!slot.finished && !freeSlots.contains(i)) {
+            abandoned.append(buffer(slot.file));
+            buffer(slot.file) = QByteArray();
+            slot.finished = true;
+        }
+    }
+}
+
+bool RawFileLoader::setupRing()
+{
+    unsigned entries = 1;
+    while (entries < static_cast<unsigned>(m_queueDepth) * 2) // an open and a statx per file
+        entries <<= 1;
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return false; // no kernel support, or blocked by a seccomp policy
+    Ring *ring = new Ring(this);
+    ring->fd = fd;
+
+    // the file operations need Linux 5.6, older kernels have the ring but not these.
+    const int probeOps = 256;
+    QByteArray probeData(sizeof(io_uring_probe) + probeOps * sizeof(io_uring_probe_op), 0);
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe*>(probeData.data());
+    bool ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, probeOps) >= 0;
+    const int ops[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE };
+    for (unsigned i = 0; ok && i < sizeof(ops) / sizeof(ops[0]); ++i)
+        ok = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+
+    if (ok) {
+        ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap)
+            ring->sqRingSize = ring->cqRingSize = qMax(ring->sqRingSize, ring->cqRingSize);
+        ring->sqRing = mmap(0, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        ring->cqRing = singleMap ? ring->sqRing
+                : mmap(0, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        ring->sqes = static_cast<io_uring_sqe*>(mmap(0, ring->sqesSize, PROT_READ | PROT_WRITE,
+                                                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        ok = ring->sqRing != MAP_FAILED && ring->cqRing != MAP_FAILED && ring->sqes != MAP_FAILED;
+    }
+    if (!ok) {
+        delete ring;
+        return false;
+    }
+    char *sq = static_cast<char*>(ring->sqRing);
+    ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->sqEntries = params.sq_entries;
+    ring->sqTailLocal = *ring->sqTail;
+    char *cq = static_cast<char*>(ring->cqRing);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    m_ring = ring;
+    return true;
+}
+#else
+struct RawFileLoader::Ring {
+    bool pump(bool) {
+        return false;
+    }
+    bool idle() const {
+        return true;
+    }
+    void abandon() {}
+};
+
+bool RawFileLoader::setupRing()
+{
+    return false;
+}
+#endif
+
+// the threads of the pool each claim the next file to load until all are claimed.
+class RawFileLoader::LoadJob : public QRunnable
+{
+public:
+    explicit LoadJob(RawFileLoader *loader) : m_loader(loader) {}
+
+    void run() {
+        m_loader->loadFiles();
+    }
+
+private:
+    RawFileLoader *m_loader;
+};
+
+RawFileLoader::RawFileLoader(Backend backend, int queueDepth, int readAhead)
+    : m_backend(backend),
+      m_queueDepth(queueDepth),
+      m_ring(0),
+      m_pool(0),
+      m_window(readAhead),
+      m_loaded(readAhead, 0),
+      m_nextFile(0),
+      m_started(0),
+      m_stopping(false)
+{
+    Q_ASSERT(queueDepth > 0);
+    Q_ASSERT(readAhead > 0);
+    if (m_backend == Automatic || m_backend == IoUring) {
+        const bool requested = m_backend == IoUring;
+        m_backend = setupRing() ? IoUring : Threads;
+        if (requested && m_backend != IoUring)
+            qWarning() << "io_uring is not available, reading the files with threads";
+    }
+    if (m_backend == Threads) {
+        m_pool = new QThreadPool();
+        m_pool->setMaxThreadCount(m_queueDepth);
+    }
+}
+
+RawFileLoader::~RawFileLoader()
+{
+    stop();
+    delete m_pool;
+    delete m_ring;
+}
+
+const char *RawFileLoader::name(Backend backend)
+{
+    switch (backend) {
+    case Automatic: return "auto";
+    case IoUring: return "uring";
+    case Threads: return "threads";
+    case Sync: return "sync";
+    }
+    return "";
+}
+
+bool RawFileLoader::parseBackend(const QString &name, Backend &backend)
+{
+    for (int i = Automatic; i <= Sync; ++i) {
+        if (name == QLatin1String(RawFileLoader::name(static_cast<Backend>(i)))) {
+            backend = static_cast<Backend>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void RawFileLoader::start(const QStringList &files)
+{
+    stop();
+    m_files = files;
+    m_nextFile = m_started = 0;
+    m_window.fill(QByteArray());
+    m_loaded.fill(0);
+    if (m_backend == Threads)
+        startThreads();
+    else if (m_backend == IoUring && !m_ring->pump(false))
+        fallBackToThreads();
+}
+
+int RawFileLoader::next(QList<QByteArray> &contents, int max)
+{
+    Q_ASSERT(max > 0);
+    if (m_backend == IoUring)
+        return nextWithRing(contents, max);
+    if (m_backend == Threads)
+        return nextWithThreads(contents, max);
+    int count = 0;
+    for (; count < max && m_nextFile < m_files.size(); ++count)
+        contents.append(readFile(m_files.at(m_nextFile++)));
+    return count;
+}
+
+void RawFileLoader::stop()
+{
+    if (m_pool) {
+        m_lock.lock();
+        m_stopping = true;
+        m_windowMoved.wakeAll();
+        m_lock.unlock();
+        m_pool->waitForDone();
+        m_stopping = false;
+    }
+    if (m_backend == IoUring) {
+        // the files in flight write into the window, let them finish.
+        m_started = m_files.size();
+        while (!m_ring->idle()) {
+            if (!m_ring->pump(true)) {
+                m_ring->abandon();
+                break;
+            }
+        }
+    }
+}
+
+bool RawFileLoader::takeLoaded(QList<QByteArray> &contents)
+{
+    const int index = m_nextFile % m_window.size();
+    if (!m_loaded.at(index))
+        return false;
+    contents.append(m_window.at(index));
+    m_window[index] = QByteArray();
+    m_loaded[index] = 0;
+    ++m_nextFile;
+    return true;
+}
+
+int RawFileLoader::nextWithRing(QList<QByteArray> &contents, int max)
+{
+    int count = 0;
+    while (count < max && m_nextFile < m_files.size()) {
+        if (takeLoaded(contents)) {
+            ++count;
+        } else if (!m_ring->pump(true)) {
+            fallBackToThreads();
+            return count + nextWithThreads(contents, max - count);
+        }
+    }
+    // refill the window, those files load while the caller is busy with these.
+    if (!m_ring->pump(false))
+        fallBackToThreads();
+    return count;
+}
+
+void RawFileLoader::fallBackToThreads()
+{
+    qWarning() << "io_uring failed, reading the remaining files with threads";
+    m_ring->abandon();
+    m_backend = Threads;
+    m_pool = new QThreadPool();
+    m_pool->setMaxThreadCount(m_queueDepth);
+    m_started = m_nextFile; // the files io_uring completed are skipped
+    startThreads();
+}
+
+void RawFileLoader::startThreads()
+{
+    const int jobs = qMin(m_queueDepth, m_files.size() - m_started);
+    for (int i = 0; i < jobs; ++i)
+        m_pool->start(new LoadJob(this));
+}
+
+void RawFileLoader::loadFiles()
+{
+    m_lock.lock();
+    while (true) {
+        while (!m_stopping && m_started < m_files.size() && m_started >= m_nextFile + m_window.size())
+            m_windowMoved.wait(&m_lock);
+        if (m_stopping || m_started >= m_files.size())
+            break;
+        const int file = m_started++;
+        const int index = file % m_window.size();
+        if (file < m_nextFile || m_loaded.at(index)) // io_uring loaded it before it failed
+            continue;
+        const QString filename = m_files.at(file);
+        m_lock.unlock();
+        const QByteArray data = readFile(filename);
+        m_lock.lock();
+        m_window[index] = data;
+        m_loaded[index] = 1;
+        m_fileLoaded.wakeOne(); // there is only one reader
+    }
+    m_lock.unlock();
+}
+
+int RawFileLoader::nextWithThreads(QList<QByteArray> &contents, int max)
+{
+    QMutexLocker locker(&m_lock);
+    int count = 0;
+    while (count < max && m_nextFile < m_files.size()) {
+        if (takeLoaded(contents)) {
+            ++count;
+            m_windowMoved.wakeOne(); // room for one more file
+        } else {
+            m_fileLoaded.wait(&m_lock);
+        }
+    }
+    return count;
+}
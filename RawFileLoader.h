@@ -0,0 +1,114 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RAWFILELOADER_H
+#define RAWFILELOADER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+class QThreadPool;
+
+/**
+ * RawFileLoader reads the complete contents of many small files, like a directory with
+ * one raw transaction per file.
+ *
+ * Reading such files one after the other makes each of them pay the latency of open,
+ * read and close in turn, and on a cold cache that latency is nearly all the time spent.
+ * This loader keeps many files in flight instead. With io_uring the opens, reads and
+ * closes of up to queueDepth files are queued from one thread and completed by the
+ * kernel in any order. Where io_uring is not available (before Linux 5.6, other
+ * systems, or when it is blocked) a pool of queueDepth threads does blocking reads.
+ *
+ * Loading runs ahead of the caller: after start() up to readAhead files are loaded
+ * beyond the ones next() returned, independent of how many next() is asked for.
+ * With io_uring the files stay in flight between calls to next(), with threads the
+ * pool keeps on reading in the background.
+ */
+class RawFileLoader
+{
+public:
+    enum Backend {
+        Automatic,  ///< io_uring when the kernel supports it, otherwise Threads.
+        IoUring,
+        Threads,
+        Sync        ///< one file at a time on the calling thread.
+    };
+
+    explicit RawFileLoader(Backend backend = Automatic, int queueDepth = 128, int readAhead = 1024);
+    ~RawFileLoader();
+
+    /**
+     * The backend in use. Automatic and an unavailable IoUring are resolved when constructed,
+     * an IoUring that fails while loading falls back to Threads.
+     */
+    inline Backend backend() const {
+        return m_backend;
+    }
+    /// return a short name of @a backend, like "uring".
+    static const char *name(Backend backend);
+    /// find the backend called @a name, returns false if there is none.
+    static bool parseBackend(const QString &name, Backend &backend);
+
+    /// start loading @a files, dropping what is left of the files of a previous start().
+    void start(const QStringList &files);
+
+    /**
+     * Append the contents of the next files to @a contents, up to @a max and in the order
+     * the files were given to start().
+     * A file that can't be read gives an empty entry and a warning, keeping the order aligned.
+     * @return the amount of files appended, zero when all files were returned.
+     */
+    int next(QList<QByteArray> &contents, int max);
+
+private:
+    struct Ring;
+    class LoadJob;
+    bool setupRing();
+    void stop();
+    /// take the file next() has to return from the window if it is loaded.
+    bool takeLoaded(QList<QByteArray> &contents);
+    int nextWithRing(QList<QByteArray> &contents, int max);
+    int nextWithThreads(QList<QByteArray> &contents, int max);
+    void startThreads();
+    void fallBackToThreads();
+    /// the loop of each thread of the pool.
+    void loadFiles();
+
+    Backend m_backend;
+    const int m_queueDepth;
+    Ring *m_ring;
+    QThreadPool *m_pool;
+
+    QStringList m_files;
+    QVector<QByteArray> m_window; // the contents of file i are at i % readAhead
+    QVector<quint8> m_loaded;     // non-zero when the file in the window is complete
+    int m_nextFile;               // the next file next() returns
+    int m_started;                // the files before this one are (being) loaded
+
+    // the threads backend
+    QMutex m_lock;
+    QWaitCondition m_fileLoaded;
+    QWaitCondition m_windowMoved;
+    bool m_stopping;
+};
+
+#endif
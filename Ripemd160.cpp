@@ -0,0 +1,145 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Ripemd160.h"
+#include "Sha256.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+namespace {
+// the message word used in each step, for the left and the right line.
+const quint8 WordLeft[80] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+    3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,
+    1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+    4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13
+};
+const quint8 WordRight[80] = {
+    5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,
+    6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+    15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,
+    8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+    12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11
+};
+// the rotation of each step
+const quint8 ShiftLeft[80] = {
+    11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,
+    7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+    11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,
+    11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+    9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6
+};
+const quint8 ShiftRight[80] = {
+    8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,
+    9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+    9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,
+    15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+    8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11
+};
+const quint32 ConstantLeft[5] = { 0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E };
+const quint32 ConstantRight[5] = { 0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000 };
+
+inline quint32 rotl(quint32 x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+// the boolean function of each of the 5 rounds, the right line uses them in reverse order.
+inline quint32 f(int round, quint32 x, quint32 y, quint32 z)
+{
+    switch (round) {
+    case 0: return x ^ y ^ z;
+    case 1: return (x & y) | (~x & z);
+    case 2: return (x | ~y) ^ z;
+    case 3: return (x & z) | (y & ~z);
+    default: return x ^ (y | ~z);
+    }
+}
+
+void compress(quint32 *state, const char *block)
+{
+    quint32 x[16];
+    for (int i = 0; i < 16; ++i)
+        x[i] = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(block + i * 4));
+    quint32 al = state[0], bl = state[1], cl = state[2], dl = state[3], el = state[4];
+    quint32 ar = al, br = bl, cr = cl, dr = dl, er = el;
+    for (int j = 0; j < 80; ++j) {
+        const int round = j / 16;
+        quint32 t = rotl(al + f(round, bl, cl, dl) + x[WordLeft[j]] + ConstantLeft[round], ShiftLeft[j]) + el;
+        al = el;
+        el = dl;
+        dl = rotl(cl, 10);
+        cl = bl;
+        bl = t;
+        t = rotl(ar + f(4 - round, br, cr, dr) + x[WordRight[j]] + ConstantRight[round], ShiftRight[j]) + er;
+        ar = er;
+        er = dr;
+        dr = rotl(cr, 10);
+        cr = br;
+        br = t;
+    }
+    const quint32 t = state[1] + cl + dr;
+    state[1] = state[2] + dl + er;
+    state[2] = state[3] + el + ar;
+    state[3] = state[4] + al + br;
+    state[4] = state[0] + bl + cr;
+    state[0] = t;
+}
+}
+
+void Ripemd160::hash(const char *data, int size, char *out)
+{
+    Q_ASSERT(size >= 0);
+    Q_ASSERT(out);
+    quint32 state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    const int blocks = size / 64;
+    for (int i = 0; i < blocks; ++i)
+        compress(state, data + i * 64);
+
+    // the padding; a one bit, zeros and the length in bits, in one or two blocks.
+    char tail[128];
+    const int rest = size - blocks * 64;
+    memcpy(tail, data + blocks * 64, rest);
+    tail[rest] = static_cast<char>(0x80);
+    const int tailSize = rest < 56 ? 64 : 128;
+    memset(tail + rest + 1, 0, tailSize - rest - 1);
+    qToLittleEndian<quint64>(static_cast<quint64>(size) * 8, reinterpret_cast<uchar*>(tail + tailSize - 8));
+    compress(state, tail);
+    if (tailSize == 128)
+        compress(state, tail + 64);
+    for (int i = 0; i < 5; ++i)
+        qToLittleEndian<quint32>(state[i], reinterpret_cast<uchar*>(out + i * 4));
+}
+
+QByteArray Ripemd160::hash(const char *data, int size)
+{
+    QByteArray answer(HashSize, Qt::Uninitialized);
+    hash(data, size, answer.data());
+    return answer;
+}
+
+void Ripemd160::hash160(const char *data, int size, char *out)
+{
+    Sha256 sha;
+    sha.write(data, size);
+    char first[Sha256::HashSize];
+    sha.finalize(first);
+    hash(first, Sha256::HashSize, out);
+}
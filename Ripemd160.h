@@ -0,0 +1,43 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RIPEMD160_H
+#define RIPEMD160_H
+
+#include <QByteArray>
+
+/**
+ * Ripemd160 calculates RIPEMD-160 hashes, which combined with Sha256 gives the
+ * hash160 that P2PKH and P2SH output scripts contain.
+ * The inputs are small, keys and scripts, so only the portable implementation exists.
+ */
+class Ripemd160
+{
+public:
+    enum {
+        HashSize = 20
+    };
+
+    /// write the hash of @a size bytes at @a data to @a out, which needs room for HashSize bytes.
+    static void hash(const char *data, int size, char *out);
+    static QByteArray hash(const char *data, int size);
+
+    /// write ripemd160(sha256(data)) to @a out, which needs room for HashSize bytes.
+    static void hash160(const char *data, int size, char *out);
+};
+
+#endif
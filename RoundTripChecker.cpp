@@ -0,0 +1,199 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "RoundTripChecker.h"
+#include "CorpusReader.h"
+#include "MessageBuilder.h"
+#include "Transaction.h"
+#include "TransactionView.h"
+
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+enum Outcome {
+    Failed,
+    NotLegacy,
+    Identical,
+    Expected,   // a difference the format can't avoid
+    Differs
+};
+
+struct Result {
+    Result() : legacy(Failed), v4(Failed) {}
+    Outcome legacy;
+    Outcome v4;
+};
+
+// true if each item of the push-only input scripts uses the shortest push, like Transaction::writeLegacy() does.
+bool usesMinimalPushes(const TransactionView &view)
+{
+    foreach (const TransactionView::Input &input, view.inputs()) {
+        int size = 0;
+        for (int i = input.firstItem; i < input.firstItem + input.itemCount; ++i) {
+            const TransactionView::Range &item = view.scriptItems().at(i);
+            if (item.length == 1 && *view.at(item) == 0) // OP_0
+                size += 1;
+            else
+                size += item.length + (item.length <= 75 ? 1 : (item.length <= 0xFF ? 2 : (item.length <= 0xFFFF ? 3 : 5)));
+        }
+        if (size != input.script.length)
+            return false;
+    }
+    return true;
+}
+
+// true if the transaction uses fields which v4 can't represent.
+bool usesLegacyOnlyFields(const TransactionView &view)
+{
+    if (view.version() != 1 || view.lockTime() != 0)
+        return true;
+    foreach (const TransactionView::Input &input, view.inputs()) {
+        if (input.sequence != 0xFFFFFFFF)
+            return true;
+    }
+    return false;
+}
+
+class CheckAnalysis : public ChunkedCorpus::Analysis
+{
+public:
+    explicit CheckAnalysis(RoundTripChecker::Statistics &stats) : m_stats(stats) {}
+
+    void beginChunk(const QList<QByteArray> &chunk, qint64, int) {
+        m_results.fill(Result(), chunk.size());
+    }
+
+    void processRange(const QList<QByteArray> &chunk, int, int start, int count) {
+        // the buffers are reused for all transactions of the range.
+        QByteArray legacy, v4;
+        MessageBuilder builder(&v4);
+        TransactionView view;
+        for (int i = start; i < start + count; ++i) {
+            const QByteArray &original = chunk.at(i);
+            Result &result = m_results[i];
+            if (original.size() > 4 && original.at(0) == 4) {
+                result.legacy = result.v4 = NotLegacy;
+                continue;
+            }
+            Transaction tx;
+            if (!tx.read(original))
+                continue;
+            legacy.resize(tx.legacySize());
+            tx.writeLegacy(legacy.data());
+            const bool legacyIdentical = legacy == original;
+
+            builder.reset();
+            tx.writev4(builder, true);
+            bool v4Identical = false;
+            {
+                Transaction fromV4;
+                if (fromV4.read(v4)) {
+                    legacy.resize(fromV4.legacySize());
+                    fromV4.writeLegacy(legacy.data());
+                    v4Identical = legacy == original;
+                }
+            }
+            if (legacyIdentical && v4Identical) {
+                result.legacy = result.v4 = Identical;
+                continue;
+            }
+
+            // find out if the difference was to be expected
+            const bool minimal = view.parse(original) && usesMinimalPushes(view);
+            result.legacy = legacyIdentical ? Identical : (minimal ? Differs : Expected);
+            if (v4Identical)
+                result.v4 = Identical;
+            else if (!minimal || usesLegacyOnlyFields(view))
+                result.v4 = Expected;
+            else
+                result.v4 = Differs;
+        }
+    }
+
+    void reduceChunk(const QList<QByteArray> &, qint64) {
+        foreach (const Result &result, m_results) {
+            if (result.legacy == Failed) {
+                ++m_stats.failed;
+            } else if (result.legacy == NotLegacy) {
+                ++m_stats.notLegacy;
+            } else {
+                if (result.legacy == Identical)
+                    ++m_stats.legacyIdentical;
+                else if (result.legacy == Expected)
+                    ++m_stats.nonMinimal;
+                else
+                    ++m_stats.legacyDiffers;
+                if (result.v4 == Identical)
+                    ++m_stats.v4Identical;
+                else if (result.v4 == Expected)
+                    ++m_stats.v4Lossy;
+                else
+                    ++m_stats.v4Differs;
+                if ((result.legacy == Differs || result.v4 == Differs) && m_stats.examples.size() < 10)
+                    m_stats.examples.append(m_stats.transactions);
+            }
+            ++m_stats.transactions;
+        }
+    }
+
+private:
+    RoundTripChecker::Statistics &m_stats;
+    QVector<Result> m_results;
+};
+}
+
+void RoundTripChecker::setThreadCount(int threads)
+{
+    m_workers.setThreadCount(threads);
+}
+
+bool RoundTripChecker::check(CorpusReader &reader)
+{
+    m_stats = Statistics();
+    QElapsedTimer timer;
+    timer.start();
+
+    CheckAnalysis analysis(m_stats);
+    m_workers.forEachChunk(reader, analysis);
+
+    m_stats.bytesIn = reader.bytesRead();
+    m_stats.milliseconds = timer.elapsed();
+    return m_stats.legacyDiffers == 0 && m_stats.v4Differs == 0;
+}
+
+void RoundTripChecker::printStatistics(QTextStream &out) const
+{
+    const double seconds = qMax<qint64>(1, m_stats.milliseconds) / 1000.;
+    out << "transactions: " << m_stats.transactions << " (" << m_stats.failed << " failed, "
+        << m_stats.notLegacy << " not legacy)\n";
+    out << "v1 -> v1: " << m_stats.legacyIdentical << " identical, " << m_stats.nonMinimal
+        << " with non-minimal pushes, " << m_stats.legacyDiffers << " different\n";
+    out << "v1 -> v4 -> v1: " << m_stats.v4Identical << " identical, " << m_stats.v4Lossy
+        << " using sequence, nLockTime, version 2 or non-minimal pushes, " << m_stats.v4Differs << " different\n";
+    if (!m_stats.examples.isEmpty()) {
+        out << "first differences at index:";
+        foreach (qint64 index, m_stats.examples) {
+            out << ' ' << index;
+        }
+        out << '\n';
+    }
+    out << "time: " << m_stats.milliseconds << " ms, threads: " << m_workers.threadCount() << "\n";
+    out << "throughput: " << qRound64(m_stats.transactions / seconds) << " tx/s, "
+        << QString::number(m_stats.bytesIn / seconds / 1E6, 'f', 2) << " MB/s\n";
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ROUNDTRIPCHECKER_H
+#define ROUNDTRIPCHECKER_H
+
+#include "ChunkedCorpus.h"
+
+#include <QList>
+
+class CorpusReader;
+class QTextStream;
+
+/**
+ * The RoundTripChecker checks the legacy serializer against a corpus of legacy transactions.
+ *
+ * Each transaction is parsed and written as legacy again, as well as converted to v4,
+ * parsed from that and then written as legacy. Both results are byte-compared to the
+ * original. The work is spread over a pool of worker threads.
+ *
+ * The v4 format has no place for the sequence numbers, nLockTime and version 2, so a
+ * transaction that uses them can not survive the trip through v4; these are counted
+ * separately from differences that point at a bug.
+ */
+class RoundTripChecker
+{
+public:
+    /// the amount of worker threads, defaults to the amount of cores.
+    void setThreadCount(int threads);
+
+    /// check all transactions from the reader, returns false if any unexpected difference was found.
+    bool check(CorpusReader &reader);
+
+    struct Statistics {
+        Statistics() : transactions(0), failed(0), notLegacy(0), legacyIdentical(0), nonMinimal(0),
+            legacyDiffers(0), v4Identical(0), v4Lossy(0), v4Differs(0), bytesIn(0), milliseconds(0) {}
+        qint64 transactions;
+        qint64 failed;          // didn't parse
+        qint64 notLegacy;       // v4 input, skipped
+        qint64 legacyIdentical; // v1 -> v1
+        qint64 nonMinimal;      // v1 -> v1 differs due to pushes not using the shortest opcode
+        qint64 legacyDiffers;
+        qint64 v4Identical;     // v1 -> v4 -> v1
+        qint64 v4Lossy;         // v1 -> v4 -> v1 differs due to fields v4 doesn't have
+        qint64 v4Differs;
+        qint64 bytesIn;
+        qint64 milliseconds;
+        QList<qint64> examples; // the indexes of the first unexpected differences
+    };
+
+    inline const Statistics &statistics() const {
+        return m_stats;
+    }
+
+    /// print the results and the throughput of the last check().
+    void printStatistics(QTextStream &out) const;
+
+private:
+    ChunkedCorpus m_workers;
+    Statistics m_stats;
+};
+
+#endif
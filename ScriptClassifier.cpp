@@ -0,0 +1,167 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ScriptClassifier.h"
+#include "ScriptTokenizer.h"
+#include "StreamMethods.h"
+
+namespace {
+enum Opcodes {
+    OpPushData1 = 0x4c,
+    OpPushData2 = 0x4d,
+    Op1 = 0x51,
+    Op16 = 0x60,
+    OpReturn = 0x6a,
+    OpDup = 0x76,
+    OpEqual = 0x87,
+    OpEqualVerify = 0x88,
+    OpHash160 = 0xa9,
+    OpCheckSig = 0xac,
+    OpCheckMultiSig = 0xae
+};
+
+inline bool isPubKey(const quint8 *key, int size)
+{
+    return (size == 33 && (key[0] == 2 || key[0] == 3)) || (size == 65 && key[0] == 4);
+}
+
+inline bool isSmallNumber(quint8 opcode)
+{
+    return opcode >= Op1 && opcode <= Op16;
+}
+
+// @a script starts with OP_RETURN
+bool isNullData(const char *script, int length, ConstBytes &data)
+{
+    const quint8 *s = reinterpret_cast<const quint8*>(script);
+    // the usual case is one push that takes the rest of the script.
+    if (length == 1) {
+        data = ConstBytes(script + 1, 0);
+        return true;
+    }
+    const quint8 k = s[1];
+    int start = -1, size = -1;
+    if (k > 0 && k < OpPushData1) {
+        start = 2;
+        size = k;
+    } else if (k == OpPushData1 && length >= 3) {
+        start = 3;
+        size = s[2];
+    } else if (k == OpPushData2 && length >= 4) {
+        start = 4;
+        size = Streaming::fetch16bitValue(script, 2);
+    }
+    if (start + size == length) {
+        data = ConstBytes(script + start, size);
+        return true;
+    }
+
+    // anything else has to be push-only, which includes the small numbers.
+    ScriptTokenizer tokenizer(script + 1, length - 1);
+    ScriptTokenizer::Type type = tokenizer.next();
+    while (type == ScriptTokenizer::FoundOpcode) {
+        if (tokenizer.opcode() > Op16)
+            return false;
+        type = tokenizer.next();
+    }
+    data = ConstBytes(script + 1, length - 1);
+    return type == ScriptTokenizer::EndOfScript;
+}
+
+bool isMultiSig(const char *script, int length, ScriptClassifier::Payload *payload)
+{
+    const quint8 *s = reinterpret_cast<const quint8*>(script);
+    if (length < 37 || s[length - 1] != OpCheckMultiSig || !isSmallNumber(s[0]) || !isSmallNumber(s[length - 2]))
+        return false;
+    const int required = s[0] - Op1 + 1;
+    const int keyCount = s[length - 2] - Op1 + 1;
+    if (required > keyCount)
+        return false;
+    int pos = 1;
+    for (int i = 0; i < keyCount; ++i) {
+        const int size = s[pos];
+        if (pos + 1 + size > length - 2 || !isPubKey(s + pos + 1, size))
+            return false;
+        if (payload)
+            payload->keys[i] = ConstBytes(script + pos + 1, size);
+        pos += 1 + size;
+    }
+    if (pos != length - 2)
+        return false;
+    if (payload) {
+        payload->required = required;
+        payload->keyCount = keyCount;
+    }
+    return true;
+}
+}
+
+ScriptClassifier::ScriptType ScriptClassifier::classify(const char *script, int length, Payload *payload)
+{
+    const quint8 *s = reinterpret_cast<const quint8*>(script);
+    ScriptType type = NonStandard;
+    ConstBytes data;
+    switch (length) {
+    case 25:
+        if (s[0] == OpDup && s[1] == OpHash160 && s[2] == 20 && s[23] == OpEqualVerify && s[24] == OpCheckSig) {
+            type = PayToPubKeyHash;
+            data = ConstBytes(script + 3, 20);
+        }
+        break;
+    case 23:
+        if (s[0] == OpHash160 && s[1] == 20 && s[22] == OpEqual) {
+            type = PayToScriptHash;
+            data = ConstBytes(script + 2, 20);
+        }
+        break;
+    case 35:
+    case 67:
+        if (s[0] == length - 2 && s[length - 1] == OpCheckSig && isPubKey(s + 1, length - 2)) {
+            type = PayToPubKey;
+            data = ConstBytes(script + 1, length - 2);
+        }
+        break;
+    default:
+        break;
+    }
+    if (type == NonStandard && length > 0) {
+        if (s[0] == OpReturn) {
+            if (isNullData(script, length, data))
+                type = NullData;
+        } else if (isMultiSig(script, length, payload)) {
+            type = MultiSig;
+        }
+    }
+    if (payload) {
+        payload->data = data;
+        if (type != MultiSig)
+            payload->required = payload->keyCount = 0;
+    }
+    return type;
+}
+
+const char *ScriptClassifier::name(ScriptType type)
+{
+    switch (type) {
+    case PayToPubKeyHash: return "p2pkh";
+    case PayToScriptHash: return "p2sh";
+    case PayToPubKey: return "p2pk";
+    case MultiSig: return "multisig";
+    case NullData: return "null-data";
+    default: return "nonstandard";
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SCRIPTCLASSIFIER_H
+#define SCRIPTCLASSIFIER_H
+
+#include "MessageParser.h"
+
+/**
+ * ScriptClassifier recognizes the standard output script templates.
+ *
+ * The templates all have a fixed length, or a few, so a script is matched by its size
+ * and a compare of the opcodes at known positions. No tokenizing is done, with the
+ * exception of null-data scripts that push more than one item.
+ * The payload of the script, like the hash of a P2PKH script, is returned pointing
+ * into the script, without copying.
+ */
+class ScriptClassifier
+{
+public:
+    enum ScriptType {
+        PayToPubKeyHash,    ///< OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+        PayToScriptHash,    ///< OP_HASH160 <20 bytes> OP_EQUAL
+        PayToPubKey,        ///< <33 or 65 bytes pubkey> OP_CHECKSIG
+        MultiSig,           ///< OP_m <pubkey> ... <pubkey> OP_n OP_CHECKMULTISIG
+        NullData,           ///< OP_RETURN followed by pushes only
+        NonStandard,
+        ScriptTypeCount
+    };
+
+    enum {
+        MaxKeys = 16
+    };
+
+    struct Payload {
+        Payload() : required(0), keyCount(0) {}
+        /**
+         * The hash160 of P2PKH and P2SH, the pubkey of P2PK and for null-data the pushed
+         * bytes. Null-data with more than one push gets all of them, including the push opcodes.
+         */
+        ConstBytes data;
+        int required;   ///< multisig: the amount of signatures needed.
+        int keyCount;   ///< multisig: the amount of pubkeys in keys.
+        ConstBytes keys[MaxKeys];
+    };
+
+    /// return the type of the @a length bytes of @a script, and if @a payload is given fill it.
+    static ScriptType classify(const char *script, int length, Payload *payload = 0);
+    static inline ScriptType classify(const QByteArray &script, Payload *payload = 0) {
+        return classify(script.constData(), script.size(), payload);
+    }
+
+    /// return a short name of @a type, like "p2pkh".
+    static const char *name(ScriptType type);
+};
+
+#endif
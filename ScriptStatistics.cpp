@@ -0,0 +1,150 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ScriptStatistics.h"
+#include "CorpusReader.h"
+#include "TransactionView.h"
+
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+#include <string.h>
+
+namespace {
+class ClassifyAnalysis : public ChunkedCorpus::Analysis
+{
+public:
+    explicit ClassifyAnalysis(ScriptStatistics::Statistics &stats) : m_stats(stats) {}
+
+    void beginChunk(const QList<QByteArray> &, qint64, int rangeCount) {
+        m_results.fill(ScriptStatistics::Statistics(), rangeCount);
+    }
+
+    void processRange(const QList<QByteArray> &chunk, int range, int start, int count) {
+        TransactionView view;
+        ScriptClassifier::Payload payload;
+        ScriptStatistics::Statistics &stats = m_results[range];
+        for (int i = start; i < start + count; ++i) {
+            ++stats.transactions;
+            if (!view.parse(chunk.at(i))) {
+                ++stats.failed;
+                continue;
+            }
+            const QVector<TransactionView::Output> &outputs = view.outputs();
+            for (int o = 0; o < outputs.size(); ++o) {
+                const TransactionView::Output &output = outputs.at(o);
+                const ScriptClassifier::ScriptType type
+                        = ScriptClassifier::classify(view.at(output.script), output.script.length, &payload);
+                ScriptStatistics::Totals &totals = stats.types[type];
+                ++totals.outputs;
+                totals.scriptBytes += output.script.length;
+                totals.value += output.value;
+                if (type == ScriptClassifier::MultiSig) {
+                    ++stats.multiSig[payload.required - 1][payload.keyCount - 1];
+                    for (int k = 0; k < payload.keyCount; ++k)
+                        totals.payloadBytes += payload.keys[k].size;
+                } else if (type != ScriptClassifier::NonStandard) {
+                    totals.payloadBytes += payload.data.size;
+                }
+            }
+        }
+    }
+
+    void reduceChunk(const QList<QByteArray> &, qint64) {
+        for (int i = 0; i < m_results.size(); ++i)
+            m_stats.add(m_results.at(i));
+    }
+
+private:
+    ScriptStatistics::Statistics &m_stats;
+    QVector<ScriptStatistics::Statistics> m_results; // one per range
+};
+}
+
+ScriptStatistics::Statistics::Statistics()
+    : transactions(0),
+      failed(0),
+      bytesIn(0),
+      milliseconds(0)
+{
+    memset(multiSig, 0, sizeof(multiSig));
+}
+
+void ScriptStatistics::Statistics::add(const Statistics &other)
+{
+    transactions += other.transactions;
+    failed += other.failed;
+    for (int i = 0; i < ScriptClassifier::ScriptTypeCount; ++i) {
+        types[i].outputs += other.types[i].outputs;
+        types[i].scriptBytes += other.types[i].scriptBytes;
+        types[i].payloadBytes += other.types[i].payloadBytes;
+        types[i].value += other.types[i].value;
+    }
+    for (int m = 0; m < ScriptClassifier::MaxKeys; ++m) {
+        for (int n = 0; n < ScriptClassifier::MaxKeys; ++n)
+            multiSig[m][n] += other.multiSig[m][n];
+    }
+}
+
+void ScriptStatistics::setThreadCount(int threads)
+{
+    m_workers.setThreadCount(threads);
+}
+
+void ScriptStatistics::collect(CorpusReader &reader)
+{
+    m_stats = Statistics();
+    QElapsedTimer timer;
+    timer.start();
+
+    ClassifyAnalysis analysis(m_stats);
+    m_workers.forEachChunk(reader, analysis);
+
+    m_stats.bytesIn = reader.bytesRead();
+    m_stats.milliseconds = timer.elapsed();
+}
+
+void ScriptStatistics::printStatistics(QTextStream &out) const
+{
+    const double seconds = qMax<qint64>(1, m_stats.milliseconds) / 1000.;
+    qint64 outputs = 0;
+    for (int i = 0; i < ScriptClassifier::ScriptTypeCount; ++i)
+        outputs += m_stats.types[i].outputs;
+    out << "transactions: " << m_stats.transactions << " (" << m_stats.failed << " failed)\n";
+    out << "outputs: " << outputs << "\n";
+    out << QString("type").leftJustified(12) << QString("outputs").rightJustified(12)
+        << QString("script bytes").rightJustified(14) << QString("payload bytes").rightJustified(14)
+        << QString("value (satoshi)").rightJustified(20) << "\n";
+    for (int i = 0; i < ScriptClassifier::ScriptTypeCount; ++i) {
+        const Totals &totals = m_stats.types[i];
+        out << QString(ScriptClassifier::name(static_cast<ScriptClassifier::ScriptType>(i))).leftJustified(12)
+            << QString::number(totals.outputs).rightJustified(12)
+            << QString::number(totals.scriptBytes).rightJustified(14)
+            << QString::number(totals.payloadBytes).rightJustified(14)
+            << QString::number(totals.value).rightJustified(20) << "\n";
+    }
+    for (int m = 0; m < ScriptClassifier::MaxKeys; ++m) {
+        for (int n = m; n < ScriptClassifier::MaxKeys; ++n) {
+            if (m_stats.multiSig[m][n])
+                out << "multisig " << m + 1 << "-of-" << n + 1 << ": " << m_stats.multiSig[m][n] << "\n";
+        }
+    }
+    out << "time: " << m_stats.milliseconds << " ms, threads: " << m_workers.threadCount() << "\n";
+    out << "throughput: " << qRound64(m_stats.transactions / seconds) << " tx/s, "
+        << QString::number(m_stats.bytesIn / seconds / 1E6, 'f', 2) << " MB/s\n";
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SCRIPTSTATISTICS_H
+#define SCRIPTSTATISTICS_H
+
+#include "ChunkedCorpus.h"
+#include "ScriptClassifier.h"
+
+class CorpusReader;
+class QTextStream;
+
+/**
+ * ScriptStatistics counts the output scripts of a corpus per standard type.
+ *
+ * Transactions are parsed with a TransactionView and each output script is matched
+ * by the ScriptClassifier. The work is spread over a pool of worker threads; each range
+ * of a chunk collects its own totals, these are added up when the chunk is done.
+ */
+class ScriptStatistics
+{
+public:
+    /// the amount of worker threads, defaults to the amount of cores.
+    void setThreadCount(int threads);
+
+    /// classify the outputs of all transactions from the reader.
+    void collect(CorpusReader &reader);
+
+    struct Totals {
+        Totals() : outputs(0), scriptBytes(0), payloadBytes(0), value(0) {}
+        qint64 outputs;
+        qint64 scriptBytes;
+        qint64 payloadBytes; // the hashes, pubkeys or data, see ScriptClassifier::Payload
+        quint64 value;
+    };
+
+    struct Statistics {
+        Statistics();
+        void add(const Statistics &other);
+
+        qint64 transactions;
+        qint64 failed;      // didn't parse
+        qint64 bytesIn;
+        qint64 milliseconds;
+        Totals types[ScriptClassifier::ScriptTypeCount];
+        /// multisig outputs by required signatures and key count, [m-1][n-1]
+        qint64 multiSig[ScriptClassifier::MaxKeys][ScriptClassifier::MaxKeys];
+    };
+
+    inline const Statistics &statistics() const {
+        return m_stats;
+    }
+
+    /// print the results and the throughput of the last collect().
+    void printStatistics(QTextStream &out) const;
+
+private:
+    ChunkedCorpus m_workers;
+    Statistics m_stats;
+};
+
+#endif
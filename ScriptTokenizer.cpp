@@ -0,0 +1,42 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ScriptTokenizer.h"
+
+constexpr ScriptTokenizer::Opcode ScriptTokenizer::opcodes[256];
+
+// the direct pushes and unknown opcodes are filled in by macro; make sure the named ones landed on their spot.
+static_assert(ScriptTokenizer::opcodes[75].pushWidth == 0 && ScriptTokenizer::opcodes[75].name == 0, "direct pushes");
+static_assert(ScriptTokenizer::opcodes[76].pushWidth == 1, "OP_PUSHDATA1");
+static_assert(ScriptTokenizer::opcodes[78].pushWidth == 4, "OP_PUSHDATA4");
+static_assert(ScriptTokenizer::opcodes[0xa9].flags == ScriptTokenizer::HashOpcode, "OP_HASH160");
+static_assert(ScriptTokenizer::opcodes[0xb9].pushWidth == ScriptTokenizer::NoPush
+        && ScriptTokenizer::opcodes[0xb9].name != 0, "OP_NOP10");
+static_assert(ScriptTokenizer::opcodes[0xfc].flags == ScriptTokenizer::UnknownOpcode, "unassigned");
+static_assert(ScriptTokenizer::opcodes[0xfd].flags == ScriptTokenizer::InvalidOpcode, "OP_PUBKEYHASH");
+
+bool ScriptTokenizer::isPushOnly(const char *script, int length)
+{
+    ScriptTokenizer tokenizer(script, length);
+    ScriptTokenizer::Type type = tokenizer.next();
+    while (type == FoundOpcode) {
+        if (!tokenizer.isPush())
+            return false;
+        type = tokenizer.next();
+    }
+    return type == EndOfScript;
+}
@@ -0,0 +1,329 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SCRIPTTOKENIZER_H
+#define SCRIPTTOKENIZER_H
+
+#include "MessageParser.h"
+#include "StreamMethods.h"
+
+/**
+ * ScriptTokenizer splits a bitcoin script into its opcodes.
+ *
+ * Like the MessageParser, call next() as long as it returns FoundOpcode and use the
+ * getters to inspect the opcode and, for the push opcodes, the data it pushes.
+ * The tokenizer reads straight from the script and never allocates; the pushed data
+ * points into the script, which the caller has to keep alive.
+ *
+ * Everything known about an opcode, its name, the width of the push length that
+ * follows it and what kind of opcode it is, comes from the constant opcodes table.
+ * A truncated push makes next() return Error, every other opcode is returned even
+ * when it is not valid in a script, checking that is left to the caller.
+ */
+class ScriptTokenizer
+{
+public:
+    enum OpcodeFlags {
+        PushOpcode = 1,         ///< OP_FALSE up to OP_PUSHDATA4, which push the data that follows them.
+        NumberOpcode = 2,       ///< OP_1NEGATE and OP_TRUE up to OP_16, which push a small number.
+        HashOpcode = 4,         ///< OP_RIPEMD160 up to OP_HASH256.
+        SignatureOpcode = 8,    ///< OP_CHECKSIG and friends.
+        DisabledOpcode = 0x10,  ///< fails the script, even in an unexecuted branch.
+        ReservedOpcode = 0x20,  ///< fails the script when executed.
+        InvalidOpcode = 0x40,   ///< pseudo opcodes, never valid in a script.
+        UnknownOpcode = 0x80    ///< not assigned.
+    };
+
+    enum {
+        NoPush = -1
+    };
+
+    struct Opcode {
+        const char *name; ///< zero for direct pushes and unknown opcodes.
+        /**
+         * The amount of bytes of the little-endian push length that follows the opcode.
+         * Zero for OP_FALSE and the direct pushes, which have the length in the opcode itself,
+         * or NoPush.
+         */
+        qint8 pushWidth;
+        quint8 flags;
+    };
+
+#define DIRECT_PUSH { 0, 0, PushOpcode }
+#define UNKNOWN_OPCODE { 0, NoPush, UnknownOpcode }
+    static constexpr Opcode opcodes[256] = {
+        { "OP_FALSE", 0, PushOpcode }, // 0x00
+        // 0x01 - 0x4b push the amount of bytes of their opcode
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH, DIRECT_PUSH,
+        { "OP_PUSHDATA1", 1, PushOpcode }, // 0x4c
+        { "OP_PUSHDATA2", 2, PushOpcode }, // 0x4d
+        { "OP_PUSHDATA4", 4, PushOpcode }, // 0x4e
+        { "OP_1NEGATE", NoPush, NumberOpcode }, // 0x4f
+        { "OP_RESERVED", NoPush, ReservedOpcode }, // 0x50
+        { "OP_TRUE", NoPush, NumberOpcode }, // 0x51
+        { "OP_2", NoPush, NumberOpcode }, // 0x52
+        { "OP_3", NoPush, NumberOpcode }, // 0x53
+        { "OP_4", NoPush, NumberOpcode }, // 0x54
+        { "OP_5", NoPush, NumberOpcode }, // 0x55
+        { "OP_6", NoPush, NumberOpcode }, // 0x56
+        { "OP_7", NoPush, NumberOpcode }, // 0x57
+        { "OP_8", NoPush, NumberOpcode }, // 0x58
+        { "OP_9", NoPush, NumberOpcode }, // 0x59
+        { "OP_10", NoPush, NumberOpcode }, // 0x5a
+        { "OP_11", NoPush, NumberOpcode }, // 0x5b
+        { "OP_12", NoPush, NumberOpcode }, // 0x5c
+        { "OP_13", NoPush, NumberOpcode }, // 0x5d
+        { "OP_14", NoPush, NumberOpcode }, // 0x5e
+        { "OP_15", NoPush, NumberOpcode }, // 0x5f
+        { "OP_16", NoPush, NumberOpcode }, // 0x60
+        { "OP_NOP", NoPush, 0 }, // 0x61
+        { "OP_VER", NoPush, ReservedOpcode }, // 0x62
+        { "OP_IF", NoPush, 0 }, // 0x63
+        { "OP_NOTIF", NoPush, 0 }, // 0x64
+        { "OP_VERIF", NoPush, ReservedOpcode }, // 0x65
+        { "OP_VERNOTIF", NoPush, ReservedOpcode }, // 0x66
+        { "OP_ELSE", NoPush, 0 }, // 0x67
+        { "OP_ENDIF", NoPush, 0 }, // 0x68
+        { "OP_VERIFY", NoPush, 0 }, // 0x69
+        { "OP_RETURN", NoPush, 0 }, // 0x6a
+        { "OP_TOALTSTACK", NoPush, 0 }, // 0x6b
+        { "OP_FROMALTSTACK", NoPush, 0 }, // 0x6c
+        { "OP_2DROP", NoPush, 0 }, // 0x6d
+        { "OP_2DUP", NoPush, 0 }, // 0x6e
+        { "OP_3DUP", NoPush, 0 }, // 0x6f
+        { "OP_2OVER", NoPush, 0 }, // 0x70
+        { "OP_2ROT", NoPush, 0 }, // 0x71
+        { "OP_2SWAP", NoPush, 0 }, // 0x72
+        { "OP_IFDUP", NoPush, 0 }, // 0x73
+        { "OP_DEPTH", NoPush, 0 }, // 0x74
+        { "OP_DROP", NoPush, 0 }, // 0x75
+        { "OP_DUP", NoPush, 0 }, // 0x76
+        { "OP_NIP", NoPush, 0 }, // 0x77
+        { "OP_OVER", NoPush, 0 }, // 0x78
+        { "OP_PICK", NoPush, 0 }, // 0x79
+        { "OP_ROLL", NoPush, 0 }, // 0x7a
+        { "OP_ROT", NoPush, 0 }, // 0x7b
+        { "OP_SWAP", NoPush, 0 }, // 0x7c
+        { "OP_TUCK", NoPush, 0 }, // 0x7d
+        { "OP_CAT", NoPush, DisabledOpcode }, // 0x7e
+        { "OP_SUBSTR", NoPush, DisabledOpcode }, // 0x7f
+        { "OP_LEFT", NoPush, DisabledOpcode }, // 0x80
+        { "OP_RIGHT", NoPush, DisabledOpcode }, // 0x81
+        { "OP_SIZE", NoPush, 0 }, // 0x82
+        { "OP_INVERT", NoPush, DisabledOpcode }, // 0x83
+        { "OP_AND", NoPush, DisabledOpcode }, // 0x84
+        { "OP_OR", NoPush, DisabledOpcode }, // 0x85
+        { "OP_XOR", NoPush, DisabledOpcode }, // 0x86
+        { "OP_EQUAL", NoPush, 0 }, // 0x87
+        { "OP_EQUALVERIFY", NoPush, 0 }, // 0x88
+        { "OP_RESERVED1", NoPush, ReservedOpcode }, // 0x89
+        { "OP_RESERVED2", NoPush, ReservedOpcode }, // 0x8a
+        { "OP_1ADD", NoPush, 0 }, // 0x8b
+        { "OP_1SUB", NoPush, 0 }, // 0x8c
+        { "OP_2MUL", NoPush, DisabledOpcode }, // 0x8d
+        { "OP_2DIV", NoPush, DisabledOpcode }, // 0x8e
+        { "OP_NEGATE", NoPush, 0 }, // 0x8f
+        { "OP_ABS", NoPush, 0 }, // 0x90
+        { "OP_NOT", NoPush, 0 }, // 0x91
+        { "OP_0NOTEQUAL", NoPush, 0 }, // 0x92
+        { "OP_ADD", NoPush, 0 }, // 0x93
+        { "OP_SUB", NoPush, 0 }, // 0x94
+        { "OP_MUL", NoPush, DisabledOpcode }, // 0x95
+        { "OP_DIV", NoPush, DisabledOpcode }, // 0x96
+        { "OP_MOD", NoPush, DisabledOpcode }, // 0x97
+        { "OP_LSHIFT", NoPush, DisabledOpcode }, // 0x98
+        { "OP_RSHIFT", NoPush, DisabledOpcode }, // 0x99
+        { "OP_BOOLAND", NoPush, 0 }, // 0x9a
+        { "OP_BOOLOR", NoPush, 0 }, // 0x9b
+        { "OP_NUMEQUAL", NoPush, 0 }, // 0x9c
+        { "OP_NUMEQUALVERIFY", NoPush, 0 }, // 0x9d
+        { "OP_NUMNOTEQUAL", NoPush, 0 }, // 0x9e
+        { "OP_LESSTHAN", NoPush, 0 }, // 0x9f
+        { "OP_GREATERTHAN", NoPush, 0 }, // 0xa0
+        { "OP_LESSTHANOREQUAL", NoPush, 0 }, // 0xa1
+        { "OP_GREATERTHANOREQUAL", NoPush, 0 }, // 0xa2
+        { "OP_MIN", NoPush, 0 }, // 0xa3
+        { "OP_MAX", NoPush, 0 }, // 0xa4
+        { "OP_WITHIN", NoPush, 0 }, // 0xa5
+        { "OP_RIPEMD160", NoPush, HashOpcode }, // 0xa6
+        { "OP_SHA1", NoPush, HashOpcode }, // 0xa7
+        { "OP_SHA256", NoPush, HashOpcode }, // 0xa8
+        { "OP_HASH160", NoPush, HashOpcode }, // 0xa9
+        { "OP_HASH256", NoPush, HashOpcode }, // 0xaa
+        { "OP_CODESEPARATOR", NoPush, 0 }, // 0xab
+        { "OP_CHECKSIG", NoPush, SignatureOpcode }, // 0xac
+        { "OP_CHECKSIGVERIFY", NoPush, SignatureOpcode }, // 0xad
+        { "OP_CHECKMULTISIG", NoPush, SignatureOpcode }, // 0xae
+        { "OP_CHECKMULTISIGVERIFY", NoPush, SignatureOpcode }, // 0xaf
+        { "OP_NOP1", NoPush, 0 }, // 0xb0
+        { "OP_CHECKLOCKTIMEVERIFY", NoPush, 0 }, // 0xb1
+        { "OP_CHECKSEQUENCEVERIFY", NoPush, 0 }, // 0xb2
+        { "OP_NOP4", NoPush, 0 }, // 0xb3
+        { "OP_NOP5", NoPush, 0 }, // 0xb4
+        { "OP_NOP6", NoPush, 0 }, // 0xb5
+        { "OP_NOP7", NoPush, 0 }, // 0xb6
+        { "OP_NOP8", NoPush, 0 }, // 0xb7
+        { "OP_NOP9", NoPush, 0 }, // 0xb8
+        { "OP_NOP10", NoPush, 0 }, // 0xb9
+        // 0xba - 0xfc are not assigned
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE, UNKNOWN_OPCODE,
+        UNKNOWN_OPCODE,
+        { "OP_PUBKEYHASH", NoPush, InvalidOpcode }, // 0xfd
+        { "OP_PUBKEY", NoPush, InvalidOpcode }, // 0xfe
+        { "OP_INVALIDOPCODE", NoPush, InvalidOpcode }, // 0xff
+    };
+#undef DIRECT_PUSH
+#undef UNKNOWN_OPCODE
+
+    /**
+     * Tokenize the @a length bytes at @a script without copying them.
+     * The caller has to keep the data alive for the lifetime of the tokenizer.
+     */
+    inline ScriptTokenizer(const char *script, int length)
+        : m_script(script),
+          m_length(length),
+          m_position(0),
+          m_opcodeStart(0),
+          m_opcode(0),
+          m_dataStart(0),
+          m_dataLength(0)
+    {
+    }
+    inline ScriptTokenizer(const QByteArray &script)
+        : ScriptTokenizer(script.constData(), script.size())
+    {
+    }
+
+    enum Type {
+        FoundOpcode,
+        EndOfScript,
+        Error       ///< a push with more bytes than the script has left.
+    };
+
+    inline Type next() {
+        if (m_position >= m_length)
+            return EndOfScript;
+        m_opcodeStart = m_position;
+        m_opcode = static_cast<quint8>(m_script[m_position++]);
+        const int width = opcodes[m_opcode].pushWidth;
+        if (width == NoPush) {
+            m_dataStart = m_position;
+            m_dataLength = 0;
+            return FoundOpcode;
+        }
+        quint32 size = m_opcode;
+        if (width > 0) {
+            if (width > m_length - m_position)
+                return fail(-1);
+            if (width == 1)
+                size = static_cast<quint8>(m_script[m_position]);
+            else if (width == 2)
+                size = Streaming::fetch16bitValue(m_script, m_position);
+            else
+                size = Streaming::fetch32bitValue(m_script, m_position);
+            m_position += width;
+        }
+        if (size > static_cast<quint32>(m_length - m_position))
+            return fail(size > 0x7FFFFFFF ? -1 : static_cast<int>(size));
+        m_dataStart = m_position;
+        m_dataLength = size;
+        m_position += size;
+        return FoundOpcode;
+    }
+
+    /// return the opcode found by the latest next().
+    inline quint8 opcode() const {
+        return m_opcode;
+    }
+    /// return the table entry of opcode().
+    inline const Opcode &info() const {
+        return opcodes[m_opcode];
+    }
+    /// return true if the latest opcode is one of the push opcodes, OP_FALSE up to OP_PUSHDATA4.
+    inline bool isPush() const {
+        return opcodes[m_opcode].flags & PushOpcode;
+    }
+
+    /// for push opcodes, return the pushed bytes without copying them.
+    inline ConstBytes pushData() const {
+        return ConstBytes(m_script + m_dataStart, m_dataLength);
+    }
+    /// for push opcodes, return the offset in the script the pushed bytes start at.
+    inline int dataStart() const {
+        return m_dataStart;
+    }
+    /**
+     * for push opcodes, return the amount of bytes pushed.
+     * After Error this is the length the push claimed, or -1 if the length itself was cut off.
+     */
+    inline int dataLength() const {
+        return m_dataLength;
+    }
+    /// return the offset in the script of the latest opcode.
+    inline int opcodeStart() const {
+        return m_opcodeStart;
+    }
+    /// return the amount of bytes consumed up-including the latest opcode and its data.
+    inline int consumed() const {
+        return m_position;
+    }
+
+    /// return true if the script only has push opcodes, which is what input scripts need to be.
+    static bool isPushOnly(const char *script, int length);
+
+private:
+    inline Type fail(int claimedLength) {
+        m_dataStart = m_position;
+        m_dataLength = claimedLength;
+        m_position = m_length;
+        return Error;
+    }
+
+    const char *m_script;
+    int m_length;
+    int m_position;
+    int m_opcodeStart;
+    quint8 m_opcode;
+    int m_dataStart;
+    int m_dataLength;
+};
+
+#endif
@@ -0,0 +1,941 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Secp256k1.h"
+
+#include <QVector>
+
+#include <string.h>
+
+namespace {
+// return the low half of a * b + c + d and store the high half in @a high, this never overflows.
+inline quint64 mulAdd(quint64 a, quint64 b, quint64 c, quint64 d, quint64 &high)
+{
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 result = static_cast<unsigned __int128>(a) * b + c + d;
+    high = static_cast<quint64>(result >> 64);
+    return static_cast<quint64>(result);
+#else
+    const quint64 aLow = a & 0xFFFFFFFF, aHigh = a >> 32;
+    const quint64 bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+    const quint64 lowLow = aLow * bLow, lowHigh = aLow * bHigh, highLow = aHigh * bLow;
+    const quint64 middle = (lowLow >> 32) + (lowHigh & 0xFFFFFFFF) + (highLow & 0xFFFFFFFF);
+    quint64 low = (lowLow & 0xFFFFFFFF) | (middle << 32);
+    high = aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+    low += c;
+    high += low < c;
+    low += d;
+    high += low < d;
+    return low;
+#endif
+}
+
+// the sums of the products of a column in a multiplication, c0 + c1 * 2^64 + c2 * 2^128.
+struct Accumulator {
+#ifdef __SIZEOF_INT128__
+    Accumulator() : low(0), c2(0) {}
+    inline void add(quint64 a, quint64 b) {
+        const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        low += product;
+        c2 += low < product;
+    }
+    inline void addTwice(quint64 a, quint64 b) {
+        const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        low += product;
+        c2 += low < product;
+        low += product;
+        c2 += low < product;
+    }
+    /// return the lowest limb and shift the rest down.
+    inline quint64 extract() {
+        const quint64 answer = static_cast<quint64>(low);
+        low = (low >> 64) | (static_cast<unsigned __int128>(c2) << 64);
+        c2 = 0;
+        return answer;
+    }
+    inline quint64 c0() const {
+        return static_cast<quint64>(low);
+    }
+    unsigned __int128 low;
+    quint64 c2;
+#else
+    Accumulator() : c0Limb(0), c1(0), c2(0) {}
+    inline void add(quint64 a, quint64 b) {
+        quint64 high;
+        const quint64 low = mulAdd(a, b, 0, 0, high);
+        c0Limb += low;
+        high += c0Limb < low; // high is at most 2^64 - 2, this doesn't overflow.
+        c1 += high;
+        c2 += c1 < high;
+    }
+    inline void addTwice(quint64 a, quint64 b) {
+        add(a, b);
+        add(a, b);
+    }
+    inline quint64 extract() {
+        const quint64 answer = c0Limb;
+        c0Limb = c1;
+        c1 = c2;
+        c2 = 0;
+        return answer;
+    }
+    inline quint64 c0() const {
+        return c0Limb;
+    }
+    quint64 c0Limb, c1, c2;
+#endif
+};
+
+// the full 512 bits product of two 4 limb numbers; written out, the loops are too slow unless unrolled.
+inline void multiply(quint64 *t, const quint64 *a, const quint64 *b)
+{
+    Accumulator acc;
+    acc.add(a[0], b[0]);
+    t[0] = acc.extract();
+    acc.add(a[0], b[1]);
+    acc.add(a[1], b[0]);
+    t[1] = acc.extract();
+    acc.add(a[0], b[2]);
+    acc.add(a[1], b[1]);
+    acc.add(a[2], b[0]);
+    t[2] = acc.extract();
+    acc.add(a[0], b[3]);
+    acc.add(a[1], b[2]);
+    acc.add(a[2], b[1]);
+    acc.add(a[3], b[0]);
+    t[3] = acc.extract();
+    acc.add(a[1], b[3]);
+    acc.add(a[2], b[2]);
+    acc.add(a[3], b[1]);
+    t[4] = acc.extract();
+    acc.add(a[2], b[3]);
+    acc.add(a[3], b[2]);
+    t[5] = acc.extract();
+    acc.add(a[3], b[3]);
+    t[6] = acc.extract();
+    t[7] = acc.c0();
+}
+
+inline void square(quint64 *t, const quint64 *a)
+{
+    Accumulator acc;
+    acc.add(a[0], a[0]);
+    t[0] = acc.extract();
+    acc.addTwice(a[0], a[1]);
+    t[1] = acc.extract();
+    acc.addTwice(a[0], a[2]);
+    acc.add(a[1], a[1]);
+    t[2] = acc.extract();
+    acc.addTwice(a[0], a[3]);
+    acc.addTwice(a[1], a[2]);
+    t[3] = acc.extract();
+    acc.addTwice(a[1], a[3]);
+    acc.add(a[2], a[2]);
+    t[4] = acc.extract();
+    acc.addTwice(a[2], a[3]);
+    t[5] = acc.extract();
+    acc.add(a[3], a[3]);
+    t[6] = acc.extract();
+    t[7] = acc.c0();
+}
+
+// add a carry into the limbs, returns the carry out.
+inline quint64 addCarry(quint64 &limb, quint64 value, quint64 carry)
+{
+    limb += carry;
+    quint64 out = limb < carry;
+    limb += value;
+    return out + (limb < value);
+}
+
+// 4 limb helpers, the carry or borrow is returned.
+inline quint64 add(quint64 *r, const quint64 *a, const quint64 *b)
+{
+    quint64 r0 = a[0], r1 = a[1], r2 = a[2], r3 = a[3];
+    quint64 carry = addCarry(r0, b[0], 0);
+    carry = addCarry(r1, b[1], carry);
+    carry = addCarry(r2, b[2], carry);
+    carry = addCarry(r3, b[3], carry);
+    r[0] = r0;
+    r[1] = r1;
+    r[2] = r2;
+    r[3] = r3;
+    return carry;
+}
+
+inline quint64 subBorrow(quint64 &limb, quint64 value, quint64 borrow)
+{
+    const quint64 out = limb < value;
+    limb -= value;
+    const quint64 out2 = limb < borrow;
+    limb -= borrow;
+    return out | out2;
+}
+
+inline quint64 sub(quint64 *r, const quint64 *a, const quint64 *b)
+{
+    quint64 r0 = a[0], r1 = a[1], r2 = a[2], r3 = a[3];
+    quint64 borrow = subBorrow(r0, b[0], 0);
+    borrow = subBorrow(r1, b[1], borrow);
+    borrow = subBorrow(r2, b[2], borrow);
+    borrow = subBorrow(r3, b[3], borrow);
+    r[0] = r0;
+    r[1] = r1;
+    r[2] = r2;
+    r[3] = r3;
+    return borrow;
+}
+
+inline bool isZero(const quint64 *a)
+{
+    return (a[0] | a[1] | a[2] | a[3]) == 0;
+}
+
+inline bool isEqual(const quint64 *a, const quint64 *b)
+{
+    return ((a[0] ^ b[0]) | (a[1] ^ b[1]) | (a[2] ^ b[2]) | (a[3] ^ b[3])) == 0;
+}
+
+inline bool greaterOrEqual(const quint64 *a, const quint64 *b)
+{
+    for (int i = 3; i >= 0; --i) {
+        if (a[i] != b[i])
+            return a[i] > b[i];
+    }
+    return true;
+}
+
+void fromBigEndian(const char *data, quint64 *out)
+{
+    for (int i = 0; i < 4; ++i) {
+        quint64 limb = 0;
+        for (int b = 0; b < 8; ++b)
+            limb = (limb << 8) | static_cast<quint8>(data[(3 - i) * 8 + b]);
+        out[i] = limb;
+    }
+}
+
+void toBigEndian(const quint64 *in, char *data)
+{
+    for (int i = 0; i < 4; ++i) {
+        for (int b = 0; b < 8; ++b)
+            data[(3 - i) * 8 + b] = static_cast<char>(in[i] >> (56 - b * 8));
+    }
+}
+
+// the field; numbers modulo p = 2^256 - 2^32 - 977, always kept fully reduced.
+struct Field {
+    quint64 n[4];
+};
+
+const quint64 FieldP[4] = { 0xFFFFFFFEFFFFFC2FULL, ~0ULL, ~0ULL, ~0ULL };
+const quint64 FieldC = 0x1000003D1ULL; // 2^256 - p
+
+inline void fieldSet(Field &r, quint64 value)
+{
+    r.n[0] = value;
+    r.n[1] = r.n[2] = r.n[3] = 0;
+}
+
+// true if @a a, which is below 2^256, is not below p. The upper limbs of p are all ones.
+inline bool fieldOverflows(const quint64 *a)
+{
+    return (a[1] & a[2] & a[3]) == ~0ULL && a[0] >= FieldP[0];
+}
+
+inline void fieldAdd(Field &r, const Field &a, const Field &b)
+{
+    if (add(r.n, a.n, b.n) || fieldOverflows(r.n))
+        sub(r.n, r.n, FieldP);
+}
+
+inline void fieldSub(Field &r, const Field &a, const Field &b)
+{
+    if (sub(r.n, a.n, b.n))
+        add(r.n, r.n, FieldP);
+}
+
+inline void fieldNegate(Field &r, const Field &a)
+{
+    if (isZero(a.n))
+        r = a;
+    else
+        sub(r.n, FieldP, a.n);
+}
+
+// reduce the 512 bits @a t modulo p.
+inline void fieldReduce(Field &r, const quint64 *t)
+{
+    // 2^256 is congruent to FieldC, fold the high half onto the low one, twice.
+    quint64 carry;
+    quint64 r0 = mulAdd(t[4], FieldC, t[0], 0, carry);
+    quint64 r1 = mulAdd(t[5], FieldC, t[1], carry, carry);
+    quint64 r2 = mulAdd(t[6], FieldC, t[2], carry, carry);
+    quint64 r3 = mulAdd(t[7], FieldC, t[3], carry, carry);
+    r0 = mulAdd(carry, FieldC, r0, 0, carry);
+    carry = addCarry(r1, carry, 0);
+    carry = addCarry(r2, 0, carry);
+    carry = addCarry(r3, 0, carry);
+    if (carry) { // wrapped, what is left is small enough to not wrap again.
+        carry = addCarry(r0, FieldC, 0);
+        carry = addCarry(r1, 0, carry);
+        carry = addCarry(r2, 0, carry);
+        r3 += carry;
+    }
+    r.n[0] = r0;
+    r.n[1] = r1;
+    r.n[2] = r2;
+    r.n[3] = r3;
+    if (fieldOverflows(r.n))
+        sub(r.n, r.n, FieldP);
+}
+
+void fieldMul(Field &r, const Field &a, const Field &b)
+{
+    quint64 t[8];
+    multiply(t, a.n, b.n);
+    fieldReduce(r, t);
+}
+
+void fieldSqr(Field &r, const Field &a)
+{
+    quint64 t[8];
+    square(t, a.n);
+    fieldReduce(r, t);
+}
+
+void fieldSqrTimes(Field &r, const Field &a, int times)
+{
+    r = a;
+    for (int i = 0; i < times; ++i)
+        fieldSqr(r, r);
+}
+
+/*
+ * The exponents for the inverse (p - 2) and the square root ((p + 1) / 4) both start with
+ * blocks of ones of 223 and 22 bits long. Calculate a^(2^k - 1) for those using an addition chain.
+ */
+void fieldPowerBlocks(const Field &a, Field &x2, Field &x3, Field &x22, Field &x223)
+{
+    Field x6, x9, x11, x44, x88, x176, x220, t;
+    fieldSqr(t, a);
+    fieldMul(x2, t, a);
+    fieldSqr(t, x2);
+    fieldMul(x3, t, a);
+    fieldSqrTimes(t, x3, 3);
+    fieldMul(x6, t, x3);
+    fieldSqrTimes(t, x6, 3);
+    fieldMul(x9, t, x3);
+    fieldSqrTimes(t, x9, 2);
+    fieldMul(x11, t, x2);
+    fieldSqrTimes(t, x11, 11);
+    fieldMul(x22, t, x11);
+    fieldSqrTimes(t, x22, 22);
+    fieldMul(x44, t, x22);
+    fieldSqrTimes(t, x44, 44);
+    fieldMul(x88, t, x44);
+    fieldSqrTimes(t, x88, 88);
+    fieldMul(x176, t, x88);
+    fieldSqrTimes(t, x176, 44);
+    fieldMul(x220, t, x44);
+    fieldSqrTimes(t, x220, 3);
+    fieldMul(x223, t, x3);
+}
+
+void fieldInverse(Field &r, const Field &a)
+{
+    Field x2, x3, x22, x223, t;
+    fieldPowerBlocks(a, x2, x3, x22, x223);
+    fieldSqrTimes(t, x223, 23);
+    fieldMul(t, t, x22);
+    fieldSqrTimes(t, t, 5);
+    fieldMul(t, t, a);
+    fieldSqrTimes(t, t, 3);
+    fieldMul(t, t, x2);
+    fieldSqrTimes(t, t, 2);
+    fieldMul(r, t, a);
+}
+
+// returns false if @a a has no square root.
+bool fieldSqrt(Field &r, const Field &a)
+{
+    Field x2, x3, x22, x223, t;
+    fieldPowerBlocks(a, x2, x3, x22, x223);
+    fieldSqrTimes(t, x223, 23);
+    fieldMul(t, t, x22);
+    fieldSqrTimes(t, t, 6);
+    fieldMul(t, t, x2);
+    fieldSqrTimes(r, t, 2);
+    fieldSqr(t, r);
+    return isEqual(t.n, a.n);
+}
+
+// the scalars; numbers modulo the group order n.
+struct Scalar {
+    quint64 n[4];
+};
+
+const quint64 GroupN[4] = { 0xBFD25E8CD0364141ULL, 0xBAAEDCE6AF48A03BULL, 0xFFFFFFFFFFFFFFFEULL, ~0ULL };
+const quint64 GroupC[3] = { 0x402DA1732FC9BEBFULL, 0x4551231950B75FC4ULL, 1 }; // 2^256 - n
+const quint64 HalfN[4] = { 0xDFE92F46681B20A0ULL, 0x5D576E7357A4501DULL, ~0ULL, 0x7FFFFFFFFFFFFFFFULL };
+
+void scalarMul(Scalar &r, const Scalar &a, const Scalar &b)
+{
+    quint64 t[8];
+    multiply(t, a.n, b.n);
+    // 2^256 is congruent to GroupC, fold the high half onto the low one until it fits.
+    while ((t[4] | t[5] | t[6] | t[7]) != 0) {
+        quint64 folded[8] = { t[0], t[1], t[2], t[3], 0, 0, 0, 0 };
+        for (int i = 0; i < 4; ++i) {
+            quint64 carry = 0;
+            for (int j = 0; j < 3; ++j)
+                folded[i + j] = mulAdd(t[i + 4], GroupC[j], folded[i + j], carry, carry);
+            for (int k = i + 3; k < 8 && carry; ++k) {
+                folded[k] += carry;
+                carry = folded[k] < carry;
+            }
+        }
+        memcpy(t, folded, sizeof(t));
+    }
+    memcpy(r.n, t, sizeof(r.n));
+    if (greaterOrEqual(r.n, GroupN))
+        sub(r.n, r.n, GroupN);
+}
+
+inline void scalarAdd(Scalar &r, const Scalar &a, const Scalar &b)
+{
+    if (add(r.n, a.n, b.n) || greaterOrEqual(r.n, GroupN))
+        sub(r.n, r.n, GroupN);
+}
+
+void scalarInverse(Scalar &r, const Scalar &a)
+{
+    // a^(n - 2) with a fixed window of 4 bits.
+    static const quint64 Exponent[4] = { 0xBFD25E8CD036413FULL, 0xBAAEDCE6AF48A03BULL, 0xFFFFFFFFFFFFFFFEULL, ~0ULL };
+    Scalar powers[16];
+    memset(powers[0].n, 0, sizeof(powers[0].n));
+    powers[0].n[0] = 1;
+    powers[1] = a;
+    for (int i = 2; i < 16; ++i)
+        scalarMul(powers[i], powers[i - 1], a);
+    Scalar result = powers[0];
+    for (int nibble = 63; nibble >= 0; --nibble) {
+        for (int i = 0; i < 4; ++i)
+            scalarMul(result, result, result);
+        const int digit = (Exponent[nibble / 16] >> ((nibble % 16) * 4)) & 0xF;
+        if (digit)
+            scalarMul(result, result, powers[digit]);
+    }
+    r = result;
+}
+
+/*
+ * Write the width @a w non-adjacent form of @a scalar to @a digits, which needs room for 257.
+ * Every non-zero digit is odd and below 2^(w-1) in magnitude and is followed by at least w - 1
+ * zeros. Returns the amount of digits.
+ */
+int toWindowedNaf(const Scalar &scalar, int w, int *digits)
+{
+    quint64 k[4];
+    memcpy(k, scalar.n, sizeof(k));
+    int length = 0;
+    while (!isZero(k)) {
+        int digit = 0;
+        if (k[0] & 1) {
+            digit = k[0] & ((1 << w) - 1);
+            if (digit >= (1 << (w - 1)))
+                digit -= 1 << w;
+            // k -= digit. k < n is far enough from 2^256 for this to never wrap.
+            const quint64 value[4] = { static_cast<quint64>(digit < 0 ? -digit : digit), 0, 0, 0 };
+            if (digit > 0)
+                sub(k, k, value);
+            else
+                add(k, k, value);
+        }
+        digits[length++] = digit;
+        for (int i = 0; i < 3; ++i)
+            k[i] = (k[i] >> 1) | (k[i + 1] << 63);
+        k[3] >>= 1;
+    }
+    return length;
+}
+
+// points in jacobian coordinates, x = X / Z^2 and y = Y / Z^3.
+struct Point {
+    Field x, y, z;
+    bool infinity;
+};
+
+struct AffinePoint {
+    Field x, y;
+};
+
+void pointDouble(Point &r, const Point &a)
+{
+    if (a.infinity || isZero(a.y.n)) {
+        r.infinity = true;
+        return;
+    }
+    Field xx, yy, yyyy, d, e, f, t;
+    fieldSqr(xx, a.x);
+    fieldSqr(yy, a.y);
+    fieldSqr(yyyy, yy);
+    fieldAdd(t, a.x, yy); // d = 2 * ((x + yy)^2 - xx - yyyy)
+    fieldSqr(t, t);
+    fieldSub(t, t, xx);
+    fieldSub(t, t, yyyy);
+    fieldAdd(d, t, t);
+    fieldAdd(e, xx, xx); // e = 3 * xx
+    fieldAdd(e, e, xx);
+    fieldSqr(f, e);
+
+    Field z;
+    fieldMul(z, a.y, a.z);
+    fieldAdd(r.z, z, z);
+    fieldAdd(t, d, d);
+    fieldSub(r.x, f, t);
+    fieldSub(t, d, r.x);
+    fieldMul(t, e, t);
+    fieldAdd(yyyy, yyyy, yyyy); // 8 * yyyy
+    fieldAdd(yyyy, yyyy, yyyy);
+    fieldAdd(yyyy, yyyy, yyyy);
+    fieldSub(r.y, t, yyyy);
+    r.infinity = false;
+}
+
+/*
+ * Add @a b to @a a, given u1 = x1 * z2^2, s1 = y1 * z2^3 and the x2 * z1^2 and y2 * z1^3
+ * as u2 and s2. The z of the result is @a zFactor * h.
+ */
+void pointAddFinish(Point &r, const Point &a, const Field &u1, const Field &s1, const Field &u2,
+                    const Field &s2, const Field &zFactor)
+{
+    Field h, rr;
+    fieldSub(h, u2, u1);
+    fieldSub(rr, s2, s1);
+    if (isZero(h.n)) {
+        if (isZero(rr.n))
+            pointDouble(r, a);
+        else
+            r.infinity = true;
+        return;
+    }
+    Field hh, hhh, v, t;
+    fieldSqr(hh, h);
+    fieldMul(hhh, h, hh);
+    fieldMul(v, u1, hh);
+    fieldMul(r.z, zFactor, h);
+    fieldSqr(t, rr);
+    fieldSub(t, t, hhh);
+    fieldSub(t, t, v);
+    fieldSub(r.x, t, v);
+    fieldSub(t, v, r.x);
+    fieldMul(t, rr, t);
+    fieldMul(v, s1, hhh);
+    fieldSub(r.y, t, v);
+    r.infinity = false;
+}
+
+void pointAdd(Point &r, const Point &a, const Point &b)
+{
+    if (a.infinity) {
+        r = b;
+        return;
+    }
+    if (b.infinity) {
+        r = a;
+        return;
+    }
+    Field z1z1, z2z2, u1, u2, s1, s2, zFactor;
+    fieldSqr(z1z1, a.z);
+    fieldSqr(z2z2, b.z);
+    fieldMul(u1, a.x, z2z2);
+    fieldMul(u2, b.x, z1z1);
+    fieldMul(s1, a.y, b.z);
+    fieldMul(s1, s1, z2z2);
+    fieldMul(s2, b.y, a.z);
+    fieldMul(s2, s2, z1z1);
+    fieldMul(zFactor, a.z, b.z);
+    const Point copy = a; // r may be a
+    pointAddFinish(r, copy, u1, s1, u2, s2, zFactor);
+}
+
+void pointAddAffine(Point &r, const Point &a, const AffinePoint &b)
+{
+    if (a.infinity) {
+        r.x = b.x;
+        r.y = b.y;
+        fieldSet(r.z, 1);
+        r.infinity = false;
+        return;
+    }
+    Field z1z1, u2, s2;
+    fieldSqr(z1z1, a.z);
+    fieldMul(u2, b.x, z1z1);
+    fieldMul(s2, b.y, a.z);
+    fieldMul(s2, s2, z1z1);
+    const Point copy = a;
+    pointAddFinish(r, copy, copy.x, copy.y, u2, s2, copy.z);
+}
+
+void toAffine(AffinePoint &r, const Point &a)
+{
+    Field zInverse, zInverse2;
+    fieldInverse(zInverse, a.z);
+    fieldSqr(zInverse2, zInverse);
+    fieldMul(r.x, a.x, zInverse2);
+    fieldMul(zInverse2, zInverse2, zInverse);
+    fieldMul(r.y, a.y, zInverse2);
+}
+
+enum {
+    GeneratorWindow = 8,  // a table of 64 points, created once.
+    KeyWindow = 5,        // 8 points, created for each verify.
+    GeneratorTableSize = 1 << (GeneratorWindow - 2),
+    KeyTableSize = 1 << (KeyWindow - 2)
+};
+
+// the odd multiples 1G, 3G, 5G ... of the generator.
+struct GeneratorTable {
+    GeneratorTable() {
+        AffinePoint g;
+        fromBigEndian("\x79\xBE\x66\x7E\xF9\xDC\xBB\xAC\x55\xA0\x62\x95\xCE\x87\x0B\x07"
+                      "\x02\x9B\xFC\xDB\x2D\xCE\x28\xD9\x59\xF2\x81\x5B\x16\xF8\x17\x98", g.x.n);
+        fromBigEndian("\x48\x3A\xDA\x77\x26\xA3\xC4\x65\x5D\xA4\xFB\xFC\x0E\x11\x08\xA8"
+                      "\xFD\x17\xB4\x48\xA6\x85\x54\x19\x9C\x47\xD0\x8F\xFB\x10\xD4\xB8", g.y.n);
+        Point current, twice;
+        current.infinity = true;
+        pointAddAffine(current, current, g);
+        pointDouble(twice, current);
+        points[0] = g;
+        for (int i = 1; i < GeneratorTableSize; ++i) {
+            pointAdd(current, current, twice);
+            toAffine(points[i], current);
+        }
+    }
+    AffinePoint points[GeneratorTableSize];
+};
+
+const GeneratorTable &generatorTable()
+{
+    static const GeneratorTable table; // initialization is thread-safe.
+    return table;
+}
+
+// r = a * G + b * key, the key is optional.
+void doubleMultiply(Point &r, const Scalar &a, const Scalar &b, const Secp256k1::PublicKey *key)
+{
+    const GeneratorTable &table = generatorTable();
+    int nafA[257], nafB[257];
+    const int lengthA = toWindowedNaf(a, GeneratorWindow, nafA);
+    int lengthB = 0;
+    Point keyTable[KeyTableSize];
+    if (key) {
+        lengthB = toWindowedNaf(b, KeyWindow, nafB);
+        Point &first = keyTable[0];
+        memcpy(first.x.n, key->x, sizeof(first.x.n));
+        memcpy(first.y.n, key->y, sizeof(first.y.n));
+        fieldSet(first.z, 1);
+        first.infinity = false;
+        Point twice;
+        pointDouble(twice, first);
+        for (int i = 1; i < KeyTableSize; ++i)
+            pointAdd(keyTable[i], keyTable[i - 1], twice);
+    }
+
+    r.infinity = true;
+    for (int i = qMax(lengthA, lengthB) - 1; i >= 0; --i) {
+        pointDouble(r, r);
+        if (i < lengthB && nafB[i] != 0) {
+            Point term = keyTable[(nafB[i] < 0 ? -nafB[i] : nafB[i]) / 2];
+            if (nafB[i] < 0)
+                fieldNegate(term.y, term.y);
+            pointAdd(r, r, term);
+        }
+        if (i < lengthA && nafA[i] != 0) {
+            AffinePoint term = table.points[(nafA[i] < 0 ? -nafA[i] : nafA[i]) / 2];
+            if (nafA[i] < 0)
+                fieldNegate(term.y, term.y);
+            pointAddAffine(r, r, term);
+        }
+    }
+}
+
+// returns false if the 32 bytes big-endian @a data is zero or not below n.
+bool scalarFromBytes(const char *data, Scalar &r)
+{
+    fromBigEndian(data, r.n);
+    return !isZero(r.n) && !greaterOrEqual(r.n, GroupN);
+}
+
+// append a DER integer of the 32 bytes big-endian @a value
+void appendDerInteger(QByteArray &out, const char *value)
+{
+    int start = 0;
+    while (start < 31 && value[start] == 0)
+        ++start;
+    const bool pad = value[start] & 0x80;
+    out.append('\x02');
+    out.append(static_cast<char>(32 - start + pad));
+    if (pad)
+        out.append('\0');
+    out.append(value + start, 32 - start);
+}
+
+// the length of a DER element at @a pos, which is moved past it. Returns false if truncated.
+bool readDerLength(const quint8 *der, int size, int &pos, quint64 &length)
+{
+    if (pos >= size)
+        return false;
+    length = der[pos++];
+    if (length & 0x80) {
+        int bytes = length - 0x80;
+        if (bytes > size - pos)
+            return false;
+        while (bytes > 0 && der[pos] == 0) {
+            ++pos;
+            --bytes;
+        }
+        if (bytes >= 4)
+            return false;
+        length = 0;
+        while (bytes-- > 0)
+            length = (length << 8) | der[pos++];
+    }
+    return length <= static_cast<quint64>(size - pos);
+}
+
+// copy a DER integer, without its leading zeros, into the 32 bytes big-endian @a out.
+bool readDerInteger(const quint8 *der, int start, int length, quint64 *out)
+{
+    while (length > 0 && der[start] == 0) {
+        ++start;
+        --length;
+    }
+    if (length > 32)
+        return false;
+    char value[32];
+    memset(value, 0, sizeof(value));
+    memcpy(value + 32 - length, der + start, length);
+    fromBigEndian(value, out);
+    return !isZero(out) && !greaterOrEqual(out, GroupN);
+}
+}
+
+Secp256k1::Signature::Signature()
+{
+    memset(r, 0, sizeof(r));
+    memset(s, 0, sizeof(s));
+    memset(sInverse, 0, sizeof(sInverse));
+}
+
+bool Secp256k1::parsePublicKey(const char *data, int size, PublicKey &key)
+{
+    Q_ASSERT(data || size == 0);
+    if (size == 0)
+        return false;
+    const int type = static_cast<quint8>(data[0]);
+    if (!((size == 33 && (type == 2 || type == 3)) || (size == 65 && (type == 4 || type == 6 || type == 7))))
+        return false;
+    Field x, y, yy, expected;
+    fromBigEndian(data + 1, x.n);
+    if (fieldOverflows(x.n))
+        return false;
+    fieldSqr(expected, x); // x^3 + 7
+    fieldMul(expected, expected, x);
+    Field seven;
+    fieldSet(seven, 7);
+    fieldAdd(expected, expected, seven);
+    if (size == 33) {
+        if (!fieldSqrt(y, expected))
+            return false;
+        if ((y.n[0] & 1) != static_cast<quint64>(type & 1))
+            fieldNegate(y, y);
+    } else {
+        fromBigEndian(data + 33, y.n);
+        if (fieldOverflows(y.n))
+            return false;
+        fieldSqr(yy, y);
+        if (!isEqual(yy.n, expected.n))
+            return false;
+        if (type != 4 && (y.n[0] & 1) != static_cast<quint64>(type & 1)) // hybrid keys also state the parity.
+            return false;
+    }
+    memcpy(key.x, x.n, sizeof(key.x));
+    memcpy(key.y, y.n, sizeof(key.y));
+    return true;
+}
+
+bool Secp256k1::parseSignature(const char *der, int size, Signature &signature)
+{
+    Q_ASSERT(der || size == 0);
+    const quint8 *bytes = reinterpret_cast<const quint8*>(der);
+    int pos = 0;
+    if (size < 1 || bytes[pos++] != 0x30)
+        return false;
+    if (pos >= size)
+        return false;
+    const int sequenceLength = bytes[pos++];
+    if (sequenceLength & 0x80) { // the length of the sequence is not used.
+        if (sequenceLength - 0x80 > size - pos)
+            return false;
+        pos += sequenceLength - 0x80;
+    }
+
+    quint64 rLength, sLength;
+    if (pos >= size || bytes[pos++] != 0x02 || !readDerLength(bytes, size, pos, rLength))
+        return false;
+    const int rStart = pos;
+    pos += rLength;
+    if (pos >= size || bytes[pos++] != 0x02 || !readDerLength(bytes, size, pos, sLength))
+        return false;
+    const int sStart = pos;
+
+    signature = Signature();
+    return readDerInteger(bytes, rStart, rLength, signature.r)
+            && readDerInteger(bytes, sStart, sLength, signature.s);
+}
+
+void Secp256k1::prepare(Signature *signatures, int count)
+{
+    if (count <= 0)
+        return;
+    // Montgomery's trick, invert the product of all and peel off the individual inverses.
+    QVector<Scalar> products(count);
+    memcpy(products[0].n, signatures[0].s, sizeof(products[0].n));
+    for (int i = 1; i < count; ++i) {
+        Scalar s;
+        memcpy(s.n, signatures[i].s, sizeof(s.n));
+        scalarMul(products[i], products[i - 1], s);
+    }
+    Scalar inverse;
+    scalarInverse(inverse, products[count - 1]);
+    for (int i = count - 1; i > 0; --i) {
+        Scalar s, single;
+        scalarMul(single, inverse, products[i - 1]);
+        memcpy(signatures[i].sInverse, single.n, sizeof(single.n));
+        memcpy(s.n, signatures[i].s, sizeof(s.n));
+        scalarMul(inverse, inverse, s);
+    }
+    memcpy(signatures[0].sInverse, inverse.n, sizeof(inverse.n));
+}
+
+bool Secp256k1::verify(const char *hash, const Signature &signature, const PublicKey &key)
+{
+    Q_ASSERT(hash);
+    Scalar r, w, e;
+    memcpy(r.n, signature.r, sizeof(r.n));
+    if (isZero(r.n) || isZero(signature.s))
+        return false;
+    if (isZero(signature.sInverse)) {
+        Scalar s;
+        memcpy(s.n, signature.s, sizeof(s.n));
+        scalarInverse(w, s);
+    } else {
+        memcpy(w.n, signature.sInverse, sizeof(w.n));
+    }
+    fromBigEndian(hash, e.n);
+    if (greaterOrEqual(e.n, GroupN))
+        sub(e.n, e.n, GroupN);
+
+    Scalar u1, u2;
+    scalarMul(u1, e, w);
+    scalarMul(u2, r, w);
+    Point point;
+    doubleMultiply(point, u1, u2, &key);
+    if (point.infinity)
+        return false;
+
+    // compare x / z^2 with r, or r + n which is possible as long as that is below p; without an inversion.
+    Field zz, rz;
+    fieldSqr(zz, point.z);
+    Field rField;
+    memcpy(rField.n, r.n, sizeof(rField.n));
+    fieldMul(rz, rField, zz);
+    if (isEqual(rz.n, point.x.n))
+        return true;
+    quint64 limit[4];
+    sub(limit, FieldP, GroupN);
+    if (greaterOrEqual(r.n, limit))
+        return false;
+    add(rField.n, r.n, GroupN);
+    fieldMul(rz, rField, zz);
+    return isEqual(rz.n, point.x.n);
+}
+
+QByteArray Secp256k1::createPublicKey(const char *secret, bool compressed)
+{
+    Q_ASSERT(secret);
+    Scalar d, zero;
+    if (!scalarFromBytes(secret, d))
+        return QByteArray();
+    memset(zero.n, 0, sizeof(zero.n));
+    Point point;
+    doubleMultiply(point, d, zero, 0);
+    AffinePoint affine;
+    toAffine(affine, point);
+    QByteArray answer(compressed ? 33 : 65, Qt::Uninitialized);
+    answer.data()[0] = compressed ? 2 + (affine.y.n[0] & 1) : 4;
+    toBigEndian(affine.x.n, answer.data() + 1);
+    if (!compressed)
+        toBigEndian(affine.y.n, answer.data() + 33);
+    return answer;
+}
+
+QByteArray Secp256k1::sign(const char *hash, const char *secret, const char *nonce)
+{
+    Q_ASSERT(hash);
+    Q_ASSERT(secret);
+    Q_ASSERT(nonce);
+    Scalar d, k, zero;
+    if (!scalarFromBytes(secret, d) || !scalarFromBytes(nonce, k))
+        return QByteArray();
+    memset(zero.n, 0, sizeof(zero.n));
+    Point point;
+    doubleMultiply(point, k, zero, 0);
+    AffinePoint affine;
+    toAffine(affine, point);
+    Scalar r, s, e, kInverse;
+    memcpy(r.n, affine.x.n, sizeof(r.n));
+    if (greaterOrEqual(r.n, GroupN))
+        sub(r.n, r.n, GroupN);
+    fromBigEndian(hash, e.n);
+    if (greaterOrEqual(e.n, GroupN))
+        sub(e.n, e.n, GroupN);
+    // s = (e + r * d) / k
+    scalarMul(s, r, d);
+    scalarAdd(s, s, e);
+    scalarInverse(kInverse, k);
+    scalarMul(s, s, kInverse);
+    if (isZero(r.n) || isZero(s.n))
+        return QByteArray();
+    if (!greaterOrEqual(HalfN, s.n))
+        sub(s.n, GroupN, s.n);
+
+    char rBytes[32], sBytes[32];
+    toBigEndian(r.n, rBytes);
+    toBigEndian(s.n, sBytes);
+    QByteArray body;
+    appendDerInteger(body, rBytes);
+    appendDerInteger(body, sBytes);
+    QByteArray answer;
+    answer.reserve(body.size() + 2);
+    answer.append('\x30');
+    answer.append(static_cast<char>(body.size()));
+    answer.append(body);
+    return answer;
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SECP256K1_H
+#define SECP256K1_H
+
+#include <QByteArray>
+
+/**
+ * Secp256k1 verifies ECDSA signatures on the secp256k1 curve, as used by Bitcoin.
+ *
+ * Numbers are stored as four 64 bit limbs, least significant first. A verification
+ * calculates u1 * G + u2 * Q in a single pass over the bits of both scalars, using
+ * windowed non-adjacent forms and a table of multiples of the generator that is
+ * created on first use.
+ *
+ * Nothing here is constant time, which is fine for checking the signatures of public
+ * data. The signing methods exist to create test data and should not be used otherwise.
+ */
+class Secp256k1
+{
+public:
+    /// a public key, a point on the curve.
+    struct PublicKey {
+        quint64 x[4], y[4];
+    };
+
+    /// a signature, r and s are in the range [1, n).
+    struct Signature {
+        Signature();
+        quint64 r[4], s[4];
+        quint64 sInverse[4]; // calculated by prepare() or verify(), zero until then.
+    };
+
+    /// parse a compressed, uncompressed or hybrid public key, returns false if it isn't on the curve.
+    static bool parsePublicKey(const char *data, int size, PublicKey &key);
+
+    /**
+     * Parse a DER encoded signature, without the sighash byte.
+     * Like the chain did before BIP66 this is lenient about the encoding, lengths and
+     * padding don't need to be minimal and bytes after the signature are ignored.
+     * Returns false if the signature can't be parsed or r or s are out of range.
+     */
+    static bool parseSignature(const char *der, int size, Signature &signature);
+
+    /**
+     * Calculate the sInverse of @a count signatures, which verify() needs.
+     * All of them share a single modular inversion, making batches cheaper to verify.
+     */
+    static void prepare(Signature *signatures, int count);
+
+    /// return true if @a signature signs the 32 bytes at @a hash with @a key.
+    static bool verify(const char *hash, const Signature &signature, const PublicKey &key);
+
+    /// return the public key of the 32 bytes big-endian @a secret, or an empty array if it is out of range.
+    static QByteArray createPublicKey(const char *secret, bool compressed = true);
+
+    /// return the DER encoded low-s signature of @a hash, using the 32 bytes of @a nonce.
+    static QByteArray sign(const char *hash, const char *secret, const char *nonce);
+};
+
+#endif
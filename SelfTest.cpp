@@ -0,0 +1,2621 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "SelfTest.h"
+#include "Arena.h"
+#include "ArenaTransaction.h"
+#include "ArchiveWriter.h"
+#include "BlockFileReader.h"
+#include "BoundedQueue.h"
+#include "BufferedWriter.h"
+#include "CMF.h"
+#include "CMFSchema.h"
+#include "ColumnarArchive.h"
+#include "ColumnarWriter.h"
+#include "CorpusReader.h"
+#include "MessageBuilder.h"
+#include "MessageParser.h"
+#include "RawFileLoader.h"
+#include "Ripemd160.h"
+#include "RoundTripChecker.h"
+#include "ScriptClassifier.h"
+#include "ScriptTokenizer.h"
+#include "Secp256k1.h"
+#include "Sha256.h"
+#include "SignatureHash.h"
+#include "SignatureVerifier.h"
+#include "SizeStatistics.h"
+#include "StreamMethods.h"
+#include "StructuredWriter.h"
+#include "Transaction.h"
+#include "TransactionArchive.h"
+#include "TransactionBatch.h"
+#include "TransactionGenerator.h"
+#include "TransactionView.h"
+#include "UtxoIndex.h"
+
+#include <QBuffer>
+#include <QHash>
+#include <QRunnable>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QVector>
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+// xorshift64*, the checks need to be repeatable so no seeding from the clock.
+class Random
+{
+public:
+    Random() : m_state(0x9E3779B97F4A7C15ULL) {}
+    quint64 next() {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1DULL;
+    }
+    /// a value with a random bit-length, to get all varint lengths equally often.
+    quint64 nextValue() {
+        const int bits = next() % 65;
+        return bits == 0 ? 0 : next() >> (64 - bits);
+    }
+private:
+    quint64 m_state;
+};
+
+struct Token {
+    Token() : tag(0), type(CMF::BoolFalse), number(0) {}
+    bool operator==(const Token &other) const {
+        return tag == other.tag && type == other.type && number == other.number && bytes == other.bytes;
+    }
+    quint32 tag;
+    CMF::ValueType type;
+    qint64 number;
+    QByteArray bytes;
+};
+
+Token currentToken(const MessageParser &parser)
+{
+    Token token;
+    token.tag = parser.tag();
+    token.type = parser.valueType();
+    token.number = parser.longData();
+    if (token.type == CMF::String)
+        token.bytes = parser.stringData().toByteArray();
+    else
+        token.bytes = parser.bytesData().toByteArray();
+    return token;
+}
+
+QByteArray createDocument(Random &random)
+{
+    QByteArray document;
+    MessageBuilder builder(&document);
+    const int count = random.next() % 40;
+    for (int i = 0; i < count; ++i) {
+        // mostly small tags, some need the extra varint.
+        const quint32 tag = (random.next() % 4) ? random.next() % 31 : random.next() % 0x10000;
+        switch (random.next() % 5) {
+        case 0:
+            builder.add(tag, random.nextValue() >> 8);
+            break;
+        case 1:
+            builder.add(tag, -static_cast<qint64>(random.nextValue() >> 8));
+            break;
+        case 2: {
+            QByteArray bytes(random.next() % ((random.next() % 4) ? 40 : 400), 0);
+            for (int b = 0; b < bytes.size(); ++b)
+                bytes[b] = random.next();
+            builder.add(tag, bytes);
+            break;
+        }
+        case 3:
+            builder.add(tag, QString::fromLatin1("text %1").arg(random.next() % 100000));
+            break;
+        default:
+            builder.add(tag, (random.next() % 2) == 0);
+            break;
+        }
+    }
+    return document;
+}
+
+bool compareUnserialize(const char *data, int dataSize, int position, QTextStream &out)
+{
+    int refPosition = position, fastPosition = position;
+    quint64 refResult = 0, fastResult = 12345;
+    const bool refOk = CMF::unserialize(data, dataSize, refPosition, refResult);
+    const bool fastOk = CMF::unserializeFast(data, dataSize, fastPosition, fastResult);
+    if (refOk != fastOk || refPosition != fastPosition || (refOk && refResult != fastResult)) {
+        out << "unserializeFast differs at size " << dataSize << ": " << fastResult
+            << " instead of " << refResult << endl;
+        return false;
+    }
+    return true;
+}
+
+bool checkValue(quint64 value, QTextStream &out)
+{
+    char ref[20], fast[20];
+    memset(ref, 0, sizeof(ref));
+    memset(fast, 0, sizeof(fast));
+    const int refSize = CMF::serialize(ref, value);
+    const int fastSize = CMF::serializeFast(fast, value);
+    if (refSize != fastSize || memcmp(ref, fast, refSize) != 0) {
+        out << "serializeFast differs for " << value << endl;
+        return false;
+    }
+    // decode with padding behind the value, and with the buffer ending right after it.
+    return compareUnserialize(ref, sizeof(ref), 0, out)
+            && compareUnserialize(ref, refSize, 0, out);
+}
+
+// the straightforward way to classify a script: tokenize it and compare the opcodes.
+ScriptClassifier::ScriptType referenceClassify(const QByteArray &script, ScriptClassifier::Payload &payload)
+{
+    QList<quint8> opcodes;
+    QList<ConstBytes> pushes;
+    ScriptTokenizer tokenizer(script);
+    ScriptTokenizer::Type type = tokenizer.next();
+    for (; type == ScriptTokenizer::FoundOpcode; type = tokenizer.next()) {
+        opcodes.append(tokenizer.opcode());
+        pushes.append(tokenizer.pushData());
+    }
+    payload = ScriptClassifier::Payload();
+    if (type == ScriptTokenizer::Error)
+        return ScriptClassifier::NonStandard;
+    const int count = opcodes.size();
+    struct PubKey {
+        static bool check(quint8 opcode, const ConstBytes &key) {
+            return (opcode == 33 && (key.data[0] == 2 || key.data[0] == 3)) || (opcode == 65 && key.data[0] == 4);
+        }
+    };
+
+    if (count == 5 && opcodes[0] == 0x76 && opcodes[1] == 0xa9 && opcodes[2] == 20 && opcodes[3] == 0x88 && opcodes[4] == 0xac) {
+        payload.data = pushes[2];
+        return ScriptClassifier::PayToPubKeyHash;
+    }
+    if (count == 3 && opcodes[0] == 0xa9 && opcodes[1] == 20 && opcodes[2] == 0x87) {
+        payload.data = pushes[1];
+        return ScriptClassifier::PayToScriptHash;
+    }
+    if (count == 2 && opcodes[1] == 0xac && PubKey::check(opcodes[0], pushes[0])) {
+        payload.data = pushes[0];
+        return ScriptClassifier::PayToPubKey;
+    }
+    if (count >= 1 && opcodes[0] == 0x6a) {
+        for (int i = 1; i < count; ++i) {
+            if (opcodes[i] > 0x60)
+                return ScriptClassifier::NonStandard;
+        }
+        if (count == 2 && opcodes[1] > 0 && opcodes[1] <= 0x4d)
+            payload.data = pushes[1];
+        else
+            payload.data = ConstBytes(script.constData() + 1, script.size() - 1);
+        return ScriptClassifier::NullData;
+    }
+    if (count >= 4 && opcodes[count - 1] == 0xae && opcodes[0] >= 0x51 && opcodes[0] <= 0x60
+            && opcodes[count - 2] >= 0x51 && opcodes[count - 2] <= 0x60) {
+        const int required = opcodes[0] - 0x50, keyCount = opcodes[count - 2] - 0x50;
+        if (required > keyCount || keyCount != count - 3)
+            return ScriptClassifier::NonStandard;
+        for (int i = 0; i < keyCount; ++i) {
+            if (!PubKey::check(opcodes[i + 1], pushes[i + 1]))
+                return ScriptClassifier::NonStandard;
+            payload.keys[i] = pushes[i + 1];
+        }
+        payload.required = required;
+        payload.keyCount = keyCount;
+        return ScriptClassifier::MultiSig;
+    }
+    return ScriptClassifier::NonStandard;
+}
+
+bool sameBytes(const ConstBytes &a, const ConstBytes &b)
+{
+    return a.size == b.size && (a.size == 0 || memcmp(a.data, b.data, a.size) == 0);
+}
+
+QByteArray createStandardScript(Random &random)
+{
+    QByteArray script;
+    struct Append {
+        static void bytes(QByteArray &out, Random &random, int size, char first) {
+            out.append(first);
+            for (int i = 1; i < size; ++i)
+                out.append(static_cast<char>(random.next()));
+        }
+    };
+    switch (random.next() % 5) {
+    case 0:
+        script.append("\x76\xa9\x14", 3);
+        Append::bytes(script, random, 20, random.next());
+        script.append("\x88\xac", 2);
+        break;
+    case 1:
+        script.append("\xa9\x14", 2);
+        Append::bytes(script, random, 20, random.next());
+        script.append('\x87');
+        break;
+    case 2: {
+        const int size = random.next() % 2 ? 33 : 65;
+        script.append(static_cast<char>(size));
+        Append::bytes(script, random, size, size == 33 ? 2 + random.next() % 2 : 4);
+        script.append('\xac');
+        break;
+    }
+    case 3: {
+        const int keys = 1 + random.next() % 16;
+        script.append(static_cast<char>(0x51 + random.next() % keys));
+        for (int i = 0; i < keys; ++i) {
+            const int size = random.next() % 4 ? 33 : 65;
+            script.append(static_cast<char>(size));
+            Append::bytes(script, random, size, size == 33 ? 2 + random.next() % 2 : 4);
+        }
+        script.append(static_cast<char>(0x50 + keys));
+        script.append('\xae');
+        break;
+    }
+    default: {
+        script.append('\x6a'); // OP_RETURN with pushes of all kinds
+        const int pushes = random.next() % 3;
+        for (int i = 0; i < pushes; ++i) {
+            const int size = random.next() % 100;
+            if (random.next() % 4 == 0) {
+                script.append(static_cast<char>(0x4c + random.next() % 3));
+                const int width = script.at(script.size() - 1) == 0x4c ? 1 : (script.at(script.size() - 1) == 0x4d ? 2 : 4);
+                for (int b = 0; b < width; ++b)
+                    script.append(static_cast<char>(size >> (b * 8)));
+            } else if (size < 76) {
+                script.append(static_cast<char>(size));
+            } else {
+                script.append(static_cast<char>(0x51 + size % 16)); // a number
+                continue;
+            }
+            for (int b = 0; b < size; ++b)
+                script.append(static_cast<char>(random.next()));
+        }
+        break;
+    }
+    }
+    return script;
+}
+
+void appendCompactSize(QByteArray &out, quint64 value)
+{
+    char buffer[9];
+    out.append(buffer, Streaming::writeBitcoinCompact(buffer, value));
+}
+
+void appendValue(QByteArray &out, quint64 value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out.append(static_cast<char>(value >> (i * 8)));
+}
+
+QByteArray doubleSha256(const QByteArray &data)
+{
+    return Sha256::doubleHash(data.constData(), data.size());
+}
+
+// the original signature hash as it was first written; serialize a modified copy of the transaction.
+QByteArray referenceLegacyHash(const TransactionView &tx, int inputIndex, const QByteArray &scriptCode, quint32 hashType)
+{
+    const int baseType = hashType & 0x1f;
+    if (baseType == SignatureHash::SigHashSingle && inputIndex >= tx.outputs().size()) {
+        QByteArray one(Sha256::HashSize, 0);
+        one[0] = 1;
+        return one;
+    }
+    QByteArray script;
+    ScriptTokenizer tokenizer(scriptCode);
+    int start = 0;
+    while (tokenizer.next() == ScriptTokenizer::FoundOpcode) {
+        if (tokenizer.opcode() == 0xab) {
+            script.append(scriptCode.mid(start, tokenizer.opcodeStart() - start));
+            start = tokenizer.consumed();
+        }
+    }
+    script.append(scriptCode.mid(start));
+
+    struct Input {
+        QByteArray outpoint, script;
+        quint32 sequence;
+    };
+    QList<Input> inputs;
+    for (int i = 0; i < tx.inputs().size(); ++i) {
+        Input input;
+        input.outpoint = tx.bytes(TransactionView::Range(tx.inputs().at(i).prevHash.offset, 36));
+        input.sequence = tx.inputs().at(i).sequence;
+        if (i == inputIndex)
+            input.script = script;
+        else if (baseType == SignatureHash::SigHashNone || baseType == SignatureHash::SigHashSingle)
+            input.sequence = 0;
+        inputs.append(input);
+    }
+    if (hashType & SignatureHash::SigHashAnyoneCanPay)
+        inputs = QList<Input>() << inputs.at(inputIndex);
+    QVector<TransactionView::Output> outputs;
+    if (baseType != SignatureHash::SigHashNone)
+        outputs = tx.outputs();
+    if (baseType == SignatureHash::SigHashSingle) {
+        outputs.resize(inputIndex + 1);
+        for (int i = 0; i < inputIndex; ++i) {
+            outputs[i].value = ~0ULL;
+            outputs[i].script = TransactionView::Range();
+        }
+    }
+
+    QByteArray copy = tx.bytes(TransactionView::Range(0, 4));
+    appendCompactSize(copy, inputs.size());
+    foreach (const Input &input, inputs) {
+        copy.append(input.outpoint);
+        appendCompactSize(copy, input.script.size());
+        copy.append(input.script);
+        appendValue(copy, input.sequence, 4);
+    }
+    appendCompactSize(copy, outputs.size());
+    foreach (const TransactionView::Output &output, outputs) {
+        appendValue(copy, output.value, 8);
+        appendCompactSize(copy, output.script.length);
+        copy.append(tx.bytes(output.script));
+    }
+    appendValue(copy, tx.lockTime(), 4);
+    appendValue(copy, hashType, 4);
+    return doubleSha256(copy);
+}
+
+// BIP143 as specified, recalculating everything for each input.
+QByteArray referenceBip143Hash(const TransactionView &tx, int inputIndex, const QByteArray &scriptCode,
+                               quint64 amount, quint32 hashType)
+{
+    const int baseType = hashType & 0x1f;
+    const bool anyoneCanPay = hashType & SignatureHash::SigHashAnyoneCanPay;
+    const bool single = baseType == SignatureHash::SigHashSingle;
+    const bool none = baseType == SignatureHash::SigHashNone;
+    QByteArray prevouts, sequences, outputs, singleOutput;
+    foreach (const TransactionView::Input &input, tx.inputs()) {
+        prevouts.append(tx.bytes(TransactionView::Range(input.prevHash.offset, 36)));
+        appendValue(sequences, input.sequence, 4);
+    }
+    for (int i = 0; i < tx.outputs().size(); ++i) {
+        QByteArray output;
+        appendValue(output, tx.outputs().at(i).value, 8);
+        appendCompactSize(output, tx.outputs().at(i).script.length);
+        output.append(tx.bytes(tx.outputs().at(i).script));
+        outputs.append(output);
+        if (i == inputIndex)
+            singleOutput = output;
+    }
+    const QByteArray zeros(Sha256::HashSize, 0);
+    const TransactionView::Input &input = tx.inputs().at(inputIndex);
+    QByteArray preimage = tx.bytes(TransactionView::Range(0, 4));
+    preimage.append(anyoneCanPay ? zeros : doubleSha256(prevouts));
+    preimage.append(anyoneCanPay || single || none ? zeros : doubleSha256(sequences));
+    preimage.append(tx.bytes(TransactionView::Range(input.prevHash.offset, 36)));
+    appendCompactSize(preimage, scriptCode.size());
+    preimage.append(scriptCode);
+    appendValue(preimage, amount, 8);
+    appendValue(preimage, input.sequence, 4);
+    if (!single && !none)
+        preimage.append(doubleSha256(outputs));
+    else if (single && inputIndex < tx.outputs().size())
+        preimage.append(doubleSha256(singleOutput));
+    else
+        preimage.append(zeros);
+    appendValue(preimage, tx.lockTime(), 4);
+    appendValue(preimage, hashType, 4);
+    return doubleSha256(preimage);
+}
+
+// a script push of @a data, as the shortest push opcode.
+void appendPush(QByteArray &script, const QByteArray &data)
+{
+    if (data.size() >= 0x4c)
+        script.append('\x4c'); // OP_PUSHDATA1
+    script.append(static_cast<char>(data.size()));
+    script.append(data);
+}
+
+QByteArray randomBytes(Random &random, int size)
+{
+    QByteArray answer(size, 0);
+    for (int i = 0; i < size; ++i)
+        answer.data()[i] = static_cast<char>(random.next());
+    return answer;
+}
+
+struct TestInput {
+    TestInput() : prevIndex(0) {}
+    QByteArray prevHash;
+    quint32 prevIndex;
+    QByteArray script;
+};
+
+struct TestOutput {
+    TestOutput() : value(0) {}
+    quint64 value;
+    QByteArray script;
+};
+
+QByteArray createLegacyTransaction(int version, const QList<TestInput> &inputs, const QList<TestOutput> &outputs)
+{
+    QByteArray tx;
+    appendValue(tx, version, 4);
+    appendCompactSize(tx, inputs.size());
+    foreach (const TestInput &input, inputs) {
+        tx.append(input.prevHash);
+        appendValue(tx, input.prevIndex, 4);
+        appendCompactSize(tx, input.script.size());
+        tx.append(input.script);
+        appendValue(tx, 0xFFFFFFFF, 4);
+    }
+    appendCompactSize(tx, outputs.size());
+    foreach (const TestOutput &output, outputs) {
+        appendValue(tx, output.value, 8);
+        appendCompactSize(tx, output.script.size());
+        tx.append(output.script);
+    }
+    appendValue(tx, 0, 4);
+    return tx;
+}
+
+// return the signature of @a digest with the hashtype byte appended.
+QByteArray signDigest(const char *digest, const QByteArray &secret, Random &random, quint32 hashType)
+{
+    const QByteArray nonce = randomBytes(random, 32);
+    QByteArray signature = Secp256k1::sign(digest, secret.constData(), nonce.constData());
+    signature.append(static_cast<char>(hashType));
+    return signature;
+}
+
+// pushes the numbers from start to end into a queue.
+class QueueProducer : public QRunnable
+{
+public:
+    QueueProducer(BoundedQueue<int> &queue, int start, int end) : m_queue(queue), m_start(start), m_end(end) {}
+    void run() {
+        for (int i = m_start; i < m_end; ++i)
+            m_queue.push(i);
+    }
+private:
+    BoundedQueue<int> &m_queue;
+    const int m_start, m_end;
+};
+
+// counts the numbers it pops from a queue, until the queue is closed.
+class QueueConsumer : public QRunnable
+{
+public:
+    QueueConsumer(BoundedQueue<int> &queue, QVector<int> &seen) : m_queue(queue), m_seen(seen) {}
+    void run() {
+        int value;
+        while (m_queue.pop(value))
+            ++m_seen[value];
+    }
+private:
+    BoundedQueue<int> &m_queue;
+    QVector<int> &m_seen;
+};
+
+// a record with a field of every CMFSchema value type, tags below, at and above the header limit.
+struct SchemaRecord {
+    SchemaRecord() : count(0), flag(false), wide(0) {}
+    QByteArray name;
+    quint64 count;
+    QString label;
+    bool flag;
+    int wide;
+};
+
+enum SchemaRecordTags {
+    RecordName = 1,
+    RecordCount = 5,
+    RecordLabel = 30,
+    RecordFlag = 31,
+    RecordWide = 200,
+    RecordUnknown = 7
+};
+
+typedef CMFSchema::Field<RecordName, CMF::ByteArray, SchemaRecord, QByteArray, &SchemaRecord::name> RecordNameField;
+typedef CMFSchema::Field<RecordCount, CMF::PositiveNumber, SchemaRecord, quint64, &SchemaRecord::count, CMFSchema::Optional> RecordCountField;
+typedef CMFSchema::Field<RecordLabel, CMF::String, SchemaRecord, QString, &SchemaRecord::label, CMFSchema::Optional> RecordLabelField;
+typedef CMFSchema::Field<RecordFlag, CMF::BoolTrue, SchemaRecord, bool, &SchemaRecord::flag> RecordFlagField;
+typedef CMFSchema::Field<RecordWide, CMF::PositiveNumber, SchemaRecord, int, &SchemaRecord::wide, CMFSchema::Optional> RecordWideField;
+typedef CMFSchema::Schema<SchemaRecord, CMFSchema::KeyStartsRecord, RecordNameField, RecordCountField,
+        RecordLabelField, RecordFlagField, RecordWideField> KeyedRecordSchema;
+typedef CMFSchema::Schema<SchemaRecord, CMFSchema::RepeatStartsRecord, RecordNameField, RecordCountField,
+        RecordLabelField, RecordFlagField, RecordWideField> RepeatedRecordSchema;
+
+// what the schema should write, with the plain MessageBuilder calls.
+void writeSchemaRecord(MessageBuilder &builder, const SchemaRecord &record)
+{
+    builder.add(RecordName, record.name);
+    if (record.count > 0)
+        builder.add(RecordCount, record.count);
+    if (!record.label.isEmpty())
+        builder.add(RecordLabel, record.label);
+    builder.add(RecordFlag, record.flag);
+    if (record.wide > 0)
+        builder.add(RecordWide, static_cast<quint64>(record.wide));
+}
+
+bool sameRecords(const QList<SchemaRecord> &a, const QList<SchemaRecord> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int i = 0; i < a.size(); ++i) {
+        if (a.at(i).name != b.at(i).name || a.at(i).count != b.at(i).count || a.at(i).label != b.at(i).label
+                || a.at(i).flag != b.at(i).flag || a.at(i).wide != b.at(i).wide)
+            return false;
+    }
+    return true;
+}
+
+// read the records of @a data with the ListReader of @a Schema, returns the number of fields that were not stored.
+template <typename Schema>
+int readSchemaRecords(const QByteArray &data, QList<SchemaRecord> &records, CMFSchema::ReadResult &lastResult)
+{
+    typename Schema::ListReader reader(records);
+    MessageParser parser(data);
+    int skipped = 0;
+    while (parser.next() == MessageParser::FoundTag) {
+        const CMFSchema::ReadResult result = reader.read(parser);
+        if (result != CMFSchema::Stored) {
+            lastResult = result;
+            ++skipped;
+        }
+    }
+    return skipped;
+}
+
+// turn @a legacy into the segwit serialization, with a random witness for each of its @a inputCount inputs.
+QByteArray addWitness(const QByteArray &legacy, int inputCount, Random &random)
+{
+    QByteArray tx = legacy.left(4);
+    tx.append('\0'); // marker
+    tx.append('\1'); // flag
+    tx.append(legacy.mid(4, legacy.size() - 8));
+    for (int i = 0; i < inputCount; ++i) {
+        const int count = random.next() % 3;
+        appendCompactSize(tx, count);
+        for (int j = 0; j < count; ++j) {
+            const QByteArray item = randomBytes(random, random.next() % 80);
+            appendCompactSize(tx, item.size());
+            tx.append(item);
+        }
+    }
+    tx.append(legacy.right(4));
+    return tx;
+}
+
+// append a block with its network magic and size, and @a count before the @a transactions.
+void appendBlock(QByteArray &blockFile, quint32 magic, quint64 count, const QByteArray &transactions)
+{
+    QByteArray block(80, 'h'); // the header isn't looked at
+    appendCompactSize(block, count);
+    block.append(transactions);
+    appendValue(blockFile, magic, 4);
+    appendValue(blockFile, block.size(), 4);
+    blockFile.append(block);
+}
+
+// walk @a contents with a BlockFileReader, the position of each transaction is its block * 1000 + its index.
+bool readBlockFile(const QByteArray &contents, QList<QByteArray> &transactions, QList<int> &positions, bool &error)
+{
+    QTemporaryFile file;
+    if (!file.open() || file.write(contents) != contents.size() || !file.flush())
+        return false;
+    BlockFileReader reader(file.fileName());
+    if (!reader.open())
+        return false;
+    while (reader.next()) {
+        transactions.append(QByteArray(reader.transactionData(), reader.transactionSize()));
+        positions.append(reader.blockIndex() * 1000 + reader.transactionIndex());
+    }
+    error = reader.error();
+    return true;
+}
+
+// append @a codePoint, below 0x10000, as utf8.
+void appendUtf8(QByteArray &out, int codePoint)
+{
+    if (codePoint < 0x80) {
+        out.append(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        out.append(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.append(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+QByteArray latin1ToUtf8(const QByteArray &latin1)
+{
+    QByteArray answer;
+    for (int i = 0; i < latin1.size(); ++i)
+        appendUtf8(answer, static_cast<quint8>(latin1.at(i)));
+    return answer;
+}
+
+QByteArray toHex(const char *data, int length, bool reversed = false)
+{
+    QByteArray bytes(data, length);
+    if (reversed) {
+        for (int i = 0; i < length; ++i)
+            bytes.data()[i] = data[length - 1 - i];
+    }
+    return bytes.toHex();
+}
+
+// a parsed JSON value, only the unsigned numbers, strings, arrays and objects StructuredWriter writes.
+struct JsonValue {
+    enum Type { Number, String, Array, Object };
+    JsonValue() : type(Number), number(0) {}
+
+    // return the member called @a key of an object, or 0.
+    const JsonValue *member(const char *key) const {
+        for (int i = 0; i < keys.size(); ++i) {
+            if (keys.at(i) == key)
+                return &items.at(i);
+        }
+        return 0;
+    }
+
+    Type type;
+    quint64 number;
+    QByteArray string; // decoded to utf8
+    QList<QByteArray> keys; // objects only, one for each item
+    QList<JsonValue> items;
+};
+
+bool isString(const JsonValue *value, const QByteArray &expected)
+{
+    return value && value->type == JsonValue::String && value->string == expected;
+}
+
+bool isNumber(const JsonValue *value, quint64 expected)
+{
+    return value && value->type == JsonValue::Number && value->number == expected;
+}
+
+// a strict, small JSON parser to read back what StructuredWriter wrote.
+class JsonReader
+{
+public:
+    JsonReader(const char *data, int size) : m_pos(data), m_end(data + size) {}
+
+    bool read(JsonValue &value) {
+        if (m_pos == m_end)
+            return false;
+        if (*m_pos == '"') {
+            value.type = JsonValue::String;
+            return readString(value.string);
+        }
+        if (*m_pos == '[' || *m_pos == '{') {
+            const bool object = *m_pos++ == '{';
+            const char close = object ? '}' : ']';
+            value.type = object ? JsonValue::Object : JsonValue::Array;
+            if (m_pos < m_end && *m_pos == close) {
+                ++m_pos;
+                return true;
+            }
+            while (true) {
+                if (object) {
+                    QByteArray key;
+                    if (!readString(key) || m_pos == m_end || *m_pos++ != ':')
+                        return false;
+                    value.keys.append(key);
+                }
+                JsonValue item;
+                if (!read(item))
+                    return false;
+                value.items.append(item);
+                if (m_pos == m_end)
+                    return false;
+                const char c = *m_pos++;
+                if (c == close)
+                    return true;
+                if (c != ',')
+                    return false;
+            }
+        }
+        value.type = JsonValue::Number;
+        const char *start = m_pos;
+        while (m_pos < m_end && *m_pos >= '0' && *m_pos <= '9')
+            value.number = value.number * 10 + (*m_pos++ - '0');
+        return m_pos > start;
+    }
+
+    inline bool atEnd() const {
+        return m_pos == m_end;
+    }
+
+private:
+    bool readString(QByteArray &string) {
+        if (m_pos == m_end || *m_pos++ != '"')
+            return false;
+        while (m_pos < m_end) {
+            const quint8 c = *m_pos++;
+            if (c == '"')
+                return true;
+            if (c < 0x20) // control characters have to be escaped
+                return false;
+            if (c != '\\') {
+                string.append(static_cast<char>(c));
+                continue;
+            }
+            if (m_pos == m_end)
+                return false;
+            const char escape = *m_pos++;
+            if (escape == 'u') {
+                if (m_end - m_pos < 4)
+                    return false;
+                int codePoint = 0;
+                for (int i = 0; i < 4; ++i) {
+                    const char digit = *m_pos++;
+                    codePoint <<= 4;
+                    if (digit >= '0' && digit <= '9')
+                        codePoint += digit - '0';
+                    else if (digit >= 'a' && digit <= 'f')
+                        codePoint += digit - 'a' + 10;
+                    else if (digit >= 'A' && digit <= 'F')
+                        codePoint += digit - 'A' + 10;
+                    else
+                        return false;
+                }
+                appendUtf8(string, codePoint);
+            } else if (escape == '"' || escape == '\\' || escape == '/') {
+                string.append(escape);
+            } else if (escape == 'n') {
+                string.append('\n');
+            } else if (escape == 'r') {
+                string.append('\r');
+            } else if (escape == 't') {
+                string.append('\t');
+            } else if (escape == 'b') {
+                string.append('\b');
+            } else if (escape == 'f') {
+                string.append('\f');
+            } else {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    const char *m_pos;
+    const char *m_end;
+};
+
+// compare a JSON line of StructuredWriter against the view, returns the first field that differs, or 0.
+const char *compareJson(const JsonValue &json, const TransactionView &view, const QByteArray &txid)
+{
+    const bool legacy = view.version() != 4;
+    const TransactionView::Range coinbase = view.coinbaseMessage();
+    if (json.type != JsonValue::Object || json.keys.size() != (coinbase.length > 0 ? 6 : 5))
+        return "object";
+    if (!isString(json.member("txid"), toHex(txid.constData(), txid.size(), true)))
+        return "txid";
+    const JsonValue *inputs = json.member("inputs");
+    if (!inputs || inputs->type != JsonValue::Array || inputs->items.size() != view.inputs().size())
+        return "inputs";
+    for (int i = 0; i < view.inputs().size(); ++i) {
+        const TransactionView::Input &input = view.inputs().at(i);
+        const JsonValue &in = inputs->items.at(i);
+        if (!isString(in.member("txid"), toHex(view.at(input.prevHash), input.prevHash.length, legacy)))
+            return "inputs.txid";
+        if (!isNumber(in.member("vout"), input.prevIndex))
+            return "inputs.vout";
+        if (!isNumber(in.member("sequence"), legacy ? input.sequence : 0xFFFFFFFF))
+            return "inputs.sequence";
+        const JsonValue *script = in.member("script");
+        if (!script || script->type != JsonValue::Array || script->items.size() != input.itemCount)
+            return "inputs.script";
+        for (int j = 0; j < input.itemCount; ++j) {
+            const TransactionView::Range &item = view.scriptItems().at(input.firstItem + j);
+            if (!isString(&script->items.at(j), toHex(view.at(item), item.length)))
+                return "inputs.script";
+        }
+    }
+    if (coinbase.length > 0 && !isString(json.member("coinbase-message"), latin1ToUtf8(view.bytes(coinbase))))
+        return "coinbase-message";
+    const JsonValue *outputs = json.member("outputs");
+    if (!outputs || outputs->type != JsonValue::Array || outputs->items.size() != view.outputs().size())
+        return "outputs";
+    for (int i = 0; i < view.outputs().size(); ++i) {
+        const TransactionView::Output &output = view.outputs().at(i);
+        if (!isNumber(outputs->items.at(i).member("amount"), output.value))
+            return "outputs.amount";
+        if (!isString(outputs->items.at(i).member("script"), toHex(view.at(output.script), output.script.length)))
+            return "outputs.script";
+    }
+    if (!isNumber(json.member("version"), view.version()))
+        return "version";
+    if (!isNumber(json.member("nLockTime"), view.lockTime()))
+        return "nLockTime";
+    return 0;
+}
+
+// reads the fields of a binary StructuredWriter record, comparing them as it goes.
+class RecordReader
+{
+public:
+    RecordReader(const char *data, int size) : m_data(data), m_size(size), m_offset(0) {}
+
+    bool bytes(const char *expected, int length, bool reversed = false) {
+        if (m_size - m_offset < length)
+            return false;
+        for (int i = 0; i < length; ++i) {
+            if (m_data[m_offset + i] != expected[reversed ? length - 1 - i : i])
+                return false;
+        }
+        m_offset += length;
+        return true;
+    }
+    bool value32(quint32 expected) {
+        if (m_size - m_offset < 4 || Streaming::fetch32bitValue(m_data, m_offset) != expected)
+            return false;
+        m_offset += 4;
+        return true;
+    }
+    bool value64(quint64 expected) {
+        if (m_size - m_offset < 8 || Streaming::fetch64bitValue(m_data, m_offset) != expected)
+            return false;
+        m_offset += 8;
+        return true;
+    }
+    bool compact(quint64 expected) {
+        quint64 value = 0;
+        return Streaming::fetchBitcoinCompact(m_data, m_size, m_offset, value) && value == expected;
+    }
+    // a compact-size length followed by that many bytes.
+    bool sizedBytes(const char *expected, int length) {
+        return compact(length) && bytes(expected, length);
+    }
+    inline bool atEnd() const {
+        return m_offset == m_size;
+    }
+
+private:
+    const char *m_data;
+    const qint64 m_size;
+    qint64 m_offset;
+};
+
+// compare a binary record of StructuredWriter, without its length, against the view.
+const char *compareRecord(const char *record, int size, const TransactionView &view, const QByteArray &txid)
+{
+    const bool legacy = view.version() != 4;
+    RecordReader reader(record, size);
+    if (!reader.bytes(txid.constData(), txid.size(), true))
+        return "txid";
+    if (!reader.value32(view.version()) || !reader.value32(view.lockTime()))
+        return "version";
+    if (!reader.compact(view.inputs().size()))
+        return "inputs";
+    for (int i = 0; i < view.inputs().size(); ++i) {
+        const TransactionView::Input &input = view.inputs().at(i);
+        if (!reader.bytes(view.at(input.prevHash), 32, legacy) || !reader.value32(input.prevIndex)
+                || !reader.value32(legacy ? input.sequence : 0xFFFFFFFF))
+            return "inputs.prevout";
+        if (!reader.compact(input.itemCount))
+            return "inputs.script";
+        for (int j = 0; j < input.itemCount; ++j) {
+            const TransactionView::Range &item = view.scriptItems().at(input.firstItem + j);
+            if (!reader.sizedBytes(view.at(item), item.length))
+                return "inputs.script";
+        }
+    }
+    if (!reader.sizedBytes(view.at(view.coinbaseMessage()), view.coinbaseMessage().length))
+        return "coinbase-message";
+    if (!reader.compact(view.outputs().size()))
+        return "outputs";
+    for (int i = 0; i < view.outputs().size(); ++i) {
+        const TransactionView::Output &output = view.outputs().at(i);
+        if (!reader.value64(output.value) || !reader.sizedBytes(view.at(output.script), output.script.length))
+            return "outputs";
+    }
+    return reader.atEnd() ? 0 : "length";
+}
+}
+
+bool SelfTest::cmfVarInts(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+
+    // the edges of each length and of the bit-widths.
+    for (int n = 1; n <= 10; ++n) {
+        quint64 start = 0;
+        quint64 power = 1;
+        for (int k = 1; k < n; ++k) {
+            power <<= 7;
+            start += power;
+        }
+        for (int delta = -2; delta <= 2; ++delta) {
+            if (!checkValue(start + delta, out))
+                ++failures;
+        }
+    }
+    for (int bit = 0; bit < 64; ++bit) {
+        const quint64 value = Q_UINT64_C(1) << bit;
+        if (!checkValue(value - 1, out) || !checkValue(value, out) || !checkValue(value + 1, out))
+            ++failures;
+    }
+    for (int i = 0; i < 1000000 && failures < 10; ++i) {
+        if (!checkValue(random.nextValue(), out))
+            ++failures;
+    }
+
+    // random bytes, which includes too-long and truncated varints.
+    char noise[16];
+    for (int i = 0; i < 1000000 && failures < 10; ++i) {
+        const quint64 a = random.next(), b = random.next();
+        memcpy(noise, &a, 8);
+        memcpy(noise + 8, &b, 8);
+        // bias towards continuation bits to get longer varints
+        const quint64 mask = random.next();
+        for (int j = 0; j < 8; ++j) {
+            if (mask & (1 << j))
+                noise[j] |= 0x80;
+        }
+        if (!compareUnserialize(noise, 1 + (mask >> 8) % 16, (mask >> 16) % 4, out))
+            ++failures;
+    }
+
+    // a stream with runs of single byte values between longer ones.
+    QVector<quint64> values;
+    QByteArray stream;
+    char buf[20];
+    for (int i = 0; i < 200000; ++i) {
+        const quint64 value = (random.next() % 8) ? random.next() % 128 : random.nextValue();
+        values.append(value);
+        stream.append(buf, CMF::serialize(buf, value));
+    }
+    for (int cut = 0; cut < 3 && failures < 10; ++cut) {
+        // cut = 1 and 2 chop bytes off the end to check that truncated data is detected.
+        const int size = stream.size() - cut;
+        int refPosition = 0, count = 0;
+        QVector<quint64> reference;
+        while (true) {
+            quint64 value = 0;
+            if (!CMF::unserialize(stream.constData(), size, refPosition, value))
+                break;
+            reference.append(value);
+        }
+        QVector<quint64> results(values.size());
+        int position = 0;
+        count = CMF::unserializeMany(stream.constData(), size, position, results.data(), results.size());
+        results.resize(count);
+        if (results != reference || position != refPosition) {
+            out << "unserializeMany differs, decoded " << count << " instead of " << reference.size() << endl;
+            ++failures;
+        }
+    }
+
+    out << "CMF varint kernels: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::messageParserChunks(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+    for (int i = 0; i < 20000 && failures < 10; ++i) {
+        QByteArray document = createDocument(random);
+        // cut one in eight short to check that a truncated document is detected.
+        if (document.size() > 1 && random.next() % 8 == 0)
+            document.chop(1 + random.next() % qMin(document.size() - 1, 10));
+
+        QList<Token> expected;
+        MessageParser whole(document.constData(), document.size());
+        MessageParser::Type type = whole.next();
+        while (type == MessageParser::FoundTag) {
+            expected.append(currentToken(whole));
+            type = whole.next();
+        }
+        const MessageParser::Type expectedEnd = type;
+
+        // feed the same document in chunks of random sizes, from a single byte up.
+        QList<Token> tokens;
+        MessageParser pushed;
+        int pos = 0;
+        while (true) {
+            type = pushed.next();
+            if (type == MessageParser::FoundTag) {
+                tokens.append(currentToken(pushed));
+            } else if (type == MessageParser::NeedMoreData) {
+                if (pos == document.size()) {
+                    pushed.finish();
+                } else {
+                    const int chunk = qMin<int>(document.size() - pos, 1 + random.next() % ((random.next() % 2) ? 4 : 64));
+                    pushed.feed(document.constData() + pos, chunk);
+                    pos += chunk;
+                }
+            } else {
+                break;
+            }
+        }
+        if (type != expectedEnd || tokens != expected) {
+            out << "MessageParser push mode differs for document " << i << endl;
+            ++failures;
+        }
+    }
+
+    // a peer claiming a 2GB bytearray in its first 6 bytes.
+    char hostile[6];
+    hostile[0] = (1 << 3) | CMF::ByteArray;
+    const int prefixSize = 1 + CMF::serialize(hostile + 1, 0x7FFFFFF0);
+    MessageParser limited;
+    limited.setMaxItemSize(100000);
+    limited.feed(hostile, prefixSize);
+    if (limited.next() != MessageParser::Error) {
+        out << "MessageParser push mode accepts an item beyond its maximum size" << endl;
+        ++failures;
+    }
+    // without a limit only the bytes that arrived are buffered, a truncated item is an error.
+    MessageParser unlimited;
+    const QByteArray payload(1000, 'x');
+    unlimited.feed(hostile, prefixSize);
+    MessageParser::Type hostileType = unlimited.next();
+    for (int i = 0; i < 3 && hostileType == MessageParser::NeedMoreData; ++i) {
+        unlimited.feed(payload);
+        hostileType = unlimited.next();
+    }
+    unlimited.finish();
+    if (hostileType != MessageParser::NeedMoreData || unlimited.next() != MessageParser::Error) {
+        out << "MessageParser push mode mishandles a truncated item with a huge length" << endl;
+        ++failures;
+    }
+    out << "MessageParser push mode: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::sha256(QTextStream &out)
+{
+    struct Vector {
+        const char *message;
+        const char *hash;
+    };
+    static const Vector vectors[] = {
+        { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" }
+    };
+    int failures = 0;
+    for (unsigned int i = 0; i < sizeof(vectors) / sizeof(Vector); ++i) {
+        if (Sha256::hash(vectors[i].message, strlen(vectors[i].message)).toHex() != vectors[i].hash) {
+            out << "Sha256 gives the wrong hash for test vector " << i << endl;
+            ++failures;
+        }
+    }
+
+    QList<Sha256::Implementation> implementations;
+    implementations << Sha256::Avx2 << Sha256::ShaNi;
+    Random random;
+    for (int i = 0; i < 2000 && failures < 10; ++i) {
+        // sizes around the block boundaries and the padding edge are the interesting ones.
+        const int count = 1 + random.next() % 20;
+        QList<QByteArray> messages;
+        QVector<const char*> data;
+        QVector<int> sizes;
+        for (int j = 0; j < count; ++j) {
+            QByteArray message(random.next() % ((random.next() % 4) ? 130 : 1000), 0);
+            for (int k = 0; k < message.size(); ++k)
+                message[k] = random.next();
+            messages.append(message);
+        }
+        for (int j = 0; j < count; ++j) {
+            data.append(messages.at(j).constData());
+            sizes.append(messages.at(j).size());
+        }
+        QByteArray expected(count * Sha256::HashSize, 0);
+        Sha256::doubleHashMany(count, data.constData(), sizes.constData(), expected.data(), Sha256::Portable);
+
+        foreach (Sha256::Implementation implementation, implementations) {
+            if (!Sha256::isSupported(implementation))
+                continue;
+            QByteArray hashes(count * Sha256::HashSize, 0);
+            Sha256::doubleHashMany(count, data.constData(), sizes.constData(), hashes.data(), implementation);
+            if (hashes != expected) {
+                out << "Sha256 " << Sha256::name(implementation) << " differs for batch " << i << endl;
+                ++failures;
+            }
+        }
+
+        // the streaming API, written in random pieces.
+        const QByteArray &message = messages.first();
+        Sha256 hasher;
+        int pos = 0;
+        while (pos < message.size()) {
+            const int size = qMin<int>(message.size() - pos, random.next() % 100);
+            hasher.write(message.constData() + pos, size);
+            pos += size;
+        }
+        char hash[Sha256::HashSize];
+        hasher.finalize(hash);
+        hasher.write(hash, Sha256::HashSize);
+        hasher.finalize(hash);
+        if (memcmp(hash, expected.constData(), Sha256::HashSize) != 0) {
+            out << "Sha256 streaming differs for batch " << i << endl;
+            ++failures;
+        }
+    }
+
+    // the txid of one transaction against the batch, and of a legacy one with witness data added.
+    TransactionGenerator generator(1357);
+    generator.setVersions(QList<int>() << 1 << 2 << 4);
+    TransactionView view;
+    QList<QByteArray> transactions;
+    for (int i = 0; i < 200; ++i) {
+        QByteArray tx;
+        generator.next(tx);
+        transactions.append(tx);
+        if (tx.at(0) <= 2 && view.parse(tx)) {
+            QByteArray witness = tx.left(4) + QByteArray::fromHex("0001") + tx.mid(4, tx.size() - 8);
+            for (int j = 0; j < view.inputs().size(); ++j)
+                witness += QByteArray::fromHex("0102") + randomBytes(random, 2);
+            transactions.append(witness + tx.right(4));
+        }
+    }
+    const QByteArray txids = Transaction::txids(transactions);
+    for (int i = 0; i < transactions.size() && failures < 10; ++i) {
+        const QByteArray txid = Transaction::txid(transactions.at(i));
+        const bool isWitness = transactions.at(i).at(4) == 0;
+        if (txid != txids.mid(i * Sha256::HashSize, Sha256::HashSize)
+                || (isWitness && txid != Transaction::txid(transactions.at(i - 1)))) {
+            out << "Transaction::txid gives the wrong hash for transaction " << i << endl;
+            ++failures;
+        }
+    }
+    out << "Sha256 (";
+    foreach (Sha256::Implementation implementation, implementations) {
+        if (Sha256::isSupported(implementation))
+            out << Sha256::name(implementation) << ' ';
+    }
+    out << "checked): " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::transactionBatch(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+    for (int i = 0; i < 2000 && failures < 10; ++i) {
+        QVector<quint64> values;
+        const int count = random.next() % 100;
+        // half the sets with values of real amounts, the others are big enough to overflow the sum.
+        for (int j = 0; j < count; ++j)
+            values.append(random.nextValue() >> (i % 2 ? 0 : 12));
+        // thresholds near the values, as well as ones beyond the sign bit.
+        const quint64 threshold = (random.next() % 2 && count > 0) ? values.at(random.next() % count) : random.nextValue();
+        quint64 sum = 0;
+        bool overflow = false;
+        int below = 0;
+        foreach (quint64 value, values) {
+            sum += value;
+            overflow = overflow || sum < value;
+            below += value < threshold;
+        }
+        bool kernelOverflow;
+        if (TransactionBatch::sum(values.constData(), count, &kernelOverflow) != sum || kernelOverflow != overflow
+                || TransactionBatch::countBelow(values.constData(), count, threshold) != below) {
+            out << "TransactionBatch value kernels differ for set " << i << endl;
+            ++failures;
+        }
+    }
+
+    // script prefix matching against a plain compare, with scripts made of a tiny alphabet to get matches.
+    for (int i = 0; i < 500 && failures < 10; ++i) {
+        QByteArray tx;
+        tx.append("\x01\x00\x00\x00\x00", 5); // version 1, no inputs
+        const int outputCount = 1 + random.next() % 50;
+        tx.append(static_cast<char>(outputCount));
+        QList<QByteArray> scripts;
+        for (int j = 0; j < outputCount; ++j) {
+            QByteArray script(random.next() % 20, 0);
+            for (int k = 0; k < script.size(); ++k)
+                script[k] = 'a' + random.next() % 2;
+            scripts.append(script);
+            tx.append(QByteArray(8, 0)); // value
+            tx.append(static_cast<char>(script.size()));
+            tx.append(script);
+        }
+        tx.append(QByteArray(4, 0)); // nLockTime
+        TransactionBatch batch;
+        if (!batch.append(tx)) {
+            out << "TransactionBatch failed to parse test transaction " << i << endl;
+            ++failures;
+            continue;
+        }
+        QByteArray prefix(random.next() % 12, 0);
+        for (int k = 0; k < prefix.size(); ++k)
+            prefix[k] = 'a' + random.next() % 2;
+        const int length = random.next() % 3 ? -1 : prefix.size() + random.next() % 4;
+        QVector<int> expected;
+        for (int j = 0; j < outputCount; ++j) {
+            if (scripts.at(j).startsWith(prefix) && (length < 0 || scripts.at(j).size() == length))
+                expected.append(j);
+        }
+        if (batch.findScriptPrefix(prefix.constData(), prefix.size(), length) != expected) {
+            out << "TransactionBatch script filter differs for transaction " << i << endl;
+            ++failures;
+        }
+    }
+    out << "TransactionBatch kernels: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::scriptTokenizer(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+    for (int i = 0; i < 5000 && failures < 10; ++i) {
+        // a script of random opcodes and pushes in all encodings, including non-minimal ones.
+        QByteArray script;
+        QList<quint8> opcodes;
+        QList<QByteArray> pushes;
+        QList<int> ends;
+        const int count = random.next() % 20;
+        for (int j = 0; j < count; ++j) {
+            quint8 opcode = random.next() % 256;
+            QByteArray data;
+            if (random.next() % 2) // favor the pushes
+                opcode = random.next() % 79;
+            script.append(static_cast<char>(opcode));
+            if (opcode > 0 && opcode < 76) {
+                data.resize(opcode);
+            } else if (opcode >= 76 && opcode <= 78) {
+                if (random.next() % 4) // empty pushes test the length at the very end of the script.
+                    data.resize(random.next() % ((random.next() % 8) ? 80 : 600));
+                const int width = opcode == 76 ? 1 : (opcode == 77 ? 2 : 4);
+                if (width == 1 && data.size() > 0xFF)
+                    data.resize(0xFF);
+                for (int b = 0; b < width; ++b)
+                    script.append(static_cast<char>(data.size() >> (b * 8)));
+            }
+            for (int b = 0; b < data.size(); ++b)
+                data[b] = random.next();
+            script.append(data);
+            opcodes.append(opcode);
+            pushes.append(data);
+            ends.append(script.size());
+        }
+
+        // cut the script at a random spot, tokens have to match up to the cut.
+        const int length = random.next() % 4 ? script.size() : random.next() % (script.size() + 1);
+        ScriptTokenizer tokenizer(script.constData(), length);
+        int index = 0;
+        bool ok = true;
+        ScriptTokenizer::Type type = tokenizer.next();
+        for (; type == ScriptTokenizer::FoundOpcode; type = tokenizer.next(), ++index) {
+            if (index >= count || ends.at(index) > length || tokenizer.opcode() != opcodes.at(index)
+                    || tokenizer.consumed() != ends.at(index)
+                    || (tokenizer.isPush() && tokenizer.pushData().toByteArray() != pushes.at(index))) {
+                ok = false;
+                break;
+            }
+        }
+        if (ok) {
+            // ending on a token boundary is the end of the script, in the middle of a push an error.
+            const int start = index == 0 ? 0 : ends.at(index - 1);
+            const bool boundary = index == count || start == length;
+            ok = type == (boundary ? ScriptTokenizer::EndOfScript : ScriptTokenizer::Error);
+        }
+        if (ok && length == script.size()) {
+            bool pushOnly = true;
+            foreach (quint8 opcode, opcodes)
+                pushOnly = pushOnly && opcode <= 78;
+            ok = ScriptTokenizer::isPushOnly(script.constData(), length) == pushOnly;
+        }
+        if (!ok) {
+            out << "ScriptTokenizer differs for script " << i << ": " << script.left(length).toHex() << endl;
+            ++failures;
+        }
+    }
+    out << "ScriptTokenizer: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::scriptClassifier(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+    for (int i = 0; i < 20000 && failures < 10; ++i) {
+        // standard scripts, half of them damaged a little to get close misses.
+        QByteArray script = createStandardScript(random);
+        if (random.next() % 2) {
+            switch (random.next() % 3) {
+            case 0: { // mostly hit the opcodes at the start and end of the templates.
+                const int edge = random.next() % 3;
+                int pos = random.next() % script.size();
+                if (random.next() % 2)
+                    pos = random.next() % 2 ? edge : script.size() - 1 - edge;
+                script[qBound(0, pos, script.size() - 1)] = random.next() % 4 ? random.next() : 0x51 + random.next() % 16;
+                break;
+            }
+            case 1:
+                script.truncate(random.next() % script.size());
+                break;
+            default:
+                script.insert(static_cast<int>(random.next() % (script.size() + 1)), static_cast<char>(random.next()));
+                break;
+            }
+        }
+        ScriptClassifier::Payload expected, payload;
+        const ScriptClassifier::ScriptType expectedType = referenceClassify(script, expected);
+        const ScriptClassifier::ScriptType type = ScriptClassifier::classify(script, &payload);
+        bool ok = type == expectedType && (type == ScriptClassifier::NonStandard || (sameBytes(payload.data, expected.data)
+                && payload.required == expected.required && payload.keyCount == expected.keyCount));
+        for (int k = 0; ok && k < expected.keyCount; ++k)
+            ok = sameBytes(payload.keys[k], expected.keys[k]);
+        if (!ok) {
+            out << "ScriptClassifier says " << ScriptClassifier::name(type) << ", expected "
+                << ScriptClassifier::name(expectedType) << " for " << script.toHex() << endl;
+            ++failures;
+        }
+    }
+    out << "ScriptClassifier: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::signatureHash(QTextStream &out)
+{
+    int failures = 0;
+    // the native P2WPKH example of BIP143, SigHashForkId uses the same algorithm.
+    const QByteArray example = QByteArray::fromHex("0100000002fff7f7881a8099afa6940d42d1e7f6362bec38171ea3edf433541db4e4ad969f"
+            "0000000000eeffffffef51e1b804cc89d182d279655c3aa89e815b1b309fe287d9b2b55d57b90ec68a0100000000ffffffff"
+            "02202cb206000000001976a9148280b37df378db99f66f85c95a783a76ac7a6d5988ac9093510d000000001976a9143bde"
+            "42dbee7e4dbe6a21b2d50ce2f0167faa815988ac11000000");
+    const QByteArray exampleScript = QByteArray::fromHex("76a9141d0f172a0ecb48aee1be1f2687d2963ae33f71a188ac");
+    TransactionView view;
+    SignatureHash hasher;
+    char digest[Sha256::HashSize];
+    if (!view.parse(example) || !hasher.setTransaction(view)
+            || !hasher.bip143Hash(1, exampleScript.constData(), exampleScript.size(), 600000000, SignatureHash::SigHashAll, digest)
+            || QByteArray(digest, Sha256::HashSize).toHex() != "c37af31116d1b27caf68aae9e3ac82f1477929014d5b917657d0eb49478cb670") {
+        out << "SignatureHash gives the wrong hash for the BIP143 example" << endl;
+        ++failures;
+    }
+
+    Random random;
+    TransactionGenerator generator(1234);
+    generator.setVersions(QList<int>() << 1 << 2);
+    generator.setInputCounts(TransactionGenerator::Distribution::geometric(4, 40));
+    generator.setOutputCounts(TransactionGenerator::Distribution::uniform(1, 6));
+    for (int i = 0; i < 1000 && failures < 10; ++i) {
+        QByteArray tx;
+        generator.next(tx);
+        if (!view.parse(tx)) {
+            out << "SignatureHash test transaction " << i << " does not parse" << endl;
+            ++failures;
+            continue;
+        }
+        // the generator only creates final sequences and no lock time, give them some variety.
+        for (int j = 0; j < view.inputs().size(); ++j) {
+            const TransactionView::Range &script = view.inputs().at(j).script;
+            if (random.next() % 2)
+                Streaming::write32bitValue(tx.data() + script.offset + script.length, random.next());
+        }
+        Streaming::write32bitValue(tx.data() + tx.size() - 4, random.next() % 2 ? random.next() : 0);
+        if (!view.parse(tx) || !hasher.setTransaction(view)) {
+            out << "SignatureHash does not accept test transaction " << i << endl;
+            ++failures;
+            continue;
+        }
+
+        // hash the inputs in order, which continues the cached prefix, or in random order.
+        const int inputCount = view.inputs().size();
+        const bool inOrder = random.next() % 2;
+        for (int j = 0; j < inputCount && failures < 10; ++j) {
+            const int inputIndex = inOrder ? j : random.next() % inputCount;
+            QByteArray scriptCode = createStandardScript(random);
+            for (int k = random.next() % 4; k > 0; --k) // OP_CODESEPARATORs, or bytes of pushed data.
+                scriptCode.insert(static_cast<int>(random.next() % (scriptCode.size() + 1)), '\xab');
+            if (random.next() % 8 == 0)
+                scriptCode.truncate(random.next() % (scriptCode.size() + 1));
+            static const quint32 baseTypes[] = { 0, 1, 1, 2, 3, 3, 4 };
+            quint32 hashType = random.next() % 8 ? baseTypes[random.next() % 7] : random.next() % 0x20;
+            if (random.next() % 4 == 0)
+                hashType |= SignatureHash::SigHashAnyoneCanPay;
+            if (random.next() % 2)
+                hashType |= SignatureHash::SigHashForkId;
+            if (random.next() % 8 == 0)
+                hashType |= random.next() << 8;
+            const quint64 amount = random.nextValue();
+
+            const QByteArray result = hasher.hash(inputIndex, scriptCode, amount, hashType);
+            const QByteArray expected = (hashType & SignatureHash::SigHashForkId)
+                    ? referenceBip143Hash(view, inputIndex, scriptCode, amount, hashType)
+                    : referenceLegacyHash(view, inputIndex, scriptCode, hashType);
+            if (result != expected) {
+                out << "SignatureHash differs for input " << inputIndex << " of transaction " << i
+                    << " with type " << hashType << ": " << tx.toHex() << endl;
+                ++failures;
+            }
+        }
+        if (!hasher.hash(inputCount, QByteArray(), 0, SignatureHash::SigHashAll).isEmpty()) {
+            out << "SignatureHash hashes a non-existing input" << endl;
+            ++failures;
+        }
+    }
+    out << "SignatureHash: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::secp256k1(QTextStream &out)
+{
+    struct Vector {
+        const char *message;
+        const char *hash;
+    };
+    static const Vector vectors[] = {
+        { "", "9c1185a5c5e9fc54612808977ee8f548b2258d31" },
+        { "abc", "8eb208f7e05d987a9b044a8e98c6b087f15a0bfc" },
+        { "message digest", "5d0689ef49d2fae572b881b123a85ffa21595f36" }
+    };
+    int failures = 0;
+    for (unsigned int i = 0; i < sizeof(vectors) / sizeof(Vector); ++i) {
+        if (Ripemd160::hash(vectors[i].message, strlen(vectors[i].message)).toHex() != vectors[i].hash) {
+            out << "Ripemd160 gives the wrong hash for test vector " << i << endl;
+            ++failures;
+        }
+    }
+
+    // the first payment between two people, in block 170, spends a P2PK output of block 9.
+    const QByteArray block170 = QByteArray::fromHex("0100000001c997a5e56e104102fa209c6a852dd90660a20b2d9c352423edce25857fcd3704"
+            "000000004847304402204e45e16932b8af514961a1d3a1a25fdf3f4f7732e9d624c6c61548ab5fb8cd410220181522ec8eca07de48"
+            "60a4acdd12909d831cc56cbbac4622082221a8768d1d0901ffffffff0200ca9a3b00000000434104ae1a62fe09c5f51b13905f07f06b"
+            "99a2f7159b2225f374cd378d71302fa28414e7aab37397f554a7df5f142c21c1b7303b8a0626f1baded5c72a704f7e6cd84cac00286b"
+            "ee0000000043410411db93e1dcdb8a016b49840f8c53bc1eb68a382e97b1482ecad7b148a6909a5cb2e0eaddfb84ccf9744464f82e16"
+            "0bfa9b8b64f9d4c03f999b8643f656b412a3ac00000000");
+    const QByteArray block9Script = QByteArray::fromHex("410411db93e1dcdb8a016b49840f8c53bc1eb68a382e97b1482ecad7b148a6909a5c"
+            "b2e0eaddfb84ccf9744464f82e160bfa9b8b64f9d4c03f999b8643f656b412a3ac");
+    TransactionView view;
+    SignatureHash hasher;
+    char digest[Sha256::HashSize];
+    Secp256k1::PublicKey key;
+    Secp256k1::Signature signature;
+    bool verified = view.parse(block170) && hasher.setTransaction(view)
+            && hasher.hash(0, block9Script.constData(), block9Script.size(), 0, SignatureHash::SigHashAll, digest)
+            && QByteArray(digest, Sha256::HashSize).toHex() == "7a05c6145f10101e9d6325494245adf1297d80f8f38d4d576d57cdba220bcb19"
+            && Secp256k1::parsePublicKey(block9Script.constData() + 1, 65, key);
+    if (verified) {
+        const TransactionView::Range &item = view.scriptItems().at(view.inputs().first().firstItem);
+        verified = Secp256k1::parseSignature(view.at(item), item.length - 1, signature)
+                && Secp256k1::verify(digest, signature, key);
+        digest[Sha256::HashSize - 1] ^= 1;
+        verified = verified && !Secp256k1::verify(digest, signature, key);
+    }
+    if (!verified) {
+        out << "Secp256k1 does not verify the signature of block 170" << endl;
+        ++failures;
+    }
+
+    // sign random hashes, verify them one by one and again after preparing them as one batch.
+    Random random;
+    QVector<Secp256k1::Signature> batch;
+    QVector<Secp256k1::PublicKey> keys;
+    QList<QByteArray> hashes;
+    QByteArray der;
+    for (int i = 0; i < 100 && failures < 10; ++i) {
+        const QByteArray secret = randomBytes(random, 32);
+        const QByteArray publicKey = Secp256k1::createPublicKey(secret.constData(), random.next() % 2);
+        const QByteArray hash = randomBytes(random, 32);
+        der = Secp256k1::sign(hash.constData(), secret.constData(), randomBytes(random, 32).constData());
+        if (!Secp256k1::parsePublicKey(publicKey.constData(), publicKey.size(), key)
+                || !Secp256k1::parseSignature(der.constData(), der.size(), signature)
+                || !Secp256k1::verify(hash.constData(), signature, key)) {
+            out << "Secp256k1 does not verify its own signature " << i << endl;
+            ++failures;
+            continue;
+        }
+        QByteArray otherHash = hash;
+        otherHash.data()[random.next() % 32] ^= 1 << (random.next() % 8);
+        QByteArray modified = der;
+        modified.data()[4 + random.next() % (der.size() - 4)] ^= 1 << (random.next() % 8);
+        Secp256k1::Signature modifiedSignature;
+        if (Secp256k1::verify(otherHash.constData(), signature, key)
+                || (Secp256k1::parseSignature(modified.constData(), modified.size(), modifiedSignature)
+                    && Secp256k1::verify(hash.constData(), modifiedSignature, key))) {
+            out << "Secp256k1 accepts a modified signature " << i << endl;
+            ++failures;
+        }
+        batch.append(signature);
+        keys.append(key);
+        hashes.append(hash);
+    }
+    Secp256k1::prepare(batch.data(), batch.size());
+    for (int i = 0; i < batch.size(); ++i) {
+        if (!Secp256k1::verify(hashes.at(i).constData(), batch.at(i), keys.at(i))) {
+            out << "Secp256k1 does not verify prepared signature " << i << endl;
+            ++failures;
+        }
+    }
+
+    // the chain accepted non-minimal encodings before BIP66, the last signature in a few of those.
+    const QByteArray hash = hashes.last();
+    const int rLength = der.at(3);
+    const QByteArray r = der.mid(4, rLength);
+    const QByteArray s = der.mid(6 + rLength);
+    struct Encoding {
+        QByteArray der;
+        bool valid;
+    };
+    const Encoding encodings[] = {
+        { der + QByteArray(3, '\0'), true },
+        { QByteArray::fromHex("3081") + der.mid(1), true },
+        { "\x30" + QByteArray(1, der.size()) + "\x02" + QByteArray(1, rLength + 2) + QByteArray(2, '\0') + r
+            + QByteArray::fromHex("028200") + QByteArray(1, s.size()) + s, true },
+        { der.left(der.size() - 1), false },
+        { QByteArray::fromHex("3006020100") + der.mid(4 + rLength), false },
+        { der.left(4 + rLength) + QByteArray::fromHex("022100fffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364141"), false }
+    };
+    for (unsigned int i = 0; i < sizeof(encodings) / sizeof(Encoding); ++i) {
+        const QByteArray &encoded = encodings[i].der;
+        const bool valid = Secp256k1::parseSignature(encoded.constData(), encoded.size(), signature)
+                && Secp256k1::verify(hash.constData(), signature, keys.last());
+        if (valid != encodings[i].valid) {
+            out << "Secp256k1 handles the encoding " << encoded.toHex() << " wrong" << endl;
+            ++failures;
+        }
+    }
+    out << "Secp256k1: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::signatureVerifier(QTextStream &out)
+{
+    Random random;
+    QList<QByteArray> secrets;
+    QList<QByteArray> publicKeys;
+    for (int i = 0; i < 5; ++i) {
+        secrets.append(randomBytes(random, 32));
+        publicKeys.append(Secp256k1::createPublicKey(secrets.last().constData(), i != 1));
+    }
+    char hash160[Ripemd160::HashSize];
+    Ripemd160::hash160(publicKeys.at(0).constData(), publicKeys.at(0).size(), hash160);
+    const QByteArray payToPubKeyHash = QByteArray::fromHex("76a914") + QByteArray(hash160, Ripemd160::HashSize)
+            + QByteArray::fromHex("88ac");
+    QByteArray payToPubKey;
+    appendPush(payToPubKey, publicKeys.at(1));
+    payToPubKey.append('\xac');
+    QByteArray redeemScript("\x52"); // 2 of 3
+    for (int i = 2; i < 5; ++i)
+        appendPush(redeemScript, publicKeys.at(i));
+    redeemScript.append("\x53\xae");
+    Ripemd160::hash160(redeemScript.constData(), redeemScript.size(), hash160);
+    const QByteArray payToScriptHash = QByteArray::fromHex("a914") + QByteArray(hash160, Ripemd160::HashSize)
+            + QByteArray::fromHex("87");
+    QByteArray otherRedeemScript("\x51"); // 1 of 1, not the one payToScriptHash pays to
+    appendPush(otherRedeemScript, publicKeys.at(3));
+    otherRedeemScript.append("\x51\xae");
+
+    // two pairs of a coinbase and a transaction spending its outputs, the second is modified after signing.
+    QByteArray corpus;
+    for (int pair = 0; pair < 2; ++pair) {
+        QList<TestInput> inputs;
+        TestInput coinbase;
+        coinbase.prevHash = QByteArray(Sha256::HashSize, 0);
+        coinbase.prevIndex = 0xFFFFFFFF;
+        coinbase.script = randomBytes(random, 8);
+        inputs.append(coinbase);
+        QList<TestOutput> outputs;
+        const QByteArray scripts[] = { payToPubKeyHash, payToPubKey, payToScriptHash, payToPubKeyHash,
+                                       payToPubKeyHash, payToScriptHash };
+        for (int i = 0; i < 6; ++i) {
+            TestOutput output;
+            output.value = 50000 + random.next() % 50000;
+            output.script = scripts[i];
+            outputs.append(output);
+        }
+        const QByteArray funding = createLegacyTransaction(1, inputs, outputs);
+        const QByteArray fundingId = doubleSha256(funding);
+
+        // P2PKH, P2PK, P2SH multisig, P2PKH with ForkId and an output without outputs to match,
+        // ForkId spending an output that isn't known, a script that isn't push-only, P2PKH signed
+        // by another key, P2SH with another redeem script and P2PKH spending an output that isn't known.
+        const int fundingIndex[] = { 0, 1, 2, 3, -1, -1, 4, 5, -1 };
+        inputs.clear();
+        for (int i = 0; i < 9; ++i) {
+            TestInput input;
+            input.prevHash = fundingIndex[i] >= 0 ? fundingId : randomBytes(random, 32);
+            input.prevIndex = qMax(fundingIndex[i], 0);
+            inputs.append(input);
+        }
+        QList<TestOutput> spendOutputs;
+        for (int i = 0; i < 2; ++i) {
+            TestOutput output;
+            output.value = 10000;
+            output.script = payToPubKeyHash;
+            spendOutputs.append(output);
+        }
+        QByteArray tx = createLegacyTransaction(2, inputs, spendOutputs);
+        TransactionView view;
+        SignatureHash hasher;
+        char digest[Sha256::HashSize];
+        if (!view.parse(tx) || !hasher.setTransaction(view)) {
+            out << "SignatureVerifier test transaction does not parse" << endl;
+            return false;
+        }
+        const quint32 forkIdAll = SignatureHash::SigHashForkId | SignatureHash::SigHashAll;
+        hasher.hash(0, payToPubKeyHash.constData(), payToPubKeyHash.size(), 0, SignatureHash::SigHashAll, digest);
+        appendPush(inputs[0].script, signDigest(digest, secrets.at(0), random, SignatureHash::SigHashAll));
+        appendPush(inputs[0].script, publicKeys.at(0));
+        const quint32 anyoneCanPay = SignatureHash::SigHashAll | SignatureHash::SigHashAnyoneCanPay;
+        hasher.hash(1, payToPubKey.constData(), payToPubKey.size(), 0, anyoneCanPay, digest);
+        appendPush(inputs[1].script, signDigest(digest, secrets.at(1), random, anyoneCanPay));
+        inputs[2].script.append('\0');
+        hasher.hash(2, redeemScript.constData(), redeemScript.size(), outputs.at(2).value, forkIdAll, digest);
+        appendPush(inputs[2].script, signDigest(digest, secrets.at(2), random, forkIdAll));
+        appendPush(inputs[2].script, signDigest(digest, secrets.at(4), random, forkIdAll));
+        appendPush(inputs[2].script, redeemScript);
+        const quint32 forkIdSingle = SignatureHash::SigHashForkId | SignatureHash::SigHashSingle;
+        hasher.hash(3, payToPubKeyHash.constData(), payToPubKeyHash.size(), outputs.at(3).value, forkIdSingle, digest);
+        appendPush(inputs[3].script, signDigest(digest, secrets.at(0), random, forkIdSingle));
+        appendPush(inputs[3].script, publicKeys.at(0));
+        inputs[4].script = inputs[3].script;
+        inputs[5].script = QByteArray::fromHex("5176");
+        hasher.hash(6, payToPubKeyHash.constData(), payToPubKeyHash.size(), 0, SignatureHash::SigHashAll, digest);
+        appendPush(inputs[6].script, signDigest(digest, secrets.at(2), random, SignatureHash::SigHashAll));
+        appendPush(inputs[6].script, publicKeys.at(2));
+        inputs[7].script.append('\0');
+        hasher.hash(7, otherRedeemScript.constData(), otherRedeemScript.size(), 0, SignatureHash::SigHashAll, digest);
+        appendPush(inputs[7].script, signDigest(digest, secrets.at(3), random, SignatureHash::SigHashAll));
+        appendPush(inputs[7].script, otherRedeemScript);
+        hasher.hash(8, payToPubKeyHash.constData(), payToPubKeyHash.size(), 0, SignatureHash::SigHashAll, digest);
+        appendPush(inputs[8].script, signDigest(digest, secrets.at(0), random, SignatureHash::SigHashAll));
+        appendPush(inputs[8].script, publicKeys.at(0));
+        if (pair == 1)
+            spendOutputs[1].value = 10001;
+        tx = createLegacyTransaction(2, inputs, spendOutputs);
+        corpus += funding.toHex() + "\n" + tx.toHex() + "\n";
+    }
+
+    const QByteArray expected = "tx,input,result\n"
+            "1,0,valid\n1,1,valid\n1,2,valid\n1,3,valid\n1,4,missing-amount\n1,5,unsupported\n"
+            "1,6,invalid\n1,7,invalid\n1,8,unchecked\n"
+            "3,0,invalid\n3,1,invalid\n3,2,invalid\n3,3,valid\n3,4,missing-amount\n3,5,unsupported\n"
+            "3,6,invalid\n3,7,invalid\n3,8,invalid\n";
+    QTemporaryFile file;
+    if (!file.open() || file.write(corpus) != corpus.size() || !file.flush()) {
+        out << "SignatureVerifier can't write its test corpus" << endl;
+        return false;
+    }
+    int failures = 0;
+    for (int threads = 1; threads <= 3; threads += 2) {
+        CorpusReader reader(file.fileName());
+        QByteArray results;
+        QBuffer buffer(&results);
+        buffer.open(QIODevice::WriteOnly);
+        SignatureVerifier verifier;
+        verifier.setThreadCount(threads);
+        verifier.setResultsDevice(&buffer);
+        if (!reader.open() || verifier.verify(reader) || results != expected
+                || verifier.statistics().coinbases != 2 || verifier.statistics().signatures != 12) {
+            out << "SignatureVerifier gives the wrong results with " << threads << " threads:\n" << results << endl;
+            ++failures;
+        }
+    }
+    out << "SignatureVerifier: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::utxoIndex(QTextStream &out)
+{
+    struct Expected {
+        quint64 value;
+        QByteArray script;
+    };
+    Random random;
+    UtxoIndex index;
+    QHash<QByteArray, Expected> reference;
+    QList<QByteArray> outpoints; // the keys of reference, to pick from
+    int failures = 0;
+    // grow to 200000 outputs and spend most of them again, which compacts the scripts a couple of times.
+    for (int round = 0; round < 400000 && failures < 10; ++round) {
+        const bool growing = round < 200000;
+        if (outpoints.isEmpty() || random.next() % 8 < (growing ? 6u : 1u)) {
+            const QByteArray txid = randomBytes(random, 32);
+            const int outputIndex = random.next() % 4 ? random.next() % 4 : random.next();
+            Expected output;
+            output.value = random.nextValue();
+            const int size = random.next() % 1000 == 0 ? UtxoIndex::MaxScriptSize + 1 : random.next() % 100;
+            output.script = randomBytes(random, size);
+            index.insert(txid.constData(), outputIndex, output.value, output.script.constData(), output.script.size());
+            if (size > UtxoIndex::MaxScriptSize)
+                output.script.clear();
+            QByteArray outpoint = txid;
+            appendValue(outpoint, outputIndex, 4);
+            reference.insert(outpoint, output);
+            outpoints.append(outpoint);
+        } else {
+            const int pick = random.next() % outpoints.size();
+            const QByteArray outpoint = outpoints.at(pick);
+            outpoints[pick] = outpoints.last();
+            outpoints.removeLast();
+            const Expected expected = reference.take(outpoint);
+            UtxoIndex::Output output;
+            const int outputIndex = Streaming::fetch32bitValue(outpoint.constData(), 32);
+            if (!index.spend(outpoint.constData(), outputIndex, &output)
+                    || output.value != expected.value || output.script != expected.script) {
+                out << "UtxoIndex returns the wrong output in round " << round << endl;
+                ++failures;
+            }
+            if (index.spend(outpoint.constData(), outputIndex)) {
+                out << "UtxoIndex spends an output twice in round " << round << endl;
+                ++failures;
+            }
+        }
+        if (index.size() != reference.size()) {
+            out << "UtxoIndex has " << index.size() << " outputs instead of " << reference.size() << endl;
+            ++failures;
+            break;
+        }
+    }
+    UtxoIndex values(UtxoIndex::ValuesOnly);
+    const QByteArray txid = randomBytes(random, 32);
+    values.insert(txid.constData(), 1, 5000, "\x51", 1);
+    UtxoIndex::Output output;
+    if (values.spend(txid.constData(), 0) || !values.spend(txid.constData(), 1, &output)
+            || output.value != 5000 || !output.script.isEmpty() || values.size() != 0) {
+        out << "UtxoIndex without scripts returns the wrong output" << endl;
+        ++failures;
+    }
+    out << "UtxoIndex: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::transactionArchive(QTextStream &out)
+{
+    Random random;
+    TransactionGenerator generator(4321);
+    generator.setVersions(QList<int>() << 4);
+    QHash<QByteArray, QByteArray> transactions;
+    QList<QByteArray> txids;
+    QTemporaryFile file;
+    if (!file.open()) {
+        out << "TransactionArchive can't create its test file" << endl;
+        return false;
+    }
+    // small runs to exercise spilling and merging them, runs longer than the merge reads at a time,
+    // and some txids sharing the 8 bytes the index is sorted by.
+    ArchiveWriter writer(&file, 1500);
+    for (int i = 0; i < 5000; ++i) {
+        QByteArray txid = randomBytes(random, 32);
+        if (i > 0 && random.next() % 10 == 0)
+            memcpy(txid.data(), txids.at(random.next() % txids.size()).constData(), 8);
+        QByteArray tx;
+        generator.next(tx);
+        writer.append(txid.constData(), tx.constData(), tx.size());
+        transactions.insert(txid, tx);
+        txids.append(txid);
+    }
+    int failures = 0;
+    if (!writer.finish() || writer.count() != txids.size() || !file.flush()) {
+        out << "ArchiveWriter fails to write the test archive" << endl;
+        return false;
+    }
+
+    TransactionArchive archive;
+    if (!archive.open(file.fileName()) || archive.count() != txids.size()) {
+        out << "TransactionArchive fails to open the test archive" << endl;
+        return false;
+    }
+    for (int i = 0; i < txids.size() && failures < 10; ++i) {
+        const ConstBytes found = archive.find(txids.at(i).constData());
+        if (QByteArray(found.data, found.size) != transactions.value(txids.at(i))) {
+            out << "TransactionArchive returns the wrong transaction for txid " << i << endl;
+            ++failures;
+            continue;
+        }
+        MessageParser parser(found.data + 4, found.size - 4); // skip the version
+        MessageParser::Type type;
+        while ((type = parser.next()) == MessageParser::FoundTag);
+        if (type != MessageParser::EndOfDocument) {
+            out << "TransactionArchive transaction " << i << " does not parse" << endl;
+            ++failures;
+        }
+    }
+    for (int i = 0; i < 1000 && failures < 10; ++i) {
+        QByteArray txid = txids.at(random.next() % txids.size());
+        const int changed = 8 + random.next() % 24; // same key, other txid
+        txid[changed] = txid.at(changed) ^ 1;
+        if (i % 2)
+            txid = randomBytes(random, 32);
+        if (!transactions.contains(txid) && archive.find(txid.constData()).size != 0) {
+            out << "TransactionArchive finds a txid it doesn't have" << endl;
+            ++failures;
+        }
+    }
+    QByteArray previous;
+    for (qint64 i = 0; i < archive.count() && failures < 10; ++i) {
+        const char *txid = 0;
+        const ConstBytes tx = archive.at(i, &txid);
+        const QByteArray key(txid, 32);
+        if (memcmp(previous.constData(), key.constData(), qMin(previous.size(), 8)) > 0
+                || QByteArray(tx.data, tx.size) != transactions.value(key)) {
+            out << "TransactionArchive returns the wrong transaction at " << i << endl;
+            ++failures;
+        }
+        previous = key;
+    }
+    archive.close();
+
+    // an empty archive, and a truncated one.
+    QTemporaryFile empty;
+    empty.open();
+    ArchiveWriter emptyWriter(&empty);
+    if (!emptyWriter.finish() || !empty.flush() || !archive.open(empty.fileName())
+            || archive.count() != 0 || archive.find(txids.first().constData()).size != 0) {
+        out << "TransactionArchive fails on an empty archive" << endl;
+        ++failures;
+    }
+    archive.close();
+    file.resize(file.size() - 1);
+    if (archive.open(file.fileName())) {
+        out << "TransactionArchive opens a truncated archive" << endl;
+        ++failures;
+    }
+    out << "TransactionArchive: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::columnarArchive(QTextStream &out)
+{
+    Random random;
+    TransactionGenerator generator(5678);
+    generator.setVersions(QList<int>() << 1 << 2 << 4);
+    generator.setInputCounts(TransactionGenerator::Distribution::geometric(3, 30));
+    generator.setOutputCounts(TransactionGenerator::Distribution::uniform(1, 8));
+    QList<QByteArray> transactions;
+    TransactionView view;
+    int expectedRaw = 0;
+    quint64 expectedTotal = 0;
+    for (int i = 0; i < 3000; ++i) {
+        QByteArray tx;
+        generator.next(tx);
+        if (!view.parse(tx))
+            return false;
+        if (view.version() == 4) {
+            ++expectedRaw;
+        } else {
+            // give the fields that are always the same some variety.
+            for (int j = 0; j < view.inputs().size(); ++j) {
+                const TransactionView::Input &input = view.inputs().at(j);
+                if (random.next() % 4 == 0)
+                    Streaming::write32bitValue(tx.data() + input.prevHash.offset + 32, random.next() % 2 ? -1 : random.next());
+                if (random.next() % 4 == 0)
+                    Streaming::write32bitValue(tx.data() + input.script.offset + input.script.length, random.next());
+            }
+            Streaming::write32bitValue(tx.data() + tx.size() - 4, random.next() % 2 ? random.next() : 0);
+            view.parse(tx);
+        }
+        foreach (const TransactionView::Output &output, view.outputs())
+            expectedTotal += output.value;
+        if (i % 500 == 1 && view.version() != 4) {
+            // a non-minimal input count and a truncated transaction are kept as they are.
+            QByteArray longCount = tx.left(4);
+            longCount += QByteArray::fromHex("fd");
+            longCount += tx.at(4);
+            longCount += QByteArray::fromHex("00");
+            longCount += tx.mid(5);
+            transactions.append(longCount);
+            transactions.append(tx.left(tx.size() - 1));
+            TransactionView truncated;
+            if (truncated.parse(transactions.last()) || truncated.error() != TransactionView::WrongLength) {
+                out << "TransactionView doesn't report the wrong length of a truncated transaction" << endl;
+                return false;
+            }
+            expectedRaw += 2;
+            foreach (const TransactionView::Output &output, view.outputs())
+                expectedTotal += output.value;
+        }
+        transactions.append(tx);
+    }
+
+    QTemporaryFile file;
+    if (!file.open()) {
+        out << "ColumnarWriter can't create its test file" << endl;
+        return false;
+    }
+    ColumnarWriter writer(&file, 700);
+    foreach (const QByteArray &tx, transactions)
+        writer.append(tx.constData(), tx.size());
+    if (!writer.finish() || !file.flush() || writer.count() != transactions.size() || writer.rawCount() != expectedRaw) {
+        out << "ColumnarWriter fails to write the test archive" << endl;
+        return false;
+    }
+    int failures = 0;
+    ColumnarArchive archive;
+    if (!archive.open(file.fileName()) || archive.transactionCount() != transactions.size()
+            || archive.blockCount() != (transactions.size() + 699) / 700) {
+        out << "ColumnarArchive fails to open the test archive" << endl;
+        return false;
+    }
+    QList<QByteArray> decoded;
+    for (int i = 0; i < archive.blockCount(); ++i) {
+        if (!ColumnarArchive::decode(archive.block(i), decoded)) {
+            out << "ColumnarArchive fails to decode block " << i << endl;
+            ++failures;
+        }
+    }
+    for (int i = 0; i < transactions.size() && failures < 10; ++i) {
+        if (i >= decoded.size() || decoded.at(i) != transactions.at(i)) {
+            out << "ColumnarArchive decodes transaction " << i << " wrong" << endl;
+            ++failures;
+        }
+    }
+    for (int threads = 1; threads <= 3; threads += 2) {
+        bool ok;
+        if (archive.totalValue(threads, &ok) != expectedTotal || !ok) {
+            out << "ColumnarArchive gives the wrong total value with " << threads << " threads" << endl;
+            ++failures;
+        }
+    }
+    archive.close();
+    file.resize(file.size() - 1);
+    if (archive.open(file.fileName())) {
+        out << "ColumnarArchive opens a truncated archive" << endl;
+        ++failures;
+    }
+
+    // values close to each other are delta coded, and there are more script shapes than fit in the dictionary.
+    transactions.clear();
+    expectedTotal = 0;
+    for (int i = 0; i < 300; ++i) {
+        TestInput input;
+        input.prevHash = randomBytes(random, 32);
+        appendPush(input.script, randomBytes(random, 72));
+        TestOutput output;
+        output.value = 100000000 + i * 3;
+        output.script = i < 200 ? QByteArray("\x6a") : QByteArray("\x6a\x51"); // OP_RETURN (OP_1)
+        appendPush(output.script, randomBytes(random, ColumnarArchive::MinPayloadSize + i % 200));
+        expectedTotal += output.value;
+        transactions.append(createLegacyTransaction(1, QList<TestInput>() << input, QList<TestOutput>() << output));
+    }
+    QTemporaryFile shapesFile;
+    ColumnarWriter shapesWriter(&shapesFile);
+    if (!shapesFile.open()) {
+        out << "ColumnarWriter can't create its test file" << endl;
+        return false;
+    }
+    foreach (const QByteArray &tx, transactions)
+        shapesWriter.append(tx.constData(), tx.size());
+    QVector<ColumnarArchive::ScriptTemplate> dictionary;
+    decoded.clear();
+    bool ok = false;
+    if (!shapesWriter.finish() || !shapesFile.flush() || !archive.open(shapesFile.fileName())
+            || archive.blockCount() != 1 || !ColumnarArchive::decode(archive.block(0), decoded) || decoded != transactions
+            || archive.totalValue(1, &ok) != expectedTotal || !ok
+            || archive.block(0).columns[ColumnarArchive::Values].data[0] != ColumnarArchive::DeltaValues
+            || !ColumnarArchive::readTemplates(archive.block(0).columns[ColumnarArchive::TemplateDictionary], dictionary)
+            || dictionary.size() != ColumnarArchive::MaxTemplates) {
+        out << "ColumnarArchive fails on a block with close values and many script shapes" << endl;
+        ++failures;
+    }
+    archive.close();
+
+    // a block offset that wraps around when the block header size is added to it.
+    const qint64 listOffset = shapesFile.size() - 24 - 8; // before the footer, the offset of the one block
+    char wrapping[8];
+    Streaming::write64bitValue(wrapping, Q_UINT64_C(0xFFFFFFFFFFFFFFF0));
+    if (!shapesFile.seek(listOffset) || shapesFile.write(wrapping, 8) != 8 || !shapesFile.flush()
+            || archive.open(shapesFile.fileName())) {
+        out << "ColumnarArchive opens an archive with a wrapping block offset" << endl;
+        ++failures;
+    }
+    out << "ColumnarArchive: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::boundedQueue(QTextStream &out)
+{
+    int failures = 0;
+    BoundedQueue<int> single(5);
+    int value = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (!single.tryPush(i))
+            ++failures;
+    }
+    if (single.capacity() != 8 || single.tryPush(8) || !single.tryPop(value) || value != 0 || !single.tryPush(8)) {
+        out << "BoundedQueue does not keep to its capacity" << endl;
+        ++failures;
+    }
+    for (int i = 1; i <= 8; ++i) {
+        if (!single.tryPop(value) || value != i)
+            ++failures;
+    }
+    single.close();
+    if (single.tryPop(value) || single.pop(value)) {
+        out << "BoundedQueue returns more than was pushed" << endl;
+        ++failures;
+    }
+
+    // four producers and three consumers through a small queue, every number has to arrive once.
+    const int Producers = 4, Consumers = 3, Count = 200000;
+    BoundedQueue<int> queue(16);
+    QVector<QVector<int> > seen(Consumers, QVector<int>(Producers * Count, 0));
+    {
+        QThreadPool consumers;
+        consumers.setMaxThreadCount(Consumers);
+        for (int i = 0; i < Consumers; ++i)
+            consumers.start(new QueueConsumer(queue, seen[i]));
+        {
+            QThreadPool producers;
+            producers.setMaxThreadCount(Producers);
+            for (int i = 0; i < Producers; ++i)
+                producers.start(new QueueProducer(queue, i * Count, (i + 1) * Count));
+            producers.waitForDone();
+        }
+        queue.close();
+        consumers.waitForDone();
+    }
+    for (int i = 0; i < Producers * Count && failures < 10; ++i) {
+        int received = 0;
+        for (int c = 0; c < Consumers; ++c)
+            received += seen.at(c).at(i);
+        if (received != 1) {
+            out << "BoundedQueue delivered " << i << " " << received << " times" << endl;
+            ++failures;
+        }
+    }
+    out << "BoundedQueue: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::rawFileLoader(QTextStream &out)
+{
+    // files from empty up to a couple of hundred KB, and one that doesn't exist.
+    Random random;
+    QList<QTemporaryFile*> files;
+    QStringList names;
+    QList<QByteArray> expected;
+    for (int i = 0; i < 300; ++i) {
+        const int size = i % 100 == 0 ? 0 : (i % 50 == 1 ? 200000 + random.next() % 1000 : random.next() % 2000);
+        const QByteArray data = randomBytes(random, size);
+        QTemporaryFile *file = new QTemporaryFile();
+        files.append(file);
+        if (!file->open() || file->write(data) != size || !file->flush()) {
+            out << "RawFileLoader can't write its test files" << endl;
+            qDeleteAll(files);
+            return false;
+        }
+        names.append(file->fileName());
+        expected.append(data);
+        if (i == 150) {
+            names.append(file->fileName() + ".missing");
+            expected.append(QByteArray());
+        }
+    }
+
+    int failures = 0;
+    const RawFileLoader::Backend backends[] = { RawFileLoader::Sync, RawFileLoader::Threads, RawFileLoader::Automatic };
+    for (unsigned b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+        // a small window and odd amounts per next() make the window wrap around many times.
+        RawFileLoader loader(backends[b], 8, 20);
+        QList<QByteArray> contents;
+        loader.start(names.mid(0, 40)); // dropped half way by the next start()
+        loader.next(contents, 3);
+        loader.start(names);
+        contents.clear();
+        contents.append("before"); // next() appends
+        while (loader.next(contents, 7) > 0) {}
+        loader.start(QStringList());
+        loader.next(contents, 1);
+        bool same = contents.size() == expected.size() + 1;
+        for (int i = 0; same && i < expected.size(); ++i)
+            same = contents.at(i + 1) == expected.at(i);
+        if (!same) {
+            out << "RawFileLoader reads the wrong contents with " << RawFileLoader::name(loader.backend()) << endl;
+            ++failures;
+        }
+    }
+    qDeleteAll(files);
+    out << "RawFileLoader: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::sizeHistogram(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+    SizeStatistics::Histogram parts[3];
+    for (int round = 0; round < 20 && failures < 10; ++round) {
+        // mostly small sizes, some up to the largest int, and the bucket edges around ExactLimit.
+        QVector<int> sizes;
+        const int count = 1 + random.next() % 5000;
+        for (int i = 0; i < count; ++i) {
+            const int kind = random.next() % 8;
+            if (kind == 0)
+                sizes.append(static_cast<int>(random.nextValue() & 0x7FFFFFFF));
+            else if (kind == 1)
+                sizes.append(SizeStatistics::Histogram::ExactLimit - 2 + random.next() % 4);
+            else
+                sizes.append(random.next() % (round % 2 ? 100000 : 3000));
+        }
+        SizeStatistics::Histogram histogram;
+        for (int i = 0; i < 3; ++i)
+            parts[i].clear(); // reused, as the ranges of SizeStatistics are
+        for (int i = 0; i < sizes.size(); ++i)
+            parts[random.next() % 3].add(sizes.at(i));
+        for (int i = 0; i < 3; ++i)
+            histogram.merge(parts[i]);
+        std::sort(sizes.begin(), sizes.end());
+        if (histogram.count() != sizes.size() || histogram.max() != sizes.last()) {
+            out << "SizeStatistics::Histogram counts " << histogram.count() << " sizes up to " << histogram.max() << endl;
+            ++failures;
+        }
+        for (int percent = 1; percent <= 100; ++percent) {
+            const int exact = sizes.at(qMax(0, (sizes.size() * percent + 99) / 100 - 1));
+            const int found = histogram.percentile(percent);
+            const bool ok = exact < SizeStatistics::Histogram::ExactLimit ? found == exact
+                    : found >= exact && found <= exact + static_cast<qint64>(exact) / 16 && found <= sizes.last();
+            if (!ok) {
+                out << "SizeStatistics::Histogram gives " << found << " for percentile " << percent
+                    << ", the sizes have " << exact << endl;
+                ++failures;
+                break;
+            }
+        }
+    }
+    out << "SizeStatistics::Histogram: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::arenaTransaction(QTextStream &out)
+{
+    Random random;
+    TransactionGenerator generator(2468);
+    generator.setVersions(QList<int>() << 1 << 2 << 4);
+    generator.setInputCounts(TransactionGenerator::Distribution::geometric(3, 30));
+    generator.setOutputCounts(TransactionGenerator::Distribution::uniform(1, 8));
+    generator.setPushSizes(TransactionGenerator::Distribution::geometric(100, 70000));
+    Arena arena(64 * 1024);
+    TransactionView view;
+    int failures = 0;
+    for (int i = 0; i < 3000 && failures < 10; ++i) {
+        QByteArray data;
+        generator.next(data);
+        if (view.parse(data) && view.version() <= 2) {
+            // previous indexes of zero, which are not written, and ones above 31 bits.
+            for (int j = 0; j < view.inputs().size(); ++j) {
+                const TransactionView::Input &input = view.inputs().at(j);
+                if (random.next() % 3 == 0)
+                    Streaming::write32bitValue(data.data() + input.prevHash.offset + 32, random.next() % 2 ? 0 : random.next());
+            }
+        }
+        Transaction tx;
+        const ArenaTransaction *arenaTx = ArenaTransaction::create(arena, view, data.constData(), data.size());
+        if (!tx.read(data) || !arenaTx) {
+            out << "ArenaTransaction test transaction " << i << " does not parse" << endl;
+            ++failures;
+            continue;
+        }
+        for (int signatures = 0; signatures < 2; ++signatures) {
+            QByteArray written;
+            MessageBuilder builder(&written);
+            arenaTx->writev4(builder, signatures);
+            if (written != tx.toV4(signatures) || written.size() != tx.v4Size(signatures)) {
+                out << "ArenaTransaction writes transaction " << i << " differently than Transaction" << endl;
+                ++failures;
+            }
+        }
+        if (i % 100 == 99)
+            arena.reset();
+    }
+    out << "ArenaTransaction: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::structuredWriter(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+
+    // hex, reversed or not, longer than the chunks it is converted in and starting anywhere in the buffer.
+    for (int round = 0; round < 1000 && failures < 10; ++round) {
+        const QByteArray data = randomBytes(random, random.next() % 300);
+        const QByteArray prefix(random.next() % 64, 'x');
+        const bool reversed = round % 2;
+        QByteArray written;
+        QBuffer device(&written);
+        device.open(QIODevice::WriteOnly);
+        BufferedWriter writer(&device, 64);
+        writer.append(prefix.constData(), prefix.size());
+        writer.appendHex(data.constData(), data.size(), reversed);
+        writer.flush();
+        if (written != prefix + toHex(data.constData(), data.size(), reversed)) {
+            out << "BufferedWriter::appendHex(" << reversed << ") of " << data.size() << " bytes after "
+                << prefix.size() << " gives " << written << endl;
+            ++failures;
+        }
+    }
+
+    // JSON strings, a known escaping and every Latin-1 byte read back as utf8.
+    QByteArray latin1;
+    for (int i = 0; i < 256; ++i)
+        latin1.append(static_cast<char>(i));
+    for (int round = 0; round < 20; ++round) {
+        const QByteArray data = round == 0 ? QByteArray("a\"b\\c\n\x01\x7f\xe9\xff") : round == 1 ? latin1
+                : randomBytes(random, random.next() % 200);
+        QByteArray written;
+        QBuffer device(&written);
+        device.open(QIODevice::WriteOnly);
+        BufferedWriter writer(&device, 64);
+        writer.append('"');
+        writer.appendJsonString(data.constData(), data.size());
+        writer.append('"');
+        writer.flush();
+        JsonValue value;
+        JsonReader reader(written.constData(), written.size());
+        if (!reader.read(value) || !reader.atEnd() || !isString(&value, latin1ToUtf8(data))
+                || (round == 0 && written != "\"a\\\"b\\\\c\\u000a\\u0001\x7f\xc3\xa9\xc3\xbf\"")) {
+            out << "BufferedWriter::appendJsonString gives " << written << endl;
+            ++failures;
+        }
+    }
+
+    // generated transactions and some v4 coinbases in both formats, through small buffers.
+    TransactionGenerator generator(1357);
+    generator.setVersions(QList<int>() << 1 << 2 << 4);
+    generator.setInputCounts(TransactionGenerator::Distribution::geometric(3, 30));
+    generator.setOutputCounts(TransactionGenerator::Distribution::uniform(1, 8));
+    generator.setPushSizes(TransactionGenerator::Distribution::geometric(100, 70000));
+    QList<QByteArray> transactions;
+    QByteArray json, binary;
+    QBuffer jsonDevice(&json), binaryDevice(&binary);
+    jsonDevice.open(QIODevice::WriteOnly);
+    binaryDevice.open(QIODevice::WriteOnly);
+    BufferedWriter jsonOut(&jsonDevice, 100);
+    BufferedWriter binaryOut(&binaryDevice, 100);
+    StructuredWriter jsonWriter(jsonOut, StructuredWriter::JsonLines);
+    StructuredWriter binaryWriter(binaryOut, StructuredWriter::Binary);
+    for (int i = 0; i < 2000; ++i) {
+        QByteArray data;
+        if (i % 50 == 0) {
+            static const char version[4] = { 4, 0, 0, 0 };
+            MessageBuilder builder(&data);
+            builder.addRaw(version, sizeof(version));
+            builder.add(Transaction::CoinbaseMessage, randomBytes(random, 1 + random.next() % 100));
+            builder.add(Transaction::TxOutScript, randomBytes(random, random.next() % 40));
+            builder.add(Transaction::TxOutValue, random.nextValue());
+            builder.add(Transaction::TxEnd, true);
+        } else {
+            generator.next(data);
+        }
+        const bool accepted = jsonWriter.write(data.constData(), data.size());
+        if (binaryWriter.write(data.constData(), data.size()) != accepted) {
+            out << "StructuredWriter accepts transaction " << i << " in one format only" << endl;
+            ++failures;
+        }
+        if (accepted)
+            transactions.append(data);
+    }
+    jsonOut.flush();
+    binaryOut.flush();
+
+    const QList<QByteArray> lines = json.split('\n');
+    if (lines.size() != transactions.size() + 1 || !lines.last().isEmpty()) {
+        out << "StructuredWriter wrote " << lines.size() - 1 << " JSON lines for " << transactions.size() << " transactions" << endl;
+        ++failures;
+    }
+    TransactionView view;
+    int offset = 0;
+    for (int i = 0; i < transactions.size() && failures < 10; ++i) {
+        const QByteArray &data = transactions.at(i);
+        const QByteArray txid = Transaction::txid(data);
+        view.parse(data);
+        if (i < lines.size()) {
+            JsonValue value;
+            JsonReader reader(lines.at(i).constData(), lines.at(i).size());
+            const char *field = reader.read(value) && reader.atEnd() ? compareJson(value, view, txid) : "syntax";
+            if (field) {
+                out << "StructuredWriter JSON of transaction " << i << " has the wrong " << field << ": " << lines.at(i) << endl;
+                ++failures;
+            }
+        }
+        const int length = binary.size() - offset >= 4 ? Streaming::fetch32bitValue(binary.constData(), offset) : -1;
+        if (length < 0 || length > binary.size() - offset - 4) {
+            out << "StructuredWriter binary record " << i << " does not fit" << endl;
+            ++failures;
+            break;
+        }
+        const char *field = compareRecord(binary.constData() + offset + 4, length, view, txid);
+        if (field) {
+            out << "StructuredWriter binary record " << i << " has the wrong " << field << endl;
+            ++failures;
+        }
+        offset += 4 + length;
+    }
+    if (failures == 0 && offset != binary.size()) {
+        out << "StructuredWriter binary output has " << binary.size() - offset << " bytes after the last record" << endl;
+        ++failures;
+    }
+    out << "StructuredWriter: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::blockFileReader(QTextStream &out)
+{
+    Random random;
+    TransactionGenerator generator(97531);
+    generator.setVersions(QList<int>() << 1 << 2);
+    generator.setInputCounts(TransactionGenerator::Distribution::uniform(1, 5));
+    generator.setOutputCounts(TransactionGenerator::Distribution::uniform(1, 5));
+    generator.setPushSizes(TransactionGenerator::Distribution::geometric(30, 600));
+    const quint32 magic = 0xD9B4BEF9;
+    int failures = 0;
+
+    // legacy and segwit transactions, every tenth block is empty, has an impossible count or a corrupt transaction.
+    QByteArray blockFile;
+    QList<int> blockOffsets;
+    QList<QByteArray> expected;
+    QList<int> expectedPositions;
+    TransactionView view;
+    for (int block = 0; block < 40; ++block) {
+        const int kind = block % 10;
+        const int count = kind == 3 ? 0 : (kind == 7 ? 5 : 1 + random.next() % 8);
+        QByteArray transactions;
+        for (int i = 0; i < count; ++i) {
+            QByteArray tx;
+            do {
+                generator.next(tx);
+            } while (!view.parse(tx) || view.inputs().isEmpty());
+            if (random.next() % 3 == 0)
+                tx = addWitness(tx, view.inputs().size(), random);
+            if (BlockFileReader::legacyTransactionSize(tx.constData(), tx.size()) != tx.size()
+                    || BlockFileReader::legacyTransactionSize(tx.constData(), tx.size() - 1) != -1) {
+                out << "BlockFileReader::legacyTransactionSize is wrong for a transaction of " << tx.size() << " bytes" << endl;
+                ++failures;
+            }
+            if (kind == 7 && i == 2) { // so many inputs they run past the block, the rest of it is skipped.
+                tx = QByteArray("\x01\0\0\0\xfd\xff\xff", 7);
+            } else if (kind != 5 && (kind != 7 || i < 2)) {
+                expected.append(tx);
+                expectedPositions.append(block * 1000 + i);
+            }
+            transactions.append(tx);
+        }
+        blockOffsets.append(blockFile.size());
+        appendBlock(blockFile, magic, kind == 5 ? 1000000 : count, transactions);
+    }
+    blockFile.append(QByteArray(3000, 0)); // the preallocated tail
+
+    // the whole file, one with a different network magic half way and one cut off in a block.
+    for (int damage = 0; damage < 3; ++damage) {
+        QByteArray contents = blockFile;
+        int blocks = 40;
+        if (damage == 1) {
+            blocks = 20;
+            contents[blockOffsets.at(blocks)] = '\x0b';
+        } else if (damage == 2) {
+            blocks = 30;
+            contents.resize(blockOffsets.at(blocks) + 8 + 80 + 20);
+        }
+        int expectedCount = 0;
+        while (expectedCount < expected.size() && expectedPositions.at(expectedCount) < blocks * 1000)
+            ++expectedCount;
+        QList<QByteArray> transactions;
+        QList<int> positions;
+        bool error = false;
+        if (!readBlockFile(contents, transactions, positions, error)) {
+            out << "BlockFileReader can't read its test file" << endl;
+            ++failures;
+            break;
+        }
+        if (error != (damage > 0) || transactions != expected.mid(0, expectedCount)
+                || positions != expectedPositions.mid(0, expectedCount)) {
+            out << "BlockFileReader reads " << transactions.size() << " transactions instead of " << expectedCount
+                << (damage == 0 ? "" : damage == 1 ? " with a wrong magic" : " from a truncated file") << endl;
+            ++failures;
+        }
+    }
+    out << "BlockFileReader: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::cmfSchema(QTextStream &out)
+{
+    Random random;
+    int failures = 0;
+    for (int round = 0; round < 200 && failures < 10; ++round) {
+        QList<SchemaRecord> records;
+        QByteArray written, expected;
+        MessageBuilder builder(&written);
+        MessageBuilder reference(&expected);
+        const int count = 1 + random.next() % 20;
+        for (int i = 0; i < count; ++i) {
+            SchemaRecord record;
+            record.name = randomBytes(random, random.next() % 40);
+            if (random.next() % 2)
+                record.count = random.next() % 3 ? random.next() % 1000 : random.nextValue() >> 8; // CMF numbers are at most 8 bytes
+            if (random.next() % 2)
+                record.label = QString("label %1").arg(random.next() % 1000);
+            record.flag = random.next() % 2;
+            if (random.next() % 2)
+                record.wide = random.next() % 0x7FFFFFFF;
+            records.append(record);
+            KeyedRecordSchema::write(builder, record);
+            writeSchemaRecord(reference, record);
+        }
+        if (written != expected) {
+            out << "CMFSchema writes " << written.toHex() << " instead of " << expected.toHex() << endl;
+            ++failures;
+            continue;
+        }
+
+        QList<SchemaRecord> keyed, repeated;
+        CMFSchema::ReadResult result = CMFSchema::Stored;
+        if (readSchemaRecords<KeyedRecordSchema>(written, keyed, result) != 0 || !sameRecords(keyed, records)
+                || readSchemaRecords<RepeatedRecordSchema>(written, repeated, result) != 0 || !sameRecords(repeated, records)) {
+            out << "CMFSchema::ListReader doesn't read back the " << count << " records it wrote" << endl;
+            ++failures;
+        }
+    }
+
+    // tags of other schemas, values of the wrong type and fields before the first key are not stored.
+    SchemaRecord record;
+    record.name = "name";
+    record.wide = 1000;
+    QByteArray data;
+    MessageBuilder builder(&data);
+    builder.add(RecordCount, QByteArray("not a number"));
+    KeyedRecordSchema::write(builder, record);
+    builder.add(RecordUnknown, 12);
+    QList<SchemaRecord> keyed;
+    CMFSchema::ReadResult result = CMFSchema::Stored;
+    const int skipped = readSchemaRecords<KeyedRecordSchema>(data, keyed, result);
+    if (skipped != 2 || result != CMFSchema::UnknownTag || keyed.size() != 1 || keyed.first().wide != 1000) {
+        out << "CMFSchema::ListReader stores fields it should skip" << endl;
+        ++failures;
+    }
+    MessageParser parser(data);
+    SchemaRecord single;
+    if (parser.next() != MessageParser::FoundTag || KeyedRecordSchema::read(parser, single) != CMFSchema::WrongType
+            || parser.next() != MessageParser::FoundTag || KeyedRecordSchema::read(parser, single) != CMFSchema::Stored
+            || single.name != "name" || KeyedRecordSchema::contains(RecordUnknown) || !KeyedRecordSchema::contains(RecordWide)) {
+        out << "CMFSchema::Schema::read gives the wrong result" << endl;
+        ++failures;
+    }
+    data.clear();
+    MessageBuilder missingKey(&data);
+    missingKey.add(RecordCount, 5);
+    keyed.clear();
+    if (readSchemaRecords<KeyedRecordSchema>(data, keyed, result) != 1 || result != CMFSchema::MissingKey || !keyed.isEmpty()) {
+        out << "CMFSchema::ListReader accepts a record without its key" << endl;
+        ++failures;
+    }
+    out << "CMFSchema: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::roundTripChecker(QTextStream &out)
+{
+    Random random;
+    TransactionGenerator generator(8642);
+    generator.setVersions(QList<int>() << 1 << 2 << 4);
+    generator.setInputCounts(TransactionGenerator::Distribution::geometric(3, 30));
+    generator.setOutputCounts(TransactionGenerator::Distribution::uniform(1, 8));
+    generator.setPushSizes(TransactionGenerator::Distribution::geometric(100, 70000));
+    int failures = 0;
+
+    // generated transactions, where version 2 can't survive v4, and ones using the legacy-only fields.
+    RoundTripChecker::Statistics expected;
+    QByteArray corpus;
+    for (int i = 0; i < 1500; ++i) {
+        QByteArray tx;
+        const int kind = i % 100;
+        if (kind < 95) {
+            generator.next(tx);
+        } else {
+            TestInput input;
+            input.prevHash = randomBytes(random, 32);
+            if (kind == 95) // a 10 byte push using OP_PUSHDATA1
+                input.script = QByteArray("\x4c\x0a", 2) + randomBytes(random, 10);
+            else
+                appendPush(input.script, randomBytes(random, 10));
+            TestOutput output;
+            output.value = 5000;
+            output.script = randomBytes(random, 25);
+            tx = createLegacyTransaction(1, QList<TestInput>() << input, QList<TestOutput>() << output);
+            if (kind == 96) // a sequence number
+                tx[4 + 1 + 36 + 1 + input.script.size()] = '\xfe';
+            else if (kind == 97) // nLockTime
+                tx[tx.size() - 3] = '\x20';
+            else if (kind == 98) // truncated, 99 is left as is
+                tx.chop(1);
+        }
+        corpus += tx.toHex() + "\n";
+
+        ++expected.transactions;
+        Transaction transaction;
+        if (kind == 98) {
+            ++expected.failed;
+        } else if (tx.at(0) == 4) {
+            ++expected.notLegacy;
+        } else if (kind == 95) {
+            ++expected.nonMinimal;
+            ++expected.v4Lossy;
+        } else if (!transaction.read(tx) || transaction.toLegacy() != tx || transaction.legacySize() != tx.size()) {
+            out << "Transaction::toLegacy() changes legacy transaction " << i << endl;
+            ++failures;
+        } else {
+            ++expected.legacyIdentical;
+            if (tx.at(0) == 2 || kind == 96 || kind == 97)
+                ++expected.v4Lossy;
+            else
+                ++expected.v4Identical;
+        }
+    }
+
+    QTemporaryFile file;
+    if (!file.open() || file.write(corpus) != corpus.size() || !file.flush()) {
+        out << "RoundTripChecker can't write its test corpus" << endl;
+        return false;
+    }
+    for (int threads = 1; threads <= 3; threads += 2) {
+        CorpusReader reader(file.fileName());
+        RoundTripChecker checker;
+        checker.setThreadCount(threads);
+        const RoundTripChecker::Statistics &stats = checker.statistics();
+        if (!reader.open() || !checker.check(reader) || stats.transactions != expected.transactions
+                || stats.failed != expected.failed || stats.notLegacy != expected.notLegacy
+                || stats.legacyIdentical != expected.legacyIdentical || stats.nonMinimal != expected.nonMinimal
+                || stats.v4Identical != expected.v4Identical || stats.v4Lossy != expected.v4Lossy
+                || stats.legacyDiffers != 0 || stats.v4Differs != 0) {
+            out << "RoundTripChecker with " << threads << " threads gives:\n";
+            checker.printStatistics(out);
+            out << "expected " << expected.legacyIdentical << " and " << expected.v4Identical << " identical" << endl;
+            ++failures;
+        }
+    }
+    out << "RoundTripChecker: " << (failures ? "FAILED" : "ok") << endl;
+    return failures == 0;
+}
+
+bool SelfTest::run(QTextStream &out)
+{
+    bool ok = cmfVarInts(out);
+    ok = messageParserChunks(out) && ok;
+    ok = sha256(out) && ok;
+    ok = transactionBatch(out) && ok;
+    ok = scriptTokenizer(out) && ok;
+    ok = scriptClassifier(out) && ok;
+    ok = signatureHash(out) && ok;
+    ok = secp256k1(out) && ok;
+    ok = signatureVerifier(out) && ok;
+    ok = utxoIndex(out) && ok;
+    ok = transactionArchive(out) && ok;
+    ok = columnarArchive(out) && ok;
+    ok = boundedQueue(out) && ok;
+    ok = rawFileLoader(out) && ok;
+    ok = sizeHistogram(out) && ok;
+    ok = arenaTransaction(out) && ok;
+    ok = structuredWriter(out) && ok;
+    ok = blockFileReader(out) && ok;
+    ok = cmfSchema(out) && ok;
+    ok = roundTripChecker(out) && ok;
+    return ok;
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+class QTextStream;
+
+/**
+ * Consistency checks of the optimized code paths against their straightforward
+ * reference implementations, run with --selftest.
+ */
+namespace SelfTest {
+    /// compare the CMF::*Fast() and unserializeMany() varint kernels against the reference ones.
+    bool cmfVarInts(QTextStream &out);
+
+    /// compare the push mode of MessageParser, fed random chunks, against parsing the whole document.
+    bool messageParserChunks(QTextStream &out);
+
+    /// check Sha256 against test vectors, the accelerated implementations against the portable one, and the txids.
+    bool sha256(QTextStream &out);
+
+    /// compare the TransactionBatch value kernels and script filter against plain loops.
+    bool transactionBatch(QTextStream &out);
+
+    /// compare the ScriptTokenizer against the opcodes and pushes random scripts were built from.
+    bool scriptTokenizer(QTextStream &out);
+
+    /// compare the ScriptClassifier templates against matching the tokenized scripts.
+    bool scriptClassifier(QTextStream &out);
+
+    /// check SignatureHash against the BIP143 example, and against copying the transaction for each input.
+    bool signatureHash(QTextStream &out);
+
+    /// check Ripemd160 and Secp256k1 against test vectors, signatures from the chain and ones it signed itself.
+    bool secp256k1(QTextStream &out);
+
+    /// run SignatureVerifier over a small signed corpus, with valid, modified and unsupported inputs.
+    bool signatureVerifier(QTextStream &out);
+
+    /// compare UtxoIndex against a QHash while adding and spending many outputs.
+    bool utxoIndex(QTextStream &out);
+
+    /// write an archive with ArchiveWriter and look up every transaction with TransactionArchive.
+    bool transactionArchive(QTextStream &out);
+
+    /// round-trip legacy, v4 and malformed transactions through ColumnarWriter and ColumnarArchive.
+    bool columnarArchive(QTextStream &out);
+
+    /// move numbers from several producer to several consumer threads through a small BoundedQueue.
+    bool boundedQueue(QTextStream &out);
+
+    /// read many small files with each RawFileLoader backend and compare them to what was written.
+    bool rawFileLoader(QTextStream &out);
+
+    /// compare the SizeStatistics::Histogram percentiles, merged from parts, against sorted sizes.
+    bool sizeHistogram(QTextStream &out);
+
+    /// compare ArenaTransaction::writev4() against Transaction::writev4() on generated transactions.
+    bool arenaTransaction(QTextStream &out);
+
+    /// read back the JSON and binary StructuredWriter output of generated transactions, and check BufferedWriter's hex and strings.
+    bool structuredWriter(QTextStream &out);
+
+    /// walk a block file of legacy and segwit transactions with BlockFileReader, also damaged ones.
+    bool blockFileReader(QTextStream &out);
+
+    /// compare what a CMFSchema writes against plain MessageBuilder calls, and read the records back.
+    bool cmfSchema(QTextStream &out);
+
+    /// run RoundTripChecker, and so Transaction::toLegacy(), over generated and hand-made legacy transactions.
+    bool roundTripChecker(QTextStream &out);
+
+    /// run all checks, returns true if they all passed.
+    bool run(QTextStream &out);
+}
+
+#endif
@@ -0,0 +1,481 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Sha256.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+# include <cpuid.h>
+# include <immintrin.h>
+# define SHA256_HAVE_X86
+#endif
+
+namespace {
+const quint32 K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const quint32 InitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline quint32 readBigEndian(const char *data)
+{
+    return qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data));
+}
+
+inline void writeBigEndian(quint32 value, char *out)
+{
+    qToBigEndian<quint32>(value, reinterpret_cast<uchar*>(out));
+}
+
+inline quint32 rotr(quint32 x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+// process @a blocks blocks of 64 bytes
+typedef void (*CompressFunction)(quint32 *state, const char *data, int blocks);
+
+void compressPortable(quint32 *state, const char *data, int blocks)
+{
+    quint32 w[64];
+    for (int block = 0; block < blocks; ++block, data += 64) {
+        for (int t = 0; t < 16; ++t)
+            w[t] = readBigEndian(data + t * 4);
+        for (int t = 16; t < 64; ++t) {
+            const quint32 s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            const quint32 s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+        quint32 a = state[0], b = state[1], c = state[2], d = state[3];
+        quint32 e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 64; ++t) {
+            const quint32 s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            const quint32 ch = (e & f) ^ (~e & g);
+            const quint32 temp1 = h + s1 + ch + K[t] + w[t];
+            const quint32 s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            const quint32 maj = (a & b) ^ (a & c) ^ (b & c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + s0 + maj;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef SHA256_HAVE_X86
+__attribute__((target("sha,sse4.1")))
+void compressShaNi(quint32 *state, const char *data, int blocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    // the instructions want the state as ABEF and CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (int block = 0; block < blocks; ++block, data += 64) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), byteSwap);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), byteSwap);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), byteSwap);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), byteSwap);
+        __m128i msg;
+        // 4 rounds, while extending the message schedule held in m0 - m3.
+# define QUAD_ROUND(i, current, next, previous) \
+        msg = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i*>(K + i * 4))); \
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+        if (i >= 3 && i < 15) \
+            next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(current, previous, 4)), current); \
+        msg = _mm_shuffle_epi32(msg, 0x0E); \
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg); \
+        if (i >= 1 && i < 13) \
+            previous = _mm_sha256msg1_epu32(previous, current);
+
+        QUAD_ROUND(0, m0, m1, m3)
+        QUAD_ROUND(1, m1, m2, m0)
+        QUAD_ROUND(2, m2, m3, m1)
+        QUAD_ROUND(3, m3, m0, m2)
+        QUAD_ROUND(4, m0, m1, m3)
+        QUAD_ROUND(5, m1, m2, m0)
+        QUAD_ROUND(6, m2, m3, m1)
+        QUAD_ROUND(7, m3, m0, m2)
+        QUAD_ROUND(8, m0, m1, m3)
+        QUAD_ROUND(9, m1, m2, m0)
+        QUAD_ROUND(10, m2, m3, m1)
+        QUAD_ROUND(11, m3, m0, m2)
+        QUAD_ROUND(12, m0, m1, m3)
+        QUAD_ROUND(13, m1, m2, m0)
+        QUAD_ROUND(14, m2, m3, m1)
+        QUAD_ROUND(15, m3, m0, m2)
+# undef QUAD_ROUND
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+# define ROTR8(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n))
+
+/*
+ * Process one block for each of 8 independent messages, @a state holds word i of
+ * message j at state[i * 8 + j]. Only the messages with their bit in @a activeLanes
+ * get their state updated.
+ */
+__attribute__((target("avx2")))
+void compressAvx2(quint32 *state, const char *const *blocks, int activeLanes)
+{
+    __m256i w[16];
+    for (int t = 0; t < 16; ++t) {
+        const int offset = t * 4;
+        w[t] = _mm256_setr_epi32(readBigEndian(blocks[0] + offset), readBigEndian(blocks[1] + offset),
+                readBigEndian(blocks[2] + offset), readBigEndian(blocks[3] + offset),
+                readBigEndian(blocks[4] + offset), readBigEndian(blocks[5] + offset),
+                readBigEndian(blocks[6] + offset), readBigEndian(blocks[7] + offset));
+    }
+    __m256i *vectors = reinterpret_cast<__m256i*>(state);
+    __m256i s[8];
+    for (int i = 0; i < 8; ++i)
+        s[i] = _mm256_loadu_si256(vectors + i);
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int t = 0; t < 64; ++t) {
+        __m256i wt;
+        if (t < 16) {
+            wt = w[t];
+        } else { // the message schedule, w is used as a ring buffer
+            const __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+            const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(w15, 7), ROTR8(w15, 18)), _mm256_srli_epi32(w15, 3));
+            const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(w2, 17), ROTR8(w2, 19)), _mm256_srli_epi32(w2, 10));
+            wt = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+            w[t & 15] = wt;
+        }
+        const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(e, 6), ROTR8(e, 11)), ROTR8(e, 25));
+        const __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        const __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(h, s1),
+                _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32(K[t])), wt));
+        const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(a, 2), ROTR8(a, 13)), ROTR8(a, 22));
+        const __m256i maj = _mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_xor_si256(a, b)));
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(temp1, _mm256_add_epi32(s0, maj));
+    }
+    const __m256i mask = _mm256_setr_epi32(-(activeLanes & 1), -((activeLanes >> 1) & 1),
+            -((activeLanes >> 2) & 1), -((activeLanes >> 3) & 1), -((activeLanes >> 4) & 1),
+            -((activeLanes >> 5) & 1), -((activeLanes >> 6) & 1), -((activeLanes >> 7) & 1));
+    const __m256i result[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0; i < 8; ++i) {
+        const __m256i updated = _mm256_add_epi32(s[i], result[i]);
+        _mm256_storeu_si256(vectors + i, _mm256_blendv_epi8(s[i], updated, mask));
+    }
+}
+# undef ROTR8
+
+bool cpuHasShaNi()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_SSE4_1) == 0 || (ecx & bit_SSSE3) == 0)
+        return false;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ebx & (1 << 29)) != 0; // SHA
+}
+
+bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+CompressFunction selectCompress()
+{
+#ifdef SHA256_HAVE_X86
+    if (cpuHasShaNi())
+        return compressShaNi;
+#endif
+    return compressPortable;
+}
+
+CompressFunction bestCompress()
+{
+    static const CompressFunction function = selectCompress();
+    return function;
+}
+
+/**
+ * Write the padded end of a message of @a totalSize bytes to @a out (128 bytes), where @a tail
+ * are the last @a tailSize (less than 64) bytes. Returns the amount of blocks written.
+ */
+int createTail(const char *tail, int tailSize, quint64 totalSize, char *out)
+{
+    Q_ASSERT(tailSize < 64);
+    const int blocks = tailSize < 56 ? 1 : 2;
+    memcpy(out, tail, tailSize);
+    out[tailSize] = static_cast<char>(0x80);
+    memset(out + tailSize + 1, 0, blocks * 64 - tailSize - 1 - 8);
+    qToBigEndian<quint64>(totalSize * 8, reinterpret_cast<uchar*>(out + blocks * 64 - 8));
+    return blocks;
+}
+
+void hashWith(CompressFunction compress, const char *data, int size, quint32 *state)
+{
+    memcpy(state, InitialState, sizeof(InitialState));
+    const int fullBlocks = size / 64;
+    compress(state, data, fullBlocks);
+    char tail[128];
+    const int tailBlocks = createTail(data + fullBlocks * 64, size - fullBlocks * 64, size, tail);
+    compress(state, tail, tailBlocks);
+}
+
+// the second hash of a double hash; hashing the 32 byte result of the first.
+void createSecondBlock(const quint32 *state, char *block)
+{
+    for (int i = 0; i < 8; ++i)
+        writeBigEndian(state[i], block + i * 4);
+    createTail(block, 32, 32, block);
+}
+
+void doubleHashWith(CompressFunction compress, const char *data, int size, char *out)
+{
+    quint32 state[8];
+    hashWith(compress, data, size, state);
+    char block[64];
+    createSecondBlock(state, block);
+    memcpy(state, InitialState, sizeof(InitialState));
+    compress(state, block, 1);
+    for (int i = 0; i < 8; ++i)
+        writeBigEndian(state[i], out + i * 4);
+}
+
+#ifdef SHA256_HAVE_X86
+// double hash up to 8 messages in parallel.
+void doubleHashAvx2(int count, const char *const *data, const int *sizes, char *out)
+{
+    Q_ASSERT(count > 0 && count <= 8);
+    static const char unusedBlock[64] = { 0 };
+    quint32 state[64];
+    char tails[8][128];
+    int fullBlocks[8], totalBlocks[8];
+    int maxBlocks = 0;
+    for (int lane = 0; lane < 8; ++lane) {
+        for (int i = 0; i < 8; ++i)
+            state[i * 8 + lane] = InitialState[i];
+        if (lane >= count) {
+            fullBlocks[lane] = totalBlocks[lane] = 0;
+            continue;
+        }
+        const int size = sizes[lane];
+        fullBlocks[lane] = size / 64;
+        totalBlocks[lane] = fullBlocks[lane]
+                + createTail(data[lane] + fullBlocks[lane] * 64, size % 64, size, tails[lane]);
+        maxBlocks = qMax(maxBlocks, totalBlocks[lane]);
+    }
+
+    // messages of different lengths are processed in lockstep, a finished one is masked out.
+    const char *blocks[8];
+    for (int block = 0; block < maxBlocks; ++block) {
+        int active = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            if (block < fullBlocks[lane]) {
+                blocks[lane] = data[lane] + block * 64;
+            } else if (block < totalBlocks[lane]) {
+                blocks[lane] = tails[lane] + (block - fullBlocks[lane]) * 64;
+            } else {
+                blocks[lane] = unusedBlock;
+                continue;
+            }
+            active |= 1 << lane;
+        }
+        compressAvx2(state, blocks, active);
+    }
+
+    char secondBlocks[8][64];
+    for (int lane = 0; lane < 8; ++lane) {
+        quint32 laneState[8];
+        for (int i = 0; i < 8; ++i) {
+            laneState[i] = state[i * 8 + lane];
+            state[i * 8 + lane] = InitialState[i];
+        }
+        createSecondBlock(laneState, secondBlocks[lane]);
+        blocks[lane] = secondBlocks[lane];
+    }
+    compressAvx2(state, blocks, 0xFF);
+    for (int lane = 0; lane < count; ++lane) {
+        for (int i = 0; i < 8; ++i)
+            writeBigEndian(state[i * 8 + lane], out + lane * Sha256::HashSize + i * 4);
+    }
+}
+#endif
+}
+
+Sha256::Sha256()
+{
+    reset();
+}
+
+void Sha256::reset()
+{
+    memcpy(m_state, InitialState, sizeof(InitialState));
+    m_bufferSize = 0;
+    m_length = 0;
+}
+
+void Sha256::write(const char *data, int size)
+{
+    Q_ASSERT(size >= 0);
+    const CompressFunction compress = bestCompress();
+    m_length += size;
+    if (m_bufferSize > 0) {
+        const int count = qMin(size, 64 - m_bufferSize);
+        memcpy(m_buffer + m_bufferSize, data, count);
+        m_bufferSize += count;
+        data += count;
+        size -= count;
+        if (m_bufferSize < 64)
+            return;
+        compress(m_state, m_buffer, 1);
+        m_bufferSize = 0;
+    }
+    const int blocks = size / 64;
+    compress(m_state, data, blocks);
+    m_bufferSize = size - blocks * 64;
+    memcpy(m_buffer, data + blocks * 64, m_bufferSize);
+}
+
+void Sha256::finalize(char *out)
+{
+    Q_ASSERT(out);
+    char tail[128];
+    const int blocks = createTail(m_buffer, m_bufferSize, m_length, tail);
+    bestCompress()(m_state, tail, blocks);
+    for (int i = 0; i < 8; ++i)
+        writeBigEndian(m_state[i], out + i * 4);
+    reset();
+}
+
+QByteArray Sha256::hash(const char *data, int size)
+{
+    quint32 state[8];
+    hashWith(bestCompress(), data, size, state);
+    QByteArray answer(HashSize, Qt::Uninitialized);
+    for (int i = 0; i < 8; ++i)
+        writeBigEndian(state[i], answer.data() + i * 4);
+    return answer;
+}
+
+QByteArray Sha256::doubleHash(const char *data, int size)
+{
+    QByteArray answer(HashSize, Qt::Uninitialized);
+    doubleHashWith(bestCompress(), data, size, answer.data());
+    return answer;
+}
+
+void Sha256::doubleHash(const char *data, int size, char *out)
+{
+    doubleHashWith(bestCompress(), data, size, out);
+}
+
+void Sha256::doubleHashMany(int count, const char *const *data, const int *sizes, char *out,
+                            Implementation implementation)
+{
+    Q_ASSERT(count >= 0);
+    if (implementation == Automatic)
+        implementation = bestImplementation();
+    Q_ASSERT(isSupported(implementation));
+#ifdef SHA256_HAVE_X86
+    if (implementation == Avx2) {
+        for (int i = 0; i < count; i += 8)
+            doubleHashAvx2(qMin(8, count - i), data + i, sizes + i, out + i * HashSize);
+        return;
+    }
+    const CompressFunction compress = implementation == ShaNi ? compressShaNi : compressPortable;
+#else
+    const CompressFunction compress = compressPortable;
+#endif
+    for (int i = 0; i < count; ++i)
+        doubleHashWith(compress, data[i], sizes[i], out + i * HashSize);
+}
+
+bool Sha256::isSupported(Implementation implementation)
+{
+    switch (implementation) {
+    case Automatic:
+    case Portable:
+        return true;
+#ifdef SHA256_HAVE_X86
+    case Avx2:
+        return cpuHasAvx2();
+    case ShaNi:
+        return cpuHasShaNi();
+#else
+    default:
+        return false;
+#endif
+    }
+    return false;
+}
+
+Sha256::Implementation Sha256::bestImplementation()
+{
+    // SHA-NI does a single message faster than AVX2 does eight.
+    if (isSupported(ShaNi))
+        return ShaNi;
+    if (isSupported(Avx2))
+        return Avx2;
+    return Portable;
+}
+
+const char *Sha256::name(Implementation implementation)
+{
+    switch (implementation) {
+    case Automatic: return "automatic";
+    case Portable: return "portable";
+    case Avx2: return "avx2";
+    case ShaNi: return "sha-ni";
+    }
+    return "";
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <QByteArray>
+
+/**
+ * Sha256 calculates SHA-256 hashes, as used for the transaction id.
+ *
+ * At runtime the fastest implementation the CPU supports is selected; the SHA
+ * extensions (SHA-NI) when available, with a portable implementation as fallback.
+ * Hashing many short messages, like the transactions of a block, is best done
+ * with doubleHashMany() which can also use AVX2 to hash 8 messages in parallel.
+ */
+class Sha256
+{
+public:
+    enum {
+        HashSize = 32
+    };
+
+    enum Implementation {
+        Automatic,  ///< the fastest one this CPU supports.
+        Portable,
+        Avx2,       ///< 8 messages at a time, doubleHashMany() only.
+        ShaNi
+    };
+
+    Sha256();
+
+    void write(const char *data, int size);
+    inline void write(const QByteArray &data) {
+        write(data.constData(), data.size());
+    }
+    /// write the hash to @a out, which needs room for HashSize bytes. Resets the state.
+    void finalize(char *out);
+
+    static QByteArray hash(const char *data, int size);
+    /// return sha256(sha256(data)), the hash used for transaction ids.
+    static QByteArray doubleHash(const char *data, int size);
+    static void doubleHash(const char *data, int size, char *out);
+
+    /**
+     * Double-hash @a count messages, message i is the @a sizes[i] bytes at @a data[i]
+     * and its hash is written to @a out + i * HashSize.
+     */
+    static void doubleHashMany(int count, const char *const *data, const int *sizes, char *out,
+                               Implementation implementation = Automatic);
+
+    /// return true if this CPU can run @a implementation.
+    static bool isSupported(Implementation implementation);
+    /// return the implementation Automatic resolves to for doubleHashMany().
+    static Implementation bestImplementation();
+    static const char *name(Implementation implementation);
+
+private:
+    void reset();
+
+    quint32 m_state[8];
+    char m_buffer[64];
+    int m_bufferSize;
+    quint64 m_length;
+};
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "SignatureHash.h"
+#include "ScriptTokenizer.h"
+#include "StreamMethods.h"
+#include "TransactionView.h"
+
+#include <string.h>
+
+namespace {
+enum {
+    OpCodeSeparator = 0xab
+};
+
+void finalizeDouble(Sha256 &hasher, char *out)
+{
+    char first[Sha256::HashSize];
+    hasher.finalize(first);
+    hasher.write(first, Sha256::HashSize);
+    hasher.finalize(out);
+}
+}
+
+SignatureHash::SignatureHash()
+    : m_view(0),
+      m_outputsStart(0),
+      m_outputCountSize(0),
+      m_cached(0),
+      m_prefixInputs(-1)
+{
+}
+
+bool SignatureHash::setTransaction(const TransactionView &view)
+{
+    m_view = 0;
+    m_cached = 0;
+    m_prefixInputs = -1;
+    if (view.version() < 0 || view.version() > 2)
+        return false;
+
+    // the digests use the shortest compact sizes, when the transaction does too
+    // its bytes can be hashed as they are instead of re-serializing them.
+    int pos = 4 + Streaming::bitcoinCompactSize(view.inputs().size());
+    for (int i = 0; i < view.inputs().size(); ++i) {
+        const TransactionView::Input &input = view.inputs().at(i);
+        if (input.prevHash.offset != pos)
+            return false;
+        pos += 36 + Streaming::bitcoinCompactSize(input.script.length);
+        if (input.script.offset != pos)
+            return false;
+        pos += input.script.length + 4;
+    }
+    m_outputCountSize = Streaming::bitcoinCompactSize(view.outputs().size());
+    pos += m_outputCountSize;
+    m_outputsStart = pos;
+    for (int i = 0; i < view.outputs().size(); ++i) {
+        const TransactionView::Output &output = view.outputs().at(i);
+        pos += 8 + Streaming::bitcoinCompactSize(output.script.length);
+        if (output.script.offset != pos)
+            return false;
+        pos += output.script.length;
+    }
+    if (pos + 4 != view.size())
+        return false;
+    m_view = &view;
+    return true;
+}
+
+bool SignatureHash::hash(int inputIndex, const char *scriptCode, int scriptCodeSize, quint64 amount,
+                         quint32 hashType, char *out)
+{
+    if (hashType & SigHashForkId)
+        return bip143Hash(inputIndex, scriptCode, scriptCodeSize, amount, hashType, out);
+    return legacyHash(inputIndex, scriptCode, scriptCodeSize, hashType, out);
+}
+
+QByteArray SignatureHash::hash(int inputIndex, const QByteArray &scriptCode, quint64 amount, quint32 hashType)
+{
+    QByteArray answer(Sha256::HashSize, Qt::Uninitialized);
+    if (!hash(inputIndex, scriptCode.constData(), scriptCode.size(), amount, hashType, answer.data()))
+        return QByteArray();
+    return answer;
+}
+
+bool SignatureHash::isValidInput(int inputIndex) const
+{
+    return m_view && inputIndex >= 0 && inputIndex < m_view->inputs().size();
+}
+
+void SignatureHash::writeBlankInput(Sha256 &hasher, int inputIndex, bool withSequence) const
+{
+    const TransactionView::Input &input = m_view->inputs().at(inputIndex);
+    char buffer[41]; // outpoint, empty script, sequence
+    memcpy(buffer, m_view->at(input.prevHash), 36);
+    buffer[36] = 0;
+    Streaming::write32bitValue(buffer + 37, withSequence ? input.sequence : 0);
+    hasher.write(buffer, sizeof(buffer));
+}
+
+void SignatureHash::writeInput(Sha256 &hasher, int inputIndex, const char *scriptCode, int scriptCodeSize) const
+{
+    const TransactionView::Input &input = m_view->inputs().at(inputIndex);
+    hasher.write(m_view->at(input.prevHash), 36);
+    char buffer[9];
+    if (scriptCodeSize == 0 || memchr(scriptCode, OpCodeSeparator, scriptCodeSize) == 0) {
+        hasher.write(buffer, Streaming::writeBitcoinCompact(buffer, scriptCodeSize));
+        hasher.write(scriptCode, scriptCodeSize);
+    } else {
+        // OP_CODESEPARATORs are not signed, a byte of 0xab in pushed data is.
+        int separators = 0;
+        ScriptTokenizer counter(scriptCode, scriptCodeSize);
+        while (counter.next() == ScriptTokenizer::FoundOpcode)
+            separators += counter.opcode() == OpCodeSeparator;
+        hasher.write(buffer, Streaming::writeBitcoinCompact(buffer, scriptCodeSize - separators));
+
+        int segmentStart = 0;
+        ScriptTokenizer tokenizer(scriptCode, scriptCodeSize);
+        while (tokenizer.next() == ScriptTokenizer::FoundOpcode) {
+            if (tokenizer.opcode() == OpCodeSeparator) {
+                hasher.write(scriptCode + segmentStart, tokenizer.opcodeStart() - segmentStart);
+                segmentStart = tokenizer.consumed();
+            }
+        }
+        // a broken push at the end is signed as it is.
+        hasher.write(scriptCode + segmentStart, scriptCodeSize - segmentStart);
+    }
+    Streaming::write32bitValue(buffer, input.sequence);
+    hasher.write(buffer, 4);
+}
+
+bool SignatureHash::legacyHash(int inputIndex, const char *scriptCode, int scriptCodeSize, quint32 hashType, char *out)
+{
+    Q_ASSERT(out);
+    Q_ASSERT(scriptCode || scriptCodeSize == 0);
+    if (!isValidInput(inputIndex))
+        return false;
+    const int baseType = hashType & 0x1f;
+    const int inputCount = m_view->inputs().size();
+    if (baseType == SigHashSingle && inputIndex >= m_view->outputs().size()) {
+        // the infamous bug of the original algorithm; without a matching output the number one is signed.
+        memset(out, 0, Sha256::HashSize);
+        out[0] = 1;
+        return true;
+    }
+
+    const char *data = m_view->data();
+    const int inputsStart = 4 + Streaming::bitcoinCompactSize(inputCount);
+    char buffer[9];
+    Sha256 hasher;
+    if (hashType & SigHashAnyoneCanPay) {
+        hasher.write(data, 4);
+        buffer[0] = 1;
+        hasher.write(buffer, 1);
+        writeInput(hasher, inputIndex, scriptCode, scriptCodeSize);
+    } else if (baseType == SigHashNone || baseType == SigHashSingle) {
+        hasher.write(data, inputsStart);
+        for (int i = 0; i < inputCount; ++i) {
+            if (i == inputIndex)
+                writeInput(hasher, i, scriptCode, scriptCodeSize);
+            else
+                writeBlankInput(hasher, i, false);
+        }
+    } else {
+        // inputs tend to be hashed in order, continue the prefix from the previous input.
+        if (m_prefixInputs < 0 || m_prefixInputs > inputIndex) {
+            m_prefix = Sha256();
+            m_prefix.write(data, inputsStart);
+            m_prefixInputs = 0;
+        }
+        for (; m_prefixInputs < inputIndex; ++m_prefixInputs)
+            writeBlankInput(m_prefix, m_prefixInputs, true);
+        hasher = m_prefix;
+        writeInput(hasher, inputIndex, scriptCode, scriptCodeSize);
+        for (int i = inputIndex + 1; i < inputCount; ++i)
+            writeBlankInput(hasher, i, true);
+    }
+
+    if (baseType == SigHashNone) {
+        buffer[0] = 0;
+        hasher.write(buffer, 1);
+    } else if (baseType == SigHashSingle) {
+        hasher.write(buffer, Streaming::writeBitcoinCompact(buffer, inputIndex + 1));
+        static const char blankOutput[9] = { -1, -1, -1, -1, -1, -1, -1, -1, 0 }; // value -1, empty script
+        for (int i = 0; i < inputIndex; ++i)
+            hasher.write(blankOutput, sizeof(blankOutput));
+        const TransactionView::Output &output = m_view->outputs().at(inputIndex);
+        const int start = output.script.offset - Streaming::bitcoinCompactSize(output.script.length) - 8;
+        hasher.write(data + start, output.script.offset + output.script.length - start);
+    } else {
+        const int start = m_outputsStart - m_outputCountSize;
+        hasher.write(data + start, m_view->size() - 4 - start);
+    }
+    hasher.write(data + m_view->size() - 4, 4); // nLockTime
+    Streaming::write32bitValue(buffer, hashType);
+    hasher.write(buffer, 4);
+    finalizeDouble(hasher, out);
+    return true;
+}
+
+bool SignatureHash::bip143Hash(int inputIndex, const char *scriptCode, int scriptCodeSize, quint64 amount,
+                               quint32 hashType, char *out)
+{
+    Q_ASSERT(out);
+    Q_ASSERT(scriptCode || scriptCodeSize == 0);
+    if (!isValidInput(inputIndex))
+        return false;
+    static const char zeros[Sha256::HashSize] = { 0 };
+    const int baseType = hashType & 0x1f;
+    const bool anyoneCanPay = hashType & SigHashAnyoneCanPay;
+    const bool allOutputs = baseType != SigHashNone && baseType != SigHashSingle;
+    const QVector<TransactionView::Input> &inputs = m_view->inputs();
+    const char *data = m_view->data();
+    char buffer[12];
+
+    Sha256 hasher;
+    hasher.write(data, 4);
+    if (anyoneCanPay) {
+        hasher.write(zeros, Sha256::HashSize);
+    } else {
+        if ((m_cached & HashPrevouts) == 0) {
+            Sha256 prevouts;
+            for (int i = 0; i < inputs.size(); ++i)
+                prevouts.write(m_view->at(inputs.at(i).prevHash), 36);
+            finalizeDouble(prevouts, m_hashPrevouts);
+            m_cached |= HashPrevouts;
+        }
+        hasher.write(m_hashPrevouts, Sha256::HashSize);
+    }
+    if (anyoneCanPay || !allOutputs) {
+        hasher.write(zeros, Sha256::HashSize);
+    } else {
+        if ((m_cached & HashSequence) == 0) {
+            Sha256 sequences;
+            for (int i = 0; i < inputs.size(); ++i) {
+                Streaming::write32bitValue(buffer, inputs.at(i).sequence);
+                sequences.write(buffer, 4);
+            }
+            finalizeDouble(sequences, m_hashSequence);
+            m_cached |= HashSequence;
+        }
+        hasher.write(m_hashSequence, Sha256::HashSize);
+    }
+
+    const TransactionView::Input &input = inputs.at(inputIndex);
+    hasher.write(m_view->at(input.prevHash), 36);
+    hasher.write(buffer, Streaming::writeBitcoinCompact(buffer, scriptCodeSize));
+    hasher.write(scriptCode, scriptCodeSize);
+    Streaming::write64bitValue(buffer, amount);
+    Streaming::write32bitValue(buffer + 8, input.sequence);
+    hasher.write(buffer, 12);
+
+    if (allOutputs) {
+        if ((m_cached & HashOutputs) == 0) {
+            Sha256::doubleHash(data + m_outputsStart, m_view->size() - 4 - m_outputsStart, m_hashOutputs);
+            m_cached |= HashOutputs;
+        }
+        hasher.write(m_hashOutputs, Sha256::HashSize);
+    } else if (baseType == SigHashSingle && inputIndex < m_view->outputs().size()) {
+        const TransactionView::Output &output = m_view->outputs().at(inputIndex);
+        const int start = output.script.offset - Streaming::bitcoinCompactSize(output.script.length) - 8;
+        char outputHash[Sha256::HashSize];
+        Sha256::doubleHash(data + start, output.script.offset + output.script.length - start, outputHash);
+        hasher.write(outputHash, Sha256::HashSize);
+    } else {
+        hasher.write(zeros, Sha256::HashSize);
+    }
+    hasher.write(data + m_view->size() - 4, 4); // nLockTime
+    Streaming::write32bitValue(buffer, hashType);
+    hasher.write(buffer, 4);
+    finalizeDouble(hasher, out);
+    return true;
+}
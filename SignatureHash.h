@@ -0,0 +1,102 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIGNATUREHASH_H
+#define SIGNATUREHASH_H
+
+#include "Sha256.h"
+
+class TransactionView;
+
+/**
+ * SignatureHash calculates the digest an input signature signs, for legacy transactions.
+ *
+ * Both the original algorithm and the BIP143 style one selected by SigHashForkId are
+ * supported. The parts shared by all inputs are calculated once per transaction; the
+ * hashPrevouts, hashSequence and hashOutputs of BIP143, and for the original algorithm
+ * the hash state over the inputs before the one being signed. Hashing all inputs of a
+ * transaction with SigHashForkId is linear in its size, the original algorithm is
+ * inherently quadratic but still avoids copying the transaction for each input.
+ *
+ * Typical use is to call setTransaction() once and hash() for each of its inputs.
+ */
+class SignatureHash
+{
+public:
+    enum HashType {
+        SigHashAll = 1,
+        SigHashNone = 2,
+        SigHashSingle = 3,
+        SigHashForkId = 0x40,
+        SigHashAnyoneCanPay = 0x80
+    };
+
+    SignatureHash();
+
+    /**
+     * Use the transaction parsed by @a view, which has to stay alive as long as this is used.
+     * Returns false for v4 transactions and for transactions that use a non-minimal
+     * compact size, those can not carry valid signatures.
+     */
+    bool setTransaction(const TransactionView &view);
+
+    /**
+     * Write the digest that input @a inputIndex signs into @a out, which needs room for
+     * Sha256::HashSize bytes. The SigHashForkId flag of @a hashType selects the algorithm.
+     *
+     * @a scriptCode is the script the signature is checked against, for P2PKH that is the
+     * output script, for P2SH the redeem script. For the original algorithm the caller
+     * removes the signature itself from it, this method removes the OP_CODESEPARATORs.
+     * @a amount is the value of the output spent, only SigHashForkId signs it.
+     * Returns false if the input doesn't exist.
+     */
+    bool hash(int inputIndex, const char *scriptCode, int scriptCodeSize, quint64 amount,
+              quint32 hashType, char *out);
+    QByteArray hash(int inputIndex, const QByteArray &scriptCode, quint64 amount, quint32 hashType);
+
+    /// the original algorithm, regardless of the SigHashForkId flag.
+    bool legacyHash(int inputIndex, const char *scriptCode, int scriptCodeSize, quint32 hashType, char *out);
+    /// the BIP143 algorithm, regardless of the SigHashForkId flag.
+    bool bip143Hash(int inputIndex, const char *scriptCode, int scriptCodeSize, quint64 amount,
+                    quint32 hashType, char *out);
+
+private:
+    bool isValidInput(int inputIndex) const;
+    void writeBlankInput(Sha256 &hasher, int inputIndex, bool withSequence) const;
+    void writeInput(Sha256 &hasher, int inputIndex, const char *scriptCode, int scriptCodeSize) const;
+
+    enum CachedHashes {
+        HashPrevouts = 1,
+        HashSequence = 2,
+        HashOutputs = 4
+    };
+
+    const TransactionView *m_view;
+    int m_outputsStart;     // offset of the first output, after the output count.
+    int m_outputCountSize;  // the size of the output count before that.
+
+    int m_cached;           // CachedHashes
+    char m_hashPrevouts[Sha256::HashSize];
+    char m_hashSequence[Sha256::HashSize];
+    char m_hashOutputs[Sha256::HashSize];
+
+    // the original SIGHASH_ALL hash over the version and the blanked inputs before m_prefixInputs.
+    Sha256 m_prefix;
+    int m_prefixInputs;
+};
+
+#endif
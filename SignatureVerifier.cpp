@@ -0,0 +1,509 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "SignatureVerifier.h"
+#include "CorpusReader.h"
+#include "Ripemd160.h"
+#include "ScriptClassifier.h"
+#include "Secp256k1.h"
+#include "SignatureHash.h"
+#include "Transaction.h"
+#include "TransactionView.h"
+#include "UtxoIndex.h"
+
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QMutex>
+#include <QRunnable>
+#include <QTextStream>
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+// the amount of inputs a worker takes from its range at a time.
+const int BatchSize = 16;
+
+// an output of the corpus, known is false for outputs from outside the corpus.
+struct SpentOutput {
+    SpentOutput() : known(false), value(0) {}
+    bool known;
+    quint64 value;
+    QByteArray script; // the output script, only for P2PK, P2PKH and P2SH outputs.
+};
+
+struct Key {
+    Key() : valid(false) {}
+    Secp256k1::PublicKey key;
+    bool valid;
+};
+
+// the signatures of an input, and the keys they are matched against in order.
+struct InputTask {
+    InputTask() : transaction(0), input(0), firstCheck(0), checkCount(0), firstKey(0), keyCount(0),
+        result(SignatureVerifier::Unsupported) {}
+    qint64 transaction; // the index in the corpus
+    int input;
+    int firstCheck;
+    int checkCount;     // zero if the result is known without verifying
+    int firstKey;
+    int keyCount;
+    SignatureVerifier::InputResult result;
+};
+
+// the checks of a slice of transactions, the hash of check i is at i * Sha256::HashSize.
+struct Slice {
+    Slice() : failed(0), coinbases(0) {}
+    QVector<InputTask> tasks;
+    QVector<Secp256k1::Signature> signatures;
+    QByteArray hashes;
+    QVector<Key> keys;
+    int failed;
+    int coinbases;
+};
+
+// the tasks a verify worker still has to do, other workers take from the end.
+struct WorkRange {
+    WorkRange() : begin(0), end(0), steals(0) {}
+    QMutex lock;
+    int begin;
+    int end;
+    int steals; // only touched by the owner
+};
+
+class VerifyJob : public QRunnable
+{
+public:
+    VerifyJob(const Slice &work, InputTask *tasks, Secp256k1::Signature *signatures,
+              WorkRange *ranges, int rangeCount, int self)
+        : m_work(work),
+          m_tasks(tasks),
+          m_signatures(signatures),
+          m_ranges(ranges),
+          m_rangeCount(rangeCount),
+          m_self(self)
+    {
+    }
+
+    void run() {
+        WorkRange &own = m_ranges[m_self];
+        while (true) {
+            int begin, end;
+            {
+                QMutexLocker locker(&own.lock);
+                begin = own.begin;
+                end = qMin(own.end, begin + BatchSize);
+                own.begin = end;
+            }
+            if (begin == end) {
+                if (!steal())
+                    return;
+                continue;
+            }
+            // the checks of neighbouring tasks are neighbours too, prepare them in one go.
+            const int firstCheck = m_tasks[begin].firstCheck;
+            const InputTask &last = m_tasks[end - 1];
+            Secp256k1::prepare(m_signatures + firstCheck, last.firstCheck + last.checkCount - firstCheck);
+            for (int i = begin; i < end; ++i) {
+                if (!verify(m_tasks[i]))
+                    m_tasks[i].result = SignatureVerifier::Invalid;
+            }
+        }
+    }
+
+private:
+    // move half of the remaining tasks of another worker to our own range.
+    bool steal() {
+        for (int i = 1; i < m_rangeCount; ++i) {
+            WorkRange &victim = m_ranges[(m_self + i) % m_rangeCount];
+            int begin, end;
+            {
+                QMutexLocker locker(&victim.lock);
+                const int remaining = victim.end - victim.begin;
+                if (remaining <= 0)
+                    continue;
+                end = victim.end;
+                begin = end - (remaining + 1) / 2;
+                victim.end = begin;
+            }
+            WorkRange &own = m_ranges[m_self];
+            QMutexLocker locker(&own.lock);
+            own.begin = begin;
+            own.end = end;
+            ++own.steals;
+            return true;
+        }
+        return false;
+    }
+
+    // match the signatures against the keys in order, like OP_CHECKMULTISIG does.
+    bool verify(const InputTask &task) const {
+        int check = 0;
+        int key = 0;
+        while (check < task.checkCount) {
+            if (task.checkCount - check > task.keyCount - key)
+                return false;
+            const Key &publicKey = m_work.keys.at(task.firstKey + key);
+            const int index = task.firstCheck + check;
+            if (publicKey.valid && Secp256k1::verify(m_work.hashes.constData() + index * Sha256::HashSize,
+                                                     m_signatures[index], publicKey.key))
+                ++check;
+            ++key;
+        }
+        return true;
+    }
+
+    const Slice &m_work;
+    InputTask *m_tasks;
+    Secp256k1::Signature *m_signatures;
+    WorkRange *m_ranges;
+    const int m_rangeCount;
+    const int m_self;
+};
+
+void append(Slice &target, const Slice &source)
+{
+    const int checkOffset = target.signatures.size();
+    const int keyOffset = target.keys.size();
+    target.tasks.reserve(target.tasks.size() + source.tasks.size());
+    foreach (InputTask task, source.tasks) {
+        task.firstCheck += checkOffset;
+        task.firstKey += keyOffset;
+        target.tasks.append(task);
+    }
+    target.signatures += source.signatures;
+    target.hashes += source.hashes;
+    target.keys += source.keys;
+    target.failed += source.failed;
+    target.coinbases += source.coinbases;
+}
+
+class VerifyAnalysis : public ChunkedCorpus::Analysis
+{
+public:
+    VerifyAnalysis(SignatureVerifier::Statistics &stats, ChunkedCorpus &workers, QTextStream *results)
+        : m_stats(stats),
+          m_workers(workers),
+          m_results(results),
+          m_firstIndex(0)
+    {
+    }
+
+    // in corpus order, find the outputs spent by this chunk and remember the ones it creates.
+    void beginChunk(const QList<QByteArray> &chunk, qint64 firstIndex, int rangeCount) {
+        m_firstIndex = firstIndex;
+        const QByteArray txids = Transaction::txids(chunk);
+        m_firstSpent.fill(-1, chunk.size()); // stays -1 if the transaction is malformed
+        m_spent.clear();
+        TransactionView view;
+        UtxoIndex::Output output;
+        for (int i = 0; i < chunk.size(); ++i) {
+            if (!view.parse(chunk.at(i)))
+                continue;
+            m_firstSpent[i] = m_spent.size();
+            foreach (const TransactionView::Input &input, view.inputs()) {
+                char prevHash[Sha256::HashSize];
+                memcpy(prevHash, view.at(input.prevHash), Sha256::HashSize);
+                if (view.version() == 4) // v4 stores the hash in reverse
+                    std::reverse(prevHash, prevHash + Sha256::HashSize);
+                SpentOutput info;
+                if (m_unspent.spend(prevHash, input.prevIndex, &output)) {
+                    info.known = true;
+                    info.value = output.value;
+                    info.script = output.script;
+                }
+                m_spent.append(info);
+            }
+            const QVector<TransactionView::Output> &outputs = view.outputs();
+            for (int o = 0; o < outputs.size(); ++o) {
+                const TransactionView::Output &out = outputs.at(o);
+                const ScriptClassifier::ScriptType type = ScriptClassifier::classify(view.at(out.script), out.script.length);
+                if (type == ScriptClassifier::NullData)
+                    continue;
+                // P2PK inputs need the key, P2PKH and P2SH ones the hash to check theirs against.
+                const bool keepScript = type == ScriptClassifier::PayToPubKey
+                        || type == ScriptClassifier::PayToPubKeyHash || type == ScriptClassifier::PayToScriptHash;
+                m_unspent.insert(txids.constData() + i * Sha256::HashSize, o, out.value,
+                                 keepScript ? view.at(out.script) : 0, keepScript ? out.script.length : 0);
+            }
+        }
+        m_slices.fill(Slice(), rangeCount);
+    }
+
+    // calculate the signature hashes of a range, in parallel.
+    void processRange(const QList<QByteArray> &chunk, int range, int start, int count) {
+        Slice &output = m_slices[range];
+        TransactionView view;
+        SignatureHash hasher;
+        for (int i = start; i < start + count; ++i) {
+            if (m_firstSpent.at(i) < 0) {
+                ++output.failed;
+                continue;
+            }
+            view.parse(chunk.at(i));
+            if (view.isCoinbase()) {
+                ++output.coinbases;
+                continue;
+            }
+            const bool supported = view.version() != 4 && hasher.setTransaction(view);
+            for (int in = 0; in < view.inputs().size(); ++in) {
+                InputTask task;
+                task.transaction = m_firstIndex + i;
+                task.input = in;
+                task.firstCheck = output.signatures.size();
+                task.firstKey = output.keys.size();
+                if (supported)
+                    task.result = addChecks(view, hasher, in, m_spent.at(m_firstSpent.at(i) + in), task, output);
+                if (task.checkCount == 0) { // nothing left to verify, drop what was added.
+                    output.signatures.resize(task.firstCheck);
+                    output.hashes.resize(task.firstCheck * Sha256::HashSize);
+                    output.keys.resize(task.firstKey);
+                    task.keyCount = 0;
+                }
+                output.tasks.append(task);
+            }
+        }
+    }
+
+    void reduceChunk(const QList<QByteArray> &chunk, qint64) {
+        Slice work;
+        for (int s = 0; s < m_slices.size(); ++s)
+            append(work, m_slices.at(s));
+        m_slices.clear();
+
+        // verify, each worker starts with an equal part of the tasks.
+        QVector<int> pending;
+        for (int i = 0; i < work.tasks.size(); ++i) {
+            if (work.tasks.at(i).checkCount > 0)
+                pending.append(i);
+        }
+        QVector<InputTask> verifyTasks;
+        verifyTasks.reserve(pending.size());
+        foreach (int i, pending) {
+            verifyTasks.append(work.tasks.at(i));
+        }
+        const int threads = m_workers.threadCount();
+        WorkRange *ranges = new WorkRange[threads];
+        for (int t = 0; t < threads; ++t) {
+            ranges[t].begin = static_cast<qint64>(verifyTasks.size()) * t / threads;
+            ranges[t].end = static_cast<qint64>(verifyTasks.size()) * (t + 1) / threads;
+        }
+        for (int t = 0; t < threads; ++t)
+            m_workers.pool().start(new VerifyJob(work, verifyTasks.data(), work.signatures.data(), ranges, threads, t));
+        m_workers.pool().waitForDone();
+        for (int t = 0; t < threads; ++t)
+            m_stats.steals += ranges[t].steals;
+        delete[] ranges;
+        for (int i = 0; i < pending.size(); ++i)
+            work.tasks[pending.at(i)].result = verifyTasks.at(i).result;
+
+        m_stats.transactions += chunk.size();
+        m_stats.failed += work.failed;
+        m_stats.coinbases += work.coinbases;
+        m_stats.signatures += work.signatures.size();
+        foreach (const InputTask &task, work.tasks) {
+            ++m_stats.inputs[task.result];
+            if (m_results)
+                *m_results << task.transaction << ',' << task.input << ',' << SignatureVerifier::name(task.result) << '\n';
+        }
+    }
+
+private:
+    SignatureVerifier::InputResult addChecks(const TransactionView &view, SignatureHash &hasher, int inputIndex,
+                                             const SpentOutput &spent, InputTask &task, Slice &output)
+    {
+        const TransactionView::Input &input = view.inputs().at(inputIndex);
+        const QVector<TransactionView::Range> &items = view.scriptItems();
+        ScriptClassifier::Payload spentPayload;
+        const ScriptClassifier::ScriptType spentType = spent.known
+                ? ScriptClassifier::classify(spent.script, &spentPayload) : ScriptClassifier::NonStandard;
+        if (input.itemCount == 1) { // P2PK: <sig>
+            if (!spent.known)
+                return SignatureVerifier::MissingAmount;
+            if (spentType != ScriptClassifier::PayToPubKey)
+                return SignatureVerifier::Unsupported;
+            addKey(spentPayload.data.data, spentPayload.data.size, task, output);
+            return addCheck(view, hasher, inputIndex, spent.script.constData(), spent.script.size(),
+                            spent, items.at(input.firstItem), task, output);
+        }
+        if (input.itemCount == 2) { // P2PKH: <sig> <pubkey>
+            const TransactionView::Range &pubKey = items.at(input.firstItem + 1);
+            if (pubKey.length != 33 && pubKey.length != 65)
+                return SignatureVerifier::Unsupported;
+            char scriptCode[25];
+            scriptCode[0] = 0x76; // OP_DUP
+            scriptCode[1] = static_cast<char>(0xa9); // OP_HASH160
+            scriptCode[2] = Ripemd160::HashSize;
+            Ripemd160::hash160(view.at(pubKey), pubKey.length, scriptCode + 3);
+            scriptCode[23] = static_cast<char>(0x88); // OP_EQUALVERIFY
+            scriptCode[24] = static_cast<char>(0xac); // OP_CHECKSIG
+            if (spent.known) { // a valid signature by another key than the output pays to is no spend.
+                if (spentType != ScriptClassifier::PayToPubKeyHash)
+                    return SignatureVerifier::Unsupported;
+                if (memcmp(spentPayload.data.data, scriptCode + 3, Ripemd160::HashSize) != 0)
+                    return SignatureVerifier::Invalid;
+            }
+            addKey(view.at(pubKey), pubKey.length, task, output);
+            return unlessUnchecked(addCheck(view, hasher, inputIndex, scriptCode, sizeof(scriptCode), spent,
+                                            items.at(input.firstItem), task, output), spent);
+        }
+        if (input.itemCount >= 3) { // P2SH multisig: OP_0 <sig>... <redeemScript>
+            const TransactionView::Range &redeemScript = items.at(input.firstItem + input.itemCount - 1);
+            ScriptClassifier::Payload payload;
+            if (ScriptClassifier::classify(view.at(redeemScript), redeemScript.length, &payload)
+                    != ScriptClassifier::MultiSig)
+                return SignatureVerifier::Unsupported;
+            if (spent.known) {
+                if (spentType != ScriptClassifier::PayToScriptHash)
+                    return SignatureVerifier::Unsupported;
+                char scriptHash[Ripemd160::HashSize];
+                Ripemd160::hash160(view.at(redeemScript), redeemScript.length, scriptHash);
+                if (memcmp(spentPayload.data.data, scriptHash, Ripemd160::HashSize) != 0)
+                    return SignatureVerifier::Invalid;
+            }
+            // OP_CHECKMULTISIG takes the last 'required' items and one more, which isn't used.
+            if (input.itemCount < payload.required + 2)
+                return SignatureVerifier::Invalid;
+            for (int k = 0; k < payload.keyCount; ++k)
+                addKey(payload.keys[k].data, payload.keys[k].size, task, output);
+            const int firstSignature = input.firstItem + input.itemCount - 1 - payload.required;
+            for (int s = 0; s < payload.required; ++s) {
+                const SignatureVerifier::InputResult result = addCheck(view, hasher, inputIndex,
+                        view.at(redeemScript), redeemScript.length, spent, items.at(firstSignature + s), task, output);
+                if (result != SignatureVerifier::Valid) {
+                    task.checkCount = 0;
+                    return result;
+                }
+            }
+            // until verified otherwise, even without signatures.
+            return unlessUnchecked(SignatureVerifier::Valid, spent);
+        }
+        return SignatureVerifier::Unsupported;
+    }
+
+    // without the spent output the signatures can be right, but not that they match the output.
+    static SignatureVerifier::InputResult unlessUnchecked(SignatureVerifier::InputResult result, const SpentOutput &spent)
+    {
+        if (result == SignatureVerifier::Valid && !spent.known)
+            return SignatureVerifier::Unchecked;
+        return result;
+    }
+
+    void addKey(const char *data, int size, InputTask &task, Slice &output)
+    {
+        Key key;
+        key.valid = Secp256k1::parsePublicKey(data, size, key.key);
+        output.keys.append(key);
+        ++task.keyCount;
+    }
+
+    // add the check of one signature, including the hashtype byte.
+    SignatureVerifier::InputResult addCheck(const TransactionView &view, SignatureHash &hasher, int inputIndex,
+                                            const char *scriptCode, int scriptCodeSize, const SpentOutput &spent,
+                                            const TransactionView::Range &signature, InputTask &task, Slice &output)
+    {
+        if (signature.length < 1)
+            return SignatureVerifier::Invalid;
+        const quint32 hashType = static_cast<quint8>(view.at(signature)[signature.length - 1]);
+        if ((hashType & SignatureHash::SigHashForkId) && !spent.known)
+            return SignatureVerifier::MissingAmount;
+        Secp256k1::Signature parsed;
+        if (!Secp256k1::parseSignature(view.at(signature), signature.length - 1, parsed))
+            return SignatureVerifier::Invalid;
+        const int offset = output.hashes.size();
+        output.hashes.resize(offset + Sha256::HashSize);
+        hasher.hash(inputIndex, scriptCode, scriptCodeSize, spent.value, hashType, output.hashes.data() + offset);
+        output.signatures.append(parsed);
+        ++task.checkCount;
+        return SignatureVerifier::Valid;
+    }
+
+    SignatureVerifier::Statistics &m_stats;
+    ChunkedCorpus &m_workers;
+    QTextStream *m_results;
+    UtxoIndex m_unspent; // the outputs of the corpus, until spent
+    QVector<SpentOutput> m_spent;
+    QVector<int> m_firstSpent;
+    QVector<Slice> m_slices; // one per range
+    qint64 m_firstIndex;
+};
+}
+
+SignatureVerifier::SignatureVerifier()
+    : m_results(0)
+{
+}
+
+void SignatureVerifier::setThreadCount(int threads)
+{
+    m_workers.setThreadCount(threads);
+}
+
+void SignatureVerifier::setResultsDevice(QIODevice *device)
+{
+    m_results = device;
+}
+
+const char *SignatureVerifier::name(InputResult result)
+{
+    switch (result) {
+    case Valid: return "valid";
+    case Invalid: return "invalid";
+    case Unsupported: return "unsupported";
+    case MissingAmount: return "missing-amount";
+    case Unchecked: return "unchecked";
+    default: return "unknown";
+    }
+}
+
+bool SignatureVerifier::verify(CorpusReader &reader)
+{
+    m_stats = Statistics();
+    QElapsedTimer timer;
+    timer.start();
+
+    QTextStream results;
+    if (m_results) {
+        results.setDevice(m_results);
+        results << "tx,input,result\n";
+    }
+
+    VerifyAnalysis analysis(m_stats, m_workers, m_results ? &results : 0);
+    m_workers.forEachChunk(reader, analysis);
+
+    m_stats.bytesIn = reader.bytesRead();
+    m_stats.milliseconds = timer.elapsed();
+    return m_stats.inputs[Invalid] == 0;
+}
+
+void SignatureVerifier::printStatistics(QTextStream &out) const
+{
+    const double seconds = qMax<qint64>(1, m_stats.milliseconds) / 1000.;
+    out << "transactions: " << m_stats.transactions << " (" << m_stats.failed << " failed, "
+        << m_stats.coinbases << " coinbase)\n";
+    qint64 inputs = 0;
+    for (int i = 0; i < ResultCount; ++i)
+        inputs += m_stats.inputs[i];
+    out << "inputs: " << inputs << "\n";
+    for (int i = 0; i < ResultCount; ++i)
+        out << "  " << QString(name(static_cast<InputResult>(i))).leftJustified(16) << m_stats.inputs[i] << "\n";
+    out << "signature checks: " << m_stats.signatures << ", steals: " << m_stats.steals << "\n";
+    out << "time: " << m_stats.milliseconds << " ms, threads: " << m_workers.threadCount() << "\n";
+    out << "throughput: " << qRound64(m_stats.transactions / seconds) << " tx/s, "
+        << qRound64(m_stats.signatures / seconds) << " signatures/s, "
+        << QString::number(m_stats.bytesIn / seconds / 1E6, 'f', 2) << " MB/s\n";
+}
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIGNATUREVERIFIER_H
+#define SIGNATUREVERIFIER_H
+
+#include "ChunkedCorpus.h"
+
+class CorpusReader;
+class QIODevice;
+class QTextStream;
+
+/**
+ * SignatureVerifier checks the ECDSA signatures of the inputs of a corpus of legacy transactions.
+ *
+ * The corpus is read in chunks. For each chunk the signature hashes of all inputs are
+ * calculated in parallel, giving a list of checks, (hash, signature, public key) triples,
+ * grouped per input. Those are then verified by one worker per thread, each starting
+ * with an equal share of the inputs. A worker that runs out steals half of what is left
+ * of another worker, so a few expensive inputs, like big multisigs, don't leave the
+ * other threads idle. Each batch a worker takes shares the inversions of its signatures.
+ *
+ * Recognized inputs are P2PKH, P2SH multisig and P2PK when the output it spends is
+ * part of the corpus. The inputs signed with SigHashForkId also need that output for
+ * its amount. The outputs are remembered in memory, in corpus order, until spent.
+ * The pubkey of a P2PKH input and the redeem script of a P2SH input have to hash to
+ * the hash of the output they spend. When that output is not part of the corpus only
+ * the signatures can be verified, such inputs are Unchecked rather than Valid.
+ *
+ * The signature hash uses the redeem script or the pubkey's P2PKH script as is, a
+ * signature that is part of its own scriptCode is not removed. Such scripts don't
+ * appear in practice.
+ */
+class SignatureVerifier
+{
+public:
+    SignatureVerifier();
+
+    /// the amount of worker threads, defaults to the amount of cores.
+    void setThreadCount(int threads);
+
+    /// if set, the result of each input is written to @a device as a line of comma separated values.
+    void setResultsDevice(QIODevice *device);
+
+    /// verify all inputs of all transactions from the reader, returns false if any signature is invalid.
+    bool verify(CorpusReader &reader);
+
+    enum InputResult {
+        Valid,
+        Invalid,
+        Unsupported,    ///< not a script type this class knows, or a v4 transaction.
+        MissingAmount,  ///< a SigHashForkId or P2PK input spending an output from outside the corpus.
+        Unchecked,      ///< the signatures are valid, the output spent is not part of the corpus.
+        ResultCount
+    };
+
+    /// return a short name of @a result, like "valid".
+    static const char *name(InputResult result);
+
+    struct Statistics {
+        Statistics() : transactions(0), failed(0), coinbases(0), signatures(0), steals(0),
+            bytesIn(0), milliseconds(0) {
+            for (int i = 0; i < ResultCount; ++i)
+                inputs[i] = 0;
+        }
+        qint64 transactions;
+        qint64 failed;      // didn't parse
+        qint64 coinbases;
+        qint64 inputs[ResultCount];
+        qint64 signatures;  // the amount of signature checks done
+        qint64 steals;      // the amount of times a worker took work from another
+        qint64 bytesIn;
+        qint64 milliseconds;
+    };
+
+    inline const Statistics &statistics() const {
+        return m_stats;
+    }
+
+    /// print the results and the throughput of the last verify().
+    void printStatistics(QTextStream &out) const;
+
+private:
+    ChunkedCorpus m_workers;
+    QIODevice *m_results;
+    Statistics m_stats;
+};
+
+#endif
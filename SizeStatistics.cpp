@@ -0,0 +1,311 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "SizeStatistics.h"
+#include "CorpusReader.h"
+#include "Transaction.h"
+#include "TransactionView.h"
+
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QTextStream>
+#include <QtAlgorithms>
+
+#include <string.h>
+
+namespace {
+struct Result {
+    Result() : outputGroup(-1), inputs(0) {
+        for (int i = 0; i < SizeStatistics::FormatCount; ++i)
+            sizes[i] = 0;
+    }
+    int sizes[SizeStatistics::FormatCount];
+    int outputGroup; // -1 if the transaction didn't parse
+    int inputs;
+};
+
+void add(SizeStatistics::Group &group, const Result &result)
+{
+    for (int i = 0; i < SizeStatistics::FormatCount; ++i) {
+        group.sizes[i].add(result.sizes[i]);
+        group.totals[i] += result.sizes[i];
+    }
+}
+
+// add @a from to @a into and clear it for the next chunk.
+void mergeInto(SizeStatistics::Group &into, SizeStatistics::Group &from)
+{
+    if (from.sizes[SizeStatistics::Legacy].count() == 0)
+        return;
+    for (int i = 0; i < SizeStatistics::FormatCount; ++i) {
+        into.sizes[i].merge(from.sizes[i]);
+        into.totals[i] += from.totals[i];
+        from.sizes[i].clear();
+        from.totals[i] = 0;
+    }
+}
+
+void printGroup(const QString &name, const SizeStatistics::Group &group, QTextStream &out)
+{
+    const qint64 count = group.sizes[SizeStatistics::Legacy].count();
+    if (count == 0)
+        return;
+    const char *formats[] = { "legacy", "v4", "v4-nosig" };
+    for (int i = 0; i < SizeStatistics::FormatCount; ++i) {
+        const SizeStatistics::Histogram &sizes = group.sizes[i];
+        out << (i == 0 ? name : QString()).leftJustified(12)
+            << (i == 0 ? QString::number(count) : QString()).rightJustified(9)
+            << "  " << QString(formats[i]).leftJustified(9)
+            << QString::number(group.totals[i]).rightJustified(12)
+            << QString::number(sizes.percentile(10)).rightJustified(8)
+            << QString::number(sizes.percentile(50)).rightJustified(8)
+            << QString::number(sizes.percentile(90)).rightJustified(8)
+            << QString::number(sizes.percentile(99)).rightJustified(8)
+            << QString::number(sizes.max()).rightJustified(9);
+        if (i > 0 && group.totals[0] > 0) {
+            const double change = (group.totals[i] - group.totals[0]) * 100. / group.totals[0];
+            out << (QString::number(change, 'f', 1) + "%").rightJustified(11);
+        }
+        out << "\n";
+    }
+}
+
+class MeasureAnalysis : public ChunkedCorpus::Analysis
+{
+public:
+    MeasureAnalysis(SizeStatistics::Statistics &stats, QTextStream *details)
+        : m_stats(stats),
+          m_details(details),
+          m_rangeCount(0)
+    {
+    }
+
+    void beginChunk(const QList<QByteArray> &chunk, qint64, int rangeCount) {
+        if (m_details)
+            m_results.fill(Result(), chunk.size());
+        if (m_ranges.size() < rangeCount)
+            m_ranges.resize(rangeCount);
+        m_rangeCount = rangeCount;
+    }
+
+    void processRange(const QList<QByteArray> &chunk, int range, int start, int count) {
+        SizeStatistics::Statistics &stats = m_ranges[range];
+        TransactionView view;
+        for (int i = start; i < start + count; ++i) {
+            const QByteArray &data = chunk.at(i);
+            Result local;
+            Result &result = m_details ? m_results[i] : local;
+            Transaction tx;
+            if (!tx.read(data) || !view.parse(data)) {
+                ++stats.failed;
+                continue;
+            }
+            result.sizes[SizeStatistics::Legacy] = tx.legacySize();
+            result.sizes[SizeStatistics::V4] = tx.v4Size(true);
+            result.sizes[SizeStatistics::V4WithoutSignatures] = tx.v4Size(false);
+            result.inputs = view.inputs().size();
+
+            int group = -1;
+            const QVector<TransactionView::Output> &outputs = view.outputs();
+            for (int o = 0; o < outputs.size() && group != SizeStatistics::Mixed; ++o) {
+                const int type = ScriptClassifier::classify(view.at(outputs.at(o).script), outputs.at(o).script.length);
+                group = (group == -1 || group == type) ? type : static_cast<int>(SizeStatistics::Mixed);
+            }
+            result.outputGroup = group == -1 ? static_cast<int>(SizeStatistics::Mixed) : group;
+            add(stats.all, result);
+            add(stats.byOutputs[result.outputGroup], result);
+            add(stats.byInputs[SizeStatistics::inputGroup(result.inputs)], result);
+        }
+    }
+
+    void reduceChunk(const QList<QByteArray> &chunk, qint64 firstIndex) {
+        for (int r = 0; r < m_rangeCount; ++r) {
+            SizeStatistics::Statistics &range = m_ranges[r];
+            m_stats.failed += range.failed;
+            range.failed = 0;
+            mergeInto(m_stats.all, range.all);
+            for (int g = 0; g < SizeStatistics::OutputGroupCount; ++g)
+                mergeInto(m_stats.byOutputs[g], range.byOutputs[g]);
+            for (int g = 0; g < SizeStatistics::InputGroupCount; ++g)
+                mergeInto(m_stats.byInputs[g], range.byInputs[g]);
+        }
+        m_stats.transactions += chunk.size();
+        if (!m_details)
+            return;
+        for (int i = 0; i < m_results.size(); ++i) {
+            const Result &result = m_results.at(i);
+            if (result.outputGroup < 0)
+                continue;
+            *m_details << firstIndex + i << ',' << result.sizes[SizeStatistics::Legacy] << ','
+                       << result.sizes[SizeStatistics::V4] << ','
+                       << result.sizes[SizeStatistics::V4WithoutSignatures] << ','
+                       << (result.outputGroup == SizeStatistics::Mixed ? "mixed" : ScriptClassifier::name(
+                               static_cast<ScriptClassifier::ScriptType>(result.outputGroup)))
+                       << ',' << result.inputs << '\n';
+        }
+    }
+
+private:
+    SizeStatistics::Statistics &m_stats;
+    QTextStream *m_details;
+    QVector<Result> m_results; // only for the details
+    QVector<SizeStatistics::Statistics> m_ranges; // the sizes counted by each range of the chunk
+    int m_rangeCount;
+};
+}
+
+SizeStatistics::SizeStatistics()
+    : m_details(0)
+{
+}
+
+void SizeStatistics::setThreadCount(int threads)
+{
+    m_workers.setThreadCount(threads);
+}
+
+void SizeStatistics::setDetailsDevice(QIODevice *device)
+{
+    m_details = device;
+}
+
+SizeStatistics::Histogram::Histogram()
+    : m_count(0),
+      m_max(0)
+{
+}
+
+int SizeStatistics::Histogram::bucket(int size)
+{
+    if (size < ExactLimit)
+        return size;
+    // 16 buckets for each power of two from ExactLimit on.
+    const int exponent = 31 - qCountLeadingZeroBits(static_cast<quint32>(size));
+    return ExactLimit + (exponent - 12) * 16 + ((size >> (exponent - 4)) & 15);
+}
+
+int SizeStatistics::Histogram::bucketMax(int bucket)
+{
+    if (bucket < ExactLimit)
+        return bucket;
+    const int exponent = (bucket - ExactLimit) / 16 + 12;
+    const qint64 next = static_cast<qint64>(16 + (bucket - ExactLimit) % 16 + 1) << (exponent - 4);
+    return static_cast<int>(qMin<qint64>(next - 1, 0x7FFFFFFF));
+}
+
+void SizeStatistics::Histogram::add(int size)
+{
+    size = qMax(0, size);
+    if (m_buckets.isEmpty())
+        m_buckets.fill(0, bucket(0x7FFFFFFF) + 1);
+    ++m_buckets[bucket(size)];
+    ++m_count;
+    m_max = qMax(m_max, size);
+}
+
+void SizeStatistics::Histogram::merge(const Histogram &other)
+{
+    if (other.m_count == 0)
+        return;
+    if (m_buckets.isEmpty())
+        m_buckets.fill(0, other.m_buckets.size());
+    const int last = bucket(other.m_max);
+    qint64 *buckets = m_buckets.data();
+    const qint64 *otherBuckets = other.m_buckets.constData();
+    for (int i = 0; i <= last; ++i)
+        buckets[i] += otherBuckets[i];
+    m_count += other.m_count;
+    m_max = qMax(m_max, other.m_max);
+}
+
+void SizeStatistics::Histogram::clear()
+{
+    if (m_count > 0)
+        memset(m_buckets.data(), 0, (bucket(m_max) + 1) * sizeof(qint64));
+    m_count = 0;
+    m_max = 0;
+}
+
+int SizeStatistics::Histogram::percentile(int percent) const
+{
+    if (m_count == 0)
+        return 0;
+    const qint64 rank = qBound<qint64>(1, (m_count * percent + 99) / 100, m_count);
+    qint64 seen = 0;
+    for (int i = 0; i < m_buckets.size(); ++i) {
+        seen += m_buckets.at(i);
+        if (seen >= rank)
+            return qMin(bucketMax(i), m_max);
+    }
+    return m_max;
+}
+
+int SizeStatistics::inputGroup(int inputCount)
+{
+    if (inputCount <= 2)
+        return inputCount;
+    if (inputCount <= 4)
+        return 3;
+    if (inputCount <= 8)
+        return 4;
+    if (inputCount <= 16)
+        return 5;
+    if (inputCount <= 64)
+        return 6;
+    return 7;
+}
+
+void SizeStatistics::collect(CorpusReader &reader)
+{
+    m_stats = Statistics();
+    QElapsedTimer timer;
+    timer.start();
+
+    QTextStream details;
+    if (m_details) {
+        details.setDevice(m_details);
+        details << "index,legacy,v4,v4-nosig,outputs,inputs\n";
+    }
+
+    MeasureAnalysis analysis(m_stats, m_details ? &details : 0);
+    m_workers.forEachChunk(reader, analysis);
+
+    m_stats.bytesIn = reader.bytesRead();
+    m_stats.milliseconds = timer.elapsed();
+}
+
+void SizeStatistics::printStatistics(QTextStream &out) const
+{
+    const double seconds = qMax<qint64>(1, m_stats.milliseconds) / 1000.;
+    out << "transactions: " << m_stats.transactions << " (" << m_stats.failed << " failed)\n";
+    out << QString("group").leftJustified(12) << QString("txs").rightJustified(9) << "  "
+        << QString("format").leftJustified(9) << QString("total").rightJustified(12)
+        << QString("p10").rightJustified(8) << QString("p50").rightJustified(8)
+        << QString("p90").rightJustified(8) << QString("p99").rightJustified(8)
+        << QString("max").rightJustified(9) << QString("vs legacy").rightJustified(11) << "\n";
+    printGroup("all", m_stats.all, out);
+    for (int g = 0; g < OutputGroupCount; ++g) {
+        const char *name = g == Mixed ? "mixed" : ScriptClassifier::name(static_cast<ScriptClassifier::ScriptType>(g));
+        printGroup(QString("out:") + name, m_stats.byOutputs[g], out);
+    }
+    const char *inputNames[InputGroupCount] = { "0", "1", "2", "3-4", "5-8", "9-16", "17-64", "65+" };
+    for (int g = 0; g < InputGroupCount; ++g)
+        printGroup(QString("in:") + inputNames[g], m_stats.byInputs[g], out);
+    out << "time: " << m_stats.milliseconds << " ms, threads: " << m_workers.threadCount() << "\n";
+    out << "throughput: " << qRound64(m_stats.transactions / seconds) << " tx/s, "
+        << QString::number(m_stats.bytesIn / seconds / 1E6, 'f', 2) << " MB/s\n";
+}
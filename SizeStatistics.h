@@ -0,0 +1,145 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIZESTATISTICS_H
+#define SIZESTATISTICS_H
+
+#include "ChunkedCorpus.h"
+#include "ScriptClassifier.h"
+
+#include <QVector>
+
+class CorpusReader;
+class QIODevice;
+class QTextStream;
+
+/**
+ * SizeStatistics compares the size of transactions in the legacy and the v4 format.
+ *
+ * For each transaction of a corpus the legacy size, the v4 size and the v4 size without
+ * the signatures are calculated, using the MessageBuilder in MeasureOnly mode so
+ * nothing is actually written. The sizes are grouped by the script type of the
+ * outputs and by the amount of inputs to report percentiles per group.
+ * The work is spread over a pool of worker threads, each range of a chunk counts
+ * its sizes in its own histograms which are merged in corpus order.
+ */
+class SizeStatistics
+{
+public:
+    SizeStatistics();
+
+    /// the amount of worker threads, defaults to the amount of cores.
+    void setThreadCount(int threads);
+
+    /// if set, the sizes of each transaction are written to @a device as a line of comma separated values.
+    void setDetailsDevice(QIODevice *device);
+
+    /// measure all transactions from the reader.
+    void collect(CorpusReader &reader);
+
+    enum Format {
+        Legacy,
+        V4,
+        V4WithoutSignatures,
+        FormatCount
+    };
+
+    /**
+     * Histogram counts sizes below ExactLimit bytes exactly and larger sizes in buckets
+     * of 1/16th of their power of two, so the percentiles above it are within 6.25%.
+     */
+    class Histogram
+    {
+    public:
+        Histogram();
+
+        void add(int size);
+        /// add the counts of @a other.
+        void merge(const Histogram &other);
+        /// forget the sizes, keeping the buckets allocated.
+        void clear();
+
+        inline qint64 count() const {
+            return m_count;
+        }
+        inline int max() const {
+            return m_max;
+        }
+        /// the nearest-rank percentile, above ExactLimit the largest size of its bucket.
+        int percentile(int percent) const;
+
+        enum {
+            ExactLimit = 4096
+        };
+
+    private:
+        static int bucket(int size);
+        static int bucketMax(int bucket);
+
+        QVector<qint64> m_buckets; // allocated by the first add()
+        qint64 m_count;
+        int m_max;
+    };
+
+    struct Group {
+        Group() {
+            for (int i = 0; i < FormatCount; ++i)
+                totals[i] = 0;
+        }
+        /// the transaction sizes in each format.
+        Histogram sizes[FormatCount];
+        qint64 totals[FormatCount];
+    };
+
+    /// the script type of all outputs, or Mixed if they differ.
+    enum {
+        Mixed = ScriptClassifier::ScriptTypeCount,
+        OutputGroupCount
+    };
+    /// inputs 0, 1, 2, 3-4, 5-8, 9-16, 17-64 and more.
+    enum {
+        InputGroupCount = 8
+    };
+
+    struct Statistics {
+        Statistics() : transactions(0), failed(0), bytesIn(0), milliseconds(0) {}
+        qint64 transactions;
+        qint64 failed;      // didn't parse
+        qint64 bytesIn;
+        qint64 milliseconds;
+        Group all;
+        Group byOutputs[OutputGroupCount];
+        Group byInputs[InputGroupCount];
+    };
+
+    inline const Statistics &statistics() const {
+        return m_stats;
+    }
+
+    /// print the percentiles and the throughput of the last collect().
+    void printStatistics(QTextStream &out) const;
+
+    /// return the index in Statistics::byInputs for transactions with @a inputCount inputs.
+    static int inputGroup(int inputCount);
+
+private:
+    ChunkedCorpus m_workers;
+    QIODevice *m_details;
+    Statistics m_stats;
+};
+
+#endif
@@ -75,6 +75,70 @@ inline quint64 fetchBitcoinCompact(const char *array, int &offset)
     return answer;
 }
 
+// bounds-checked version of the above, returns false if the value doesn't fit in size bytes.
+inline bool fetchBitcoinCompact(const char *array, qint64 size, qint64 &offset, quint64 &result)
+{
+    if (offset >= size)
+        return false;
+    const quint8 indicator = array[offset];
+    const int width = indicator < 253 ? 1 : (indicator == 253 ? 3 : (indicator == 254 ? 5 : 9));
+    if (offset + width > size)
+        return false;
+    int pos = 0;
+    result = fetchBitcoinCompact(array + offset, pos);
+    offset += pos;
+    return true;
+}
+
+inline void write32bitValue(char *array, quint32 value)
+{
+    array[0] = static_cast<char>(value);
+    array[1] = static_cast<char>(value >> 8);
+    array[2] = static_cast<char>(value >> 16);
+    array[3] = static_cast<char>(value >> 24);
+}
+
+inline void write64bitValue(char *array, quint64 value)
+{
+    write32bitValue(array, static_cast<quint32>(value));
+    write32bitValue(array + 4, static_cast<quint32>(value >> 32));
+}
+
+/// return the amount of bytes writeBitcoinCompact() uses for @a value.
+inline int bitcoinCompactSize(quint64 value)
+{
+    if (value < 253)
+        return 1;
+    if (value <= 0xFFFF)
+        return 3;
+    if (value <= 0xFFFFFFFF)
+        return 5;
+    return 9;
+}
+
+/// write @a value in the compact format to @a array, returns the amount of bytes written.
+inline int writeBitcoinCompact(char *array, quint64 value)
+{
+    if (value < 253) {
+        array[0] = static_cast<char>(value);
+        return 1;
+    }
+    if (value <= 0xFFFF) {
+        array[0] = static_cast<char>(253);
+        array[1] = static_cast<char>(value);
+        array[2] = static_cast<char>(value >> 8);
+        return 3;
+    }
+    if (value <= 0xFFFFFFFF) {
+        array[0] = static_cast<char>(254);
+        write32bitValue(array + 1, static_cast<quint32>(value));
+        return 5;
+    }
+    array[0] = static_cast<char>(255);
+    write64bitValue(array + 1, value);
+    return 9;
+}
+
 }
 
 #endif
@@ -0,0 +1,172 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "StructuredWriter.h"
+#include "BufferedWriter.h"
+#include "Sha256.h"
+#include "StreamMethods.h"
+#include "Transaction.h"
+
+StructuredWriter::StructuredWriter(BufferedWriter &out, Format format)
+    : m_out(out),
+      m_format(format)
+{
+}
+
+bool StructuredWriter::write(const char *data, int size)
+{
+    if (!m_view.parse(data, size))
+        return false;
+    // like Transaction, only push-only input scripts are accepted.
+    const QVector<TransactionView::Input> &inputs = m_view.inputs();
+    for (int i = 0; i < inputs.size(); ++i) {
+        if ((inputs.at(i).itemCount == 0 && inputs.at(i).script.length > 0) || inputs.at(i).prevHash.length != 32)
+            return false;
+    }
+
+    char txid[Sha256::HashSize];
+    const int region = Transaction::txidRegionSize(data, size);
+    if (region >= 0)
+        Sha256::doubleHash(data, region, txid);
+    if (m_format == JsonLines)
+        writeJson(region >= 0 ? txid : 0);
+    else
+        writeBinary(region >= 0 ? txid : 0);
+    return true;
+}
+
+void StructuredWriter::writeJson(const char *txid)
+{
+    m_out.append("{\"txid\":\"");
+    if (txid)
+        m_out.appendHex(txid, Sha256::HashSize, true);
+    m_out.append("\",\"inputs\":[");
+    const QVector<TransactionView::Input> &inputs = m_view.inputs();
+    const QVector<TransactionView::Range> &items = m_view.scriptItems();
+    for (int i = 0; i < inputs.size(); ++i) {
+        const TransactionView::Input &input = inputs.at(i);
+        if (i > 0)
+            m_out.append(',');
+        m_out.append("{\"txid\":\"");
+        m_out.appendHex(m_view.at(input.prevHash), input.prevHash.length, isLegacy());
+        m_out.append("\",\"vout\":");
+        m_out.appendNumber(input.prevIndex);
+        m_out.append(",\"sequence\":");
+        m_out.appendNumber(isLegacy() ? input.sequence : 0xFFFFFFFF);
+        m_out.append(",\"script\":[");
+        for (int j = 0; j < input.itemCount; ++j) {
+            const TransactionView::Range &item = items.at(input.firstItem + j);
+            if (j > 0)
+                m_out.append(',');
+            m_out.append('"');
+            m_out.appendHex(m_view.at(item), item.length);
+            m_out.append('"');
+        }
+        m_out.append("]}");
+    }
+    m_out.append(']');
+    const TransactionView::Range coinbase = m_view.coinbaseMessage();
+    if (coinbase.length > 0) {
+        m_out.append(",\"coinbase-message\":\"");
+        m_out.appendJsonString(m_view.at(coinbase), coinbase.length);
+        m_out.append('"');
+    }
+    m_out.append(",\"outputs\":[");
+    const QVector<TransactionView::Output> &outputs = m_view.outputs();
+    for (int i = 0; i < outputs.size(); ++i) {
+        const TransactionView::Output &output = outputs.at(i);
+        if (i > 0)
+            m_out.append(',');
+        m_out.append("{\"amount\":");
+        m_out.appendNumber(output.value);
+        m_out.append(",\"script\":\"");
+        m_out.appendHex(m_view.at(output.script), output.script.length);
+        m_out.append("\"}");
+    }
+    m_out.append("],\"version\":");
+    m_out.appendNumber(m_view.version());
+    m_out.append(",\"nLockTime\":");
+    m_out.appendNumber(m_view.lockTime());
+    m_out.append("}\n");
+}
+
+void StructuredWriter::writeBinary(const char *txid)
+{
+    const QVector<TransactionView::Input> &inputs = m_view.inputs();
+    const QVector<TransactionView::Output> &outputs = m_view.outputs();
+    const QVector<TransactionView::Range> &items = m_view.scriptItems();
+    const TransactionView::Range coinbase = m_view.coinbaseMessage();
+
+    // the record is prefixed with its length, so calculate that first.
+    qint64 size = Sha256::HashSize + 8 + Streaming::bitcoinCompactSize(inputs.size());
+    for (int i = 0; i < inputs.size(); ++i) {
+        const TransactionView::Input &input = inputs.at(i);
+        size += 40 + Streaming::bitcoinCompactSize(input.itemCount);
+        for (int j = 0; j < input.itemCount; ++j) {
+            const int length = items.at(input.firstItem + j).length;
+            size += Streaming::bitcoinCompactSize(length) + length;
+        }
+    }
+    size += Streaming::bitcoinCompactSize(coinbase.length) + coinbase.length;
+    size += Streaming::bitcoinCompactSize(outputs.size());
+    for (int i = 0; i < outputs.size(); ++i)
+        size += 8 + Streaming::bitcoinCompactSize(outputs.at(i).script.length) + outputs.at(i).script.length;
+    m_out.append32bitValue(size);
+
+    if (txid) {
+        // the same order as the JSON shows.
+        char reversed[Sha256::HashSize];
+        for (int i = 0; i < Sha256::HashSize; ++i)
+            reversed[i] = txid[Sha256::HashSize - 1 - i];
+        m_out.append(reversed, Sha256::HashSize);
+    } else {
+        static const char zeros[Sha256::HashSize] = { 0 };
+        m_out.append(zeros, Sha256::HashSize);
+    }
+    m_out.append32bitValue(m_view.version());
+    m_out.append32bitValue(m_view.lockTime());
+    m_out.appendCompact(inputs.size());
+    for (int n = 0; n < inputs.size(); ++n) {
+        const TransactionView::Input &input = inputs.at(n);
+        const char *hash = m_view.at(input.prevHash);
+        if (isLegacy()) {
+            char *out = m_out.reserve(32);
+            for (int i = 0; i < 32; ++i)
+                out[i] = hash[31 - i];
+            m_out.commit(32);
+        } else {
+            m_out.append(hash, 32);
+        }
+        m_out.append32bitValue(input.prevIndex);
+        m_out.append32bitValue(isLegacy() ? input.sequence : 0xFFFFFFFF);
+        m_out.appendCompact(input.itemCount);
+        for (int j = 0; j < input.itemCount; ++j) {
+            const TransactionView::Range &item = items.at(input.firstItem + j);
+            m_out.appendCompact(item.length);
+            m_out.append(m_view.at(item), item.length);
+        }
+    }
+    m_out.appendCompact(coinbase.length);
+    m_out.append(m_view.at(coinbase), coinbase.length);
+    m_out.appendCompact(outputs.size());
+    for (int i = 0; i < outputs.size(); ++i) {
+        const TransactionView::Output &output = outputs.at(i);
+        m_out.append64bitValue(output.value);
+        m_out.appendCompact(output.script.length);
+        m_out.append(m_view.at(output.script), output.script.length);
+    }
+}
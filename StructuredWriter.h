@@ -0,0 +1,70 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef STRUCTUREDWRITER_H
+#define STRUCTUREDWRITER_H
+
+#include "TransactionView.h"
+
+class BufferedWriter;
+
+/**
+ * StructuredWriter writes transactions in a machine readable form, one record per transaction.
+ *
+ * The fields are the ones Transaction::debug() shows, with the same names and byte-order:
+ * the txid and the input txids are shown like block explorers do, which for legacy
+ * transactions is the reverse of the serialized order.
+ *
+ * JsonLines writes one JSON object per line, like
+ * {"txid":"..","inputs":[{"txid":"..","vout":0,"sequence":4294967295,"script":["30..","02.."]}],
+ *  "outputs":[{"amount":1000,"script":"76a9.."}],"version":1,"nLockTime":0}
+ * with an extra "coinbase-message" string after the inputs for v4 coinbase transactions.
+ * The input scripts are the list of pushed items, OP_FALSE shows as "00".
+ *
+ * Binary writes per transaction, with little-endian integers and compact-size counts:
+ * the record length (32 bit, excluding itself), txid (32 bytes, zero if unknown),
+ * version (32 bit), nLockTime (32 bit), input count, then per input the txid (32 bytes),
+ * vout (32 bit), sequence (32 bit), item count and each item as length + bytes.
+ * Then the coinbase message as length + bytes, the output count and per output the
+ * amount (64 bit) and the script as length + bytes.
+ */
+class StructuredWriter
+{
+public:
+    enum Format {
+        JsonLines,
+        Binary
+    };
+
+    StructuredWriter(BufferedWriter &out, Format format);
+
+    /// write the @a size bytes transaction at @a data, returns false if it didn't parse, nothing is written then.
+    bool write(const char *data, int size);
+
+private:
+    void writeJson(const char *txid);
+    void writeBinary(const char *txid);
+    inline bool isLegacy() const {
+        return m_view.version() != 4;
+    }
+
+    BufferedWriter &m_out;
+    const Format m_format;
+    TransactionView m_view;
+};
+
+#endif
@@ -19,10 +19,18 @@
 #include <CMF.h>
 #include <MessageParser.h>
 #include <MessageBuilder.h>
+#include <CMFSchema.h>
 #include "StreamMethods.h"
+#include "ScriptTokenizer.h"
+#include "SignatureHash.h"
+#include "V4Writer.h"
 
 #include <QFile>
 #include <QDebug>
+#include <QVector>
+
+#include <algorithm>
+#include <string.h>
 
 Transaction::Transaction()
     : m_version(-1),
@@ -52,7 +60,8 @@ bool Transaction::read(const QByteArray &bytes, Lint lint)
     if (bytes.length() <=4 || bytes.at(1) != 0 || bytes.at(2) != 0 || bytes.at(3) != 0) {
         qWarning() << "Unknown transaction format. Cowerdly bailing out before trying to parse.";
         return false;
-    } else if (bytes.at(0) <= 2) {
+    }
+    if (bytes.at(0) <= 2) {
         return parseTransactionV1(bytes, lint);
     } else if (bytes.at(0) == 4) {
         m_version = 4;
@@ -63,59 +72,356 @@ bool Transaction::read(const QByteArray &bytes, Lint lint)
     return true;
 }
 
-void Transaction::writev4(const QString &filename, bool includeSignatures)
+struct Transaction::TxInSchema : CMFSchema::Schema<TxIn, CMFSchema::KeyStartsRecord,
+    CMFSchema::Field<TxInPrevHash, CMF::ByteArray, TxIn, QByteArray, &TxIn::transaction>,
+    CMFSchema::Field<TxInPrevIndex, CMF::PositiveNumber, TxIn, int, &TxIn::prevIndex, CMFSchema::Optional>
+> {};
+
+// the value is allowed before or after the script, either way it belongs to the same output.
+struct Transaction::TxOutSchema : CMFSchema::Schema<TxOut, CMFSchema::RepeatStartsRecord,
+    CMFSchema::Field<TxOutScript, CMF::ByteArray, TxOut, QByteArray, &TxOut::script>,
+    CMFSchema::Field<TxOutValue, CMF::PositiveNumber, TxOut, quint64, &TxOut::value>
+> {};
+
+void Transaction::writev4(const QString &filename, bool includeSignatures) const
 {
     QFile out(filename);
     if (!out.open(QIODevice::WriteOnly)) {
         qWarning() << "Failed to write file" << filename;
         return;
     }
+    writev4(&out, includeSignatures);
+}
+
+void Transaction::writev4(QIODevice *device, bool includeSignatures) const
+{
+    Q_ASSERT(device);
+    device->write(toV4(includeSignatures));
+}
+
+QByteArray Transaction::toV4(bool includeSignatures) const
+{
+    QByteArray answer;
+    answer.reserve(v4Size(includeSignatures));
+    MessageBuilder builder(&answer);
+    writev4(builder, includeSignatures);
+    return answer;
+}
+
+int Transaction::v4Size(bool includeSignatures) const
+{
+    MessageBuilder builder(MessageBuilder::MeasureOnly);
+    writev4(builder, includeSignatures);
+    return builder.size();
+}
+
+struct Transaction::V4Source {
+    explicit V4Source(const Transaction &tx) : inputs(tx.m_inputs), outputs(tx.m_outputs) {}
+
+    inline int inputCount() const {
+        return inputs.size();
+    }
+    // legacy hashes are stored reversed, which is how v4 writes them.
+    inline ConstBytes prevHash(int input, char *) const {
+        return bytes(inputs.at(input).transaction);
+    }
+    inline int prevIndex(int input) const {
+        return inputs.at(input).prevIndex;
+    }
+    inline int itemCount(int input) const {
+        return inputs.at(input).scriptItems.size();
+    }
+    inline ConstBytes item(int input, int index) const {
+        return bytes(inputs.at(input).scriptItems.at(index));
+    }
+    inline int outputCount() const {
+        return outputs.size();
+    }
+    inline ConstBytes outputScript(int output) const {
+        return bytes(outputs.at(output).script);
+    }
+    inline quint64 outputValue(int output) const {
+        return outputs.at(output).value;
+    }
+
+    static inline ConstBytes bytes(const QByteArray &data) {
+        return ConstBytes(data.constData(), data.size());
+    }
+
+    const QList<TxIn> &inputs;
+    const QList<TxOut> &outputs;
+};
+
+void Transaction::writev4(MessageBuilder &builder, bool includeSignatures) const
+{
+    V4Writer<V4Source>::write(builder, V4Source(*this), includeSignatures);
+}
+
+namespace {
+// the size of a stack item in a legacy input script, see writePush()
+int pushSize(const QByteArray &item)
+{
+    const int size = item.size();
+    if (size == 1 && item.at(0) == 0) // OP_0, which TxIn::setScript() stores as a zero byte.
+        return 1;
+    if (size <= 75)
+        return 1 + size;
+    if (size <= 0xFF)
+        return 2 + size;
+    if (size <= 0xFFFF)
+        return 3 + size;
+    return 5 + size;
+}
+
+char *writePush(char *out, const QByteArray &item)
+{
+    const int size = item.size();
+    if (size == 1 && item.at(0) == 0) {
+        *out = 0;
+        return out + 1;
+    }
+    if (size <= 75) {
+        *out++ = static_cast<char>(size);
+    } else if (size <= 0xFF) {
+        *out++ = 76; // OP_PUSHDATA1
+        *out++ = static_cast<char>(size);
+    } else if (size <= 0xFFFF) {
+        *out++ = 77; // OP_PUSHDATA2
+        *out++ = static_cast<char>(size);
+        *out++ = static_cast<char>(size >> 8);
+    } else {
+        *out++ = 78; // OP_PUSHDATA4
+        Streaming::write32bitValue(out, size);
+        out += 4;
+    }
+    memcpy(out, item.constData(), size);
+    return out + size;
+}
+
+int scriptSize(const QList<QByteArray> &scriptItems)
+{
+    int size = 0;
+    foreach (const QByteArray &item, scriptItems) {
+        size += pushSize(item);
+    }
+    return size;
+}
 
-    QByteArray version;
-    version.resize(4);
-    Streaming::insert32BitInt(version, 4, 0);
-    out.write(version);
+inline bool hasWitness(const char *data, int size)
+{
+    return size > 10 && data[0] <= 2 && data[4] == 0 && data[5] == 1;
+}
 
-    MessageBuilder builder(&out);
+// copy the legacy transaction without the witness marker and data to @a out, which is what the txid is over.
+bool stripWitness(const char *data, int size, QByteArray &out)
+{
+    qint64 pos = 6; // version, marker and flag
+    quint64 count, length;
+    if (!Streaming::fetchBitcoinCompact(data, size, pos, count) || count > quint64(size))
+        return false;
+    for (quint64 i = 0; i < count; ++i) {
+        pos += 36; // prev-hash and index
+        if (!Streaming::fetchBitcoinCompact(data, size, pos, length) || length > quint64(size))
+            return false;
+        pos += length + 4; // script and sequence
+        if (pos > size)
+            return false;
+    }
+    if (!Streaming::fetchBitcoinCompact(data, size, pos, count) || count > quint64(size))
+        return false;
+    for (quint64 i = 0; i < count; ++i) {
+        pos += 8; // value
+        if (!Streaming::fetchBitcoinCompact(data, size, pos, length) || length > quint64(size))
+            return false;
+        pos += length;
+        if (pos > size)
+            return false;
+    }
+    if (pos + 4 > size)
+        return false;
+    out.reserve(pos);
+    out.append(data, 4);
+    out.append(data + 6, pos - 6);
+    out.append(data + size - 4, 4); // nLockTime
+    return true;
+}
+}
+
+int Transaction::legacySize() const
+{
+    int size = 4 + 4; // version and nLockTime
+    const bool coinbase = m_inputs.isEmpty() && !m_coinbaseMessage.isEmpty();
+    size += Streaming::bitcoinCompactSize(coinbase ? 1 : m_inputs.size());
+    if (coinbase)
+        size += 36 + Streaming::bitcoinCompactSize(m_coinbaseMessage.size()) + m_coinbaseMessage.size() + 4;
     foreach (const TxIn &tx, m_inputs) {
-        builder.add(TxInPrevHash, tx.transaction);
-        if (tx.prevIndex > 0)
-            builder.add(TxInPrevIndex, tx.prevIndex);
+        const int script = scriptSize(tx.scriptItems);
+        size += 36 + Streaming::bitcoinCompactSize(script) + script + 4;
     }
+    size += Streaming::bitcoinCompactSize(m_outputs.size());
     foreach (const TxOut &tx, m_outputs) {
-        builder.add(TxOutScript, tx.script);
-        builder.add(TxOutValue, tx.value);
+        size += 8 + Streaming::bitcoinCompactSize(tx.script.size()) + tx.script.size();
     }
+    return size;
+}
 
-    // This is the limiter. All the data above is used to create the transaction ID.
-    // What follows is the tx-in scripts. These contain the public key (of which the txout (prevtx) has a hash)
-    // and it contains a signature using that public key signing the data above.
+int Transaction::writeLegacy(char *out) const
+{
+    Q_ASSERT(out);
+    char *pos = out;
+    Streaming::write32bitValue(pos, (m_version == 1 || m_version == 2) ? m_version : 1);
+    pos += 4;
+
+    if (m_inputs.isEmpty() && !m_coinbaseMessage.isEmpty()) {
+        pos += Streaming::writeBitcoinCompact(pos, 1);
+        memset(pos, 0, 32);
+        Streaming::write32bitValue(pos + 32, 0xFFFFFFFF);
+        pos += 36;
+        pos += Streaming::writeBitcoinCompact(pos, m_coinbaseMessage.size());
+        memcpy(pos, m_coinbaseMessage.constData(), m_coinbaseMessage.size());
+        pos += m_coinbaseMessage.size();
+        Streaming::write32bitValue(pos, 0xFFFFFFFF);
+        pos += 4;
+    } else {
+        pos += Streaming::writeBitcoinCompact(pos, m_inputs.size());
+    }
+    foreach (const TxIn &tx, m_inputs) {
+        // the prev-hash is stored in reverse, see parseTransactionV1()
+        const int hashSize = qMin(32, tx.transaction.size());
+        bool nullHash = true;
+        for (int i = 0; i < 32; ++i) {
+            pos[i] = 31 - i < hashSize ? tx.transaction.at(31 - i) : 0;
+            nullHash = nullHash && pos[i] == 0;
+        }
+        // v4 doesn't store a prevIndex of zero, a coinbase needs its 0xFFFFFFFF back.
+        Streaming::write32bitValue(pos + 32, nullHash && tx.prevIndex == 0 ? 0xFFFFFFFF : tx.prevIndex);
+        pos += 36;
+        pos += Streaming::writeBitcoinCompact(pos, scriptSize(tx.scriptItems));
+        foreach (const QByteArray &item, tx.scriptItems) {
+            pos = writePush(pos, item);
+        }
+        // v4 has no sequence numbers, this is what makes an input final in the legacy format.
+        Streaming::write32bitValue(pos, m_version == 4 ? 0xFFFFFFFF : tx.sequence);
+        pos += 4;
+    }
 
-    // This means that the data below can be stripped after we established that the transaction is correct.
-    // There is no need to hash the below data to ensure its not tampered with. They are cryptographic proof
-    // on their own by the fact that they 'unlock' the puzzle of the prev TX and sign this TX.
+    pos += Streaming::writeBitcoinCompact(pos, m_outputs.size());
+    foreach (const TxOut &tx, m_outputs) {
+        Streaming::write64bitValue(pos, tx.value);
+        pos += 8;
+        pos += Streaming::writeBitcoinCompact(pos, tx.script.size());
+        memcpy(pos, tx.script.constData(), tx.script.size());
+        pos += tx.script.size();
+    }
+    Streaming::write32bitValue(pos, m_nLockTime);
+    pos += 4;
+    return pos - out;
+}
+
+QByteArray Transaction::toLegacy() const
+{
+    QByteArray answer(legacySize(), Qt::Uninitialized);
+    const int size = writeLegacy(answer.data());
+    Q_ASSERT(size == answer.size());
+    Q_UNUSED(size);
+    return answer;
+}
 
-    if (includeSignatures) {
-        foreach (const TxIn &tx, m_inputs) {
-            bool first = true;
-            foreach (auto item, tx.scriptItems) {
-                builder.add(first ? TxInputStackItem : TxInputStackItemContinued, item);
-                first = false;
+void Transaction::writeLegacy(const QString &filename) const
+{
+    QFile out(filename);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write file" << filename;
+        return;
+    }
+    out.write(toLegacy());
+}
+
+QByteArray Transaction::txid(const QByteArray &transaction)
+{
+    const int size = txidRegionSize(transaction.constData(), transaction.size());
+    if (size >= 0)
+        return Sha256::doubleHash(transaction.constData(), size);
+    QByteArray stripped;
+    if (hasWitness(transaction.constData(), transaction.size())
+            && stripWitness(transaction.constData(), transaction.size(), stripped))
+        return Sha256::doubleHash(stripped.constData(), stripped.size());
+    return QByteArray();
+}
+
+int Transaction::txidRegionSize(const char *data, int size)
+{
+    if (size <= 4 || data[1] != 0 || data[2] != 0 || data[3] != 0)
+        return -1;
+    if (data[0] <= 2)
+        return hasWitness(data, size) ? -1 : size;
+    if (data[0] != 4)
+        return -1;
+
+    // the signatures follow the body, the txid covers everything before the first of them.
+    MessageParser parser(data + 4, size - 4);
+    int bodyEnd = 0;
+    MessageParser::Type type = parser.next();
+    while (type == MessageParser::FoundTag) {
+        const int tag = parser.tag();
+        if (tag == TxInputStackItem || tag == TxInputStackItemContinued || tag == TxEnd)
+            return 4 + bodyEnd;
+        bodyEnd = parser.consumed();
+        type = parser.next();
+    }
+    if (type != MessageParser::EndOfDocument)
+        return -1;
+    return size; // no signatures included
+}
+
+QByteArray Transaction::txids(const QList<QByteArray> &transactions, Sha256::Implementation implementation)
+{
+    const int count = transactions.size();
+    QVector<const char*> data(count);
+    QVector<int> sizes(count);
+    QList<QByteArray> stripped; // keeps the copies of witness transactions alive
+    QList<int> malformed;
+    for (int i = 0; i < count; ++i) {
+        const QByteArray &tx = transactions.at(i);
+        data[i] = tx.constData();
+        sizes[i] = txidRegionSize(tx.constData(), tx.size());
+        if (sizes[i] < 0 && hasWitness(tx.constData(), tx.size())) {
+            QByteArray copy;
+            if (stripWitness(tx.constData(), tx.size(), copy)) {
+                stripped.append(copy);
+                data[i] = stripped.last().constData();
+                sizes[i] = copy.size();
             }
         }
-        builder.add(TxEnd, true);
+        if (sizes[i] < 0) {
+            malformed.append(i);
+            sizes[i] = 0;
+        }
+    }
+
+    QByteArray answer(count * Sha256::HashSize, Qt::Uninitialized);
+    Sha256::doubleHashMany(count, data.constData(), sizes.constData(), answer.data(), implementation);
+    foreach (int i, malformed) {
+        memset(answer.data() + i * Sha256::HashSize, 0, Sha256::HashSize);
     }
+    return answer;
 }
 
-void Transaction::debug() const
+void Transaction::debug(const QByteArray &txid) const
 {
     QTextStream out(stdout);
-    out << "{\ninputs :[\n";
+    out << "{\n";
+    if (!txid.isEmpty()) {
+        QByteArray id = txid;
+        std::reverse(id.begin(), id.end()); // shown in the same byte-order as the inputs use
+        out << "txid: " << id.toHex() << "\n";
+    }
+    out << "inputs :[\n";
     foreach (const TxIn &tx, m_inputs) {
-        out << "  {\n    txid: " << tx.transaction.toHex() << endl;
-        out << "    vout: " << tx.prevIndex << endl;
+        out << "  {\n    txid: " << tx.transaction.toHex() << '\n';
+        out << "    vout: " << tx.prevIndex << '\n';
         if (tx.sequence & (1 << 31)) {
-            out << "    sequence: " << QString::number(tx.sequence, 16) << endl;
+            out << "    sequence: " << QString::number(tx.sequence, 16) << '\n';
         } else {
             if (tx.sequence & (1 << 22)) {
                 quint32 time = tx.sequence & 0xFFFF;
@@ -147,7 +453,7 @@ void Transaction::debug() const
                 }
                 out << ")\n";
             } else if (tx.sequence != 0) {
-                out << "    block-based-relative-locktime: " << QString::number(tx.sequence & 0xFFFF) << endl;
+                out << "    block-based-relative-locktime: " << QString::number(tx.sequence & 0xFFFF) << '\n';
             }
 
         }
@@ -161,7 +467,7 @@ void Transaction::debug() const
     }
     out << "outputs: [\n";
     foreach (const TxOut &tx, m_outputs) {
-        out << "  {\n    amount: " << tx.value << endl;
+        out << "  {\n    amount: " << tx.value << '\n';
         out << "    script: ";
         debugScript(tx.script, 12, out);
         out << "  }\n";
@@ -172,328 +478,112 @@ void Transaction::debug() const
 namespace {
 void printHex(const char *data, int index, QTextStream &out)
 {
-    const unsigned char k= (const unsigned char)(data[index]);
-    if (k < 16)
-        out << '0';
-    out << QString::number(k, 16);
+    static const char digits[] = "0123456789abcdef";
+    const quint8 k = data[index];
+    out << digits[k >> 4] << digits[k & 15];
 }
 
-int printBytes(const char *data, int offset, QTextStream &out, int bytes = -1)
+void printData(const ConstBytes &bytes, QTextStream &out)
 {
-    if (bytes <= 0) {
-        bytes = (quint8) data[offset];
-        offset += 1;
-    }
-    out << QByteArray(data + offset, bytes).toHex();
-    return bytes;
+    for (int i = 0; i < bytes.size; ++i)
+        printHex(bytes.data, i, out);
 }
 }
 
 void Transaction::debugScript(const QByteArray &script, int textIndent, QTextStream &out)
 {
-    const int length = script.length();
-    if (length == 0) {
-        out << "\"\"" << endl;
+    if (script.isEmpty()) {
+        out << "\"\"" << '\n';
         return;
     }
-    const char *data = script.constData();
-    int pos = 0;
     QString indent;
     for (int i = 0; i < textIndent; ++i) indent += ' ';
-    bool linefeed = false;
 
-    while (pos < length) {
-        const unsigned char k= (const unsigned char)(data[pos]);
-        if (linefeed)
+    ScriptTokenizer tokenizer(script);
+    ScriptTokenizer::Type type = tokenizer.next();
+    bool first = true;
+    while (type == ScriptTokenizer::FoundOpcode) {
+        const quint8 k = tokenizer.opcode();
+        const ScriptTokenizer::Opcode &opcode = tokenizer.info();
+        // a push of data is printed where the caller left off, anything else starts on a new line.
+        const bool directPush = k > 0 && opcode.pushWidth == 0;
+        if (!first)
             out << indent;
-        if (k > 0 && k < 75) {
-            for (int i = 0; i < k; ++i) {
-                pos++;
-                printHex(data, pos, out);
-            }
-            linefeed = true;
+        else if (!directPush)
+            out << '\n' << indent;
+        first = false;
+
+        if (directPush) {
+            printData(tokenizer.pushData(), out);
+        } else if (opcode.name == 0) {
+            out << "UNKNOWN: " << QString::number(k, 16);
+        } else if (opcode.pushWidth > 0) {
+            out << opcode.name << ' ';
+            printData(tokenizer.pushData(), out);
+        } else if (opcode.flags & (ScriptTokenizer::DisabledOpcode | ScriptTokenizer::InvalidOpcode)) {
+            out << QString::fromLatin1(opcode.name).leftJustified(10) << " [ILLEGAL]";
         } else {
-            if (!linefeed)
-                out << endl << indent;
-            linefeed = true;
-            switch (k) {
-            case 0:
-                out << "OP_FALSE"; break;
-            case 81:
-                out << "OP_TRUE"; break;
-            case 76:
-            case 77:
-            case 78: {
-                const int width = k - 75;
-                out << "OP_PUSHDATA" << width << " ";
-                quint32 bytes = (quint8) data[++pos];
-                if (width > 1) {
-                    bytes = bytes << 8;
-                    bytes += data[++pos];
-                    if (width > 2) {
-                        bytes = bytes << 8;
-                        bytes += data[++pos];
-                        bytes = bytes << 8;
-                        bytes += data[++pos];
-                    }
-                }
-                if (bytes >= (unsigned int) length || (int) bytes + pos >= length) { // double check to avoid overflows
-                    out << "\nFAILED; the OP_PUSHDATA says its " << bytes << " bytes, thats more than we have\n";
-                    return;
-                }
-                for (unsigned int i = 0; i < bytes; ++i) {
-                    pos++;
-                    printHex(data, pos, out);
-                }
-                break;
-            }
-            case 79:
-                out << "OP_1NEGATE"; break;
-            case 82: case 83: case 84: case 85: case 86: case 87: case 88: case 89: case 90:
-            case 91: case 92: case 93: case 94: case 95: case 96: {
-                int count = k - 80;
-                out << "OP_" << count;
-                break;
-            }
-            case 97:
-                out << "OP_NOP"; break;
-            case 99:
-                out << "OP_IF"; break;
-            case 100:
-                out << "OP_NOTIF"; break;
-            case 103:
-                out << "OP_ELSE"; break;
-            case 104:
-                out << "OP_ENDIF"; break;
-            case 105:
-                out << "OP_VERIFY"; break;
-            case 106:
-                out << "OP_RETURN"; break;
-            case 107:
-                out << "OP_TOALTSTACK"; break;
-            case 108:
-                out << "OP_FROMALTSTACK"; break;
-            case 115:
-                out << "OP_IFDUP"; break;
-            case 116:
-                out << "OP_DEPTH"; break;
-            case 117:
-                out << "OP_DROP"; break;
-            case 118:
-                out << "OP_DUP"; break;
-            case 119:
-                out << "OP_NIP"; break;
-            case 120:
-                out << "OP_OVER"; break;
-            case 121:
-                out << "OP_PICK"; break;
-            case 122:
-                out << "OP_ROLL"; break;
-            case 123:
-                out << "OP_ROT"; break;
-            case 124:
-                out << "OP_SWAP"; break;
-            case 125:
-                out << "OP_TUCK"; break;
-            case 109:
-                out << "OP_2DROP"; break;
-            case 110:
-                out << "OP_2DUP"; break;
-            case 111:
-                out << "OP_3DUP"; break;
-            case 112:
-                out << "OP_2OVER"; break;
-            case 113:
-                out << "OP_2ROT"; break;
-            case 114:
-                out << "OP_2SWAP"; break;
-            case 126:
-                out << "OP_CAT     [ILLEGAL!]"; break;
-            case 127:
-                out << "OP_SUBSTR  [ILLEGAL!]"; break;
-            case 128:
-                out << "OP_LEFT    [ILLEGAL!]"; break;
-            case 129:
-                out << "OP_RIGHT   [ILLEGAL!]"; break;
-            case 130:
-                out << "OP_SIZE"; break;
-            case 131:
-                out << "OP_INVERT  [ILLEGAL!]"; break;
-            case 132:
-                out << "OP_AND     [ILLEGAL!]"; break;
-            case 133:
-                out << "OP_OR      [ILLEGAL!]"; break;
-            case 134:
-                out << "OP_XOR     [ILLEGAL!]"; break;
-            case 135:
-                out << "OP_EQUAL"; break;
-            case 136:
-                out << "OP_EQUALVERIFY"; break;
-            case 139:
-                out << "OP_1ADD"; break;
-            case 140:
-                out << "OP_1SUB"; break;
-            case 141:
-                out << "OP_2MUL    [ILLEGAL]"; break;
-            case 142:
-                out << "OP_2DIV    [ILLEGAL]"; break;
-            case 143:
-                out << "OP_NEGATE"; break;
-            case 144:
-                out << "OP_ABS"; break;
-            case 145:
-                out << "OP_NOT"; break;
-            case 146:
-                out << "OP_0NOTEQUAL"; break;
-            case 147:
-                out << "OP_ADD"; break;
-            case 148:
-                out << "OP_SUB"; break;
-            case 149:
-                out << "OP_MUL    [ILLEGAL]"; break;
-            case 150:
-                out << "OP_DIV    [ILLEGAL]"; break;
-            case 151:
-                out << "OP_MOD    [ILLEGAL]"; break;
-            case 152:
-                out << "OP_LSHIFT [ILLEGAL]"; break;
-            case 153:
-                out << "OP_RSHIFT [ILLEGAL]"; break;
-            case 154:
-                out << "OP_BOOLAND"; break;
-            case 155:
-                out << "OP_BOOLOR"; break;
-            case 156:
-                out << "OP_NUMEQUAL"; break;
-            case 157:
-                out << "OP_NUMEQUALVERIFY"; break;
-            case 158:
-                out << "OP_NUMNOTEQUAL"; break;
-            case 159:
-                out << "OP_LESSTHAN"; break;
-            case 160:
-                out << "OP_GREATERTHAN"; break;
-            case 161:
-                out << "OP_LESSTHANOREQUAL"; break;
-            case 162:
-                out << "OP_GREATERTHANOREQUAL"; break;
-            case 163:
-                out << "OP_MIN"; break;
-            case 164:
-                out << "OP_MAX"; break;
-            case 165:
-                out << "OP_WITHIN"; break;
-
-            case 171:
-                out << "OP_CODESEPARATOR"; break;
-            case 172:
-                out << "OP_CHECKSIG"; break;
-            case 173:
-                out << "OP_CHECKSIGVERIFY"; break;
-            case 174:
-                out << "OP_CHECKMULTISIG"; break;
-            case 175:
-                out << "OP_CHECKMULTISIGVERIFY"; break;
-            case 177:
-                out << "OP_CHECKLOCKTIMEVERIFY"; break;
-            case 178:
-                out << "OP_CHECKSEQUENCEVERIFY"; break;
-            case 253:
-                out << "OP_PUBKEYHASH [ILLEGAL]"; break;
-            case 254:
-                out << "OP_PUBKEY  [ILLEGAL]"; break;
-            case 255:
-                out << "OP_INVALIDOPCODE [ILLEGAL]"; break;
-            case 80:
-                out << "OP_RESERVED"; break;
-            case 98:
-                out << "OP_VER"; break;
-            case 101:
-                out << "OP_VERIF"; break;
-            case 102:
-                out << "OP_VERNOTIF"; break;
-            case 137:
-                out << "OP_RESERVED1"; break;
-            case 138:
-                out << "OP_RESERVED2"; break;
-            case 176: case 179: case 180: case 181: case 182: case 183: case 184: case 185:
-                out << "OP_NOP{}"; break;
-            case 0xA9:
-                out << "OP_HASH160 ";
-                pos += printBytes(data, ++pos, out);
-                break;
-            case 166:
-                out << "OP_RIPEMD160";
-                pos += printBytes(data, ++pos, out);
-                break;
-            case 167:
-                out << "OP_SHA1";
-                pos += printBytes(data, ++pos, out);
-                break;
-            case 168:
-                out << "OP_SHA256";
-                pos += printBytes(data, pos, out, 32);
-                break;
-            case 170:
-                out << "OP_HASH256";
-                pos += printBytes(data, ++pos, out);
-                break;
-            default:
-                out << "UNKNOWN: " << QString::number(k, 16);
-            }
+            out << opcode.name;
+        }
+
+        type = tokenizer.next();
+        if (opcode.flags & ScriptTokenizer::HashOpcode && type == ScriptTokenizer::FoundOpcode
+                && tokenizer.isPush() && tokenizer.opcode() > 0) {
+            // show the hash to compare against on the same line.
+            out << ' ';
+            printData(tokenizer.pushData(), out);
+            type = tokenizer.next();
         }
-        if (linefeed)
-            out << endl;
-        ++pos;
+        out << '\n';
+    }
+    if (type == ScriptTokenizer::Error) {
+        if (tokenizer.dataLength() < 0)
+            out << "\nFAILED; the script ends in the middle of a push length\n";
+        else
+            out << "\nFAILED; the push says its " << tokenizer.dataLength() << " bytes, thats more than we have\n";
     }
 }
 
-enum SigHashTypes {
-    SIGHASH_ALL = 1,
-    SIGHASH_NONE = 2,
-    SIGHASH_SINGLE = 3,
-    SIGHASH_FORKID = 0x40,
-    SIGHASH_ANYONECANPAY = 0x80,
-};
-
 void Transaction::debugInScript(const QList<QByteArray> &scriptItems, int textIndent, QTextStream &out)
 {
     static QHash<unsigned char, QString> mapping;
     if (mapping.isEmpty()) {
-        mapping.insert(SIGHASH_ALL, "ALL");
-        mapping.insert(SIGHASH_ALL|SIGHASH_ANYONECANPAY, "ALL|ANYONECANPAY");
-        mapping.insert(SIGHASH_NONE, "NONE");
-        mapping.insert(SIGHASH_NONE|SIGHASH_ANYONECANPAY, "NONE|ANYONECANPAY");
-        mapping.insert(SIGHASH_SINGLE, "SINGLE");
-        mapping.insert(SIGHASH_SINGLE|SIGHASH_ANYONECANPAY, "SINGLE|ANYONECANPAY");
+        mapping.insert(SignatureHash::SigHashAll, "ALL");
+        mapping.insert(SignatureHash::SigHashAll|SignatureHash::SigHashAnyoneCanPay, "ALL|ANYONECANPAY");
+        mapping.insert(SignatureHash::SigHashNone, "NONE");
+        mapping.insert(SignatureHash::SigHashNone|SignatureHash::SigHashAnyoneCanPay, "NONE|ANYONECANPAY");
+        mapping.insert(SignatureHash::SigHashSingle, "SINGLE");
+        mapping.insert(SignatureHash::SigHashSingle|SignatureHash::SigHashAnyoneCanPay, "SINGLE|ANYONECANPAY");
     }
 
 
-    bool first = true;
-    foreach (auto item, scriptItems) {
-        if (item.length() == 1) {
+    bool lineStart = false; // the OP_FALSE items end their line, data items start a new one.
+    for (int n = 0; n < scriptItems.size(); ++n) {
+        const QByteArray &item = scriptItems.at(n);
+        if (item.length() == 1 && item.at(0) == 0) { // OP_FALSE, any other single byte is pushed data.
             debugScript(item, textIndent, out);
-            first = false;
+            lineStart = true;
         } else {
-            if (first)
-                out << endl;
+            if (!lineStart)
+                out << '\n';
+            lineStart = false;
             for (int i = 0; i < textIndent; ++i)
                 out << ' ';
             const char *data = item.constData();
             for (int i = 0; i < item.length(); ++i) {
                 printHex(data, i, out);
             }
-            if (first && scriptItems.count() == 2) {
+            if (n == 0 && scriptItems.count() == 2) {
                 const uint8_t chSigHashType = item.at(item.count()-1) &  0xBF;
                 if (mapping.contains(chSigHashType)) {
                     out << ' ';
-                    const bool forkIdSet = (item.at(item.count()-1) & SIGHASH_FORKID) == SIGHASH_FORKID;
+                    const bool forkIdSet = (item.at(item.count()-1) & SignatureHash::SigHashForkId) == SignatureHash::SigHashForkId;
                     out << '[' <<  mapping[chSigHashType] << (forkIdSet ? "|FORKID]" : "]");
                 }
             }
         }
     }
-    out << endl;
+    out << '\n';
 }
 
 bool Transaction::parseTransactionV1(const QByteArray &bytes, Lint lint)
@@ -588,8 +678,6 @@ bool Transaction::parseTransactionV4(const QByteArray &bytes, Lint lint)
     QByteArray coinbaseMessage;
     MessageParser::Type type = parser.next();
     int inputScriptCount = -1;
-    bool storedOutValue = false, storedOutScript = false;
-    qint64 outValue = 0;
     bool inBody = true;
     QStringList errors;
 
@@ -604,22 +692,12 @@ bool Transaction::parseTransactionV4(const QByteArray &bytes, Lint lint)
     ErrorReporter reporter;
     reporter.errors = &errors;
 
+    TxInSchema::ListReader inputReader(inputs);
+    TxOutSchema::ListReader outputReader(outputs);
     while (type == MessageParser::FoundTag) {
         switch (parser.tag()) {
         case TxEnd:
             break;
-        case TxInPrevHash:
-            if (lint == StrictParsing && !inBody) errors << "signatures seen in body";
-            inputs.append(TxIn(parser.data().toByteArray()));
-            break;
-        case TxInPrevIndex:
-            if (lint == StrictParsing && !inBody) errors << "signatures seen in body";
-            if (inputs.isEmpty()) {
-                errors << "TxInPrevIndex seen without a TxInPrevHash before it";
-                return false;
-            }
-            inputs.last().prevIndex = parser.data().toInt();
-            break;
         case TxInputStackItem:
             ++inputScriptCount;
             // fall through
@@ -634,25 +712,7 @@ bool Transaction::parseTransactionV4(const QByteArray &bytes, Lint lint)
                 errors << "Too many TxInputStackItem* tags in tx";
                 break;
             }
-            inputs[inputScriptCount].scriptItems.append(parser.data().toByteArray());
-            break;
-        case TxOutValue:
-            if (lint == StrictParsing && !inBody) errors << "signatures seen in body";
-            if (storedOutScript) { // add it
-                outputs.last().value = parser.data().toLongLong();
-                storedOutScript = storedOutValue = false;
-            } else { // store it
-                outValue = parser.data().toLongLong();
-                storedOutValue = true;
-            }
-            break;
-        case TxOutScript:
-            if (lint == StrictParsing && !inBody) errors << "signatures seen in body";
-            outputs.append(TxOut(parser.data().toByteArray(), outValue));
-            if (storedOutValue)
-                storedOutValue = false;
-            else
-                storedOutScript = true;
+            inputs[inputScriptCount].scriptItems.append(parser.bytesData().toByteArray());
             break;
         case TxRelativeBlockLock:
             errors << "TxRelativeBlockLock not supported right now" << parser.data().toString();
@@ -664,15 +724,30 @@ bool Transaction::parseTransactionV4(const QByteArray &bytes, Lint lint)
             if (lint == StrictParsing && !inBody) errors << "signatures seen in body";
             if (!inputs.isEmpty())
                 errors << "CoinbaseMessage found on an TX with inputs, this is not allowed!";
-            coinbaseMessage = parser.data().toByteArray();
+            coinbaseMessage = parser.bytesData().toByteArray();
             break;
         case 11: case 12: case 13: case 14: case 15: case 16: case 17: case 18: case 19:
             errors << "Found unknown tag, skipping" << parser.data().toString();
             break;
-        default:
-            errors << "Found unknown tag, this TX is invalid" << parser.data().toString();
+        default: {
+            // the fields of inputs and outputs, as declared in their schemas.
+            CMFSchema::ReadResult result = inputReader.read(parser);
+            if (result == CMFSchema::UnknownTag)
+                result = outputReader.read(parser);
+            if (result == CMFSchema::UnknownTag) {
+                errors << "Found unknown tag, this TX is invalid" << parser.data().toString();
+                break;
+            }
+            if (lint == StrictParsing && !inBody) errors << "signatures seen in body";
+            if (result == CMFSchema::MissingKey) {
+                errors << "TxInPrevIndex seen without a TxInPrevHash before it";
+                return false;
+            }
+            if (result == CMFSchema::WrongType)
+                errors << "Found tag with an unexpected type" << QString::number(parser.tag());
             break;
         }
+        }
         type = parser.next();
     }
 
@@ -692,41 +767,26 @@ bool Transaction::parseTransactionV4(const QByteArray &bytes, Lint lint)
 bool Transaction::TxIn::setScript(const QByteArray &script, Lint lint)
 {
     scriptItems.clear();
-    const int length = script.length();
-    const char *data = script.constData();
-    int pos = 0;
-
-    while (pos < length) {
-        const quint8 k = data[pos];
-        if (k > 0 && k < 75) {
-            scriptItems.append(QByteArray(data + ++pos, k));
-            pos += k;
-        } else if (k == 0) {
+    ScriptTokenizer tokenizer(script);
+    ScriptTokenizer::Type type = tokenizer.next();
+    while (type == ScriptTokenizer::FoundOpcode) {
+        if (tokenizer.opcode() == 0) { // OP_FALSE, stored as a zero byte.
             scriptItems.append(QByteArray(1, 0));
-            ++pos;
-        } else if (k <= 78) {
-            const int width = k - 75;
-            quint32 bytes = (quint8) data[++pos];
-            if (width > 1) {
-                bytes = bytes << 8;
-                bytes += (quint8) data[++pos];
-                if (width > 2) {
-                    bytes = bytes << 8;
-                    bytes += (quint8) data[++pos];
-                    bytes = bytes << 8;
-                    bytes += (quint8) data[++pos];
-                }
-            }
-            scriptItems.append(QByteArray(data + pos, bytes));
-            pos += bytes + width;
+        } else if (tokenizer.isPush()) {
+            scriptItems.append(tokenizer.pushData().toByteArray());
         } else {
-            qWarning() << "SetScript got an invalid 'in' script. Encountered opcode:" << k;
+            qWarning() << "SetScript got an invalid 'in' script. Encountered opcode:" << tokenizer.opcode();
             if (lint == StrictParsing) {
                 QTextStream out(stdout);
                 Transaction::debugScript(script, 0, out);
             }
             return false;
         }
+        type = tokenizer.next();
+    }
+    if (type == ScriptTokenizer::Error) {
+        qWarning() << "SetScript got a truncated 'in' script";
+        return false;
     }
     return true;
 }
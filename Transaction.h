@@ -22,6 +22,10 @@
 #include <QString>
 #include <QTextStream>
 
+#include "Sha256.h"
+
+class QIODevice;
+class MessageBuilder;
 
 class Transaction
 {
@@ -39,9 +43,54 @@ public:
      */
     bool read(const QString &filename, Lint lint = LenientParsing);
     bool read(const QByteArray &data, Lint lint = LenientParsing);
-    void writev4(const QString &filename, bool includeSignatures);
+    void writev4(const QString &filename, bool includeSignatures) const;
+    void writev4(QIODevice *device, bool includeSignatures) const;
+    /// append the v4 transaction to the builder, allowing the caller to reuse its buffer.
+    void writev4(MessageBuilder &builder, bool includeSignatures) const;
+    /// return the v4 serialized transaction, the memory is allocated once.
+    QByteArray toV4(bool includeSignatures) const;
+    /// calculate the exact size of the v4 serialized transaction without creating it.
+    int v4Size(bool includeSignatures) const;
+
+    /**
+     * Write the legacy (version 1 or 2) transaction to @a out, which needs room for legacySize() bytes.
+     * Returns the amount of bytes written.
+     * Input scripts are re-assembled from their stack items, using the shortest push opcodes.
+     * A transaction read from v4 has no sequence numbers and nLockTime, they are written as
+     * 0xFFFFFFFF and zero, and its version as 1.
+     */
+    int writeLegacy(char *out) const;
+    /// return the legacy serialized transaction, the memory is allocated once.
+    QByteArray toLegacy() const;
+    /// calculate the exact size of the legacy serialized transaction without creating it.
+    int legacySize() const;
+    void writeLegacy(const QString &filename) const;
+
+    /**
+     * return the id of the serialized @a transaction, the double sha256 of the legacy transaction
+     * without its witness data or of the v4 transaction without its signatures. Bytes are in
+     * hash order, debug() shows them reversed. Returns an empty array if it is malformed.
+     */
+    static QByteArray txid(const QByteArray &transaction);
 
-    void debug() const;
+    /**
+     * return the amount of bytes from the start of the serialized transaction at @a data
+     * that its txid is calculated over, or -1 if the transaction is malformed.
+     * For v4 this is everything up to the signatures.
+     * Legacy transactions with witness data don't hash one region and also return -1.
+     */
+    static int txidRegionSize(const char *data, int size);
+
+    /**
+     * Calculate the txids of all @a transactions in one go, which is many times faster than
+     * one by one. The hashes are returned concatenated, 32 bytes per transaction in the same
+     * order. A malformed transaction gets a hash of all zeros.
+     */
+    static QByteArray txids(const QList<QByteArray> &transactions,
+                            Sha256::Implementation implementation = Sha256::Automatic);
+
+    /// print the transaction, with the @a txid from txid() if it isn't empty.
+    void debug(const QByteArray &txid = QByteArray()) const;
     static void debugScript(const QByteArray &script, int textIndent, QTextStream &out);
     static void debugInScript(const QList<QByteArray> &scriptItems, int textIndent, QTextStream &out);
 
@@ -74,12 +123,18 @@ private:
         unsigned int sequence;
     };
     struct TxOut {
-        TxOut(){}
+        TxOut() : value(0) {}
         TxOut(const QByteArray &bytes, quint64 val) : script(bytes), value(val) {}
         QByteArray script;
         quint64 value; // aka amount of satoshis
     };
 
+    // the CMFSchema declarations of the v4 fields of TxIn and TxOut, for parsing
+    struct TxInSchema;
+    struct TxOutSchema;
+    // the fields of this transaction for the V4Writer
+    struct V4Source;
+
     QList<TxIn> m_inputs;
     QList<TxOut> m_outputs;
 
@@ -0,0 +1,156 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TransactionArchive.h"
+#include "Sha256.h"
+#include "StreamMethods.h"
+
+#include <QtEndian>
+#include <QDebug>
+
+#include <string.h>
+
+namespace {
+const int HeaderSize = 8;
+const int FooterSize = 24;
+const int EntrySize = 16;
+const int RecordHeaderSize = 4 + Sha256::HashSize;
+}
+
+TransactionArchive::TransactionArchive()
+    : m_data(0),
+      m_size(0),
+      m_index(0),
+      m_indexOffset(0),
+      m_count(0)
+{
+}
+
+TransactionArchive::~TransactionArchive()
+{
+    close();
+}
+
+bool TransactionArchive::open(const QString &filename)
+{
+    close();
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open archive" << filename;
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size >= HeaderSize + FooterSize)
+        m_data = reinterpret_cast<const char*>(m_file.map(0, m_size));
+    if (m_data == 0 || memcmp(m_data, "TXARCHV1", 8) != 0
+            || memcmp(m_data + m_size - 8, "TXINDEX1", 8) != 0) {
+        qWarning() << "Not a complete transaction archive" << filename;
+        close();
+        return false;
+    }
+    const char *footer = m_data + m_size - FooterSize;
+    m_indexOffset = Streaming::fetch64bitValue(footer, 0);
+    m_count = Streaming::fetch64bitValue(footer, 8);
+    if (m_indexOffset < HeaderSize || m_indexOffset % 8 || m_count < 0
+            || m_indexOffset + m_count * EntrySize + FooterSize != m_size) {
+        qWarning() << "The index of the archive is damaged" << filename;
+        close();
+        return false;
+    }
+    m_index = m_data + m_indexOffset;
+    return true;
+}
+
+void TransactionArchive::close()
+{
+    m_file.close(); // this unmaps
+    m_data = 0;
+    m_size = 0;
+    m_index = 0;
+    m_indexOffset = 0;
+    m_count = 0;
+}
+
+quint64 TransactionArchive::keyAt(qint64 index) const
+{
+    return Streaming::fetch64bitValue(m_index + index * EntrySize, 0);
+}
+
+ConstBytes TransactionArchive::record(quint64 offset, const char **txid) const
+{
+    if (offset < HeaderSize || offset + RecordHeaderSize > static_cast<quint64>(m_indexOffset))
+        return ConstBytes();
+    const char *record = m_data + offset;
+    const quint32 size = Streaming::fetch32bitValue(record, 0);
+    if (size > m_indexOffset - offset - RecordHeaderSize)
+        return ConstBytes();
+    if (txid)
+        *txid = record + 4;
+    return ConstBytes(record + RecordHeaderSize, size);
+}
+
+ConstBytes TransactionArchive::at(qint64 index, const char **txid) const
+{
+    Q_ASSERT(index >= 0 && index < m_count);
+    return record(Streaming::fetch64bitValue(m_index + index * EntrySize, 8), txid);
+}
+
+ConstBytes TransactionArchive::find(const char *txid) const
+{
+    Q_ASSERT(txid);
+    const quint64 key = qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(txid));
+
+    // find the first entry with a key not below the one we look for. Interpolate while the
+    // range is large, a bad guess falls back to halving the range so the worst case stays logarithmic.
+    qint64 low = 0;
+    qint64 high = m_count;
+    bool interpolate = true;
+    while (high - low > 8) {
+        const quint64 lowKey = keyAt(low);
+        const quint64 highKey = keyAt(high - 1);
+        if (key <= lowKey) {
+            high = low;
+            break;
+        }
+        if (key > highKey) {
+            low = high;
+            break;
+        }
+        qint64 guess = low + (high - low) / 2;
+        if (interpolate) {
+            const double fraction = static_cast<double>(key - lowKey) / static_cast<double>(highKey - lowKey);
+            guess = qBound(low, low + static_cast<qint64>(fraction * (high - 1 - low)), high - 1);
+        }
+        const qint64 before = high - low;
+        if (keyAt(guess) < key)
+            low = guess + 1;
+        else
+            high = guess;
+        interpolate = !interpolate || (high - low) * 2 <= before; // alternate when it doesn't converge
+    }
+    while (low < high && keyAt(low) < key)
+        ++low;
+
+    // the key is only the first 8 bytes, compare the whole txid of each match.
+    for (qint64 i = low; i < m_count && keyAt(i) == key; ++i) {
+        const char *recordTxid;
+        const ConstBytes bytes = at(i, &recordTxid);
+        if (bytes.data && memcmp(recordTxid, txid, Sha256::HashSize) == 0)
+            return bytes;
+    }
+    return ConstBytes();
+}
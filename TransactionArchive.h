@@ -0,0 +1,72 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRANSACTIONARCHIVE_H
+#define TRANSACTIONARCHIVE_H
+
+#include "MessageParser.h"
+
+#include <QFile>
+
+/**
+ * TransactionArchive finds transactions by txid in an archive created by ArchiveWriter.
+ *
+ * The file is memory-mapped and used in place, opening it only checks the header and
+ * footer so it is instant regardless of the size. A lookup is an interpolation search
+ * over the sorted index, txids are uniformly distributed which makes that take only a
+ * handful of steps, and returns the transaction pointing into the mapping. Feed the
+ * bytes after the 4 byte version to a MessageParser to read the fields without copying.
+ *
+ * The archive may be used from many threads at the same time.
+ */
+class TransactionArchive
+{
+public:
+    TransactionArchive();
+    ~TransactionArchive();
+
+    /// open and map the archive, returns false if it is not a complete archive.
+    bool open(const QString &filename);
+    void close();
+
+    /// the amount of transactions in the archive.
+    inline qint64 count() const {
+        return m_count;
+    }
+
+    /**
+     * Return the v4 transaction with the 32 bytes @a txid, in hash order, or empty bytes if the
+     * archive doesn't have it. The bytes stay valid until close().
+     */
+    ConstBytes find(const char *txid) const;
+
+    /// return the transaction at @a index in txid order, and if given write its txid to @a txid.
+    ConstBytes at(qint64 index, const char **txid = 0) const;
+
+private:
+    inline quint64 keyAt(qint64 index) const;
+    ConstBytes record(quint64 offset, const char **txid) const;
+
+    QFile m_file;
+    const char *m_data;
+    qint64 m_size;
+    const char *m_index;
+    qint64 m_indexOffset;
+    qint64 m_count;
+};
+
+#endif
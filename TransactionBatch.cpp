@@ -0,0 +1,287 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TransactionBatch.h"
+
+#include <QtAlgorithms>
+#include <QtEndian>
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+# include <immintrin.h>
+# define BATCH_HAVE_AVX2
+#endif
+
+namespace {
+// true when @a count values that together have the bits of @a valueBits can not add up to more than 64 bits.
+inline bool sumFits(quint64 valueBits, int count)
+{
+    // every value is below 2^v, so their sum is below 2^(v + the bit-length of count).
+    const int v = valueBits == 0 ? 0 : 64 - qCountLeadingZeroBits(valueBits);
+    const int c = count <= 0 ? 0 : 32 - qCountLeadingZeroBits(static_cast<quint32>(count));
+    return v + c <= 64;
+}
+
+// the slow path of the sums, only taken for values too big to be real amounts.
+quint64 sumChecked(const quint64 *values, int count, bool *overflow)
+{
+    quint64 answer = 0;
+    bool wrapped = false;
+    for (int i = 0; i < count; ++i) {
+        answer += values[i];
+        wrapped |= answer < values[i]; // a sum that wrapped is smaller than the value just added
+    }
+    *overflow = wrapped;
+    return answer;
+}
+
+quint64 sumScalar(const quint64 *values, int count, bool *overflow)
+{
+    // independent accumulators, the loop is not bound by the latency of a single add.
+    quint64 a = 0, b = 0, c = 0, d = 0, bits = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        a += values[i];
+        b += values[i + 1];
+        c += values[i + 2];
+        d += values[i + 3];
+        bits |= values[i] | values[i + 1] | values[i + 2] | values[i + 3];
+    }
+    for (; i < count; ++i) {
+        a += values[i];
+        bits |= values[i];
+    }
+    if (!sumFits(bits, count))
+        return sumChecked(values, count, overflow);
+    *overflow = false;
+    return a + b + c + d;
+}
+
+int countBelowScalar(const quint64 *values, int count, quint64 threshold)
+{
+    int answer = 0;
+    for (int i = 0; i < count; ++i)
+        answer += values[i] < threshold;
+    return answer;
+}
+
+#ifdef BATCH_HAVE_AVX2
+__attribute__((target("avx2")))
+quint64 sumAvx2(const quint64 *values, int count, bool *overflow)
+{
+    __m256i a = _mm256_setzero_si256(), b = a, bits = a;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 4));
+        a = _mm256_add_epi64(a, x);
+        b = _mm256_add_epi64(b, y);
+        bits = _mm256_or_si256(bits, _mm256_or_si256(x, y));
+    }
+    quint64 lanes[4], bitLanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a, b));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(bitLanes), bits);
+    if (!sumFits(bitLanes[0] | bitLanes[1] | bitLanes[2] | bitLanes[3], i))
+        return sumChecked(values, count, overflow);
+    // the tail is checked on its own, adding it to the vector part can still wrap.
+    const quint64 head = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    const quint64 answer = head + sumScalar(values + i, count - i, overflow);
+    *overflow = *overflow || answer < head;
+    return answer;
+}
+
+__attribute__((target("avx2")))
+int countBelowAvx2(const quint64 *values, int count, quint64 threshold)
+{
+    // AVX2 only compares signed, flipping the sign bit of both sides makes that an unsigned compare.
+    const __m256i signBit = _mm256_set1_epi64x(static_cast<qint64>(Q_UINT64_C(0x8000000000000000)));
+    const __m256i limit = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<qint64>(threshold)), signBit);
+    __m256i counts = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), signBit);
+        counts = _mm256_sub_epi64(counts, _mm256_cmpgt_epi64(limit, v)); // true is -1
+    }
+    qint64 lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), counts);
+    return static_cast<int>(lanes[0] + lanes[1] + lanes[2] + lanes[3])
+            + countBelowScalar(values + i, count - i, threshold);
+}
+#endif
+
+struct ValueKernels {
+    quint64 (*sum)(const quint64 *, int, bool *);
+    int (*countBelow)(const quint64 *, int, quint64);
+};
+
+ValueKernels selectValueKernels()
+{
+    ValueKernels kernels;
+    kernels.sum = sumScalar;
+    kernels.countBelow = countBelowScalar;
+#ifdef BATCH_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.sum = sumAvx2;
+        kernels.countBelow = countBelowAvx2;
+    }
+#endif
+    return kernels;
+}
+
+const ValueKernels &valueKernels()
+{
+    static const ValueKernels kernels = selectValueKernels();
+    return kernels;
+}
+}
+
+TransactionBatch::TransactionBatch()
+{
+    clear();
+}
+
+bool TransactionBatch::append(const char *data, int size)
+{
+    if (!m_view.parse(data, size))
+        return false;
+    append(m_view);
+    return true;
+}
+
+void TransactionBatch::append(const TransactionView &view)
+{
+    foreach (const TransactionView::Input &input, view.inputs()) {
+        const int size = qMin(32, input.prevHash.length);
+        m_prevHashes.append(view.at(input.prevHash), size);
+        for (int i = size; i < 32; ++i)
+            m_prevHashes.append('\0');
+        m_prevIndexes.append(input.prevIndex);
+    }
+    foreach (const TransactionView::Output &output, view.outputs()) {
+        m_values.append(output.value);
+        m_scripts.append(view.at(output.script), output.script.length);
+        m_scriptOffsets.append(m_scripts.size());
+    }
+    m_inputStarts.append(m_prevIndexes.size());
+    m_outputStarts.append(m_values.size());
+}
+
+void TransactionBatch::clear()
+{
+    // QVector keeps its capacity on clear(), a QByteArray only after reserving it.
+    m_inputStarts.clear();
+    m_inputStarts.append(0);
+    m_outputStarts.clear();
+    m_outputStarts.append(0);
+    m_prevHashes.reserve(m_prevHashes.capacity());
+    m_prevHashes.resize(0);
+    m_prevIndexes.clear();
+    m_values.clear();
+    m_scriptOffsets.clear();
+    m_scriptOffsets.append(0);
+    m_scripts.reserve(m_scripts.capacity());
+    m_scripts.resize(0);
+}
+
+QVector<qint64> TransactionBatch::valueHistogram() const
+{
+    // four sub-histograms, consecutive values in the same bucket don't wait for each other's increment.
+    qint64 buckets[4][65];
+    memset(buckets, 0, sizeof(buckets));
+    const quint64 *values = m_values.constData();
+    const int count = m_values.size();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        for (int j = 0; j < 4; ++j) {
+            const quint64 value = values[i + j];
+            ++buckets[j][value == 0 ? 0 : 64 - qCountLeadingZeroBits(value)];
+        }
+    }
+    for (; i < count; ++i)
+        ++buckets[0][values[i] == 0 ? 0 : 64 - qCountLeadingZeroBits(values[i])];
+
+    QVector<qint64> answer(65, 0);
+    for (int b = 0; b < 65; ++b)
+        answer[b] = buckets[0][b] + buckets[1][b] + buckets[2][b] + buckets[3][b];
+    return answer;
+}
+
+template<typename Visitor>
+void TransactionBatch::matchScripts(const char *prefix, int prefixSize, int scriptLength, Visitor visitor) const
+{
+    Q_ASSERT(prefixSize >= 0);
+    // compare the first 8 bytes as one word, only longer prefixes need a memcmp.
+    const int wordSize = qMin(8, prefixSize);
+    uchar buffer[8] = { 0 };
+    memcpy(buffer, prefix, wordSize);
+    const quint64 wanted = qFromLittleEndian<quint64>(buffer);
+    const quint64 mask = wordSize == 8 ? ~Q_UINT64_C(0) : (Q_UINT64_C(1) << (8 * wordSize)) - 1;
+
+    const char *scripts = m_scripts.constData();
+    const int scriptsSize = m_scripts.size();
+    const int *offsets = m_scriptOffsets.constData();
+    const int count = m_values.size();
+    for (int i = 0; i < count; ++i) {
+        const int start = offsets[i];
+        const int length = offsets[i + 1] - start;
+        if (scriptLength >= 0 ? length != scriptLength : length < prefixSize)
+            continue;
+        quint64 word;
+        if (scriptsSize - start >= 8) {
+            word = qFromLittleEndian<quint64>(scripts + start);
+        } else { // the last script of the blob
+            memset(buffer, 0, 8);
+            memcpy(buffer, scripts + start, qMin(length, 8));
+            word = qFromLittleEndian<quint64>(buffer);
+        }
+        if ((word & mask) != wanted)
+            continue;
+        if (prefixSize > 8 && memcmp(scripts + start + 8, prefix + 8, prefixSize - 8) != 0)
+            continue;
+        visitor(i);
+    }
+}
+
+QVector<int> TransactionBatch::findScriptPrefix(const char *prefix, int prefixSize, int scriptLength) const
+{
+    QVector<int> answer;
+    matchScripts(prefix, prefixSize, scriptLength, [&answer](int output) { answer.append(output); });
+    return answer;
+}
+
+int TransactionBatch::countScriptPrefix(const char *prefix, int prefixSize, int scriptLength) const
+{
+    int answer = 0;
+    matchScripts(prefix, prefixSize, scriptLength, [&answer](int) { ++answer; });
+    return answer;
+}
+
+quint64 TransactionBatch::sum(const quint64 *values, int count, bool *overflow)
+{
+    bool wrapped;
+    const quint64 answer = valueKernels().sum(values, count, &wrapped);
+    if (overflow)
+        *overflow = wrapped;
+    return answer;
+}
+
+int TransactionBatch::countBelow(const quint64 *values, int count, quint64 threshold)
+{
+    return valueKernels().countBelow(values, count, threshold);
+}
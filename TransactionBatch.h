@@ -0,0 +1,134 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRANSACTIONBATCH_H
+#define TRANSACTIONBATCH_H
+
+#include "TransactionView.h"
+
+#include <QByteArray>
+#include <QVector>
+
+/**
+ * TransactionBatch stores the inputs and outputs of many transactions in columns.
+ *
+ * Instead of a list of objects per transaction, each field is one contiguous array
+ * over the whole batch: the output values, the prev-hashes, and the output scripts
+ * concatenated in one blob with an offsets column pointing into it. Scans that only
+ * look at a single field, like summing values, then run at memory speed.
+ *
+ * Transaction t owns the inputs inputStarts()[t] up to inputStarts()[t + 1], and
+ * likewise for its outputs. clear() keeps all capacity for the next batch.
+ */
+class TransactionBatch
+{
+public:
+    TransactionBatch();
+
+    /// parse the transaction and append it, returns false (and appends nothing) if it is malformed.
+    bool append(const char *data, int size);
+    inline bool append(const QByteArray &transaction) {
+        return append(transaction.constData(), transaction.size());
+    }
+    /// append the transaction the @a view parsed.
+    void append(const TransactionView &view);
+    void clear();
+
+    inline int transactionCount() const {
+        return m_inputStarts.size() - 1;
+    }
+    inline int inputCount() const {
+        return m_prevIndexes.size();
+    }
+    inline int outputCount() const {
+        return m_values.size();
+    }
+
+    inline const QVector<int> &inputStarts() const {
+        return m_inputStarts;
+    }
+    inline const QVector<int> &outputStarts() const {
+        return m_outputStarts;
+    }
+
+    /// the 32 bytes prev-hash of @a input, in the byte-order of the format it was read from.
+    inline const char *prevHash(int input) const {
+        return m_prevHashes.constData() + input * 32;
+    }
+    inline const QVector<int> &prevIndexes() const {
+        return m_prevIndexes;
+    }
+
+    inline const QVector<quint64> &values() const {
+        return m_values;
+    }
+    /// the script of output @a output is at scriptOffsets()[output] up to scriptOffsets()[output + 1] in scriptData().
+    inline const QVector<int> &scriptOffsets() const {
+        return m_scriptOffsets;
+    }
+    inline const QByteArray &scriptData() const {
+        return m_scripts;
+    }
+    /// return a QByteArray referencing, not copying, the script of @a output.
+    inline QByteArray script(int output) const {
+        return QByteArray::fromRawData(m_scripts.constData() + m_scriptOffsets.at(output),
+                                       m_scriptOffsets.at(output + 1) - m_scriptOffsets.at(output));
+    }
+
+    /// return the sum of all output values, @a overflow is set when it did not fit in 64 bits.
+    inline quint64 totalValue(bool *overflow = 0) const {
+        return sum(m_values.constData(), m_values.size(), overflow);
+    }
+    /// return the amount of outputs worth less than @a threshold satoshis, like dust.
+    inline int countBelow(quint64 threshold) const {
+        return countBelow(m_values.constData(), m_values.size(), threshold);
+    }
+    /**
+     * return the amount of outputs per bit-length of their value, in 65 buckets.
+     * Bucket 0 holds the zero values, bucket n those from 2^(n-1) up to 2^n - 1.
+     */
+    QVector<qint64> valueHistogram() const;
+
+    /**
+     * return the indexes of the outputs whose script starts with the @a prefixSize bytes of @a prefix.
+     * If @a scriptLength is not negative the script also has to be exactly that long.
+     * This is a byte compare only, to know the type of a script use ScriptClassifier.
+     */
+    QVector<int> findScriptPrefix(const char *prefix, int prefixSize, int scriptLength = -1) const;
+    /// return the amount of outputs findScriptPrefix() would return.
+    int countScriptPrefix(const char *prefix, int prefixSize, int scriptLength = -1) const;
+
+    // the kernels behind the reductions, using AVX2 when the CPU has it.
+    /// return the sum of the @a count values, @a overflow is set when it wrapped around.
+    static quint64 sum(const quint64 *values, int count, bool *overflow = 0);
+    static int countBelow(const quint64 *values, int count, quint64 threshold);
+
+private:
+    template<typename Visitor>
+    void matchScripts(const char *prefix, int prefixSize, int scriptLength, Visitor visitor) const;
+
+    TransactionView m_view;
+    QVector<int> m_inputStarts;
+    QVector<int> m_outputStarts;
+    QByteArray m_prevHashes;
+    QVector<int> m_prevIndexes;
+    QVector<quint64> m_values;
+    QVector<int> m_scriptOffsets;
+    QByteArray m_scripts;
+};
+
+#endif
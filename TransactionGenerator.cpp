@@ -0,0 +1,477 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TransactionGenerator.h"
+#include "Transaction.h"
+#include "MessageBuilder.h"
+
+#include <QStringList>
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+// script opcodes used in the templates
+enum {
+    Op0 = 0x00,
+    OpPushData1 = 0x4c,
+    OpPushData2 = 0x4d,
+    OpPushData4 = 0x4e,
+    Op1 = 0x51,
+    Op2 = 0x52,
+    Op3 = 0x53,
+    OpReturn = 0x6a,
+    OpDup = 0x76,
+    OpEqual = 0x87,
+    OpEqualVerify = 0x88,
+    OpHash160 = 0xa9,
+    OpCheckSig = 0xac,
+    OpCheckMultiSig = 0xae
+};
+
+const int SignatureSize = 72;
+const int PubKeySize = 33;
+
+inline void appendByte(QByteArray &out, int byte)
+{
+    out.append(static_cast<char>(byte));
+}
+
+inline void appendInt(QByteArray &out, quint64 value, int bytes)
+{
+    char buf[8];
+    for (int i = 0; i < bytes; ++i)
+        buf[i] = static_cast<char>(value >> (i * 8));
+    out.append(buf, bytes);
+}
+
+void appendCompact(QByteArray &out, quint64 value)
+{
+    if (value < 253) {
+        appendByte(out, value);
+    } else if (value <= 0xFFFF) {
+        appendByte(out, 253);
+        appendInt(out, value, 2);
+    } else if (value <= 0xFFFFFFFF) {
+        appendByte(out, 254);
+        appendInt(out, value, 4);
+    } else {
+        appendByte(out, 255);
+        appendInt(out, value, 8);
+    }
+}
+
+int pushPrefixSize(int size)
+{
+    if (size < OpPushData1)
+        return 1;
+    if (size <= 0xFF)
+        return 2;
+    return size <= 0xFFFF ? 3 : 5;
+}
+
+// the opcode(s) that push @a size bytes
+void appendPushPrefix(QByteArray &out, int size)
+{
+    if (size < OpPushData1) {
+        appendByte(out, size);
+    } else if (size <= 0xFF) {
+        appendByte(out, OpPushData1);
+        appendInt(out, size, 1);
+    } else if (size <= 0xFFFF) {
+        appendByte(out, OpPushData2);
+        appendInt(out, size, 2);
+    } else {
+        appendByte(out, OpPushData4);
+        appendInt(out, size, 4);
+    }
+}
+}
+
+TransactionGenerator::Distribution::Distribution(int value)
+    : m_kind(Fixed),
+      m_min(value),
+      m_max(value),
+      m_logFailure(0)
+{
+}
+
+TransactionGenerator::Distribution TransactionGenerator::Distribution::uniform(int min, int max)
+{
+    Q_ASSERT(min <= max);
+    Distribution answer(min);
+    answer.m_kind = Uniform;
+    answer.m_max = max;
+    return answer;
+}
+
+TransactionGenerator::Distribution TransactionGenerator::Distribution::geometric(double mean, int max)
+{
+    Q_ASSERT(mean >= 1);
+    Distribution answer(1);
+    answer.m_kind = mean > 1 ? Geometric : Fixed;
+    answer.m_max = max;
+    answer.m_logFailure = log(1 - 1 / mean);
+    return answer;
+}
+
+bool TransactionGenerator::Distribution::parse(const QString &spec, Distribution &result)
+{
+    bool ok, ok2;
+    if (spec.startsWith("geo:")) {
+        const double mean = spec.mid(4).toDouble(&ok);
+        if (!ok || mean < 1)
+            return false;
+        result = geometric(mean, 1000000);
+        return true;
+    }
+    const int dash = spec.indexOf('-');
+    if (dash > 0) {
+        const int min = spec.left(dash).toInt(&ok);
+        const int max = spec.mid(dash + 1).toInt(&ok2);
+        if (!ok || !ok2 || min < 0 || max < min)
+            return false;
+        result = uniform(min, max);
+        return true;
+    }
+    const int value = spec.toInt(&ok);
+    if (!ok || value < 0)
+        return false;
+    result = Distribution(value);
+    return true;
+}
+
+TransactionGenerator::TransactionGenerator(quint64 seed)
+    : m_state(seed * 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL), // never zero, for xorshift
+      m_inputCounts(Distribution::geometric(1.8, 2000)),
+      m_outputCounts(Distribution::uniform(1, 3)),
+      m_pushSizes(Distribution::uniform(8, 80))
+{
+    m_weights[PayToPubKeyHash] = 75;
+    m_weights[PayToScriptHash] = 15;
+    m_weights[BareMultiSig] = 3;
+    m_weights[NullData] = 7;
+    m_versions << 1 << 2;
+}
+
+void TransactionGenerator::setInputCounts(const Distribution &distribution)
+{
+    m_inputCounts = distribution;
+}
+
+void TransactionGenerator::setOutputCounts(const Distribution &distribution)
+{
+    m_outputCounts = distribution;
+}
+
+void TransactionGenerator::setPushSizes(const Distribution &distribution)
+{
+    m_pushSizes = distribution;
+}
+
+void TransactionGenerator::setTemplateWeight(ScriptTemplate scriptTemplate, int weight)
+{
+    Q_ASSERT(scriptTemplate >= 0 && scriptTemplate < TemplateCount);
+    Q_ASSERT(weight >= 0);
+    m_weights[scriptTemplate] = weight;
+}
+
+bool TransactionGenerator::setTemplateWeights(const QString &spec)
+{
+    static const char *names[TemplateCount] = { "p2pkh", "p2sh", "multisig", "opreturn" };
+    foreach (const QString &part, spec.split(',')) {
+        const int equals = part.indexOf('=');
+        bool ok;
+        const int weight = part.mid(equals + 1).toInt(&ok);
+        if (equals <= 0 || !ok || weight < 0)
+            return false;
+        const QString name = part.left(equals).trimmed();
+        int i = 0;
+        while (i < TemplateCount && name != QLatin1String(names[i]))
+            ++i;
+        if (i == TemplateCount)
+            return false;
+        m_weights[i] = weight;
+    }
+    // inputs need at least one template that can be spent.
+    return m_weights[PayToPubKeyHash] + m_weights[PayToScriptHash] + m_weights[BareMultiSig] > 0;
+}
+
+void TransactionGenerator::setVersions(const QList<int> &versions)
+{
+    Q_ASSERT(!versions.isEmpty());
+    m_versions = versions;
+}
+
+quint64 TransactionGenerator::random()
+{
+    // xorshift64*
+    m_state ^= m_state >> 12;
+    m_state ^= m_state << 25;
+    m_state ^= m_state >> 27;
+    return m_state * 0x2545F4914F6CDD1DULL;
+}
+
+int TransactionGenerator::sample(const Distribution &distribution)
+{
+    switch (distribution.m_kind) {
+    case Distribution::Fixed:
+        return distribution.m_min;
+    case Distribution::Uniform:
+        return distribution.m_min + random() % (distribution.m_max - distribution.m_min + 1);
+    case Distribution::Geometric: {
+        // inverse transform sampling, using 53 random bits for a uniform (0, 1]
+        const double uniform = ((random() >> 11) + 1) * (1.0 / 9007199254740992.0);
+        const double value = 1 + floor(log(uniform) / distribution.m_logFailure);
+        return value >= distribution.m_max ? distribution.m_max : static_cast<int>(value);
+    }
+    }
+    return distribution.m_min;
+}
+
+TransactionGenerator::ScriptTemplate TransactionGenerator::pickTemplate(bool forInput)
+{
+    const int count = forInput ? NullData : TemplateCount; // OP_RETURN outputs can't be spent
+    int total = 0;
+    for (int i = 0; i < count; ++i)
+        total += m_weights[i];
+    Q_ASSERT(total > 0);
+    int pick = random() % total;
+    for (int i = 0; i < count; ++i) {
+        pick -= m_weights[i];
+        if (pick < 0)
+            return static_cast<ScriptTemplate>(i);
+    }
+    return PayToPubKeyHash;
+}
+
+void TransactionGenerator::appendRandom(QByteArray &out, int size)
+{
+    const int start = out.size();
+    out.resize(start + size);
+    char *data = out.data() + start;
+    while (size >= 8) {
+        const quint64 value = random();
+        memcpy(data, &value, 8);
+        data += 8;
+        size -= 8;
+    }
+    if (size > 0) {
+        const quint64 value = random();
+        memcpy(data, &value, size);
+    }
+}
+
+// a random compressed pubkey, which starts with 2 or 3.
+void TransactionGenerator::appendPubKey(QByteArray &out)
+{
+    appendRandom(out, PubKeySize);
+    char *prefix = out.data() + out.size() - PubKeySize;
+    *prefix = 2 + (*prefix & 1);
+}
+
+void TransactionGenerator::createInputItems(ScriptTemplate scriptTemplate)
+{
+    // every item is stored in m_scratch, m_items references them.
+    Item item;
+    switch (scriptTemplate) {
+    case PayToPubKeyHash:
+        for (int i = 0; i < 2; ++i) {
+            item.offset = m_scratch.size();
+            item.size = i == 0 ? SignatureSize : PubKeySize;
+            if (i == 0)
+                appendRandom(m_scratch, item.size);
+            else
+                appendPubKey(m_scratch);
+            m_items.append(item);
+        }
+        break;
+    case PayToScriptHash: // OP_0 <sig> <sig> <OP_2 <key> <key> <key> OP_3 OP_CHECKMULTISIG>
+    case BareMultiSig: { // OP_0 <sig>
+        item.offset = m_scratch.size();
+        item.size = 1;
+        appendByte(m_scratch, Op0);
+        m_items.append(item);
+        const int signatures = scriptTemplate == PayToScriptHash ? 2 : 1;
+        for (int i = 0; i < signatures; ++i) {
+            item.offset = m_scratch.size();
+            item.size = SignatureSize;
+            appendRandom(m_scratch, item.size);
+            m_items.append(item);
+        }
+        if (scriptTemplate == PayToScriptHash) {
+            item.offset = m_scratch.size();
+            appendByte(m_scratch, Op2);
+            for (int i = 0; i < 3; ++i) {
+                appendByte(m_scratch, PubKeySize);
+                appendPubKey(m_scratch);
+            }
+            appendByte(m_scratch, Op3);
+            appendByte(m_scratch, OpCheckMultiSig);
+            item.size = m_scratch.size() - item.offset;
+            m_items.append(item);
+        }
+        break;
+    }
+    default:
+        Q_ASSERT(false);
+    }
+}
+
+void TransactionGenerator::appendOutputScript(QByteArray &out, ScriptTemplate scriptTemplate)
+{
+    switch (scriptTemplate) {
+    case PayToPubKeyHash:
+        appendByte(out, OpDup);
+        appendByte(out, OpHash160);
+        appendByte(out, 20);
+        appendRandom(out, 20);
+        appendByte(out, OpEqualVerify);
+        appendByte(out, OpCheckSig);
+        break;
+    case PayToScriptHash:
+        appendByte(out, OpHash160);
+        appendByte(out, 20);
+        appendRandom(out, 20);
+        appendByte(out, OpEqual);
+        break;
+    case BareMultiSig:
+        appendByte(out, Op1);
+        for (int i = 0; i < 3; ++i) {
+            appendByte(out, PubKeySize);
+            appendPubKey(out);
+        }
+        appendByte(out, Op3);
+        appendByte(out, OpCheckMultiSig);
+        break;
+    case NullData: {
+        appendByte(out, OpReturn);
+        const int size = sample(m_pushSizes);
+        appendPushPrefix(out, size);
+        appendRandom(out, size);
+        break;
+    }
+    default:
+        Q_ASSERT(false);
+    }
+}
+
+quint64 TransactionGenerator::createValue()
+{
+    // spread over the orders of magnitude, from 1 satoshi to about 10000 BCH.
+    static const quint64 scales[13] = {
+        10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+        1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 1000000000000ULL
+    };
+    return 1 + random() % scales[random() % 13];
+}
+
+void TransactionGenerator::next(QByteArray &out)
+{
+    m_inputs.clear();
+    m_outputs.clear();
+    m_items.clear();
+    m_scratch.resize(0);
+
+    const int inputCount = qMax(1, sample(m_inputCounts));
+    for (int i = 0; i < inputCount; ++i) {
+        Input input;
+        const quint64 hash[4] = { random(), random(), random(), random() };
+        memcpy(input.prevHash, hash, 32);
+        input.prevIndex = (random() % 4) ? random() % 2 : random() % 50;
+        input.firstItem = m_items.size();
+        createInputItems(pickTemplate(true));
+        input.itemCount = m_items.size() - input.firstItem;
+        m_inputs.append(input);
+    }
+    const int outputCount = qMax(1, sample(m_outputCounts));
+    for (int i = 0; i < outputCount; ++i) {
+        Output output;
+        const ScriptTemplate scriptTemplate = pickTemplate(false);
+        output.value = scriptTemplate == NullData ? 0 : createValue();
+        output.scriptOffset = m_scratch.size();
+        appendOutputScript(m_scratch, scriptTemplate);
+        output.scriptSize = m_scratch.size() - output.scriptOffset;
+        m_outputs.append(output);
+    }
+
+    const int version = m_versions.at(random() % m_versions.size());
+    if (version == 4)
+        writeV4(out);
+    else
+        writeLegacy(out, version);
+}
+
+void TransactionGenerator::writeLegacy(QByteArray &out, int version)
+{
+    const char *scratch = m_scratch.constData();
+    appendInt(out, version, 4);
+    appendCompact(out, m_inputs.size());
+    foreach (const Input &input, m_inputs) {
+        out.append(input.prevHash, 32);
+        appendInt(out, input.prevIndex, 4);
+        int scriptSize = 0;
+        for (int i = input.firstItem; i < input.firstItem + input.itemCount; ++i) {
+            const Item &item = m_items.at(i);
+            const bool opZero = item.size == 1 && scratch[item.offset] == Op0;
+            scriptSize += item.size + (opZero ? 0 : pushPrefixSize(item.size));
+        }
+        appendCompact(out, scriptSize);
+        for (int i = input.firstItem; i < input.firstItem + input.itemCount; ++i) {
+            const Item &item = m_items.at(i);
+            if (item.size == 1 && scratch[item.offset] == Op0) { // the opcode is the item
+                appendByte(out, Op0);
+                continue;
+            }
+            appendPushPrefix(out, item.size);
+            out.append(scratch + item.offset, item.size);
+        }
+        appendInt(out, 0xFFFFFFFF, 4);
+    }
+    appendCompact(out, m_outputs.size());
+    foreach (const Output &output, m_outputs) {
+        appendInt(out, output.value, 8);
+        appendCompact(out, output.scriptSize);
+        out.append(scratch + output.scriptOffset, output.scriptSize);
+    }
+    appendInt(out, 0, 4); // nLockTime
+}
+
+void TransactionGenerator::writeV4(QByteArray &out)
+{
+    const char *scratch = m_scratch.constData();
+    static const char version[4] = { 4, 0, 0, 0 };
+    MessageBuilder builder(&out);
+    builder.addRaw(version, sizeof(version));
+    foreach (const Input &input, m_inputs) {
+        builder.add(Transaction::TxInPrevHash, QByteArray::fromRawData(input.prevHash, 32));
+        if (input.prevIndex > 0)
+            builder.add(Transaction::TxInPrevIndex, input.prevIndex);
+    }
+    foreach (const Output &output, m_outputs) {
+        builder.add(Transaction::TxOutScript, QByteArray::fromRawData(scratch + output.scriptOffset, output.scriptSize));
+        builder.add(Transaction::TxOutValue, output.value);
+    }
+    foreach (const Input &input, m_inputs) {
+        for (int i = 0; i < input.itemCount; ++i) {
+            const Item &item = m_items.at(input.firstItem + i);
+            builder.add(i == 0 ? Transaction::TxInputStackItem : Transaction::TxInputStackItemContinued,
+                        QByteArray::fromRawData(scratch + item.offset, item.size));
+        }
+    }
+    builder.add(Transaction::TxEnd, true);
+}
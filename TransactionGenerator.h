@@ -0,0 +1,133 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRANSACTIONGENERATOR_H
+#define TRANSACTIONGENERATOR_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+/**
+ * TransactionGenerator creates a deterministic stream of synthetic, but realistically
+ * shaped, transactions for load testing. The same seed and settings always give the
+ * same transactions.
+ *
+ * Legacy (version 1 and 2) and v4 transactions can be generated, the output scripts are
+ * picked by weight from a set of templates and inputs spend a matching type of script.
+ * Signatures and keys are random bytes, the transactions are not valid on any chain.
+ */
+class TransactionGenerator
+{
+public:
+    explicit TransactionGenerator(quint64 seed);
+
+    /// A distribution of whole numbers.
+    class Distribution
+    {
+    public:
+        /// always returns @a value.
+        Distribution(int value = 1);
+        static Distribution uniform(int min, int max);
+        /// a geometric distribution with the given mean, starting at 1 and capped at @a max.
+        static Distribution geometric(double mean, int max);
+
+        /**
+         * Parse @a spec which is either a number ("5"), a range for a uniform
+         * distribution ("1-10") or "geo:MEAN" for a geometric distribution.
+         * Returns false if the spec is not understood.
+         */
+        static bool parse(const QString &spec, Distribution &result);
+
+    private:
+        friend class TransactionGenerator;
+        enum Kind {
+            Fixed,
+            Uniform,
+            Geometric
+        };
+        Kind m_kind;
+        int m_min, m_max;
+        double m_logFailure; // log(1 - p) of the geometric distribution
+    };
+
+    enum ScriptTemplate {
+        PayToPubKeyHash,
+        PayToScriptHash,    // inputs spend a 2-of-3 multisig redeem script
+        BareMultiSig,       // 1-of-3
+        NullData,           // OP_RETURN, only used for outputs
+        TemplateCount
+    };
+
+    void setInputCounts(const Distribution &distribution);
+    void setOutputCounts(const Distribution &distribution);
+    /// sizes of the OP_RETURN payloads, larger sizes select PUSHDATA1, 2 or 4.
+    void setPushSizes(const Distribution &distribution);
+    /// the relative chance of a template to be picked, zero disables it.
+    void setTemplateWeight(ScriptTemplate scriptTemplate, int weight);
+    /**
+     * Set the weights from a spec like "p2pkh=70,p2sh=20,multisig=5,opreturn=5".
+     * Templates not mentioned keep their weight. Returns false on errors.
+     */
+    bool setTemplateWeights(const QString &spec);
+    /// the transaction versions to generate (1, 2 or 4), picked with equal chance.
+    void setVersions(const QList<int> &versions);
+
+    /// append the next transaction to @a out.
+    void next(QByteArray &out);
+
+private:
+    struct Item { // a pushed item of an input script, in m_scratch
+        int offset, size;
+    };
+
+    quint64 random();
+    int sample(const Distribution &distribution);
+    ScriptTemplate pickTemplate(bool forInput);
+    void appendRandom(QByteArray &out, int size);
+    void appendPubKey(QByteArray &out);
+    void createInputItems(ScriptTemplate scriptTemplate);
+    void appendOutputScript(QByteArray &out, ScriptTemplate scriptTemplate);
+    quint64 createValue();
+    void writeLegacy(QByteArray &out, int version);
+    void writeV4(QByteArray &out);
+
+    quint64 m_state;
+    Distribution m_inputCounts;
+    Distribution m_outputCounts;
+    Distribution m_pushSizes;
+    int m_weights[TemplateCount];
+    QList<int> m_versions;
+
+    // the transaction being generated
+    struct Input {
+        char prevHash[32];
+        int prevIndex;
+        int firstItem, itemCount;
+    };
+    struct Output {
+        quint64 value;
+        int scriptOffset, scriptSize; // in m_scratch
+    };
+    QVector<Input> m_inputs;
+    QVector<Output> m_outputs;
+    QVector<Item> m_items;
+    QByteArray m_scratch;
+};
+
+#endif
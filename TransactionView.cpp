@@ -0,0 +1,235 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TransactionView.h"
+#include "Transaction.h"
+#include "MessageParser.h"
+#include "ScriptTokenizer.h"
+#include "StreamMethods.h"
+
+
+TransactionView::TransactionView()
+    : m_error(NoError),
+      m_errorDetail(0),
+      m_data(0),
+      m_size(0),
+      m_version(-1),
+      m_nLockTime(0)
+{
+}
+
+bool TransactionView::parse(const char *data, int length)
+{
+    Q_ASSERT(data);
+    m_error = NoError;
+    m_data = data;
+    m_size = length;
+    m_version = -1;
+    m_nLockTime = 0;
+    m_coinbaseMessage = Range();
+    // clear() keeps the capacity, making a reused view allocation-free.
+    m_inputs.clear();
+    m_outputs.clear();
+    m_scriptItems.clear();
+
+    if (length <= 4 || data[1] != 0 || data[2] != 0 || data[3] != 0)
+        return fail(UnknownFormat);
+    m_version = Streaming::fetch32bitValue(data, 0);
+    if (m_version <= 2)
+        return parseLegacy();
+    if (m_version == 4)
+        return parseV4();
+    return fail(UnknownVersion, m_version);
+}
+
+QString TransactionView::errorString() const
+{
+    switch (m_error) {
+    case NoError: return QString();
+    case UnknownFormat: return QString("Unknown transaction format, can't parse.");
+    case UnknownVersion: return QString("Unknown transaction version %1, can't parse.").arg(m_errorDetail);
+    case TruncatedInputs: return QString("Tx truncated while reading inputs");
+    case InputScriptOutOfBounds: return QString("ScriptLength (in/%1) out of bounds").arg(m_errorDetail);
+    case TruncatedOutputs: return QString("Tx truncated while reading outputs");
+    case OutputScriptOutOfBounds: return QString("ScriptLength (output/%1) out of bounds").arg(m_errorDetail);
+    case WrongLength: return QString("length of tx incorrect (%1, expected %2)").arg(m_size).arg(m_errorDetail);
+    case PrevIndexWithoutHash: return QString("TxInPrevIndex seen without a TxInPrevHash before it");
+    case MalformedMessage: return QString("Failed parsing transaction, MessageParser gave error.");
+    }
+    return QString();
+}
+
+bool TransactionView::fail(ParseError error, qint64 detail)
+{
+    m_error = error;
+    m_errorDetail = detail;
+    return false;
+}
+
+bool TransactionView::isCoinbase() const
+{
+    if (m_version == 4)
+        return m_inputs.isEmpty();
+    // legacy coinbases have a single input spending the null outpoint.
+    if (m_inputs.size() != 1 || m_inputs.first().prevIndex != -1)
+        return false;
+    const char *hash = at(m_inputs.first().prevHash);
+    for (int i = 0; i < m_inputs.first().prevHash.length; ++i) {
+        if (hash[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+bool TransactionView::parseLegacy()
+{
+    qint64 pos = 4;
+    quint64 count;
+    if (!Streaming::fetchBitcoinCompact(m_data, m_size, pos, count) || count > (quint64) m_size)
+        return fail(TruncatedInputs);
+    for (quint64 i = 0; i < count; ++i) {
+        Input input;
+        if (pos + 36 > m_size)
+            return fail(TruncatedInputs);
+        input.prevHash = Range(pos, 32);
+        input.prevIndex = Streaming::fetch32bitValue(m_data, pos + 32);
+        pos += 36;
+        quint64 scriptLength;
+        if (!Streaming::fetchBitcoinCompact(m_data, m_size, pos, scriptLength)
+                || scriptLength + 4 > (quint64) (m_size - pos))
+            return fail(InputScriptOutOfBounds, i);
+        input.script = Range(pos, scriptLength);
+        parseInputScript(input);
+        pos += scriptLength;
+        input.sequence = Streaming::fetch32bitValue(m_data, pos);
+        pos += 4;
+        m_inputs.append(input);
+    }
+
+    if (!Streaming::fetchBitcoinCompact(m_data, m_size, pos, count) || count > (quint64) m_size)
+        return fail(TruncatedOutputs);
+    for (quint64 i = 0; i < count; ++i) {
+        Output output;
+        if (pos + 8 > m_size)
+            return fail(TruncatedOutputs);
+        output.value = Streaming::fetch64bitValue(m_data, pos);
+        pos += 8;
+        quint64 scriptLength;
+        if (!Streaming::fetchBitcoinCompact(m_data, m_size, pos, scriptLength)
+                || scriptLength > (quint64) (m_size - pos))
+            return fail(OutputScriptOutOfBounds, i);
+        output.script = Range(pos, scriptLength);
+        pos += scriptLength;
+        m_outputs.append(output);
+    }
+
+    if (pos + 4 != m_size)
+        return fail(WrongLength, pos + 4);
+    m_nLockTime = Streaming::fetch32bitValue(m_data, pos);
+    return true;
+}
+
+void TransactionView::parseInputScript(Input &input)
+{
+    input.firstItem = m_scriptItems.size();
+    ScriptTokenizer tokenizer(m_data + input.script.offset, input.script.length);
+    ScriptTokenizer::Type type = tokenizer.next();
+    while (type == ScriptTokenizer::FoundOpcode && tokenizer.isPush()) {
+        if (tokenizer.opcode() == 0) // OP_FALSE, the opcode itself doubles as the item.
+            m_scriptItems.append(Range(input.script.offset + tokenizer.opcodeStart(), 1));
+        else
+            m_scriptItems.append(Range(input.script.offset + tokenizer.dataStart(), tokenizer.dataLength()));
+        type = tokenizer.next();
+    }
+    if (type != ScriptTokenizer::EndOfScript) { // only push-only scripts get items.
+        m_scriptItems.resize(input.firstItem);
+        input.itemCount = 0;
+        return;
+    }
+    input.itemCount = m_scriptItems.size() - input.firstItem;
+}
+
+bool TransactionView::parseV4()
+{
+    const int bodyOffset = 4;
+    MessageParser parser(m_data + bodyOffset, m_size - bodyOffset);
+    int inputScriptCount = -1;
+    bool storedOutValue = false, storedOutScript = false;
+    quint64 outValue = 0;
+
+    MessageParser::Type type = parser.next();
+    while (type == MessageParser::FoundTag) {
+        const Range range(bodyOffset + parser.dataStart(), parser.dataLength());
+        switch (parser.tag()) {
+        case Transaction::TxInPrevHash: {
+            Input input;
+            input.prevHash = range;
+            input.firstItem = m_scriptItems.size();
+            m_inputs.append(input);
+            break;
+        }
+        case Transaction::TxInPrevIndex:
+            if (m_inputs.isEmpty())
+                return fail(PrevIndexWithoutHash);
+            m_inputs.last().prevIndex = parser.longData();
+            break;
+        case Transaction::TxInputStackItem:
+            ++inputScriptCount;
+            if (inputScriptCount < m_inputs.size())
+                m_inputs[inputScriptCount].firstItem = m_scriptItems.size();
+            // fall through
+        case Transaction::TxInputStackItemContinued:
+            if (inputScriptCount < 0)
+                inputScriptCount = 0;
+            if (inputScriptCount >= m_inputs.size())
+                break;
+            m_scriptItems.append(range);
+            ++m_inputs[inputScriptCount].itemCount;
+            break;
+        case Transaction::TxOutValue:
+            if (storedOutScript) {
+                m_outputs.last().value = parser.longData();
+                storedOutScript = storedOutValue = false;
+            } else {
+                outValue = parser.longData();
+                storedOutValue = true;
+            }
+            break;
+        case Transaction::TxOutScript: {
+            Output output;
+            output.script = range;
+            output.value = outValue;
+            m_outputs.append(output);
+            if (storedOutValue)
+                storedOutValue = false;
+            else
+                storedOutScript = true;
+            break;
+        }
+        case Transaction::CoinbaseMessage:
+            m_coinbaseMessage = range;
+            break;
+        default: // the view is lenient, unknown tags are skipped.
+            break;
+        }
+        type = parser.next();
+    }
+
+    if (type != MessageParser::EndOfDocument)
+        return fail(MalformedMessage);
+    return true;
+}
@@ -0,0 +1,162 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRANSACTIONVIEW_H
+#define TRANSACTIONVIEW_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/**
+ * TransactionView is a read-only, zero-copy alternative to Transaction.
+ *
+ * Instead of copying hashes and scripts into their own QByteArray, the view
+ * only records where they are in the buffer it was handed. This makes it
+ * useful for bulk scans that only look at a couple of fields.
+ * The buffer has to stay alive and unchanged as long as the view is used.
+ *
+ * Both the legacy (version 1 and 2) and the v4 (CMF) formats are supported.
+ * The view can be reused for many transactions, parse() keeps the allocated
+ * capacity so after a warm-up no allocations happen at all.
+ */
+class TransactionView
+{
+public:
+    TransactionView();
+
+    /// a location in the buffer, offsets are relative to the start of the transaction.
+    struct Range {
+        Range() : offset(0), length(0) {}
+        Range(int o, int l) : offset(o), length(l) {}
+        int offset;
+        int length;
+    };
+
+    struct Input {
+        Input() : prevIndex(0), sequence(0), firstItem(0), itemCount(0) {}
+        /**
+         * The 32 bytes hash of the transaction this input spends.
+         * Legacy transactions store this in reverse byte-order compared to v4.
+         */
+        Range prevHash;
+        int prevIndex;
+        unsigned int sequence; // legacy only
+        Range script; // legacy only, the complete input script
+        /**
+         * The pushed items of the input script, stored in scriptItems().
+         * For legacy scripts that are not push-only itemCount is zero.
+         */
+        int firstItem;
+        int itemCount;
+    };
+
+    struct Output {
+        Output() : value(0) {}
+        quint64 value; // aka amount of satoshis
+        Range script;
+    };
+
+    enum ParseError {
+        NoError,
+        UnknownFormat,          ///< the first 4 bytes are not a version number.
+        UnknownVersion,         ///< only versions 1, 2 and 4 are known.
+        TruncatedInputs,
+        InputScriptOutOfBounds,
+        TruncatedOutputs,
+        OutputScriptOutOfBounds,
+        WrongLength,            ///< the lock time isn't the last 4 bytes.
+        PrevIndexWithoutHash,   ///< v4 only
+        MalformedMessage        ///< v4 only, the CMF of the body is invalid.
+    };
+
+    /**
+     * Parse the transaction in @a length bytes at @a data, returns false if it is malformed.
+     * Nothing is logged, error() and errorString() tell what was wrong.
+     */
+    bool parse(const char *data, int length);
+    inline bool parse(const QByteArray &bytes) {
+        return parse(bytes.constData(), bytes.size());
+    }
+
+    /// the reason the last parse() failed.
+    inline ParseError error() const {
+        return m_error;
+    }
+    /// return a description of error() for the log, like "length of tx incorrect (250, expected 251)".
+    QString errorString() const;
+
+    inline const char *data() const {
+        return m_data;
+    }
+    inline int size() const {
+        return m_size;
+    }
+    inline int version() const {
+        return m_version;
+    }
+    /// legacy transactions only
+    inline quint32 lockTime() const {
+        return m_nLockTime;
+    }
+
+    inline const QVector<Input> &inputs() const {
+        return m_inputs;
+    }
+    inline const QVector<Output> &outputs() const {
+        return m_outputs;
+    }
+    inline const QVector<Range> &scriptItems() const {
+        return m_scriptItems;
+    }
+    /// return true for the first transaction of a block, which has no real inputs.
+    bool isCoinbase() const;
+
+    /// v4 only
+    inline Range coinbaseMessage() const {
+        return m_coinbaseMessage;
+    }
+
+    /// return the pointer to the first byte of @a range.
+    inline const char *at(const Range &range) const {
+        return m_data + range.offset;
+    }
+    /// return a QByteArray referencing, not copying, the bytes of @a range.
+    inline QByteArray bytes(const Range &range) const {
+        return QByteArray::fromRawData(m_data + range.offset, range.length);
+    }
+
+private:
+    bool parseLegacy();
+    bool parseV4();
+    void parseInputScript(Input &input);
+    /// set the error, @a detail is the index of the input or output, or the expected size.
+    bool fail(ParseError error, qint64 detail = 0);
+
+    ParseError m_error;
+    qint64 m_errorDetail;
+    const char *m_data;
+    int m_size;
+    int m_version;
+    quint32 m_nLockTime;
+    Range m_coinbaseMessage;
+    QVector<Input> m_inputs;
+    QVector<Output> m_outputs;
+    QVector<Range> m_scriptItems;
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "UtxoIndex.h"
+#include "StreamMethods.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+const int InitialCapacity = 1 << 16;
+const int ScriptBlockSize = 4 * 1024 * 1024;
+
+inline quint64 outpointKey(const char *txid, int index)
+{
+    // the txid is a hash already, only the index needs mixing in.
+    const quint64 key = Streaming::fetch64bitValue(txid, 0) ^ (static_cast<quint64>(static_cast<quint32>(index)) * 0x9E3779B97F4A7C15ULL);
+    return key == 0 ? 1 : key;
+}
+}
+
+UtxoIndex::UtxoIndex(Contents contents)
+    : m_contents(contents),
+      m_table(0),
+      m_mask(0),
+      m_size(0),
+      m_blockUsed(ScriptBlockSize),
+      m_scriptBytes(0)
+{
+}
+
+UtxoIndex::~UtxoIndex()
+{
+    clear();
+}
+
+void UtxoIndex::clear()
+{
+    free(m_table);
+    m_table = 0;
+    m_mask = 0;
+    m_size = 0;
+    foreach (char *block, m_scriptBlocks) {
+        free(block);
+    }
+    m_scriptBlocks.clear();
+    m_blockUsed = ScriptBlockSize;
+    m_scriptBytes = 0;
+}
+
+qint64 UtxoIndex::memoryUsage() const
+{
+    const qint64 tableSize = m_table ? static_cast<qint64>(m_mask + 1) * sizeof(Entry) : 0;
+    return tableSize + static_cast<qint64>(m_scriptBlocks.size()) * ScriptBlockSize;
+}
+
+UtxoIndex::Entry *UtxoIndex::find(quint64 key) const
+{
+    if (m_table == 0)
+        return 0;
+    for (quint64 slot = key & m_mask;; slot = (slot + 1) & m_mask) {
+        Entry *entry = m_table + slot;
+        if (entry->key == key)
+            return entry;
+        if (entry->key == 0)
+            return 0;
+    }
+}
+
+void UtxoIndex::insert(const char *txid, int index, quint64 value, const char *script, int scriptSize)
+{
+    Q_ASSERT(txid);
+    if (static_cast<quint64>(m_size + 1) > (m_mask + 1) / 4 * 3)
+        grow();
+    const quint64 key = outpointKey(txid, index);
+    quint64 slot = key & m_mask;
+    while (m_table[slot].key != 0 && m_table[slot].key != key)
+        slot = (slot + 1) & m_mask;
+    Entry &entry = m_table[slot];
+    if (entry.key == key) // a duplicate txid, like the coinbases BIP30 is about.
+        m_scriptBytes -= entry.script & 0xFFFF;
+    else
+        ++m_size;
+    entry.key = key;
+    entry.value = value;
+    entry.script = 0;
+    if (m_contents == ValuesAndScripts && scriptSize > 0 && scriptSize <= MaxScriptSize)
+        entry.script = storeScript(script, scriptSize);
+}
+
+bool UtxoIndex::spend(const char *txid, int index, Output *output)
+{
+    Entry *entry = find(outpointKey(txid, index));
+    if (entry == 0)
+        return false;
+    const int scriptSize = entry->script & 0xFFFF;
+    if (output) {
+        output->value = entry->value;
+        if (scriptSize > 0) {
+            const quint64 offset = entry->script >> 16;
+            output->script = QByteArray(m_scriptBlocks.at(offset / ScriptBlockSize) + offset % ScriptBlockSize, scriptSize);
+        } else {
+            output->script.clear();
+        }
+    }
+    m_scriptBytes -= scriptSize;
+    --m_size;
+
+    // backward shift deletion, move later entries of the probe sequence into the gap.
+    quint64 gap = entry - m_table;
+    for (quint64 slot = (gap + 1) & m_mask; m_table[slot].key != 0; slot = (slot + 1) & m_mask) {
+        const quint64 home = m_table[slot].key & m_mask;
+        if (((slot - home) & m_mask) >= ((slot - gap) & m_mask)) {
+            m_table[gap] = m_table[slot];
+            gap = slot;
+        }
+    }
+    m_table[gap].key = 0;
+
+    if (m_scriptBlocks.size() > 2 && m_scriptBytes < static_cast<qint64>(m_scriptBlocks.size()) * ScriptBlockSize / 2)
+        compactScripts();
+    return true;
+}
+
+void UtxoIndex::grow()
+{
+    const quint64 oldCapacity = m_table ? m_mask + 1 : 0;
+    const quint64 capacity = oldCapacity ? oldCapacity * 2 : InitialCapacity;
+    Entry *oldTable = m_table;
+    m_table = static_cast<Entry*>(calloc(capacity, sizeof(Entry)));
+    Q_CHECK_PTR(m_table);
+    m_mask = capacity - 1;
+    for (quint64 i = 0; i < oldCapacity; ++i) {
+        const Entry &entry = oldTable[i];
+        if (entry.key == 0)
+            continue;
+        quint64 slot = entry.key & m_mask;
+        while (m_table[slot].key != 0)
+            slot = (slot + 1) & m_mask;
+        m_table[slot] = entry;
+    }
+    free(oldTable);
+}
+
+quint64 UtxoIndex::storeScript(const char *script, int size)
+{
+    if (m_blockUsed + size > ScriptBlockSize) {
+        char *block = static_cast<char*>(malloc(ScriptBlockSize));
+        Q_CHECK_PTR(block);
+        m_scriptBlocks.append(block);
+        m_blockUsed = 0;
+    }
+    const quint64 offset = static_cast<quint64>(m_scriptBlocks.size() - 1) * ScriptBlockSize + m_blockUsed;
+    memcpy(m_scriptBlocks.last() + m_blockUsed, script, size);
+    m_blockUsed += size;
+    m_scriptBytes += size;
+    return (offset << 16) | size;
+}
+
+void UtxoIndex::compactScripts()
+{
+    QList<char*> oldBlocks = m_scriptBlocks;
+    m_scriptBlocks.clear();
+    m_blockUsed = ScriptBlockSize;
+    m_scriptBytes = 0;
+    for (quint64 i = 0; i <= m_mask; ++i) {
+        Entry &entry = m_table[i];
+        const int size = entry.script & 0xFFFF;
+        if (entry.key == 0 || size == 0)
+            continue;
+        const quint64 offset = entry.script >> 16;
+        entry.script = storeScript(oldBlocks.at(offset / ScriptBlockSize) + offset % ScriptBlockSize, size);
+    }
+    foreach (char *block, oldBlocks) {
+        free(block);
+    }
+}
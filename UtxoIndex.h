@@ -0,0 +1,100 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UTXOINDEX_H
+#define UTXOINDEX_H
+
+#include <QByteArray>
+#include <QList>
+
+/**
+ * UtxoIndex holds the unspent outputs of a stream of transactions, in memory.
+ *
+ * Outputs are inserted as transactions are read in chain order and removed again
+ * when an input spends them, which gives the value and script of each input.
+ *
+ * The index is an open-addressing hash table with linear probing. Instead of the
+ * 36 bytes outpoint an entry stores a 64 bit key derived from it, so an entry is only
+ * 24 bytes. Txids are random, two outpoints with the same key are not expected to
+ * occur even in a full chain; if they did the second insert replaces the first.
+ * Scripts are stored back to back in large blocks, space freed by spending is
+ * reclaimed by compacting the blocks once it makes up half of them.
+ */
+class UtxoIndex
+{
+public:
+    enum Contents {
+        ValuesAndScripts,
+        ValuesOnly      ///< scripts passed to insert() are not stored.
+    };
+
+    explicit UtxoIndex(Contents contents = ValuesAndScripts);
+    ~UtxoIndex();
+
+    struct Output {
+        Output() : value(0) {}
+        quint64 value;
+        QByteArray script;
+    };
+
+    /**
+     * Add output @a index of the transaction with the 32 bytes @a txid, in hash order.
+     * Scripts longer than MaxScriptSize are not stored, spend() returns an empty script for those.
+     */
+    void insert(const char *txid, int index, quint64 value, const char *script = 0, int scriptSize = 0);
+
+    /// find and remove an output, returns false if it is not in the index.
+    bool spend(const char *txid, int index, Output *output = 0);
+
+    /// the amount of unspent outputs.
+    inline qint64 size() const {
+        return m_size;
+    }
+
+    /// the amount of bytes allocated for the table and the scripts.
+    qint64 memoryUsage() const;
+
+    /// remove all outputs and release the memory.
+    void clear();
+
+    enum {
+        MaxScriptSize = 0xFFFF
+    };
+
+private:
+    struct Entry {
+        quint64 key;    // zero for an empty slot
+        quint64 value;
+        quint64 script; // the offset in the script blocks << 16 | the script size
+    };
+
+    Entry *find(quint64 key) const;
+    void grow();
+    quint64 storeScript(const char *script, int size);
+    void compactScripts();
+
+    const Contents m_contents;
+    Entry *m_table;
+    quint64 m_mask;  // the capacity - 1, the capacity is a power of two.
+    qint64 m_size;
+
+    QList<char*> m_scriptBlocks;
+    int m_blockUsed;        // the bytes used in the last script block
+    qint64 m_scriptBytes;   // the bytes of the scripts currently stored
+};
+
+#endif
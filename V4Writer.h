@@ -0,0 +1,99 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef V4WRITER_H
+#define V4WRITER_H
+
+#include "CMF.h"
+#include "MessageBuilder.h"
+#include "MessageParser.h"
+#include "Transaction.h"
+
+/**
+ * V4Writer appends the v4 serialization of a transaction to a MessageBuilder.
+ *
+ * This is the one encoder of the v4 format; Transaction and ArenaTransaction both
+ * write through it and only differ in the @a Source that gives access to their fields:
+ * @code
+ *   int inputCount() const;
+ *   ConstBytes prevHash(int input, char *buffer) const; // in v4 byte order, may use the 32 bytes of buffer
+ *   int prevIndex(int input) const;
+ *   int itemCount(int input) const;
+ *   ConstBytes item(int input, int index) const;
+ *   int outputCount() const;
+ *   ConstBytes outputScript(int output) const;
+ *   quint64 outputValue(int output) const;
+ * @endcode
+ * All tags are below 31, so each field is written with a header byte that is a compile-time constant.
+ */
+template <class Source>
+class V4Writer
+{
+public:
+    static void write(MessageBuilder &builder, const Source &source, bool includeSignatures) {
+        static const char version[4] = { 4, 0, 0, 0 }; // little-endian 32 bit int
+        builder.addRaw(version, sizeof(version));
+
+        char buffer[32];
+        const int inputCount = source.inputCount();
+        for (int i = 0; i < inputCount; ++i) {
+            const ConstBytes prevHash = source.prevHash(i, buffer);
+            builder.addWithHeader(PrevHashHeader, prevHash.data, prevHash.size);
+            const int prevIndex = source.prevIndex(i);
+            if (prevIndex > 0)
+                builder.addWithHeader(PrevIndexHeader, static_cast<quint64>(prevIndex));
+        }
+        const int outputCount = source.outputCount();
+        for (int i = 0; i < outputCount; ++i) {
+            const ConstBytes script = source.outputScript(i);
+            builder.addWithHeader(OutScriptHeader, script.data, script.size);
+            builder.addWithHeader(OutValueHeader, source.outputValue(i));
+        }
+
+        // This is the limiter. All the data above is used to create the transaction ID.
+        // What follows is the tx-in scripts. These contain the public key (of which the txout (prevtx) has a hash)
+        // and it contains a signature using that public key signing the data above.
+
+        // This means that the data below can be stripped after we established that the transaction is correct.
+        // There is no need to hash the below data to ensure its not tampered with. They are cryptographic proof
+        // on their own by the fact that they 'unlock' the puzzle of the prev TX and sign this TX.
+
+        if (includeSignatures) {
+            for (int i = 0; i < inputCount; ++i) {
+                const int itemCount = source.itemCount(i);
+                for (int j = 0; j < itemCount; ++j) {
+                    const ConstBytes item = source.item(i, j);
+                    builder.addWithHeader(j == 0 ? ItemHeader : ItemContinuedHeader, item.data, item.size);
+                }
+            }
+            builder.addWithHeader(EndHeader);
+        }
+    }
+
+private:
+    enum {
+        PrevHashHeader = (Transaction::TxInPrevHash << 3) | CMF::ByteArray,
+        PrevIndexHeader = (Transaction::TxInPrevIndex << 3) | CMF::PositiveNumber,
+        OutScriptHeader = (Transaction::TxOutScript << 3) | CMF::ByteArray,
+        OutValueHeader = (Transaction::TxOutValue << 3) | CMF::PositiveNumber,
+        ItemHeader = (Transaction::TxInputStackItem << 3) | CMF::ByteArray,
+        ItemContinuedHeader = (Transaction::TxInputStackItemContinued << 3) | CMF::ByteArray,
+        EndHeader = (Transaction::TxEnd << 3) | CMF::BoolTrue
+    };
+};
+
+#endif
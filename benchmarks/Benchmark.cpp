@@ -0,0 +1,147 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Benchmark.h"
+
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__GLIBC__)
+/*
+ * Count allocations by wrapping the glibc allocator. Qt containers and operator
+ * new both end up here. The benchmarks are single threaded, a plain counter is fine.
+ */
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+static qint64 s_allocations = 0;
+
+void *malloc(size_t size)
+{
+    ++s_allocations;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    ++s_allocations;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    ++s_allocations;
+    return __libc_realloc(ptr, size);
+}
+}
+
+qint64 Benchmark::allocationCount()
+{
+    return s_allocations;
+}
+#else
+qint64 Benchmark::allocationCount()
+{
+    return -1;
+}
+#endif
+
+Benchmark::Benchmark(const QString &name, int bytesPerOperation, const Function &function)
+    : m_name(name),
+      m_bytesPerOperation(bytesPerOperation),
+      m_function(function)
+{
+}
+
+Benchmark::Result Benchmark::run(int minimumMilliseconds, int repeats) const
+{
+    Q_ASSERT(repeats > 0);
+    QElapsedTimer timer;
+    // calibrate, which also warms up caches and lazily allocated buffers.
+    int operations = 1;
+    while (true) {
+        timer.start();
+        m_function(operations);
+        if (timer.elapsed() >= minimumMilliseconds / 4 || operations >= (1 << 28))
+            break;
+        operations *= 2;
+    }
+    if (operations < (1 << 28))
+        operations *= 4;
+
+    std::vector<double> nsPerOperation;
+    double allocations = 0;
+    for (int i = 0; i < repeats; ++i) {
+        const qint64 allocationsBefore = allocationCount();
+        timer.start();
+        m_function(operations);
+        const qint64 ns = timer.nsecsElapsed();
+        allocations = double(allocationCount() - allocationsBefore) / operations;
+        nsPerOperation.push_back(double(ns) / operations);
+    }
+    std::sort(nsPerOperation.begin(), nsPerOperation.end());
+
+    Result result;
+    result.name = m_name;
+    result.operations = operations;
+    result.nsPerOperation = nsPerOperation.at(nsPerOperation.size() / 2);
+    result.bytesPerOperation = m_bytesPerOperation;
+    result.allocationsPerOperation = allocationCount() < 0 ? -1 : allocations;
+    return result;
+}
+
+void Benchmark::printTable(const QList<Result> &results, QTextStream &out)
+{
+    out << QString("benchmark").leftJustified(44) << QString("ns/op").rightJustified(12)
+        << QString("bytes/op").rightJustified(10) << QString("allocs/op").rightJustified(11)
+        << QString("MB/s").rightJustified(10) << endl;
+    foreach (const Result &result, results) {
+        const double mbPerSecond = result.nsPerOperation > 0
+                ? result.bytesPerOperation * 1000.0 / result.nsPerOperation : 0;
+        const QString allocations = result.allocationsPerOperation < 0 ? QString("n/a")
+                : QString::number(result.allocationsPerOperation, 'f', 2);
+        out << result.name.leftJustified(44)
+            << QString::number(result.nsPerOperation, 'f', 2).rightJustified(12)
+            << QString::number(result.bytesPerOperation).rightJustified(10)
+            << allocations.rightJustified(11)
+            << QString::number(mbPerSecond, 'f', 1).rightJustified(10) << endl;
+    }
+}
+
+void Benchmark::printJson(const QList<Result> &results, QTextStream &out)
+{
+    // names are plain ascii, no escaping needed.
+    out << "[\n";
+    for (int i = 0; i < results.size(); ++i) {
+        const Result &result = results.at(i);
+        out << "  {\"name\": \"" << result.name << "\", \"operations\": " << result.operations
+            << ", \"ns_per_op\": " << QString::number(result.nsPerOperation, 'f', 3)
+            << ", \"bytes_per_op\": " << result.bytesPerOperation
+            << ", \"allocs_per_op\": ";
+        if (result.allocationsPerOperation < 0)
+            out << "null";
+        else
+            out << QString::number(result.allocationsPerOperation, 'f', 3);
+        out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]" << endl;
+}
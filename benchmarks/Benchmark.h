@@ -0,0 +1,71 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QList>
+#include <QString>
+
+#include <functional>
+
+class QTextStream;
+
+/**
+ * A single micro-benchmark.
+ *
+ * The function is called with an amount of operations to perform, the amount is
+ * increased until a run takes long enough to be measured reliably. After that
+ * several runs are timed and the median is reported as nanoseconds per operation,
+ * as well as the bytes processed and the heap allocations per operation.
+ */
+class Benchmark
+{
+public:
+    typedef std::function<void(int operations)> Function;
+
+    /// @a bytesPerOperation is the amount of input or output bytes handled per operation, for throughput.
+    Benchmark(const QString &name, int bytesPerOperation, const Function &function);
+
+    struct Result {
+        Result() : operations(0), nsPerOperation(0), bytesPerOperation(0), allocationsPerOperation(0) {}
+        QString name;
+        qint64 operations; // per timed run
+        double nsPerOperation;
+        int bytesPerOperation;
+        double allocationsPerOperation; // -1 if allocations can't be counted on this platform
+    };
+
+    Result run(int minimumMilliseconds, int repeats) const;
+
+    inline QString name() const {
+        return m_name;
+    }
+
+    /// return the amount of heap allocations made by this process so far, or -1 if unknown.
+    static qint64 allocationCount();
+
+    static void printTable(const QList<Result> &results, QTextStream &out);
+    static void printJson(const QList<Result> &results, QTextStream &out);
+
+private:
+    QString m_name;
+    int m_bytesPerOperation;
+    Function m_function;
+};
+
+#endif
@@ -0,0 +1,55 @@
+TEMPLATE = app
+TARGET = benchmarks
+INCLUDEPATH += . .. ../support/cppQt
+
+# Input
+HEADERS += Benchmark.h \
+    ../StreamMethods.h \
+    ../Transaction.h \
+    ../CMF.h \
+    ../CMFSchema.h \
+    ../MessageBuilder.h \
+    ../MessageParser.h \
+    ../Sha256.h \
+    ../Arena.h \
+    ../ArenaTransaction.h \
+    ../V4Writer.h \
+    ../TransactionView.h \
+    ../TransactionBatch.h \
+    ../ScriptTokenizer.h \
+    ../ScriptClassifier.h \
+    ../BufferedWriter.h \
+    ../StructuredWriter.h \
+    ../SignatureHash.h \
+    ../Ripemd160.h \
+    ../Secp256k1.h \
+    ../UtxoIndex.h \
+    ../ArchiveWriter.h \
+    ../TransactionArchive.h \
+    ../ColumnarWriter.h \
+    ../ColumnarArchive.h
+
+SOURCES += main.cpp \
+    Benchmark.cpp \
+    ../StreamMethods.cpp \
+    ../Transaction.cpp \
+    ../CMF.cpp \
+    ../MessageBuilder.cpp \
+    ../MessageParser.cpp \
+    ../Sha256.cpp \
+    ../Arena.cpp \
+    ../ArenaTransaction.cpp \
+    ../TransactionView.cpp \
+    ../TransactionBatch.cpp \
+    ../ScriptTokenizer.cpp \
+    ../ScriptClassifier.cpp \
+    ../BufferedWriter.cpp \
+    ../StructuredWriter.cpp \
+    ../SignatureHash.cpp \
+    ../Ripemd160.cpp \
+    ../Secp256k1.cpp \
+    ../UtxoIndex.cpp \
+    ../ArchiveWriter.cpp \
+    ../TransactionArchive.cpp \
+    ../ColumnarWriter.cpp \
+    ../ColumnarArchive.cpp
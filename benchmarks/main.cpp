@@ -0,0 +1,700 @@
+/*
+ * This file is part of the Bitcoin project
+ * Copyright (C) 2014-2016 Tom Zander <tomz@freedommail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Benchmark.h"
+
+#include <Arena.h>
+#include <ArchiveWriter.h>
+#include <BufferedWriter.h>
+#include <ArenaTransaction.h>
+#include <CMF.h>
+#include <ColumnarArchive.h>
+#include <ColumnarWriter.h>
+#include <MessageBuilder.h>
+#include <MessageParser.h>
+#include <Ripemd160.h>
+#include <ScriptClassifier.h>
+#include <ScriptTokenizer.h>
+#include <Secp256k1.h>
+#include <Sha256.h>
+#include <SignatureHash.h>
+#include <StructuredWriter.h>
+#include <Transaction.h>
+#include <TransactionArchive.h>
+#include <TransactionBatch.h>
+#include <TransactionView.h>
+#include <UtxoIndex.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QSharedPointer>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QVector>
+#include <QDebug>
+
+namespace {
+// stops the compiler from optimizing away the work being measured.
+volatile quint64 s_sink = 0;
+
+// xorshift64*, fixed seed to make every run use the same data.
+/// a device that drops what is written to it, to time the formatting only.
+class NullDevice : public QIODevice
+{
+protected:
+    qint64 readData(char *, qint64) {
+        return -1;
+    }
+    qint64 writeData(const char *, qint64 length) {
+        s_sink += length;
+        return length;
+    }
+};
+
+class Random
+{
+public:
+    Random() : m_state(0x2545F4914F6CDD1DULL) {}
+    quint64 next() {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1DULL;
+    }
+    QByteArray bytes(int size) {
+        QByteArray answer(size, 0);
+        for (int i = 0; i < size; ++i)
+            answer[i] = next();
+        return answer;
+    }
+private:
+    quint64 m_state;
+};
+
+const int SetSize = 1024; // values per set, the operations cycle through them
+
+void appendCompact(QByteArray &out, quint64 value)
+{
+    if (value < 253) {
+        out.append(static_cast<char>(value));
+        return;
+    }
+    int bytes = 8;
+    if (value <= 0xFFFF) {
+        out.append(static_cast<char>(253));
+        bytes = 2;
+    } else if (value <= 0xFFFFFFFF) {
+        out.append(static_cast<char>(254));
+        bytes = 4;
+    } else {
+        out.append(static_cast<char>(255));
+    }
+    for (int i = 0; i < bytes; ++i)
+        out.append(static_cast<char>(value >> (i * 8)));
+}
+
+void appendInt(QByteArray &out, quint64 value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out.append(static_cast<char>(value >> (i * 8)));
+}
+
+QByteArray pushData(const QByteArray &data)
+{
+    QByteArray answer;
+    if (data.size() < 76) {
+        answer.append(static_cast<char>(data.size()));
+    } else if (data.size() <= 0xFF) {
+        answer.append(static_cast<char>(76)); // OP_PUSHDATA1
+        appendInt(answer, data.size(), 1);
+    } else {
+        answer.append(static_cast<char>(77)); // OP_PUSHDATA2
+        appendInt(answer, data.size(), 2);
+    }
+    return answer + data;
+}
+
+enum InputShape {
+    PayToPubKeyHash,
+    MultiSig // a P2SH 15-of-15 spend
+};
+
+const int MultiSigKeys = 15;
+
+QByteArray inputScript(Random &random, InputShape shape)
+{
+    if (shape == PayToPubKeyHash)
+        return pushData(random.bytes(72)) + pushData(QByteArray(1, 2) + random.bytes(32));
+    QByteArray script(1, 0); // OP_0, for the CHECKMULTISIG bug
+    QByteArray redeemScript(1, static_cast<char>(0x50 + MultiSigKeys)); // OP_15
+    for (int i = 0; i < MultiSigKeys; ++i) {
+        script += pushData(random.bytes(72));
+        redeemScript += pushData(QByteArray(1, 3) + random.bytes(32));
+    }
+    redeemScript.append(static_cast<char>(0x50 + MultiSigKeys));
+    redeemScript.append(static_cast<char>(0xae)); // OP_CHECKMULTISIG
+    return script + pushData(redeemScript);
+}
+
+/// create a legacy (version 1) transaction.
+QByteArray createTransaction(Random &random, int inputCount, int outputCount, InputShape shape)
+{
+    QByteArray tx;
+    appendInt(tx, 1, 4);
+    appendCompact(tx, inputCount);
+    for (int i = 0; i < inputCount; ++i) {
+        tx += random.bytes(32);
+        appendInt(tx, random.next() % 4, 4);
+        const QByteArray script = inputScript(random, shape);
+        appendCompact(tx, script.size());
+        tx += script;
+        appendInt(tx, 0xFFFFFFFF, 4);
+    }
+    appendCompact(tx, outputCount);
+    for (int i = 0; i < outputCount; ++i) {
+        appendInt(tx, random.next() % 2100000000000000ULL, 8);
+        QByteArray script("\x76\xa9\x14", 3); // OP_DUP OP_HASH160 push-20
+        script += random.bytes(20);
+        script += QByteArray("\x88\xac", 2); // OP_EQUALVERIFY OP_CHECKSIG
+        appendCompact(tx, script.size());
+        tx += script;
+    }
+    appendInt(tx, 0, 4);
+    return tx;
+}
+
+/// SetSize values that all have exactly @a bits bits.
+QVector<quint64> valuesOfWidth(Random &random, int bits)
+{
+    QVector<quint64> answer;
+    for (int i = 0; i < SetSize; ++i) {
+        quint64 value = random.next() >> (64 - bits);
+        value |= Q_UINT64_C(1) << (bits - 1);
+        answer.append(value);
+    }
+    return answer;
+}
+
+void addCmfBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    // CMF::unserialize() handles up to 8 bytes, which is at least 56 bits.
+    const int widths[] = { 7, 14, 21, 28, 42, 56 };
+    for (unsigned int w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        const QVector<quint64> values = valuesOfWidth(random, widths[w]);
+        QByteArray stream;
+        char buf[20];
+        foreach (quint64 value, values)
+            stream.append(buf, CMF::serialize(buf, value));
+        const int avgSize = stream.size() / SetSize;
+        const QString suffix = QString("/%1bit").arg(widths[w]);
+
+        list.append(Benchmark("cmf/serialize" + suffix, avgSize, [values](int operations) {
+            char out[20];
+            quint64 sum = 0;
+            for (int i = 0; i < operations; ++i)
+                sum += CMF::serialize(out, values[i % SetSize]);
+            s_sink += sum;
+        }));
+        list.append(Benchmark("cmf/serializeFast" + suffix, avgSize, [values](int operations) {
+            char out[20];
+            quint64 sum = 0;
+            for (int i = 0; i < operations; ++i)
+                sum += CMF::serializeFast(out, values[i % SetSize]);
+            s_sink += sum;
+        }));
+        list.append(Benchmark("cmf/unserialize" + suffix, avgSize, [stream](int operations) {
+            int pos = 0;
+            quint64 sum = 0;
+            for (int i = 0; i < operations; ++i) {
+                if (pos >= stream.size())
+                    pos = 0;
+                quint64 value = 0;
+                CMF::unserialize(stream.constData(), stream.size(), pos, value);
+                sum += value;
+            }
+            s_sink += sum;
+        }));
+        list.append(Benchmark("cmf/unserializeFast" + suffix, avgSize, [stream](int operations) {
+            int pos = 0;
+            quint64 sum = 0;
+            for (int i = 0; i < operations; ++i) {
+                if (pos >= stream.size())
+                    pos = 0;
+                quint64 value;
+                CMF::unserializeFast(stream.constData(), stream.size(), pos, value);
+                sum += value;
+            }
+            s_sink += sum;
+        }));
+        list.append(Benchmark("cmf/unserializeMany" + suffix, avgSize, [stream](int operations) {
+            quint64 values[SetSize];
+            quint64 sum = 0;
+            for (int done = 0; done < operations; done += SetSize) {
+                int pos = 0;
+                const int count = CMF::unserializeMany(stream.constData(), stream.size(), pos,
+                                                       values, qMin(SetSize, operations - done));
+                sum += count;
+            }
+            s_sink += sum;
+        }));
+    }
+}
+
+void addBuilderBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    // each benchmark adds to a byte array that is reset every SetSize operations.
+    typedef void (*AddFunction)(MessageBuilder &, int i);
+    struct Case {
+        const char *name;
+        int bytes;
+        AddFunction add;
+    };
+    const Case cases[] = {
+        { "builder/add/uint", 5, [](MessageBuilder &b, int i) { b.add(5, static_cast<quint64>(i) << 14); } },
+        { "builder/add/int-negative", 3, [](MessageBuilder &b, int i) { b.add(5, -static_cast<qint64>(i)); } },
+        { "builder/add/uint-large-tag", 6, [](MessageBuilder &b, int i) { b.add(200, static_cast<quint64>(i) << 14); } },
+        { "builder/add/bool", 1, [](MessageBuilder &b, int i) { b.add(4, (i & 1) == 0); } },
+        { "builder/add/bytearray32", 34, [](MessageBuilder &b, int) {
+            static const QByteArray data(32, 'x');
+            b.add(1, data);
+        } },
+        { "builder/add/string20", 22, [](MessageBuilder &b, int) {
+            static const QString data("a string of 20 chars");
+            b.add(2, data);
+        } }
+    };
+    Q_UNUSED(random);
+    for (unsigned int c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        const AddFunction add = cases[c].add;
+        list.append(Benchmark(cases[c].name, cases[c].bytes, [add](int operations) {
+            QByteArray out;
+            MessageBuilder builder(&out);
+            for (int i = 0; i < operations; ++i) {
+                if (i % SetSize == 0)
+                    builder.reset();
+                add(builder, i);
+            }
+            s_sink += out.size();
+        }));
+    }
+}
+
+void addParserBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    QByteArray document;
+    MessageBuilder builder(&document);
+    for (int i = 0; i < SetSize; ++i) {
+        switch (i % 4) {
+        case 0: builder.add(1, random.bytes(32)); break;
+        case 1: builder.add(2, random.next() >> 30); break;
+        case 2: builder.add(6, random.bytes(25)); break;
+        default: builder.add(5, random.next() >> 28); break;
+        }
+    }
+    const int avgSize = document.size() / SetSize;
+
+    list.append(Benchmark("parser/next+data", avgSize, [document](int operations) {
+        quint64 sum = 0;
+        int done = 0;
+        while (done < operations) {
+            MessageParser parser(document.constData(), document.size());
+            for (; done < operations && parser.next() == MessageParser::FoundTag; ++done)
+                sum += parser.data().toByteArray().size();
+        }
+        s_sink += sum;
+    }));
+    list.append(Benchmark("parser/next+typed", avgSize, [document](int operations) {
+        quint64 sum = 0;
+        int done = 0;
+        while (done < operations) {
+            MessageParser parser(document.constData(), document.size());
+            for (; done < operations && parser.next() == MessageParser::FoundTag; ++done) {
+                if (parser.valueType() == CMF::ByteArray)
+                    sum += parser.bytesData().size;
+                else
+                    sum += parser.longData();
+            }
+        }
+        s_sink += sum;
+    }));
+}
+
+void addSha256Benchmarks(QList<Benchmark> &list, Random &random)
+{
+    // a batch of typical transaction sizes, hashed like Transaction::txids() does.
+    const int sizes[] = { 64, 250, 1000 };
+    const Sha256::Implementation implementations[] = { Sha256::Portable, Sha256::Avx2, Sha256::ShaNi };
+    enum { BatchSize = 64 };
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        const QByteArray data = random.bytes(sizes[s] * BatchSize);
+        for (unsigned int i = 0; i < sizeof(implementations) / sizeof(implementations[0]); ++i) {
+            const Sha256::Implementation implementation = implementations[i];
+            if (!Sha256::isSupported(implementation))
+                continue;
+            const int size = sizes[s];
+            list.append(Benchmark(QString("sha256/doubleHashMany/%1/%2").arg(Sha256::name(implementation)).arg(size),
+                                  size, [data, size, implementation](int operations) {
+                QVector<const char*> pointers(BatchSize);
+                QVector<int> lengths(BatchSize, size);
+                for (int j = 0; j < BatchSize; ++j)
+                    pointers[j] = data.constData() + j * size;
+                char out[BatchSize * Sha256::HashSize];
+                for (int done = 0; done < operations; done += BatchSize) {
+                    const int count = qMin<int>(BatchSize, operations - done);
+                    Sha256::doubleHashMany(count, pointers.constData(), lengths.constData(), out, implementation);
+                    s_sink += out[0];
+                }
+            }));
+        }
+    }
+}
+
+void addSecp256k1Benchmarks(QList<Benchmark> &list, Random &random)
+{
+    // signatures of random hashes by random keys, like the inputs of a block.
+    enum { BatchSize = 64 };
+    QVector<Secp256k1::PublicKey> keys(BatchSize);
+    QVector<Secp256k1::Signature> signatures(BatchSize);
+    const QByteArray hashes = random.bytes(BatchSize * 32);
+    QByteArray compressedKey;
+    for (int i = 0; i < BatchSize; ++i) {
+        const QByteArray secret = random.bytes(32);
+        compressedKey = Secp256k1::createPublicKey(secret.constData());
+        const QByteArray der = Secp256k1::sign(hashes.constData() + i * 32, secret.constData(), random.bytes(32).constData());
+        Secp256k1::parsePublicKey(compressedKey.constData(), compressedKey.size(), keys[i]);
+        Secp256k1::parseSignature(der.constData(), der.size(), signatures[i]);
+    }
+    list.append(Benchmark("secp256k1/verify", 32, [keys, signatures, hashes](int operations) {
+        for (int i = 0; i < operations; ++i) {
+            const int j = i % BatchSize;
+            s_sink += Secp256k1::verify(hashes.constData() + j * 32, signatures.at(j), keys.at(j));
+        }
+    }));
+    list.append(Benchmark("secp256k1/verify-prepared", 32, [keys, signatures, hashes](int operations) {
+        QVector<Secp256k1::Signature> batch(signatures);
+        for (int done = 0; done < operations; done += BatchSize) {
+            const int count = qMin<int>(BatchSize, operations - done);
+            Secp256k1::prepare(batch.data(), count);
+            for (int j = 0; j < count; ++j)
+                s_sink += Secp256k1::verify(hashes.constData() + j * 32, batch.at(j), keys.at(j));
+        }
+    }));
+    list.append(Benchmark("secp256k1/parseKey", compressedKey.size(), [compressedKey](int operations) {
+        Secp256k1::PublicKey key;
+        for (int i = 0; i < operations; ++i)
+            s_sink += Secp256k1::parsePublicKey(compressedKey.constData(), compressedKey.size(), key);
+    }));
+    list.append(Benchmark("ripemd160/hash160", compressedKey.size(), [compressedKey](int operations) {
+        char hash[Ripemd160::HashSize];
+        for (int i = 0; i < operations; ++i) {
+            Ripemd160::hash160(compressedKey.constData(), compressedKey.size(), hash);
+            s_sink += hash[0];
+        }
+    }));
+}
+
+void addUtxoBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    // a million unspent outputs, each operation spends the oldest and adds a new one.
+    enum { OutputCount = 1000000 };
+    struct State {
+        State() : index(UtxoIndex::ValuesOnly), next(0) {}
+        QByteArray txids;
+        UtxoIndex index;
+        qint64 next;
+    };
+    QSharedPointer<State> state(new State());
+    state->txids = random.bytes(OutputCount * 32);
+    for (int i = 0; i < OutputCount; ++i)
+        state->index.insert(state->txids.constData() + i * 32, 0, i);
+    list.append(Benchmark("utxo/spend-insert", 32, [state](int operations) {
+        UtxoIndex::Output output;
+        for (int i = 0; i < operations; ++i, ++state->next) {
+            const char *txid = state->txids.constData() + (state->next % OutputCount) * 32;
+            const int generation = state->next / OutputCount;
+            s_sink += state->index.spend(txid, generation, &output);
+            state->index.insert(txid, generation + 1, output.value);
+        }
+    }));
+}
+
+void addArchiveBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    // a million small transactions, each operation looks one up by txid.
+    enum { TransactionCount = 1000000 };
+    struct State {
+        QByteArray txids;
+        QTemporaryFile file;
+        TransactionArchive archive;
+    };
+    QSharedPointer<State> state(new State());
+    state->txids = random.bytes(TransactionCount * 32);
+    const QByteArray tx = random.bytes(200);
+    if (!state->file.open())
+        return;
+    ArchiveWriter writer(&state->file);
+    for (int i = 0; i < TransactionCount; ++i)
+        writer.append(state->txids.constData() + i * 32, tx.constData(), tx.size());
+    if (!writer.finish() || !state->file.flush() || !state->archive.open(state->file.fileName()))
+        return;
+    list.append(Benchmark("archive/find", 32, [state](int operations) {
+        for (int i = 0; i < operations; ++i)
+            s_sink += state->archive.find(state->txids.constData() + (i % TransactionCount) * 32).size;
+    }));
+}
+
+void addColumnarBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    // one block of 10000 payments, the per-output cost of decoding the value column.
+    struct State {
+        QTemporaryFile file;
+        ColumnarArchive archive;
+        QVector<quint64> values;
+    };
+    QSharedPointer<State> state(new State());
+    if (!state->file.open())
+        return;
+    ColumnarWriter writer(&state->file);
+    for (int i = 0; i < 10000; ++i) {
+        const QByteArray tx = createTransaction(random, 1, 2, PayToPubKeyHash);
+        writer.append(tx.constData(), tx.size());
+    }
+    if (!writer.finish() || !state->file.flush() || !state->archive.open(state->file.fileName()))
+        return;
+    const int outputs = state->archive.block(0).outputs;
+    list.append(Benchmark("columnar/decodeValues", 8, [state, outputs](int operations) {
+        for (int done = 0; done < operations; done += outputs) {
+            ColumnarArchive::decodeValues(state->archive.block(0), state->values);
+            s_sink += TransactionBatch::sum(state->values.constData(), state->values.size());
+        }
+    }));
+}
+
+void addBatchBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    // a batch of 1000 payments, the per-output cost of the columnar scans.
+    QSharedPointer<TransactionBatch> batch(new TransactionBatch());
+    for (int i = 0; i < 1000; ++i)
+        batch->append(createTransaction(random, 1, 2, PayToPubKeyHash));
+    const int outputs = batch->outputCount();
+    list.append(Benchmark("batch/totalValue", 8, [batch, outputs](int operations) {
+        for (int done = 0; done < operations; done += outputs)
+            s_sink += batch->totalValue();
+    }));
+    list.append(Benchmark("batch/countBelow", 8, [batch, outputs](int operations) {
+        for (int done = 0; done < operations; done += outputs)
+            s_sink += batch->countBelow(546);
+    }));
+    list.append(Benchmark("batch/valueHistogram", 8, [batch, outputs](int operations) {
+        for (int done = 0; done < operations; done += outputs)
+            s_sink += batch->valueHistogram().at(40);
+    }));
+    list.append(Benchmark("batch/countScriptPrefix/p2pkh", 25, [batch, outputs](int operations) {
+        for (int done = 0; done < operations; done += outputs)
+            s_sink += batch->countScriptPrefix("\x76\xa9\x14", 3, 25);
+    }));
+}
+
+void addScriptBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    // the per-byte cost of walking a script, output scripts are all opcodes and input scripts all pushes.
+    QByteArray output("\x76\xa9\x14", 3); // OP_DUP OP_HASH160 push-20
+    output += random.bytes(20);
+    output += QByteArray("\x88\xac", 2); // OP_EQUALVERIFY OP_CHECKSIG
+    const QByteArray scripts[] = { output, inputScript(random, PayToPubKeyHash), inputScript(random, MultiSig) };
+    const char *names[] = { "p2pkh-output", "p2pkh-input", "multisig-input" };
+    for (int i = 0; i < 3; ++i) {
+        const QByteArray script = scripts[i];
+        list.append(Benchmark(QString("script/tokenize/") + names[i], script.size(), [script](int operations) {
+            for (int j = 0; j < operations; ++j) {
+                ScriptTokenizer tokenizer(script);
+                while (tokenizer.next() == ScriptTokenizer::FoundOpcode)
+                    s_sink += tokenizer.opcode();
+            }
+        }));
+    }
+
+    // classifying the most common template, and the one that needs a walk over its keys.
+    QByteArray multiSig(1, '\x51'); // OP_1
+    for (int i = 0; i < 3; ++i)
+        multiSig += pushData(QByteArray(1, 2) + random.bytes(32));
+    multiSig += QByteArray("\x53\xae", 2); // OP_3 OP_CHECKMULTISIG
+    const QByteArray classified[] = { output, multiSig };
+    const char *classifiedNames[] = { "p2pkh", "multisig-1of3" };
+    for (int i = 0; i < 2; ++i) {
+        const QByteArray script = classified[i];
+        list.append(Benchmark(QString("script/classify/") + classifiedNames[i], script.size(), [script](int operations) {
+            ScriptClassifier::Payload payload;
+            for (int j = 0; j < operations; ++j)
+                s_sink += ScriptClassifier::classify(script, &payload) + payload.data.size;
+        }));
+    }
+}
+
+void addTransactionBenchmarks(QList<Benchmark> &list, Random &random)
+{
+    struct Shape {
+        const char *name;
+        int inputs, outputs;
+        InputShape input;
+    };
+    const Shape shapes[] = {
+        { "p2pkh-1in-2out", 1, 2, PayToPubKeyHash },
+        { "multisig-15of15-3in-2out", 3, 2, MultiSig },
+        { "consolidation-1000in-1out", 1000, 1, PayToPubKeyHash }
+    };
+    for (unsigned int s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+        const QByteArray v1 = createTransaction(random, shapes[s].inputs, shapes[s].outputs, shapes[s].input);
+        Transaction tx;
+        if (!tx.read(v1)) {
+            qWarning() << "Failed to create the" << shapes[s].name << "transaction";
+            continue;
+        }
+        const QByteArray v4 = tx.toV4(true);
+        const QString shape(shapes[s].name);
+
+        list.append(Benchmark("tx/parse-v1/" + shape, v1.size(), [v1](int operations) {
+            for (int i = 0; i < operations; ++i) {
+                Transaction t;
+                s_sink += t.read(v1);
+            }
+        }));
+        list.append(Benchmark("tx/parse-arena/" + shape, v1.size(), [v1](int operations) {
+            Arena arena;
+            TransactionView view;
+            for (int i = 0; i < operations; ++i) {
+                if ((i & 255) == 0) // release in batches, like the BatchConverter does.
+                    arena.reset();
+                s_sink += ArenaTransaction::create(arena, view, v1.constData(), v1.size()) != 0;
+            }
+        }));
+        list.append(Benchmark("tx/parse-v4/" + shape, v4.size(), [v4](int operations) {
+            for (int i = 0; i < operations; ++i) {
+                Transaction t;
+                s_sink += t.read(v4);
+            }
+        }));
+        list.append(Benchmark("tx/writev4/" + shape, v4.size(), [tx](int operations) {
+            QByteArray out;
+            MessageBuilder builder(&out);
+            for (int i = 0; i < operations; ++i) {
+                builder.reset();
+                tx.writev4(builder, true);
+            }
+            s_sink += out.size();
+        }));
+        list.append(Benchmark("tx/dump-json/" + shape, v1.size(), [v1](int operations) {
+            NullDevice device;
+            device.open(QIODevice::WriteOnly);
+            BufferedWriter out(&device);
+            StructuredWriter writer(out, StructuredWriter::JsonLines);
+            for (int i = 0; i < operations; ++i)
+                s_sink += writer.write(v1.constData(), v1.size());
+        }));
+        list.append(Benchmark("tx/dump-binary/" + shape, v1.size(), [v1](int operations) {
+            NullDevice device;
+            device.open(QIODevice::WriteOnly);
+            BufferedWriter out(&device);
+            StructuredWriter writer(out, StructuredWriter::Binary);
+            for (int i = 0; i < operations; ++i)
+                s_sink += writer.write(v1.constData(), v1.size());
+        }));
+        // signing every input, the forkid digest reuses the hashes of the outputs and other inputs.
+        const QByteArray scriptCode = QByteArray("\x76\xa9\x14", 3) + random.bytes(20) + QByteArray("\x88\xac", 2);
+        const char *hashNames[] = { "legacy", "forkid" };
+        for (int h = 0; h < 2; ++h) {
+            const quint32 hashType = SignatureHash::SigHashAll | (h ? SignatureHash::SigHashForkId : 0);
+            list.append(Benchmark(QString("tx/sighash-%1/").arg(hashNames[h]) + shape, v1.size(),
+                                  [v1, scriptCode, hashType](int operations) {
+                TransactionView view;
+                SignatureHash hasher;
+                char digest[Sha256::HashSize];
+                for (int i = 0; i < operations; ++i) {
+                    view.parse(v1);
+                    hasher.setTransaction(view);
+                    for (int j = 0; j < view.inputs().size(); ++j) {
+                        hasher.hash(j, scriptCode.constData(), scriptCode.size(), 100000, hashType, digest);
+                        s_sink += digest[0];
+                    }
+                }
+            }));
+        }
+        list.append(Benchmark("tx/writeLegacy/" + shape, v1.size(), [tx](int operations) {
+            QByteArray out(tx.legacySize(), 0);
+            for (int i = 0; i < operations; ++i)
+                s_sink += tx.writeLegacy(out.data());
+        }));
+    }
+}
+}
+
+int main(int x, char **y)
+{
+    QCoreApplication app(x, y);
+    QCoreApplication::setApplicationName("benchmarks");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks of the transaction codecs");
+    parser.addHelpOption();
+    parser.addPositionalArgument("filter", "only run benchmarks whose name contains this text");
+    QCommandLineOption json("json", "write the results as JSON to <file>", "file");
+    parser.addOption(json);
+    QCommandLineOption minTime("min-time", "minimum duration of a timed run, in milliseconds (default 100)", "ms");
+    parser.addOption(minTime);
+    QCommandLineOption repeats("repeats", "amount of timed runs, the median is reported (default 5)", "count");
+    parser.addOption(repeats);
+    parser.process(app);
+
+    const QString filter = parser.positionalArguments().isEmpty() ? QString() : parser.positionalArguments().first();
+    const int minimumMs = parser.isSet(minTime) ? parser.value(minTime).toInt() : 100;
+    const int runs = parser.isSet(repeats) ? qMax(1, parser.value(repeats).toInt()) : 5;
+
+    Random random;
+    QList<Benchmark> benchmarks;
+    addCmfBenchmarks(benchmarks, random);
+    addBuilderBenchmarks(benchmarks, random);
+    addParserBenchmarks(benchmarks, random);
+    addSha256Benchmarks(benchmarks, random);
+    addSecp256k1Benchmarks(benchmarks, random);
+    addUtxoBenchmarks(benchmarks, random);
+    addArchiveBenchmarks(benchmarks, random);
+    addColumnarBenchmarks(benchmarks, random);
+    addTransactionBenchmarks(benchmarks, random);
+    addBatchBenchmarks(benchmarks, random);
+    addScriptBenchmarks(benchmarks, random);
+
+    QTextStream out(stdout);
+    QList<Benchmark::Result> results;
+    foreach (const Benchmark &benchmark, benchmarks) {
+        if (!filter.isEmpty() && !benchmark.name().contains(filter))
+            continue;
+        results.append(benchmark.run(minimumMs, runs));
+    }
+    Benchmark::printTable(results, out);
+
+    if (parser.isSet(json)) {
+        QFile file(parser.value(json));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "Failed to write file" << file.fileName();
+            return 1;
+        }
+        QTextStream jsonOut(&file);
+        Benchmark::printJson(results, jsonOut);
+    }
+    return 0;
+}
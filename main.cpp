@@ -16,12 +16,502 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "Transaction.h"
+#include "ArchiveWriter.h"
+#include "BatchConverter.h"
+#include "BufferedWriter.h"
+#include "ColumnarArchive.h"
+#include "ColumnarWriter.h"
+#include "CorpusReader.h"
+#include "FeeStatistics.h"
+#include "RoundTripChecker.h"
+#include "ScriptClassifier.h"
+#include "ScriptStatistics.h"
+#include "SelfTest.h"
+#include "SignatureVerifier.h"
+#include "SizeStatistics.h"
+#include "StructuredWriter.h"
+#include "TransactionArchive.h"
+#include "TransactionBatch.h"
+#include "TransactionGenerator.h"
 
 #include <QCoreApplication>
 #include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QScopedPointer>
+#include <QThread>
 #include <QDebug>
 
+#include <algorithm>
+
+namespace {
+bool openOutput(QFile &file, const QString &filename)
+{
+    if (QFileInfo(filename).exists()) {
+        qWarning() << "Outfile" << filename << "exists, exiting";
+        return false;
+    }
+    file.setFileName(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write file" << filename;
+        return false;
+    }
+    return true;
+}
+
+int batchConvert(const QStringList &args, Transaction::Lint parsingType, int threads, bool arena, bool hugePages,
+                 const QString &archiveFile, const QString &fileBackend)
+{
+    CorpusReader reader(args.at(0));
+    RawFileLoader::Backend backend = RawFileLoader::Automatic;
+    if (!fileBackend.isEmpty() && !RawFileLoader::parseBackend(fileBackend, backend)) {
+        qWarning() << "Unknown io backend" << fileBackend << "(use auto, uring, threads or sync)";
+        return 1;
+    }
+    reader.setFileBackend(backend);
+    if (!reader.open())
+        return 1;
+
+    QFile out1, out2, archiveOut;
+    if (args.count() > 1 && !openOutput(out1, args[1]))
+        return 1;
+    if (args.count() > 2 && !openOutput(out2, args[2]))
+        return 1;
+    if (!archiveFile.isEmpty() && !openOutput(archiveOut, archiveFile))
+        return 1;
+    QScopedPointer<ArchiveWriter> archive(archiveOut.isOpen() ? new ArchiveWriter(&archiveOut) : 0);
+
+    BatchConverter converter;
+    converter.setLint(parsingType);
+    if (threads > 0)
+        converter.setThreadCount(threads);
+    if (arena || hugePages)
+        converter.setUseArena(true, hugePages ? Arena::HugePages : Arena::NormalPages);
+    converter.setArchive(archive.data());
+    bool success = converter.convert(reader, out1.isOpen() ? &out1 : 0, out2.isOpen() ? &out2 : 0);
+    if (!archive.isNull() && !archive->finish()) {
+        qWarning() << "Failed to write the archive" << archiveFile;
+        success = false;
+    }
+
+    QTextStream out(stdout);
+    converter.printStatistics(out);
+    if (reader.fileLoader())
+        out << "files read with: " << RawFileLoader::name(reader.fileLoader()->backend()) << "\n";
+    return success ? 0 : 1;
+}
+
+int lookup(const QString &archiveFile, const QString &txid)
+{
+    TransactionArchive archive;
+    if (!archive.open(archiveFile))
+        return 1;
+    QByteArray hash = QByteArray::fromHex(txid.toLatin1());
+    if (hash.size() != Sha256::HashSize) {
+        qWarning() << "Not a txid:" << txid;
+        return 1;
+    }
+    std::reverse(hash.begin(), hash.end()); // shown reversed, like debug() does
+    const ConstBytes bytes = archive.find(hash.constData());
+    if (bytes.data == 0) {
+        qWarning() << "Transaction not found in the archive";
+        return 1;
+    }
+    const QByteArray data = QByteArray::fromRawData(bytes.data, bytes.size);
+    Transaction tx;
+    if (!tx.read(data))
+        return 1;
+    tx.debug(Transaction::txid(data));
+    return 0;
+}
+
+int checkRoundTrip(const QString &source, int threads)
+{
+    CorpusReader reader(source);
+    if (!reader.open())
+        return 1;
+    RoundTripChecker checker;
+    if (threads > 0)
+        checker.setThreadCount(threads);
+    const bool success = checker.check(reader);
+    QTextStream out(stdout);
+    checker.printStatistics(out);
+    return success ? 0 : 1;
+}
+
+int printScriptStatistics(const QString &source, int threads)
+{
+    CorpusReader reader(source);
+    if (!reader.open())
+        return 1;
+    ScriptStatistics statistics;
+    if (threads > 0)
+        statistics.setThreadCount(threads);
+    statistics.collect(reader);
+    QTextStream out(stdout);
+    statistics.printStatistics(out);
+    return 0;
+}
+
+int printSizeStatistics(const QStringList &args, int threads)
+{
+    CorpusReader reader(args[0]);
+    if (!reader.open())
+        return 1;
+    QFile details;
+    if (args.count() > 1 && !openOutput(details, args[1]))
+        return 1;
+    SizeStatistics statistics;
+    if (threads > 0)
+        statistics.setThreadCount(threads);
+    if (details.isOpen())
+        statistics.setDetailsDevice(&details);
+    statistics.collect(reader);
+    QTextStream out(stdout);
+    statistics.printStatistics(out);
+    return 0;
+}
+
+int printFeeStatistics(const QStringList &args, int threads)
+{
+    CorpusReader reader(args[0]);
+    if (!reader.open())
+        return 1;
+    QFile details;
+    if (args.count() > 1 && !openOutput(details, args[1]))
+        return 1;
+    FeeStatistics statistics;
+    if (threads > 0)
+        statistics.setThreadCount(threads);
+    if (details.isOpen())
+        statistics.setDetailsDevice(&details);
+    statistics.collect(reader);
+    QTextStream out(stdout);
+    statistics.printStatistics(out);
+    return 0;
+}
+
+int verifySignatures(const QStringList &args, int threads)
+{
+    CorpusReader reader(args[0]);
+    if (!reader.open())
+        return 1;
+    QFile results;
+    if (args.count() > 1 && !openOutput(results, args[1]))
+        return 1;
+    SignatureVerifier verifier;
+    if (threads > 0)
+        verifier.setThreadCount(threads);
+    if (results.isOpen())
+        verifier.setResultsDevice(&results);
+    const bool success = verifier.verify(reader);
+    QTextStream out(stdout);
+    verifier.printStatistics(out);
+    return success ? 0 : 1;
+}
+
+int dump(const QStringList &args, const QString &format)
+{
+    StructuredWriter::Format type;
+    if (format == "json") {
+        type = StructuredWriter::JsonLines;
+    } else if (format == "binary") {
+        type = StructuredWriter::Binary;
+    } else {
+        qWarning() << "Unknown dump format" << format << "(use json or binary)";
+        return 1;
+    }
+    CorpusReader reader(args[0]);
+    if (!reader.open())
+        return 1;
+    QFile file;
+    if (args.count() > 1) {
+        if (!openOutput(file, args[1]))
+            return 1;
+    } else {
+        file.open(stdout, QIODevice::WriteOnly);
+    }
+
+    qint64 index = 0, failed = 0;
+    {
+        BufferedWriter out(&file);
+        StructuredWriter writer(out, type);
+        QList<QByteArray> chunk;
+        while (reader.read(chunk, 10000) > 0) {
+            foreach (const QByteArray &tx, chunk) {
+                if (!writer.write(tx.constData(), tx.size())) {
+                    if (failed++ < 10)
+                        qWarning() << "Transaction" << index << "failed to parse, skipped";
+                }
+                ++index;
+            }
+            chunk.clear();
+        }
+        if (!out.flush()) {
+            qWarning() << "Failed to write the output";
+            return 1;
+        }
+    }
+    if (failed > 0)
+        qWarning() << failed << "of" << index << "transactions failed to parse";
+    return failed > 0 ? 1 : 0;
+}
+
+int printValueStatistics(const QString &source)
+{
+    CorpusReader reader(source);
+    if (!reader.open())
+        return 1;
+
+    const quint64 DustLimit = 546;
+
+    TransactionBatch batch;
+    QList<QByteArray> chunk;
+    qint64 transactions = 0, failed = 0, outputs = 0, dust = 0;
+    qint64 types[ScriptClassifier::ScriptTypeCount] = { 0 };
+    quint64 total = 0;
+    bool overflow = false;
+    QVector<qint64> histogram(65, 0);
+    while (reader.read(chunk, 10000) > 0) {
+        batch.clear();
+        foreach (const QByteArray &tx, chunk) {
+            if (!batch.append(tx))
+                ++failed;
+        }
+        transactions += chunk.size();
+        chunk.clear();
+
+        outputs += batch.outputCount();
+        bool batchOverflow;
+        const quint64 value = batch.totalValue(&batchOverflow);
+        total += value;
+        overflow = overflow || batchOverflow || total < value;
+        dust += batch.countBelow(DustLimit);
+        const QVector<qint64> batchHistogram = batch.valueHistogram();
+        for (int i = 0; i < histogram.size(); ++i)
+            histogram[i] += batchHistogram.at(i);
+        const char *scripts = batch.scriptData().constData();
+        const int *offsets = batch.scriptOffsets().constData();
+        for (int i = 0; i < batch.outputCount(); ++i)
+            ++types[ScriptClassifier::classify(scripts + offsets[i], offsets[i + 1] - offsets[i])];
+    }
+
+    QTextStream out(stdout);
+    out << "transactions: " << transactions << " (" << failed << " failed)\n";
+    out << "outputs: " << outputs << "\n";
+    out << "total value: " << (overflow ? QString("overflow") : QString::number(total)) << " satoshi\n";
+    out << "dust (below " << DustLimit << " satoshi): " << dust << "\n";
+    for (int i = 0; i < ScriptClassifier::ScriptTypeCount; ++i)
+        out << ScriptClassifier::name(static_cast<ScriptClassifier::ScriptType>(i)) << ": " << types[i] << "\n";
+    out << "value histogram (satoshi):\n";
+    for (int i = 0; i < histogram.size(); ++i) {
+        if (histogram.at(i) == 0)
+            continue;
+        if (i == 0)
+            out << "  0: ";
+        else
+            out << "  " << (Q_UINT64_C(1) << (i - 1)) << "-" << ((Q_UINT64_C(1) << (i - 1)) * 2 - 1) << ": ";
+        out << histogram.at(i) << "\n";
+    }
+    return 0;
+}
+
+int printTxids(const QString &source)
+{
+    CorpusReader reader(source);
+    if (!reader.open())
+        return 1;
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    QList<QByteArray> chunk;
+    QByteArray lines, txid;
+    while (reader.read(chunk, 4096) > 0) {
+        const QByteArray hashes = Transaction::txids(chunk);
+        for (int i = 0; i < chunk.size(); ++i) {
+            // txids are shown in reverse byte-order
+            txid = hashes.mid(i * Sha256::HashSize, Sha256::HashSize);
+            std::reverse(txid.begin(), txid.end());
+            lines.append(txid.toHex());
+            lines.append('\n');
+        }
+        out.write(lines);
+        lines.resize(0);
+        chunk.clear();
+    }
+    return 0;
+}
+
+int writeColumns(const QStringList &args)
+{
+    if (args.count() < 2) {
+        qWarning() << "Missing the columnar file to write";
+        return 1;
+    }
+    CorpusReader reader(args[0]);
+    if (!reader.open())
+        return 1;
+    QFile file;
+    if (!openOutput(file, args[1]))
+        return 1;
+
+    ColumnarWriter writer(&file);
+    qint64 inputBytes = 0;
+    QList<QByteArray> chunk;
+    while (reader.read(chunk, 10000) > 0) {
+        foreach (const QByteArray &tx, chunk) {
+            writer.append(tx.constData(), tx.size());
+            inputBytes += tx.size();
+        }
+        chunk.clear();
+    }
+    if (!writer.finish()) {
+        qWarning() << "Failed to write the columnar file" << args[1];
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out << "transactions: " << writer.count() << " (" << writer.rawCount() << " stored as they are)\n";
+    out << "input: " << inputBytes << " bytes, columnar: " << writer.bytesWritten() << " bytes\n";
+    for (int i = 0; i < ColumnarArchive::ColumnCount; ++i) {
+        out << "  " << ColumnarArchive::columnName(static_cast<ColumnarArchive::Column>(i))
+            << ": " << writer.columnSizes().at(i) << " bytes\n";
+    }
+    return 0;
+}
+
+int readColumns(const QStringList &args)
+{
+    ColumnarArchive archive;
+    if (!archive.open(args[0]))
+        return 1;
+    QFile file;
+    if (args.count() > 1) {
+        if (!openOutput(file, args[1]))
+            return 1;
+    } else {
+        file.open(stdout, QIODevice::WriteOnly);
+    }
+
+    BufferedWriter out(&file);
+    QList<QByteArray> transactions;
+    for (int i = 0; i < archive.blockCount(); ++i) {
+        transactions.clear();
+        if (!ColumnarArchive::decode(archive.block(i), transactions)) {
+            qWarning() << "Block" << i << "of the columnar file is damaged";
+            return 1;
+        }
+        foreach (const QByteArray &tx, transactions) {
+            out.appendHex(tx.constData(), tx.size());
+            out.append('\n');
+        }
+    }
+    if (!out.flush()) {
+        qWarning() << "Failed to write the output";
+        return 1;
+    }
+    return 0;
+}
+
+int sumColumns(const QString &filename, int threads)
+{
+    ColumnarArchive archive;
+    if (!archive.open(filename))
+        return 1;
+    if (threads <= 0)
+        threads = qMax(1, QThread::idealThreadCount());
+    QElapsedTimer timer;
+    timer.start();
+    bool ok;
+    const quint64 total = archive.totalValue(threads, &ok);
+    const qint64 elapsed = timer.elapsed();
+    if (!ok) {
+        qWarning() << "The values of the columnar file are damaged";
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out << "transactions: " << archive.transactionCount() << " in " << archive.blockCount() << " blocks\n";
+    out << "total value: " << total << " satoshi\n";
+    out << "time: " << elapsed << " ms, threads: " << threads << "\n";
+    return 0;
+}
+
+int generate(const QCommandLineParser &parser, const QString &filename)
+{
+    bool ok;
+    const qint64 count = parser.value("generate").toLongLong(&ok);
+    if (!ok || count < 0) {
+        qWarning() << "Invalid amount of transactions to generate";
+        return 1;
+    }
+    TransactionGenerator generator(parser.value("seed").toULongLong());
+    TransactionGenerator::Distribution distribution;
+    if (parser.isSet("inputs")) {
+        if (!TransactionGenerator::Distribution::parse(parser.value("inputs"), distribution)) {
+            qWarning() << "Invalid inputs distribution";
+            return 1;
+        }
+        generator.setInputCounts(distribution);
+    }
+    if (parser.isSet("outputs")) {
+        if (!TransactionGenerator::Distribution::parse(parser.value("outputs"), distribution)) {
+            qWarning() << "Invalid outputs distribution";
+            return 1;
+        }
+        generator.setOutputCounts(distribution);
+    }
+    if (parser.isSet("push-sizes")) {
+        if (!TransactionGenerator::Distribution::parse(parser.value("push-sizes"), distribution)) {
+            qWarning() << "Invalid push-sizes distribution";
+            return 1;
+        }
+        generator.setPushSizes(distribution);
+    }
+    if (parser.isSet("templates") && !generator.setTemplateWeights(parser.value("templates"))) {
+        qWarning() << "Invalid templates, expected something like p2pkh=70,p2sh=20,multisig=5,opreturn=5";
+        return 1;
+    }
+    if (parser.isSet("tx-versions")) {
+        QList<int> versions;
+        foreach (const QString &version, parser.value("tx-versions").split(',')) {
+            const int v = version.toInt(&ok);
+            if (!ok || (v != 1 && v != 2 && v != 4)) {
+                qWarning() << "Invalid transaction version" << version;
+                return 1;
+            }
+            versions.append(v);
+        }
+        generator.setVersions(versions);
+    }
+
+    QFile out;
+    if (!openOutput(out, filename))
+        return 1;
+    const bool binary = parser.isSet("binary");
+    // write in large blocks, the transactions are small.
+    const int BlockSize = 4 * 1024 * 1024;
+    QByteArray block, tx;
+    block.reserve(BlockSize + 1024 * 1024);
+    for (qint64 i = 0; i < count; ++i) {
+        if (binary) {
+            generator.next(block);
+        } else {
+            tx.resize(0);
+            generator.next(tx);
+            block.append(tx.toHex());
+            block.append('\n');
+        }
+        if (block.size() >= BlockSize) {
+            out.write(block);
+            block.resize(0);
+        }
+    }
+    out.write(block);
+    return 0;
+}
+}
+
 int main(int x, char **y) {
     QCoreApplication app(x, y);
     QCoreApplication::setApplicationName("Transactions");
@@ -40,13 +530,104 @@ int main(int x, char **y) {
 
     QCommandLineOption debug(QStringList() << "d" << "debug", "Show content of the transaction" );
     parser.addOption(debug);
+    QCommandLineOption batch("batch", "convert many transactions. The source is a file with one hex transaction per line, a directory of raw transaction files or blk*.dat block files, outputs get one hex transaction per line");
+    parser.addOption(batch);
+    QCommandLineOption archiveOption("archive", "batch: also write the v4 transactions with signatures to an archive file, indexed by txid", "file");
+    parser.addOption(archiveOption);
+    QCommandLineOption lookupOption("lookup", "show the transaction with this txid from the archive given as argument", "txid");
+    parser.addOption(lookupOption);
+    QCommandLineOption ioOption("io", "batch: how to read a directory of raw transaction files; 'uring', 'threads', 'sync' or the default 'auto', which uses io_uring when the kernel supports it", "backend");
+    parser.addOption(ioOption);
+    QCommandLineOption threads("threads", "amount of worker threads used in batch mode", "count");
+    parser.addOption(threads);
+    QCommandLineOption arena("arena", "batch: parse into per-thread arenas, avoiding most memory allocations");
+    parser.addOption(arena);
+    QCommandLineOption hugePages("huge-pages", "batch: like --arena, with the arenas backed by huge pages if possible");
+    parser.addOption(hugePages);
+    QCommandLineOption roundTrip("roundtrip", "check that legacy transactions from the source survive being written as legacy and as v4, the source is read like in batch mode");
+    parser.addOption(roundTrip);
+    QCommandLineOption legacy("legacy", "write out-with-sign in the legacy format instead of v4");
+    parser.addOption(legacy);
+    QCommandLineOption valueStats("value-stats", "print the total value, dust count, value histogram and script types of the outputs of the source, which is read like in batch mode");
+    parser.addOption(valueStats);
+    QCommandLineOption scriptStats("script-stats", "count the output scripts of the source per standard type, with their size and value. The source is read like in batch mode");
+    parser.addOption(scriptStats);
+    QCommandLineOption sizeStats("size-stats", "compare the legacy, v4 and v4 without signatures sizes of the transactions of the source, which is read like in batch mode. The sizes of each transaction are written to the optional second argument as CSV");
+    parser.addOption(sizeStats);
+    QCommandLineOption fees("fees", "calculate the fee and fee rate of the transactions of the source, which is read like in batch mode and has to be in chain order. The fee of each transaction is written to the optional second argument as CSV");
+    parser.addOption(fees);
+    QCommandLineOption verify("verify", "verify the signatures of the P2PKH, P2PK and P2SH multisig inputs of the source, which is read like in batch mode. The result of each input is written to the optional second argument as CSV");
+    parser.addOption(verify);
+    QCommandLineOption dumpOption("dump", "write the transactions of the source, which is read like in batch mode, as 'json' lines or in a 'binary' record format to the file given as second argument, or stdout", "format");
+    parser.addOption(dumpOption);
+    QCommandLineOption toColumns("to-columns", "write the transactions of the source, which is read like in batch mode, by column to the file given as second argument");
+    parser.addOption(toColumns);
+    QCommandLineOption fromColumns("from-columns", "write the transactions of the columnar file given as argument as hex lines to the optional second argument, or stdout");
+    parser.addOption(fromColumns);
+    QCommandLineOption sumColumnsOption("sum-columns", "print the total output value of the columnar file given as argument, only reading its value columns");
+    parser.addOption(sumColumnsOption);
+    QCommandLineOption txids("txids", "print the txid of each transaction of the source, which is read like in batch mode");
+    parser.addOption(txids);
+    QCommandLineOption generateOption("generate", "write <count> synthetic transactions to the file given as first argument, as hex lines", "count");
+    parser.addOption(generateOption);
+    QCommandLineOption seed("seed", "generate: the random seed, the same seed gives the same transactions", "number", "1");
+    parser.addOption(seed);
+    QCommandLineOption binary("binary", "generate: write the raw transactions concatenated instead of as hex lines");
+    parser.addOption(binary);
+    QCommandLineOption inputs("inputs", "generate: the input count, a number, a range like 1-5 or geo:MEAN", "distribution");
+    parser.addOption(inputs);
+    QCommandLineOption outputs("outputs", "generate: the output count, a number, a range like 1-5 or geo:MEAN", "distribution");
+    parser.addOption(outputs);
+    QCommandLineOption pushSizes("push-sizes", "generate: the OP_RETURN data size, a number, a range like 1-70000 or geo:MEAN", "distribution");
+    parser.addOption(pushSizes);
+    QCommandLineOption templates("templates", "generate: the weights of the script templates, like p2pkh=70,p2sh=20,multisig=5,opreturn=5", "weights");
+    parser.addOption(templates);
+    QCommandLineOption txVersions("tx-versions", "generate: comma separated transaction versions to create, out of 1, 2 and 4", "list");
+    parser.addOption(txVersions);
+    QCommandLineOption selfTest("selftest", "check the optimized code paths against their reference implementations");
+    parser.addOption(selfTest);
 
     parser.process(app);
+    if (parser.isSet(selfTest)) {
+        QTextStream out(stdout);
+        return SelfTest::run(out) ? 0 : 1;
+    }
     const QStringList args = parser.positionalArguments();
     if (args.isEmpty())
         parser.showHelp(1);
 
+    if (parser.isSet(generateOption))
+        return generate(parser, args.at(0));
+
+    if (parser.isSet(lookupOption))
+        return lookup(args.at(0), parser.value(lookupOption));
+    if (parser.isSet(toColumns))
+        return writeColumns(args);
+    if (parser.isSet(fromColumns))
+        return readColumns(args);
+    if (parser.isSet(sumColumnsOption))
+        return sumColumns(args.at(0), parser.value(threads).toInt());
+    if (parser.isSet(txids))
+        return printTxids(args.at(0));
+    if (parser.isSet(valueStats))
+        return printValueStatistics(args.at(0));
+    if (parser.isSet(scriptStats))
+        return printScriptStatistics(args.at(0), parser.value(threads).toInt());
+    if (parser.isSet(dumpOption))
+        return dump(args, parser.value(dumpOption));
+    if (parser.isSet(sizeStats))
+        return printSizeStatistics(args, parser.value(threads).toInt());
+    if (parser.isSet(fees))
+        return printFeeStatistics(args, parser.value(threads).toInt());
+    if (parser.isSet(verify))
+        return verifySignatures(args, parser.value(threads).toInt());
+    if (parser.isSet(roundTrip))
+        return checkRoundTrip(args.at(0), parser.value(threads).toInt());
+
     Transaction::Lint parsingType = parser.isSet(lint) ? Transaction::StrictParsing : Transaction::LenientParsing;
+    if (parser.isSet(batch))
+        return batchConvert(args, parsingType, parser.value(threads).toInt(), parser.isSet(arena), parser.isSet(hugePages),
+                            parser.value(archiveOption), parser.value(ioOption));
 
     Transaction t;
     bool success;
@@ -61,11 +642,17 @@ int main(int x, char **y) {
         return 1;
 
     if (parser.isSet(debug)) {
-        t.debug();
+        QByteArray data;
         if (parser.isSet(rawtx)) {
-            QByteArray data = QByteArray::fromHex(args.at(0).toLatin1());
-            qDebug() << "size:" << data.length();
+            data = QByteArray::fromHex(args.at(0).toLatin1());
+        } else {
+            QFile in(args.at(0));
+            if (in.open(QIODevice::ReadOnly))
+                data = in.readAll();
         }
+        t.debug(Transaction::txid(data));
+        if (parser.isSet(rawtx))
+            qDebug() << "size:" << data.length();
     }
 
     if (args.count() > 1) {
@@ -74,7 +661,10 @@ int main(int x, char **y) {
             qWarning() << "Outfile 1 exists, exiting";
             return 1;
         }
-        t.writev4(args[1], true);
+        if (parser.isSet(legacy))
+            t.writeLegacy(args[1]);
+        else
+            t.writev4(args[1], true);
     }
     if (args.count() > 2) {
         QFileInfo fi(args[2]);
@@ -5,11 +5,72 @@ INCLUDEPATH += . support/cppQt
 # Input
 HEADERS += StreamMethods.h Transaction.h \
     CMF.h \
+    CMFSchema.h \
     MessageBuilder.h \
-    MessageParser.h
+    MessageParser.h \
+    CorpusReader.h \
+    TransactionView.h \
+    BlockFileReader.h \
+    BatchConverter.h \
+    SelfTest.h \
+    TransactionGenerator.h \
+    Sha256.h \
+    RoundTripChecker.h \
+    Arena.h \
+    ArenaTransaction.h \
+    V4Writer.h \
+    TransactionBatch.h \
+    ScriptTokenizer.h \
+    ScriptClassifier.h \
+    ScriptStatistics.h \
+    SizeStatistics.h \
+    BufferedWriter.h \
+    StructuredWriter.h \
+    SignatureHash.h \
+    Ripemd160.h \
+    Secp256k1.h \
+    SignatureVerifier.h \
+    UtxoIndex.h \
+    FeeStatistics.h \
+    ArchiveWriter.h \
+    TransactionArchive.h \
+    ColumnarWriter.h \
+    ColumnarArchive.h \
+    BoundedQueue.h \
+    RawFileLoader.h \
+    ChunkedCorpus.h
 
 SOURCES += main.cpp StreamMethods.cpp Transaction.cpp \
     CMF.cpp \
     MessageBuilder.cpp \
-    MessageParser.cpp
+    MessageParser.cpp \
+    CorpusReader.cpp \
+    TransactionView.cpp \
+    BlockFileReader.cpp \
+    BatchConverter.cpp \
+    SelfTest.cpp \
+    TransactionGenerator.cpp \
+    Sha256.cpp \
+    RoundTripChecker.cpp \
+    Arena.cpp \
+    ArenaTransaction.cpp \
+    TransactionBatch.cpp \
+    ScriptTokenizer.cpp \
+    ScriptClassifier.cpp \
+    ScriptStatistics.cpp \
+    SizeStatistics.cpp \
+    BufferedWriter.cpp \
+    StructuredWriter.cpp \
+    SignatureHash.cpp \
+    Ripemd160.cpp \
+    Secp256k1.cpp \
+    SignatureVerifier.cpp \
+    UtxoIndex.cpp \
+    FeeStatistics.cpp \
+    ArchiveWriter.cpp \
+    TransactionArchive.cpp \
+    ColumnarWriter.cpp \
+    ColumnarArchive.cpp \
+    RawFileLoader.cpp \
+    ChunkedCorpus.cpp
 